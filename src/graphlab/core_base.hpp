@@ -103,6 +103,9 @@ namespace graphlab {
      *                     be started with multiple "simulated threads".
      *                     The simulation is low-fidelity however, and should
      *                     be used with caution.
+     *  \li \b "synchronous" Bulk synchronous supersteps. Updates read
+     *                     their neighbors as of the previous superstep
+     *                     and may only write their vertex and in-edges.
      */
     virtual void set_engine_type(const std::string& engine_type) = 0;
     
@@ -117,6 +117,13 @@ class distributed_chromatic_engine : public iengine<Graph> {
   size_t task_budget;
   
   size_t randomize_schedule;
+
+  /** If set, the interior of each color runs during the color barrier */
+  size_t pipelined_sync;
+
+  /** If set, colors other than the last end in a barrier among
+      neighboring machines instead of a full barrier */
+  size_t neighborhood_barrier;
   
   /** If dynamic scheduling is used, the number of scheduled tasks */
   atomic<size_t> num_pending_tasks;
@@ -128,6 +135,9 @@ class distributed_chromatic_engine : public iengine<Graph> {
   scope_range::scope_range_enum default_scope_range;
  
   std::vector<std::vector<vertex_id_t> > color_block; // set of localvids in each color
+  std::vector<size_t> color_boundary_size; // the first color_boundary_size[c]
+                                           // localvids of color_block[c] are
+                                           // on the boundary
   dense_bitset scheduled_vertices;  // take advantage that local vertices
                                     // are always the first N
   
@@ -182,6 +192,8 @@ class distributed_chromatic_engine : public iengine<Graph> {
                             force_stop(false),
                             task_budget(0),
                             randomize_schedule(0),
+                            pipelined_sync(0),
+                            neighborhood_barrier(0),
                             termination_reason(EXEC_UNSET),
                             scheduled_vertices(graph.owned_vertices().size()),
                             update_function(NULL),
@@ -404,22 +416,33 @@ class distributed_chromatic_engine : public iengine<Graph> {
     // we have to perform to synchronize modifications to that vertex
 
 
+    // boundary vertices and interior vertices are kept apart. Each
+    // color block lists its boundary vertices first.
     std::vector<std::vector<std::pair<size_t, vertex_id_t> > > color_block_and_weight;
+    std::vector<std::vector<std::pair<size_t, vertex_id_t> > > interior_block_and_weight;
     const size_t num_colors(graph.recompute_num_colors());
     // the list of vertices for each color
     color_block_and_weight.resize(num_colors);
+    interior_block_and_weight.resize(num_colors);
     
     foreach(vertex_id_t v, graph.owned_vertices()) {
-      color_block_and_weight[graph.get_color(v)].push_back(
-                                    std::make_pair(graph.globalvid_to_replicas(v).size(), 
-                                              graph.globalvid_to_localvid(v)));
+      std::vector<std::pair<size_t, vertex_id_t> >& block = 
+                                    graph.on_boundary(v) ? 
+                                        color_block_and_weight[graph.get_color(v)] :
+                                        interior_block_and_weight[graph.get_color(v)];
+      block.push_back(std::make_pair(graph.globalvid_to_replicas(v).size(), 
+                                     graph.globalvid_to_localvid(v)));
     }
     color_block.clear();
     color_block.resize(num_colors);
+    color_boundary_size.clear();
+    color_boundary_size.resize(num_colors);
     if (randomize_schedule) {
       for (size_t i = 0; i < color_block_and_weight.size(); ++i) {
         random::shuffle(color_block_and_weight[i].begin(),
                             color_block_and_weight[i].end());
+        random::shuffle(interior_block_and_weight[i].begin(),
+                            interior_block_and_weight[i].end());
       }
     }
     else {
@@ -434,10 +457,15 @@ class distributed_chromatic_engine : public iengine<Graph> {
 
     // insert the sorted vertices into the final color_block
     for (size_t i = 0;i < color_block_and_weight.size(); ++i ) {  
+      color_boundary_size[i] = color_block_and_weight[i].size();
       std::transform(color_block_and_weight[i].begin(),
                     color_block_and_weight[i].end(), 
                     std::back_inserter(color_block[i]),
                     __gnu_cxx::select2nd<std::pair<size_t, vertex_id_t> >());
+      std::transform(interior_block_and_weight[i].begin(),
+                    interior_block_and_weight[i].end(), 
+                    std::back_inserter(color_block[i]),
+                    __gnu_cxx::select2nd<std::pair<size_t, vertex_id_t> >());
     }
     
   }
@@ -446,6 +474,8 @@ class distributed_chromatic_engine : public iengine<Graph> {
  private:
 
   atomic<size_t> curidx;
+  /// the next vertex of the interior of the color (pipelined_sync only)
+  atomic<size_t> interioridx;
   barrier thread_color_barrier;
  public: 
   
@@ -530,16 +560,12 @@ class distributed_chromatic_engine : public iengine<Graph> {
       for (size_t i = 0;i < active_sync_tasks.size(); ++i) {
         sync_task* task = active_sync_tasks[i];
         procid_t target = task->sharedvariable->preferred_machine();
-        std::vector<any> gathervals(rmi.numprocs());
-        gathervals[rmi.procid()] = task->mergeval;
-        rmi.gather(gathervals, target);
+        // merge up a tree onto the target so that the target does
+        // not receive a value from every machine
+        rmi.reduce(task->mergeval, target, task->merge_fun);
 
-        // now if I am target I need to do the final merge and apply
+        // now if I am target I need to apply
         if (target == rmi.procid()) {
-          task->mergeval = gathervals[0];
-          for (size_t i = 1; i < gathervals.size(); ++i) {
-            task->merge_fun(task->mergeval, gathervals[i]);
-          }
           // apply!!!
           task->sharedvariable->apply(task->apply_fun, task->mergeval);
           numsyncs.inc();
@@ -636,6 +662,47 @@ class distributed_chromatic_engine : public iengine<Graph> {
     return reason_and_task.second;
   }
  
+  /**
+   * Runs the vertices color_block[c][begin] to color_block[c][end - 1].
+   * The threads share the vertices through idx, which must be 0 on entry
+   * and is left past the range.
+   */
+  void run_color_range(size_t c, size_t begin, size_t end,
+                       atomic<size_t>& idx,
+                       dgraph_scope<Graph>& scope,
+                       size_t threadid,
+                       bool usestatic,
+                       bool hassynctasks) {
+    while(1) {
+      // grab a vertex  
+      size_t i = begin + idx.inc_ret_last();  
+      // if index out of scope, we are done with this range. break
+      if (i >= end) break;
+      // otherwise, get the local and globalvid
+      vertex_id_t localvid = color_block[c][i];
+      vertex_id_t globalvid = graph.localvid_to_globalvid(color_block[c][i]);
+      if (usestatic || scheduled_vertices.clear_bit(localvid)) {
+        if (!usestatic) num_pending_tasks.dec();
+        // otherwise. run the vertex
+        // create the scope
+        scope.init(&graph, globalvid);
+        // run the update function
+        update_function(scope, callback);
+        // check if there are tasks to run
+        if (hassynctasks) eval_syncs(globalvid, scope, threadid);
+        scope.commit_async_untracked();
+        update_counts[threadid]++;
+      }
+      else {
+        // ok this vertex is not scheduled. But if there are syncs
+        // to run I will still need to get the scope
+        scope.init(&graph, globalvid);
+        if (hassynctasks) eval_syncs(globalvid, scope, threadid);
+        scope.commit_async_untracked();
+      }
+    }
+  }
+
   void start_thread(size_t threadid) {
     // create the scope
     dgraph_scope<Graph> scope;
@@ -653,54 +720,52 @@ class distributed_chromatic_engine : public iengine<Graph> {
       bool hassynctasks = active_sync_tasks.size() > 0;
       // loop over colors    
       for (size_t c = 0;c < color_block.size(); ++c) {
-        // internal loop over vertices in the color
-        while(1) {
-          // grab a vertex  
-          size_t i = curidx.inc_ret_last();  
-          // if index out of scope, we are done with this color. break
-          if (i >= color_block[c].size()) break;
-          // otherwise, get the local and globalvid
-          vertex_id_t localvid = color_block[c][i];
-          vertex_id_t globalvid = graph.localvid_to_globalvid(color_block[c][i]);
-          if (usestatic || scheduled_vertices.clear_bit(localvid)) {
-            if (!usestatic) num_pending_tasks.dec();
-            // otherwise. run the vertex
-            // create the scope
-            scope.init(&graph, globalvid);
-            // run the update function
-            update_function(scope, callback);
-            // check if there are tasks to run
-            if (hassynctasks) eval_syncs(globalvid, scope, threadid);
-            scope.commit_async_untracked();
-            update_counts[threadid]++;
-          }
-          else {
-            // ok this vertex is not scheduled. But if there are syncs
-            // to run I will still need to get the scope
-            scope.init(&graph, globalvid);
-            if (hassynctasks) eval_syncs(globalvid, scope, threadid);
-            scope.commit_async_untracked();
-          }
-        }
+        // the boundary vertices read ghosts written in the previous
+        // color, so they wait for its barrier. Without pipelining
+        // the whole color is treated as boundary. So it is with full
+        // consistency, since an interior vertex may then write to a
+        // neighbor on the boundary.
+        const size_t nboundary = (pipelined_sync && const_nbr_vertices) ? 
+                                      color_boundary_size[c] :
+                                      color_block[c].size();
+        run_color_range(c, 0, nboundary, curidx, scope, threadid,
+                        usestatic, hassynctasks);
         // wait for all threads to synchronize on this color.
         thread_color_barrier.wait();
-        curidx.value = 0;
         // full barrier on the color
         // this will complete synchronization of all add tasks as well
         if (threadid == 0) {
+          curidx.value = 0;
           ti.start();
           graph.wait_for_all_async_syncs();
-          // TODO! If synchronize() calls were made then this barrier is necessary
-          // but the time needed to figure out if a synchronize call is required 
-          // could be as long as the barrier itself
-          if (const_nbr_vertices == false || const_edges == false)  rmi.dc().barrier();
-          rmi.dc().full_barrier();
+          if (neighborhood_barrier && c + 1 < color_block.size()) {
+            // the ghost pushes and the add_tasks of neighbors only
+            // come from neighboring machines. The last color still
+            // takes a full barrier so that the termination check
+            // sees every task.
+            graph.neighborhood_barrier();
+            rmi.neighborhood_barrier(graph.neighbor_procs());
+          }
+          else {
+            // TODO! If synchronize() calls were made then this barrier is necessary
+            // but the time needed to figure out if a synchronize call is required 
+            // could be as long as the barrier itself
+            if (const_nbr_vertices == false || const_edges == false)  rmi.dc().barrier();
+            rmi.dc().full_barrier();
+          }
           num_dist_barriers_called++;
           //std::cout << rmi.procid() << ": Full Barrier at end of color" << std::endl;
           barrier_time += ti.current_time();
         }
+        // interior vertices have no ghost neighbors and no replicas.
+        // They neither wait for nor generate communication, so the
+        // other threads run them while thread 0 is in the barrier.
+        run_color_range(c, nboundary, color_block[c].size(), interioridx,
+                        scope, threadid, usestatic, hassynctasks);
         thread_color_barrier.wait();
-
+        // nobody touches interioridx again until after the next
+        // boundary phase, which thread 0 also has to complete
+        if (threadid == 0) interioridx.value = 0;
       }
 
 
@@ -758,6 +823,7 @@ class distributed_chromatic_engine : public iengine<Graph> {
 
     // reset indices
     curidx.value = 0;
+    interioridx.value = 0;
     ti.start();
     // spawn threads
     thread_group thrgrp; 
@@ -831,6 +897,8 @@ class distributed_chromatic_engine : public iengine<Graph> {
   void set_engine_options(const scheduler_options& opts) {
     opts.get_int_option("max_iterations", max_iterations);
     opts.get_int_option("randomize_schedule", randomize_schedule);
+    opts.get_int_option("pipelined_sync", pipelined_sync);
+    opts.get_int_option("neighborhood_barrier", neighborhood_barrier);
     any uf;
     if (opts.get_any_option("update_function", uf)) {
       update_function = uf.as<update_function_type>();
@@ -846,11 +914,36 @@ class distributed_chromatic_engine : public iengine<Graph> {
     rmi.barrier();
   }
 
+  /**
+   * If set, only the boundary vertices of a color wait for the
+   * distributed barrier of the previous color. The interior vertices,
+   * whose neighbors are all owned by this machine, run while the
+   * barrier is in progress.
+   * Must be called by all machines simultaneously.
+   */
+  void set_pipelined_sync(bool pipelined_sync_) {
+    pipelined_sync = pipelined_sync_;
+    rmi.barrier();
+  }
+
+  /**
+   * If set, the end of every color but the last waits only for the
+   * machines sharing ghosts with this one, rather than for all
+   * machines. The update function must then only schedule vertices
+   * in its scope. Must be called by all machines simultaneously.
+   */
+  void set_neighborhood_barrier(bool neighborhood_barrier_) {
+    neighborhood_barrier = neighborhood_barrier_;
+    rmi.barrier();
+  }
+
   
   
   static void print_options_help(std::ostream &out) {
     out << "max_iterations = [integer, default = 0]\n";
     out << "randomize_schedule = [integer, default = 0]\n";
+    out << "pipelined_sync = [integer, default = 0]\n";
+    out << "neighborhood_barrier = [integer, default = 0]\n";
     out << "update_function = [update_function_type,"
       "default = set on add_task]\n";
   };
@@ -54,6 +54,7 @@
 #include <graphlab/distributed2/graph/chandy_misra_lock.hpp>
 #include <graphlab/distributed2/graph/distributed_mutex_lock.hpp>
 #include <graphlab/distributed2/snapshot_task.hpp>
+#include <graphlab/distributed2/snapshot_writer.hpp>
 #include <unistd.h>
 #include <graphlab/macros_def.hpp>
 
@@ -130,21 +131,20 @@ class distributed_locking_engine:public iengine<Graph> {
     
     void save_vertex(vertex_id_t vid, const typename Graph::vertex_data_type &vdata) {
       vertex_id_t localvid = eng->graph.globalvid_to_localvid(vid);
-      eng->snapshot2_targets[threadid]->add_vertex_with_data(vid,
-                                                            eng->graph.localvid_to_source_atom(localvid),
-                                                            serialize_to_string(vdata));
-                                                            
+      eng->snapshot2_out.add_vertex(vid,
+                                    eng->graph.localvid_to_source_atom(localvid),
+                                    vdata);
       eng->graph.get_local_store().set_vertex_snapshot_req(localvid, false);
 
     }
     
     void save_edge(edge_id_t eid, vertex_id_t srcvid, vertex_id_t targetvid,
                    const typename Graph::edge_data_type &edata) {
-      eng->snapshot2_targets[threadid]->add_edge_with_data(srcvid,
-                                                          eng->graph.globalvid_to_source_atom(srcvid),
-                                                          targetvid,
-                                                          eng->graph.globalvid_to_source_atom(targetvid),
-                                                          serialize_to_string(edata));
+      eng->snapshot2_out.add_edge(srcvid,
+                                  eng->graph.globalvid_to_source_atom(srcvid),
+                                  targetvid,
+                                  eng->graph.globalvid_to_source_atom(targetvid),
+                                  edata);
       eng->graph.get_local_store().set_edge_snapshot_req(eid, false);
     }
 
@@ -204,6 +204,8 @@ class distributed_locking_engine:public iengine<Graph> {
   size_t snapshot_interval_updates;
   size_t last_snapshot;
   size_t snapshot_number;
+  // written in the background so the vertex locks can be released early
+  gl_impl::snapshot_writer<Graph> snapshot_out;
   
   /** Parameters for snapshot algorithm 2: asynchronous snapshotting */
   mutex snapshot2_lock;
@@ -212,7 +214,7 @@ class distributed_locking_engine:public iengine<Graph> {
   size_t snapshot2_number;
   atomic<size_t> snapshot2_remaining_vertices;
   update_function_type snapshot2_update;
-  std::vector<write_only_disk_atom*> snapshot2_targets;
+  gl_impl::snapshot_writer<Graph> snapshot2_out;
   // this is EXTREMELY annoying. I need to tack on an additional bit of information
   // to each vertex. But other than requiring intrusive access to user data,
   // there is no easy way to this. Therefore I need to keep my own bitset and maintain
@@ -251,6 +253,8 @@ class distributed_locking_engine:public iengine<Graph> {
   std::vector<deferred_tasks> vertex_deferred_tasks;
   atomic<size_t> num_deferred_tasks;
   size_t max_deferred_tasks;
+  /// Buffered lock messages are sent at least this often (microseconds)
+  static const size_t LOCK_FLUSH_INTERVAL_USEC = 1000;
 
   blocking_queue<vertex_id_t> ready_vertices;
   
@@ -662,16 +666,12 @@ class distributed_locking_engine:public iengine<Graph> {
       for (size_t i = 0;i < active_sync_tasks.size(); ++i) {
         sync_task* task = active_sync_tasks[i];
         procid_t target = task->sharedvariable->preferred_machine();
-        std::vector<any> gathervals(rmi.numprocs());
-        gathervals[rmi.procid()] = task->mergeval;
-        reduction_services.gather(gathervals, target, true);
+        // merge up a tree onto the target so that the target does
+        // not receive a value from every machine
+        reduction_services.reduce(task->mergeval, target, task->merge_fun, true);
 
-        // now if I am target I need to do the final merge and apply
+        // now if I am target I need to apply
         if (target == rmi.procid()) {
-          task->mergeval = gathervals[0];
-          for (size_t i = 1; i < gathervals.size(); ++i) {
-            task->merge_fun(task->mergeval, gathervals[i]);
-          }
           // apply!!!
           task->sharedvariable->apply(task->apply_fun, task->mergeval);
           numsyncs.inc();
@@ -951,26 +951,22 @@ class distributed_locking_engine:public iengine<Graph> {
   
     snapshot_synchronization_time = ti.current_time();  
   
-    int items_added = 0;
-    #pragma omp parallel reduction(+:items_added)
+    // Copy the modified data into the log. The writer thread serializes
+    // and writes it after the locks have been released
+    snapshot_out.open(snapshot_filename(snapshot_number, 0, 1), rmi.procid());
+    #pragma omp parallel
     {
       size_t thread_id = omp_get_thread_num();
       size_t numthreads = omp_get_num_threads();
-      // Go ahead and open files for the snapshot
-      const std::string filename = snapshot_filename(snapshot_number,thread_id,numthreads);
-      write_only_disk_atom atom(filename, rmi.procid(), true);
-      // Wait for the syncs to finish
-
       // Save the local vertex data. Only take owned vertices
       for(local_vertex_id_type localvid = thread_id; 
           localvid < graph_local_store.num_vertices(); localvid+=numthreads) {
         if(graph.localvid_is_ghost(localvid) == false &&
           graph_local_store.vertex_snapshot_req(localvid)) {
-          atom.add_vertex_with_data(graph.localvid_to_globalvid(localvid),
-                                    graph.localvid_to_source_atom(localvid),
-                                    serialize_to_string(graph_local_store.vertex_data(localvid)));
+          snapshot_out.add_vertex(graph.localvid_to_globalvid(localvid),
+                                  graph.localvid_to_source_atom(localvid),
+                                  graph_local_store.vertex_data(localvid));
           graph_local_store.set_vertex_snapshot_req(localvid, false);
-          ++items_added;
         }
       } // end of for loop over local vids
       
@@ -981,18 +977,17 @@ class distributed_locking_engine:public iengine<Graph> {
           graph_local_store.edge_snapshot_req(localeid)) {
           vertex_id_t localsource = graph_local_store.source(localeid);
           vertex_id_t localtarget = graph_local_store.target(localeid);
-          atom.add_edge_with_data(graph.localvid_to_globalvid(localsource),
-                                  graph.localvid_to_source_atom(localsource),
-                                  graph.localvid_to_globalvid(localtarget),
-                                  graph.localvid_to_source_atom(localtarget),
-                                  serialize_to_string(graph_local_store.edge_data(localeid)));
+          snapshot_out.add_edge(graph.localvid_to_globalvid(localsource),
+                                graph.localvid_to_source_atom(localsource),
+                                graph.localvid_to_globalvid(localtarget),
+                                graph.localvid_to_source_atom(localtarget),
+                                graph_local_store.edge_data(localeid));
           graph_local_store.set_edge_snapshot_req(localeid, false);
-          ++items_added;
         }
       } // end of for loop over local eids
-      atom.synchronize();
     }
-    sync();
+    size_t items_added = snapshot_out.num_records();
+    snapshot_out.close();
     snapshot_end_time = ti.current_time();
     std::cout << "Snapshot "<< snapshot_number << " Items added in snapshot: " << items_added << std::endl;
     ++snapshot_number;
@@ -1013,12 +1008,7 @@ class distributed_locking_engine:public iengine<Graph> {
 */
   void initialize_snapshot2(bool sense, size_t snapshot_number) {  
     snapshot2_lock.lock();
-    for (size_t i = 0;i < snapshot2_targets.size(); ++i) {
-      snapshot2_targets[i] = new write_only_disk_atom(
-                                      snapshot_filename(snapshot_number, i, ncpus), 
-                                      rmi.procid(), 
-                                      true);
-    }
+    snapshot2_out.open(snapshot_filename(snapshot_number, 0, 1), rmi.procid());
     snapshot2_number = snapshot_number;
     snapshot2_remaining_vertices.value = graph.owned_vertices().size();
     // flip the sense last
@@ -1122,12 +1112,18 @@ class distributed_locking_engine:public iengine<Graph> {
     
     boost::function<void(vertex_id_t)> handler = 
       boost::bind(&distributed_locking_engine<Graph, Scheduler>::vertex_is_ready, this, _1);
+    // the lock may buffer its messages. Bound how long they wait
+    size_t last_lock_flush = timer::usec_of_day();
       
     while(1) {
       if (termination_reason != EXEC_UNSET) {
         consensus.force_done();
         break;
       }
+      if (timer::usec_of_day() >= last_lock_flush + LOCK_FLUSH_INTERVAL_USEC) {
+        graphlock->flush();
+        last_lock_flush = timer::usec_of_day();
+      }
       // task executor will loop until #tasks is < lower_threshold
       size_t lower_threshold = max_deferred_tasks;
       bool upperlimit_exceeded = false;
@@ -1147,6 +1143,7 @@ class distributed_locking_engine:public iengine<Graph> {
         }
         
         if (stat == sched_status::EMPTY && num_deferred_tasks.value == 0) {
+          graphlock->flush();
           bool ret = try_to_quit(threadid, stat, task);
           if (ret == true) break;
           if (ret == false && stat == sched_status::EMPTY) {
@@ -1192,6 +1189,9 @@ class distributed_locking_engine:public iengine<Graph> {
         std::pair<vertex_id_t, bool> job = ready_vertices.try_dequeue();
         while (termination_reason == EXEC_UNSET && 
           job.second == false && num_deferred_tasks.value > lower_threshold) {
+          // nothing to run until some lock completes
+          graphlock->flush();
+          last_lock_flush = timer::usec_of_day();
           ready_vertices.try_timed_wait_for_data(1000000,1);
           job = ready_vertices.try_dequeue();
         }
@@ -1211,17 +1211,14 @@ class distributed_locking_engine:public iengine<Graph> {
           // am I scheduled?
           if (snapshot2_tokens.get(curv) != snapshot2_sense) {
             scope.init(&graph, globalvid);
-            ASSERT_TRUE(snapshot2_targets[threadid] != NULL);
+            ASSERT_TRUE(snapshot2_out.is_open());
             snapshot2_update(scope, snapshot2_callback);
             ASSERT_EQ(snapshot2_tokens.get(curv), snapshot2_sense);
             if (snapshot2_remaining_vertices.dec() == 0) {
+              // the writer finishes the file in the background
               snapshot2_lock.lock();
-              for (size_t i = 0;i < snapshot2_targets.size(); ++i) {
-                delete snapshot2_targets[i];
-                snapshot2_targets[i] = NULL;
-              }
+              snapshot2_out.close();
               snapshot2_lock.unlock();
-              sync();
               logger(LOG_DEBUG, "Local Snapshot complete!");
             }
           }
@@ -1322,7 +1319,6 @@ class distributed_locking_engine:public iengine<Graph> {
    
     if (snapshot2_interval_updates > 0) {
       snapshot2_tokens.resize(graph.get_local_store().num_vertices());
-      snapshot2_targets.resize(ncpus, NULL);
       snapshot2_tokens.clear();
     }
     reduction_stop = false; 
@@ -1399,6 +1395,16 @@ class distributed_locking_engine:public iengine<Graph> {
     reduction_cond.broadcast();
     reduction_mut.unlock();
     thrgrp_reduction.join();    
+    // make sure every snapshot written during this run is on disk
+    snapshot_out.wait();
+    if (snapshot2_remaining_vertices.value > 0) {
+      // the run ended part way through an asynchronous snapshot
+      logstream(LOG_WARNING) << "Discarding incomplete snapshot " 
+                             << snapshot2_number << std::endl;
+      snapshot2_out.abandon();
+    }
+    snapshot2_out.close();
+    snapshot2_out.wait();
     rmi.barrier();
     
     if (termination_reason == EXEC_UNSET) termination_reason = EXEC_TASK_DEPLETION;
@@ -1433,6 +1439,10 @@ class distributed_locking_engine:public iengine<Graph> {
     // get RMI statistics
     std::map<std::string, size_t> ret = rmi.gather_statistics();
 
+    std::vector<std::map<std::string, size_t> > lockstats(rmi.numprocs());
+    lockstats[rmi.procid()] = graphlock->get_statistics();
+    rmi.gather(lockstats, 0);
+
     if (rmi.procid() == 0) {
       total_update_count = 0;
       engine_metrics.add("runtime",
@@ -1481,6 +1491,23 @@ class distributed_locking_engine:public iengine<Graph> {
       engine_metrics.set("total_calls_sent", ret["total_calls_sent"], INTEGER);
       engine_metrics.set("total_bytes_sent", ret["total_bytes_sent"], INTEGER);
       total_bytes_sent = ret["total_bytes_sent"];
+      
+      // summed over all machines
+      std::map<std::string, size_t> totallockstats;
+      for (size_t i = 0; i < lockstats.size(); ++i) {
+        std::map<std::string, size_t>::const_iterator iter = lockstats[i].begin();
+        for (; iter != lockstats[i].end(); ++iter) {
+          totallockstats[iter->first] += iter->second;
+        }
+      }
+      std::map<std::string, size_t>::const_iterator lsiter = totallockstats.begin();
+      for (; lsiter != totallockstats.end(); ++lsiter) {
+        engine_metrics.set(lsiter->first, lsiter->second, INTEGER);
+        if (total_update_count > 0) {
+          engine_metrics.set(lsiter->first + "_per_update", 
+                             double(lsiter->second) / total_update_count);
+        }
+      }
     }
     
     
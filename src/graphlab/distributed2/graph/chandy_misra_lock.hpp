@@ -7,6 +7,7 @@
 #include <graphlab/parallel/parallel_includes.hpp>
 #include <graphlab/rpc/dc_dist_object.hpp>
 #include <graphlab/util/lazy_deque.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
 #include <graphlab/distributed2/graph/distributed_graph.hpp>
 #include <graphlab/distributed2/graph/graph_lock.hpp>
 #include <graphlab/macros_def.hpp>
@@ -15,6 +16,28 @@
 
 namespace graphlab {
 
+  /**
+   * One message of the distributed lock protocol. Messages to the same
+   * machine are sent together in a batch.
+   */
+  struct chandy_misra_message {
+    enum message_type {SCOPE_REQUEST, SCOPE_READY,
+                       FINALIZE_REQUEST, FINALIZE_REPLY,
+                       CANCEL_FINALIZE, SCOPE_UNLOCK};
+    unsigned char type;
+    bool flag;  // the result of a FINALIZE_REPLY
+    vertex_id_t vid;
+    chandy_misra_message() { }
+    chandy_misra_message(unsigned char type, vertex_id_t vid, bool flag):
+                                         type(type), flag(flag), vid(vid) { }
+    void save(oarchive &oarc) const {
+      oarc << type << flag << vid;
+    }
+    void load(iarchive &iarc) {
+      iarc >> type >> flag >> vid;
+    }
+  };
+
   template <typename GraphType>
   class shm_chandy_misra_lock {
    public:
@@ -75,6 +98,8 @@ namespace graphlab {
 
     
     std::vector<vertex_lock_state> vertex_state; 
+    // number of forks handed from one vertex to another
+    atomic<size_t> nforks;
    public:
     shm_chandy_misra_lock(GraphType &g):dgraph(g),
                                         forks_and_state(3 * dgraph.get_local_store().num_edges()), 
@@ -398,9 +423,14 @@ namespace graphlab {
 #ifdef DISTRIBUTED_LOCK_DEBUG
 //      logstream(LOG_DEBUG) << "Tx Fork " << forkid << ": " << localvid << "-->" << local_altvid << std::endl;
 #endif
+      nforks.inc();
       incoming_fork(local_altvid, forkid, rerequest_from);
     }
 
+    size_t num_forks_moved() const {
+      return nforks.value;
+    }
+
 
     
     void print_state() {
@@ -445,6 +475,8 @@ namespace graphlab {
     typedef typename GraphType::edge_id_type   edge_id_type;
     
     
+    typedef chandy_misra_message message_type;
+    
     struct vertex_lock_state {
       mutex lock; // protects this strict
       size_t pending;
@@ -465,8 +497,94 @@ namespace graphlab {
     
     std::vector<vertex_lock_state> vertex_state; 
 
-    // requesting for fork on edge forkid where t
+    /// messages waiting to be sent to one machine on one channel
+    struct outgoing_batch {
+      mutex lock;
+      std::vector<message_type> messages;
+    };
+    /// indexed by destination * LOCK_CHANNELS + channel
+    std::vector<outgoing_batch> outgoing;
+    
+    /// A buffer is flushed as soon as this many messages are waiting
+    static const size_t LOCK_BATCH_SIZE = 128;
+    /// The number of sequentialization keys the lock messages use
+    static const size_t LOCK_CHANNELS = 16;
+    
+    atomic<size_t> nmessages;
+    atomic<size_t> nbatches;
+    
+    /// The channel the lock messages of a vertex are batched on
+    static size_t lock_channel(vertex_id_t globalvid) {
+      return globalvid % LOCK_CHANNELS;
+    }
+
+    /**
+     * The lock messages of a vertex, and the ghost data pushed when it
+     * is unlocked, go out on the sequentialization key of its channel.
+     * They are therefore handled in the order they were sent, even
+     * across batches, while the channels of one sender still spread
+     * over the handler threads.
+     */
+    static unsigned char lock_channel_key(size_t channel) {
+      return (unsigned char)(channel + 1);
+    }
+    
+    // the lock of the buffer must be held, so that batches leave in order
+    void send_batch_locked(procid_t p, size_t channel) {
+      outgoing_batch& batch = outgoing[p * LOCK_CHANNELS + channel];
+      unsigned char prevkey = 
+        rmi.dc().set_sequentialization_key(lock_channel_key(channel));
+      rmi.remote_call(p, 
+                      &chandy_misra_lock<GraphType>::process_batch,
+                      rmi.procid(),
+                      batch.messages);
+      rmi.dc().set_sequentialization_key(prevkey);
+      batch.messages.clear();
+      nbatches.inc();
+    }
     
+    void send_message(procid_t p, unsigned char type, 
+                      vertex_id_t globalvid, bool flag = false) {
+      const size_t channel = lock_channel(globalvid);
+      outgoing_batch& batch = outgoing[p * LOCK_CHANNELS + channel];
+      batch.lock.lock();
+      batch.messages.push_back(message_type(type, globalvid, flag));
+      if (batch.messages.size() >= LOCK_BATCH_SIZE) send_batch_locked(p, channel);
+      batch.lock.unlock();
+      nmessages.inc();
+    }
+    
+    void process_batch(procid_t source, const std::vector<message_type>& messages) {
+      for (size_t i = 0;i < messages.size(); ++i) {
+        const message_type& m = messages[i];
+        switch(m.type) {
+          case message_type::SCOPE_REQUEST:
+            local_scope_request(m.vid, source);
+            break;
+          case message_type::SCOPE_READY:
+            remote_scope_ready(m.vid);
+            break;
+          case message_type::FINALIZE_REQUEST:
+            local_finalize_request(m.vid, source);
+            break;
+          case message_type::FINALIZE_REPLY:
+            remote_finalize_reply_callback(m.vid, m.flag);
+            break;
+          case message_type::CANCEL_FINALIZE:
+            local_cancel_finalize(m.vid);
+            break;
+          case message_type::SCOPE_UNLOCK:
+            local_scope_unlock(m.vid);
+            break;
+          default:
+            ASSERT_MSG(false, "Unknown lock message");
+        }
+      }
+      // replies to the whole batch leave together
+      flush();
+    }
+    
+
    public:    
     void print_state() {
       cmlock.print_state();
@@ -488,7 +606,7 @@ namespace graphlab {
         remote_scope_ready(globalvid);
       }
       else {
-        rmi.remote_call(source, &chandy_misra_lock<GraphType>::remote_scope_ready, globalvid);
+        send_message(source, message_type::SCOPE_READY, globalvid);
       }
     }
    
@@ -511,7 +629,7 @@ namespace graphlab {
         remote_finalize_reply_callback(globalvid, ready);
       }
       else {
-        rmi.remote_call(source, &chandy_misra_lock<GraphType>::remote_finalize_reply_callback, globalvid, ready);
+        send_message(source, message_type::FINALIZE_REPLY, globalvid, ready);
       }
     }
     
@@ -540,7 +658,6 @@ namespace graphlab {
           #ifdef DISTRIBUTED_LOCK_DEBUG
                 logstream(LOG_DEBUG) << "Finalize Failed "<< globalvid << std::endl;
           #endif
-          char prevkey = rmi.dc().set_sequentialization_key((globalvid % 254) + 1);
           const fixed_dense_bitset<MAX_N_PROCS> procs = dgraph.localvid_to_replicas(localvid);
           uint32_t p = 0;
           ASSERT_TRUE(procs.first_bit(p));
@@ -550,12 +667,9 @@ namespace graphlab {
               local_cancel_finalize(globalvid);
             }
             else {
-              rmi.remote_call((procid_t)(p), 
-                              &chandy_misra_lock<GraphType>::local_cancel_finalize,
-                              globalvid);
+              send_message((procid_t)(p), message_type::CANCEL_FINALIZE, globalvid);
             }
           } while(procs.next_bit(p));
-          rmi.dc().set_sequentialization_key(prevkey);
         }
         else {
           #ifdef DISTRIBUTED_LOCK_DEBUG
@@ -599,7 +713,6 @@ namespace graphlab {
       if (done) {
         // issue finalize
         const fixed_dense_bitset<MAX_N_PROCS>& procs = dgraph.localvid_to_replicas(localvid);
-        char prevkey = rmi.dc().set_sequentialization_key((globalvid % 254) + 1);
         uint32_t p = 0;
         ASSERT_TRUE(procs.first_bit(p));
   
@@ -608,12 +721,9 @@ namespace graphlab {
             local_finalize_request(globalvid, rmi.procid());
           }
           else {
-            rmi.remote_call(p, 
-                            &chandy_misra_lock<GraphType>::local_finalize_request, 
-                            globalvid, rmi.procid());
+            send_message(p, message_type::FINALIZE_REQUEST, globalvid);
           }
         }while(procs.next_bit(p));
-        rmi.dc().set_sequentialization_key(prevkey);
       }
     }
     
@@ -637,7 +747,34 @@ namespace graphlab {
                                        rmi(dc, this), 
                                        synchronize_data(synchronize_data),
                                        strict_scope(strict_scope),
-                                       vertex_state(dgraph.get_local_store().num_vertices()){ }
+                                       vertex_state(dgraph.get_local_store().num_vertices()),
+                                       outgoing(dc.numprocs() * LOCK_CHANNELS) { }
+
+    /// Sends every buffered lock message
+    void flush() {
+      for (procid_t p = 0;p < rmi.numprocs(); ++p) {
+        for (size_t c = 0;c < LOCK_CHANNELS; ++c) {
+          outgoing_batch& batch = outgoing[p * LOCK_CHANNELS + c];
+          batch.lock.lock();
+          if (!batch.messages.empty()) send_batch_locked(p, c);
+          batch.lock.unlock();
+        }
+      }
+    }
+
+    /**
+     * Returns the number of forks handed over on this machine
+     * ("forks_moved"), the lock messages sent to other machines
+     * ("lock_messages") and the batches they were sent in
+     * ("lock_batches").
+     */
+    std::map<std::string, size_t> get_statistics() {
+      std::map<std::string, size_t> ret;
+      ret["forks_moved"] = cmlock.num_forks_moved();
+      ret["lock_messages"] = nmessages.value;
+      ret["lock_batches"] = nbatches.value;
+      return ret;
+    }
 
     /**
        Requests a lock on the scope surrounding globalvid.
@@ -663,7 +800,6 @@ namespace graphlab {
       vertex_state[localvid].locked = false;
       vertex_state[localvid].locking = true;
       vertex_state[localvid].has_failed_finalize = false;
-      char prevkey = rmi.dc().set_sequentialization_key((globalvid % 254) + 1);
       vertex_state[localvid].lock.unlock();
       
       uint32_t p = 0;
@@ -673,13 +809,9 @@ namespace graphlab {
           local_scope_request(globalvid, rmi.procid());
         }
         else {
-          rmi.remote_call(p, 
-                          &chandy_misra_lock<GraphType>::local_scope_request, 
-                          globalvid, rmi.procid());
+          send_message(p, message_type::SCOPE_REQUEST, globalvid);
         }
       } while(procs.next_bit(p));
-      
-      rmi.dc().set_sequentialization_key(prevkey);
 
     }
 
@@ -704,12 +836,16 @@ namespace graphlab {
       vertex_id_type localvid = dgraph.globalvid_to_localvid(globalvid);
       
       
-      unsigned char prevkey = 0;
-      bool synchronizing = false;
-      prevkey = rmi.dc().set_sequentialization_key((globalvid % 254) + 1);
+      // the ghost data goes out on the lock channel of the vertex, so
+      // the unlock which is batched behind it cannot overtake it. With
+      // aggregated_send the unlock batch may be sent by another thread,
+      // so the ghost data must leave the buffer of this thread first
       if (synchronize_data && dgraph.on_boundary(globalvid)) {
-        synchronizing = true;
+        unsigned char prevkey = rmi.dc().set_sequentialization_key(
+                                 lock_channel_key(lock_channel(globalvid)));
         dgraph.synchronize_scope(globalvid, true);
+        rmi.dc().set_sequentialization_key(prevkey);
+        rmi.dc().flush_thread();
       }
 
       vertex_state[localvid].lock.lock();
@@ -727,10 +863,9 @@ namespace graphlab {
           local_scope_unlock(globalvid);
         }
         else {
-          rmi.remote_call(p,&chandy_misra_lock<GraphType>::local_scope_unlock, globalvid);
+          send_message(p, message_type::SCOPE_UNLOCK, globalvid);
         }
       }while(procs.next_bit(p));    
-      rmi.dc().set_sequentialization_key(prevkey);
     }
   };
   
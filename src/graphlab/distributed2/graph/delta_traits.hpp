@@ -0,0 +1,160 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#ifndef GRAPHLAB_DELTA_TRAITS_HPP
+#define GRAPHLAB_DELTA_TRAITS_HPP
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * Describes how the distributed graph sends changes to vertex or
+   * edge data of type DataType when delta synchronization is enabled
+   * (see distributed_graph::set_delta_sync). The default sends the
+   * whole value. To send deltas, specialize the traits for the
+   * data type:
+   *
+   * \code
+   * template <>
+   * struct delta_traits<vertex_data> {
+   *   static const bool enabled = true;
+   *   typedef ... delta_type;   // must be serializable
+   *   static bool diff(const vertex_data& oldval, const vertex_data& newval,
+   *                    double tolerance, delta_type& delta);
+   *   static void apply(vertex_data& val, const delta_type& delta);
+   * };
+   * \endcode
+   *
+   * diff() computes in delta the change from oldval to newval, leaving
+   * out whatever changed by no more than tolerance. It returns false
+   * if nothing is left, in which case nothing is sent. apply() makes
+   * the change to val. A replica only ever applies a delta to the
+   * oldval it was computed from.
+   */
+  template <typename DataType>
+  struct delta_traits {
+    static const bool enabled = false;
+    typedef DataType delta_type;
+    static bool diff(const DataType& oldval, const DataType& newval,
+                     double tolerance, delta_type& delta) {
+      delta = newval;
+      return true;
+    }
+    static void apply(DataType& val, const delta_type& delta) {
+      val = delta;
+    }
+  };
+
+
+  /**
+   * The changed entries of a dense vector. For use in delta_traits
+   * specializations of data types holding dense vectors. VecType must
+   * provide size(), resize() and operator[].
+   */
+  template <typename VecType>
+  struct dense_vector_delta {
+    /// The size of the new value
+    uint32_t size;
+    std::vector<std::pair<uint32_t, double> > entries;
+
+    dense_vector_delta(): size(0) { }
+
+    /**
+     * Records the entries of newval which differ from oldval by more
+     * than tolerance. If the size changed, records all the entries of
+     * newval. Returns false if there is nothing to record.
+     */
+    bool diff(const VecType& oldval, const VecType& newval, double tolerance) {
+      size = (uint32_t)newval.size();
+      entries.clear();
+      if ((size_t)oldval.size() != (size_t)newval.size()) {
+        for (size_t i = 0;i < (size_t)newval.size(); ++i) {
+          entries.push_back(std::make_pair((uint32_t)i, double(newval[i])));
+        }
+        return true;
+      }
+      for (size_t i = 0;i < (size_t)newval.size(); ++i) {
+        if (std::fabs(double(newval[i]) - double(oldval[i])) > tolerance) {
+          entries.push_back(std::make_pair((uint32_t)i, double(newval[i])));
+        }
+      }
+      return !entries.empty();
+    }
+
+    /// Resizes val to the new size and writes the recorded entries
+    void apply(VecType& val) const {
+      if ((size_t)val.size() != size) val.resize(size);
+      for (size_t i = 0;i < entries.size(); ++i) {
+        val[entries[i].first] = entries[i].second;
+      }
+    }
+
+    void save(oarchive& oarc) const {
+      oarc << size << entries;
+    }
+
+    void load(iarchive& iarc) {
+      iarc >> size >> entries;
+    }
+  };
+
+
+  /// Dense vectors of doubles send the entries which changed
+  template <>
+  struct delta_traits<std::vector<double> > {
+    static const bool enabled = true;
+    typedef dense_vector_delta<std::vector<double> > delta_type;
+    static bool diff(const std::vector<double>& oldval,
+                     const std::vector<double>& newval,
+                     double tolerance, delta_type& delta) {
+      return delta.diff(oldval, newval, tolerance);
+    }
+    static void apply(std::vector<double>& val, const delta_type& delta) {
+      delta.apply(val);
+    }
+  };
+
+  /// Dense vectors of floats send the entries which changed
+  template <>
+  struct delta_traits<std::vector<float> > {
+    static const bool enabled = true;
+    typedef dense_vector_delta<std::vector<float> > delta_type;
+    static bool diff(const std::vector<float>& oldval,
+                     const std::vector<float>& newval,
+                     double tolerance, delta_type& delta) {
+      return delta.diff(oldval, newval, tolerance);
+    }
+    static void apply(std::vector<float>& val, const delta_type& delta) {
+      delta.apply(val);
+    }
+  };
+
+} // namespace graphlab
+
+#endif
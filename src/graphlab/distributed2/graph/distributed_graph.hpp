@@ -58,6 +58,7 @@
 #include <graphlab/graph/disk_graph.hpp>
 #include <graphlab/distributed2/graph/dgraph_edge_list.hpp>
 #include <graphlab/distributed2/graph/graph_local_store.hpp>
+#include <graphlab/distributed2/graph/delta_traits.hpp>
 #include <graphlab/logger/assertions.hpp>
 
 #include <graphlab/macros_def.hpp>
@@ -261,6 +262,7 @@ namespace graphlab {
       globalvid2owner(dc, 65536),
       pending_async_updates(true, 0),
       pending_push_updates(true, 0),
+      delta_tolerance(0.0),
       graph_metrics("distributed_graph"){
 
                                 
@@ -659,6 +661,24 @@ namespace graphlab {
     bool on_boundary(vertex_id_type vid) const{
       return boundaryscopesset.find(vid) != boundaryscopesset.end();
     }
+
+    /**
+     * The machines which own a ghost in this fragment or hold a ghost
+     * of a vertex owned here. These are the only machines the
+     * synchronization and push functions communicate with.
+     */
+    const std::vector<procid_t>& neighbor_procs() const{
+      return neighborprocs;
+    }
+
+    /**
+     * A full barrier on the graph's RMI calls among neighbor_procs()
+     * only. Must be called by all machines simultaneously.
+     * \see dc_dist_object::neighborhood_barrier
+     */
+    void neighborhood_barrier() {
+      rmi.neighborhood_barrier(neighborprocs);
+    }
  
     const std::vector<vertex_id_type>& ghost_vertices() const{
       return ghostvertices;
@@ -1346,6 +1366,21 @@ namespace graphlab {
   
     /** Waits for all asynchronous push requests to complete */
     void wait_for_all_async_pushes();
+
+    /**
+     * Enables or disables delta synchronization. When enabled, the
+     * push_owned_* functions send a vertex or edge to its replicas as
+     * a delta against what the replicas already hold, if its data type
+     * has a delta_traits specialization. Changes of no more than
+     * tolerance are left out until they add up to more. Data types
+     * without a specialization are sent whole. Costs a copy of every
+     * owned vertex and edge which has a replica.
+     * The replicas must hold the current data when this is called,
+     * as after push_all_owned_vertices_to_replicas() and
+     * push_all_owned_edges_to_replicas().
+     * Must be called by all machines simultaneously.
+     */
+    void set_delta_sync(bool enable, double tolerance = 0.0);
   public:
   
     // extra types
@@ -1366,6 +1401,23 @@ namespace graphlab {
     typedef conditional_store<std::pair<VertexData, uint64_t> >  vertex_conditional_store;
     typedef conditional_store<std::pair<EdgeData, uint64_t> >  edge_conditional_store;
 
+    /// A change to data held at version baseversion, moving it to version
+    template <typename DataType>
+    struct delta_store{
+      uint64_t baseversion;
+      uint64_t version;
+      typename delta_traits<DataType>::delta_type delta;
+      void save(oarchive &oarc) const {
+        oarc << baseversion << version << delta;
+      }
+      void load(iarchive &iarc) {
+        iarc >> baseversion >> version >> delta;
+      }
+    };
+
+    typedef delta_store<VertexData> vertex_delta_store;
+    typedef delta_store<EdgeData> edge_delta_store;
+
   
     struct block_synchronize_request2 {
       std::vector<vertex_id_type> vid;
@@ -1437,6 +1489,9 @@ namespace graphlab {
     std::vector<vertex_id_type> boundaryscopes;
   
     std::vector<fixed_dense_bitset<MAX_N_PROCS> > localvid2ghostedprocs;
+
+    /// machines sharing a ghost with this fragment. \see neighbor_procs()
+    std::vector<procid_t> neighborprocs;
   
     /** To avoid requiring O(V) storage on each maching, the 
      * global_vid -> owner mapping cannot be stored in its entirely locally
@@ -1458,6 +1513,18 @@ namespace graphlab {
 
     dc_impl::reply_ret_type pending_async_updates;
     dc_impl::reply_ret_type pending_push_updates;
+
+    /// Set by set_delta_sync()
+    double delta_tolerance;
+    /** The index into vertex_delta_base of every local vertex.
+     * size_t(-1) if the vertex is not sent as deltas */
+    std::vector<size_t> localvid2deltaslot;
+    /// The data and version of an owned vertex as its replicas hold it
+    std::vector<std::pair<VertexData, uint64_t> > vertex_delta_base;
+    /// The index into edge_delta_base of every local edge
+    std::vector<size_t> eid2deltaslot;
+    /// The data and version of an owned edge as its replica holds it
+    std::vector<std::pair<EdgeData, uint64_t> > edge_delta_base;
   
   
     struct async_scope_callback {
@@ -1947,12 +2014,47 @@ namespace graphlab {
       __ownedvertices__.clear();
       __ghostvertices__.clear();
       __boundaryscopesset__.clear();
+
+      // the neighboring machines are the owners of my ghosts, and
+      // those which have a ghost of my vertices
+      fixed_dense_bitset<MAX_N_PROCS> nbrs;
+      nbrs.clear();
+      for (size_t i = 0;i < localvid2owner.size(); ++i) {
+        if (localvid2owner[i] != rmi.procid()) {
+          nbrs.set_bit_unsync(localvid2owner[i]);
+        }
+        else {
+          uint32_t proc = 0;
+          if (localvid2ghostedprocs[i].first_bit(proc)) {
+            do {
+              nbrs.set_bit_unsync(proc);
+            } while(localvid2ghostedprocs[i].next_bit(proc));
+          }
+        }
+      }
+      nbrs.clear_bit_unsync(rmi.procid());
+      neighborprocs.clear();
+      uint32_t proc = 0;
+      if (nbrs.first_bit(proc)) {
+        do {
+          neighborprocs.push_back((procid_t)proc);
+        } while(nbrs.next_bit(proc));
+      }
     }
     
     
     vertex_conditional_store get_vertex_if_version_less_than(vertex_id_type vid, 
                                                              uint64_t vertexversion,
                                                              vertex_conditional_store &vdata);
+
+    /// The local changes of ghost localvid to send to its owner
+    vertex_conditional_store ghost_vertex_changes(vertex_id_type localvid);
+
+    /**
+     * Sends the local changes of ghost vid to its owner. The future
+     * holds the owner's data if it is newer.
+     */
+    request_future<vertex_conditional_store> request_vertex_sync(vertex_id_type vid);
                                                        
     edge_conditional_store get_edge_if_version_less_than2(vertex_id_type source, 
                                                           vertex_id_type target, 
@@ -2054,6 +2156,23 @@ namespace graphlab {
                                                  vertex_id_type target, 
                                                  edge_conditional_store &estore,
                                                  procid_t srcproc, size_t reply);
+
+    void update_vertex_delta_and_reply(vertex_id_type vid, 
+                                       vertex_delta_store &dstore,
+                                       procid_t srcproc,
+                                       size_t reply);
+
+    void update_edge_delta_and_reply2(vertex_id_type source, 
+                                      vertex_id_type target, 
+                                      edge_delta_store &dstore,
+                                      procid_t srcproc, size_t reply);
+
+    /// Sends the whole owned vertex to a replica which missed a delta
+    void push_whole_vertex_to(vertex_id_type vid, procid_t proc);
+
+    /// Sends the whole owned edge to a replica which missed a delta
+    void push_whole_edge_to(vertex_id_type source, vertex_id_type target, 
+                            procid_t proc);
                           
   
   
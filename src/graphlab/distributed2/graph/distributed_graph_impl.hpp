@@ -45,24 +45,16 @@ void distributed_graph<VertexData, EdgeData>::
 synchronize_vertex(vertex_id_type vid, bool async) {
   vertex_id_type localvid = global2localvid[vid];
   if (is_ghost(vid)) {
-    vertex_conditional_store out;
-    out.hasdata = localstore.vertex_modified(localvid);
-    if (out.hasdata) {
-      localstore.set_vertex_modified(localvid, false);
-      out.data.first = localstore.vertex_data(localvid);
-    }
     if (async == false) {
-      vertex_conditional_store v;
-      v = rmi.remote_request(localvid2owner[localvid],
-                             &distributed_graph<VertexData, EdgeData>::
-                             get_vertex_if_version_less_than,
-                             vid,
-                             localstore.vertex_version(localvid),
-                             out);
+      request_future<vertex_conditional_store> reply = request_vertex_sync(vid);
+      vertex_conditional_store& v = reply();
       if (v.hasdata) {
         update_vertex_data_and_version(vid, v);
       }
     } else {
+      vertex_conditional_store out = ghost_vertex_changes(localvid);
+      // the owner handles all requests for this vertex on one thread
+      uint32_t oldhint = distributed_control::set_affinity_hint(vid + 1);
       pending_async_updates.flag.inc();
       rmi.remote_call(localvid2owner[localvid],
                       &distributed_graph<VertexData, EdgeData>::
@@ -71,11 +63,46 @@ synchronize_vertex(vertex_id_type vid, bool async) {
                       vid,
                       localstore.vertex_version(localvid),
                       out);
+      distributed_control::set_affinity_hint(oldhint);
     }
   }
 } // end of sycnhronize vertex
 
 
+template <typename VertexData, typename EdgeData>
+typename distributed_graph<VertexData, EdgeData>::vertex_conditional_store 
+distributed_graph<VertexData, EdgeData>::
+ghost_vertex_changes(vertex_id_type localvid) {
+  vertex_conditional_store out;
+  out.hasdata = localstore.vertex_modified(localvid);
+  if (out.hasdata) {
+    localstore.set_vertex_modified(localvid, false);
+    out.data.first = localstore.vertex_data(localvid);
+  }
+  return out;
+}
+
+
+template <typename VertexData, typename EdgeData>
+request_future<typename distributed_graph<VertexData, EdgeData>::vertex_conditional_store>
+distributed_graph<VertexData, EdgeData>::
+request_vertex_sync(vertex_id_type vid) {
+  vertex_id_type localvid = global2localvid[vid];
+  vertex_conditional_store out = ghost_vertex_changes(localvid);
+  // the owner handles all requests for this vertex on one thread
+  uint32_t oldhint = distributed_control::set_affinity_hint(vid + 1);
+  request_future<vertex_conditional_store> reply = 
+    rmi.future_remote_request(localvid2owner[localvid],
+                              &distributed_graph<VertexData, EdgeData>::
+                              get_vertex_if_version_less_than,
+                              vid,
+                              localstore.vertex_version(localvid),
+                              out);
+  distributed_control::set_affinity_hint(oldhint);
+  return reply;
+}
+
+
   /**
    * synchronize the data on edge with global id eid
    * target of edge must be a ghost
@@ -698,8 +725,25 @@ reply_alot2(distributed_graph<VertexData, EdgeData>::
 template <typename VertexData, typename EdgeData>
 void distributed_graph<VertexData, EdgeData>::
 synchronize_all_vertices(bool async) {
+  if (async) {
+    foreach(vertex_id_type vid, ghostvertices) {
+      synchronize_vertex(vid, true);
+    }
+    return;
+  }
+  // issue all the requests before waiting for any of the replies so
+  // that the round trips overlap
+  std::vector<vertex_id_type> vids;
+  std::vector<request_future<vertex_conditional_store> > replies;
   foreach(vertex_id_type vid, ghostvertices) {
-    synchronize_vertex(vid, async);
+    vids.push_back(vid);
+    replies.push_back(request_vertex_sync(vid));
+  }
+  for (size_t i = 0; i < replies.size(); ++i) {
+    vertex_conditional_store& v = replies[i]();
+    if (v.hasdata) {
+      update_vertex_data_and_version(vids[i], v);
+    }
   }
 }
 
@@ -793,6 +837,143 @@ update_edge_data_and_version_and_reply2(vertex_id_type source,
 
 
 
+template <typename VertexData, typename EdgeData> 
+void distributed_graph<VertexData, EdgeData>::
+update_vertex_delta_and_reply(vertex_id_type vid, 
+                              distributed_graph<VertexData, EdgeData>::
+                              vertex_delta_store &dstore,
+                              procid_t srcproc,
+                              size_t reply) {
+  vertex_id_type localvid = global2localvid[vid];
+  // this must be a ghost
+  ASSERT_NE(localvid2owner[localvid], rmi.procid());
+  if (!localstore.conditional_apply_vertex_delta(localvid, dstore.delta, 
+                                                 dstore.baseversion, 
+                                                 dstore.version)) {
+    // the delta was computed against data this replica does not
+    // hold. Ask for the whole vertex
+    rmi.remote_call(localvid2owner[localvid],
+                    &distributed_graph<VertexData, EdgeData>::
+                    push_whole_vertex_to,
+                    vid,
+                    rmi.procid());
+  }
+  if (srcproc != procid_t(-1)) {
+    rmi.dc().remote_call(srcproc, reply_increment_counter, 
+                         reply, dc_impl::blob());
+  }
+}
+
+
+
+template <typename VertexData, typename EdgeData> 
+void distributed_graph<VertexData, EdgeData>::
+update_edge_delta_and_reply2(vertex_id_type source, 
+                             vertex_id_type target, 
+                             distributed_graph<VertexData, EdgeData>::
+                             edge_delta_store &dstore,
+                             procid_t srcproc, size_t reply) {
+  std::pair<bool, edge_id_type> findret = 
+    localstore.find(global2localvid[source], global2localvid[target]);
+  assert(findret.first);
+  if (!localstore.conditional_apply_edge_delta(findret.second, dstore.delta, 
+                                               dstore.baseversion, 
+                                               dstore.version)) {
+    rmi.remote_call(localvid2owner[global2localvid[target]],
+                    &distributed_graph<VertexData, EdgeData>::
+                    push_whole_edge_to,
+                    source,
+                    target,
+                    rmi.procid());
+  }
+  if (srcproc != procid_t(-1)) {
+    rmi.dc().remote_call(srcproc, reply_increment_counter, 
+                         reply, dc_impl::blob());
+  }
+}
+
+
+
+template <typename VertexData, typename EdgeData> 
+void distributed_graph<VertexData, EdgeData>::
+push_whole_vertex_to(vertex_id_type vid, procid_t proc) {
+  vertex_id_type localvid = global2localvid[vid];
+  vertex_conditional_store vstore;
+  vstore.hasdata = true;
+  vstore.data.first = localstore.vertex_data(localvid);
+  vstore.data.second = localstore.vertex_version(localvid);
+  rmi.remote_call(proc,
+                  &distributed_graph<VertexData, EdgeData>::
+                  update_vertex_data_and_version_and_reply,
+                  vid,
+                  vstore,
+                  procid_t(-1),
+                  0);
+}
+
+
+
+template <typename VertexData, typename EdgeData> 
+void distributed_graph<VertexData, EdgeData>::
+push_whole_edge_to(vertex_id_type source, vertex_id_type target, 
+                   procid_t proc) {
+  std::pair<bool, edge_id_type> findret = 
+    localstore.find(global2localvid[source], global2localvid[target]);
+  assert(findret.first);
+  edge_conditional_store estore;
+  estore.hasdata = true;
+  estore.data.first = localstore.edge_data(findret.second);
+  estore.data.second = localstore.edge_version(findret.second);
+  rmi.remote_call(proc,
+                  &distributed_graph<VertexData, EdgeData>::
+                  update_edge_data_and_version_and_reply2,
+                  source,
+                  target,
+                  estore,
+                  procid_t(-1),
+                  0);
+}
+
+
+
+template <typename VertexData, typename EdgeData> 
+void distributed_graph<VertexData, EdgeData>::
+set_delta_sync(bool enable, double tolerance) {
+  delta_tolerance = tolerance;
+  localvid2deltaslot.clear();
+  vertex_delta_base.clear();
+  eid2deltaslot.clear();
+  edge_delta_base.clear();
+  // the owned vertices with replicas are those on the boundary. 
+  // Take a copy of their data as the replicas hold it
+  if (enable && delta_traits<VertexData>::enabled) {
+    localvid2deltaslot.resize(localstore.num_vertices(), size_t(-1));
+    foreach(vertex_id_type vid, boundaryscopes) {
+      vertex_id_type localvid = global2localvid[vid];
+      localvid2deltaslot[localvid] = vertex_delta_base.size();
+      vertex_delta_base.push_back(std::make_pair(localstore.vertex_data(localvid),
+                                       localstore.vertex_version(localvid)));
+    }
+  }
+  // the owned edges with a replica are the in edges of the boundary
+  // coming from a ghost
+  if (enable && delta_traits<EdgeData>::enabled) {
+    eid2deltaslot.resize(localstore.num_edges(), size_t(-1));
+    foreach(vertex_id_type vid, boundaryscopes) {
+      foreach(edge_id_type eid, localstore.in_edge_ids(global2localvid[vid])) {
+        if (localvid_is_ghost(localstore.source(eid))) {
+          eid2deltaslot[eid] = edge_delta_base.size();
+          edge_delta_base.push_back(std::make_pair(localstore.edge_data(eid),
+                                                   localstore.edge_version(eid)));
+        }
+      }
+    }
+  }
+  rmi.barrier();
+}
+
+
+
 
 template <typename VertexData, typename EdgeData>
 void distributed_graph<VertexData, EdgeData>::
@@ -803,6 +984,32 @@ push_owned_vertex_to_replicas(vertex_id_type vid, bool async, bool untracked) {
   size_t replica_size = replicas.popcount() ;
   // owner is a replica too. if there are no other replicas quit
   if (replica_size <= 1) return;
+
+  // with delta sync, send the change from what the replicas hold
+  const size_t slot = localvid2deltaslot.empty() ? size_t(-1) : 
+                                                   localvid2deltaslot[localvid];
+  vertex_delta_store dstore;
+  if (slot != size_t(-1)) {
+    // the vertex lock keeps the data, the version and the base in step
+    // with concurrent updates and pushes of the vertex
+    localstore.lock_vertex(localvid);
+    std::pair<VertexData, uint64_t>& base = vertex_delta_base[slot];
+    const uint64_t version = localstore.vertex_version(localvid);
+    // if nothing changed by more than the tolerance, send nothing.
+    // The base stays, so small changes add up until they are sent
+    if (version == base.second ||
+        !delta_traits<VertexData>::diff(base.first, 
+                                        localstore.vertex_data(localvid),
+                                        delta_tolerance, dstore.delta)) {
+      localstore.unlock_vertex(localvid);
+      return;
+    }
+    delta_traits<VertexData>::apply(base.first, dstore.delta);
+    dstore.baseversion = base.second;
+    dstore.version = version;
+    base.second = version;
+    localstore.unlock_vertex(localvid);
+  }
   
   dc_impl::reply_ret_type ret(true, replica_size - 1);
   
@@ -825,9 +1032,14 @@ push_owned_vertex_to_replicas(vertex_id_type vid, bool async, bool untracked) {
   else srcprocid = procid_t(-1);
   // build the store
   vertex_conditional_store vstore;
-  vstore.hasdata = true;
-  vstore.data.first = localstore.vertex_data(localvid);
-  vstore.data.second = localstore.vertex_version(localvid);
+  vstore.hasdata = (slot == size_t(-1));
+  if (vstore.hasdata) {
+    vstore.data.first = localstore.vertex_data(localvid);
+    vstore.data.second = localstore.vertex_version(localvid);
+  }
+  // deltas must be applied in order. Keep them on one handler thread
+  uint32_t oldhint = distributed_control::get_affinity_hint();
+  if (slot != size_t(-1)) distributed_control::set_affinity_hint(vid + 1);
   
   uint32_t proc = 0;
   if (replicas.first_bit(proc)) {
@@ -836,16 +1048,28 @@ push_owned_vertex_to_replicas(vertex_id_type vid, bool async, bool untracked) {
   #ifdef DGRAPH_DEBUG
         logger(LOG_DEBUG, "Pushing vertex %d to proc %d", vid, proc);
   #endif
-        rmi.remote_call((procid_t)proc,
-                        &distributed_graph<VertexData, EdgeData>::
-                        update_vertex_data_and_version_and_reply,
-                        vid,
-                        vstore,
-                        srcprocid,
-                        retptr);
+        if (slot == size_t(-1)) {
+          rmi.remote_call((procid_t)proc,
+                          &distributed_graph<VertexData, EdgeData>::
+                          update_vertex_data_and_version_and_reply,
+                          vid,
+                          vstore,
+                          srcprocid,
+                          retptr);
+        }
+        else {
+          rmi.remote_call((procid_t)proc,
+                          &distributed_graph<VertexData, EdgeData>::
+                          update_vertex_delta_and_reply,
+                          vid,
+                          dstore,
+                          srcprocid,
+                          retptr);
+        }
       }
     } while(replicas.next_bit(proc));
   }
+  distributed_control::set_affinity_hint(oldhint);
   if (async == false && untracked == false)  ret.wait();
 }
 
@@ -877,6 +1101,26 @@ push_owned_edge_to_replicas(edge_id_type eid, bool async, bool untracked) {
     sendto = localvid2owner[localstore.source(eid)];
   }
 
+  // with delta sync, send the change from what the replica holds
+  const size_t slot = eid2deltaslot.empty() ? size_t(-1) : eid2deltaslot[eid];
+  edge_delta_store dstore;
+  if (slot != size_t(-1)) {
+    localstore.lock_edge(eid);
+    std::pair<EdgeData, uint64_t>& base = edge_delta_base[slot];
+    const uint64_t version = localstore.edge_version(eid);
+    if (version == base.second ||
+        !delta_traits<EdgeData>::diff(base.first, localstore.edge_data(eid),
+                                      delta_tolerance, dstore.delta)) {
+      localstore.unlock_edge(eid);
+      return;
+    }
+    delta_traits<EdgeData>::apply(base.first, dstore.delta);
+    dstore.baseversion = base.second;
+    dstore.version = version;
+    base.second = version;
+    localstore.unlock_edge(eid);
+  }
+
   dc_impl::reply_ret_type ret(true, 1);  
   // if async, set the return reply to go to the global pending push updates
   size_t retptr;
@@ -894,25 +1138,39 @@ push_owned_edge_to_replicas(edge_id_type eid, bool async, bool untracked) {
   procid_t srcprocid;
   if (untracked == false) srcprocid = rmi.procid();
   else srcprocid = procid_t(-1);
-  // build the store
-  edge_conditional_store estore;
-  estore.hasdata = true;
-  estore.data.first = localstore.edge_data(eid);
-  estore.data.second = localstore.edge_version(eid);
-  
 #ifdef DGRAPH_DEBUG
   logstream(LOG_DEBUG) 
     << "Pushing edge ("  << globalsource << ", " << globaltarget 
     << ") to proc " << sendto << std::endl;
 #endif
-  rmi.remote_call(sendto,
-                  &distributed_graph<VertexData, EdgeData>::
-                  update_edge_data_and_version_and_reply2,
-                  globalsource,
-                  globaltarget,
-                  estore,
-                  srcprocid,
-                  retptr);
+  if (slot == size_t(-1)) {
+    // build the store
+    edge_conditional_store estore;
+    estore.hasdata = true;
+    estore.data.first = localstore.edge_data(eid);
+    estore.data.second = localstore.edge_version(eid);
+    rmi.remote_call(sendto,
+                    &distributed_graph<VertexData, EdgeData>::
+                    update_edge_data_and_version_and_reply2,
+                    globalsource,
+                    globaltarget,
+                    estore,
+                    srcprocid,
+                    retptr);
+  }
+  else {
+    // deltas must be applied in order. Keep them on one handler thread
+    uint32_t oldhint = distributed_control::set_affinity_hint(globaltarget + 1);
+    rmi.remote_call(sendto,
+                    &distributed_graph<VertexData, EdgeData>::
+                    update_edge_delta_and_reply2,
+                    globalsource,
+                    globaltarget,
+                    dstore,
+                    srcprocid,
+                    retptr);
+    distributed_control::set_affinity_hint(oldhint);
+  }
 
   if (async == false && untracked == false)  ret.wait();
 }
@@ -935,8 +1193,15 @@ void distributed_graph<VertexData, EdgeData>::push_all_owned_vertices_to_replica
     // build the store
     vertex_conditional_store vstore;
     vstore.hasdata = true;
+    localstore.lock_vertex(localvid);
     vstore.data.first = localstore.vertex_data(localvid);
     vstore.data.second = localstore.vertex_version(localvid);
+    // the replicas now hold the whole data
+    if (!localvid2deltaslot.empty() && 
+        localvid2deltaslot[localvid] != size_t(-1)) {
+      vertex_delta_base[localvid2deltaslot[localvid]] = vstore.data;
+    }
+    localstore.unlock_vertex(localvid);
     
     uint32_t proc = 0;
     if (replicas.first_bit(proc)) {
@@ -984,9 +1249,14 @@ void distributed_graph<VertexData, EdgeData>::push_all_owned_edges_to_replicas()
       vertex_id_type targetvid = local2globalvid[localstore.target(localeid)];
       edge_conditional_store estore;
       estore.hasdata = true;
+      localstore.lock_edge(localeid);
       estore.data.first = localstore.edge_data(localeid);
       estore.data.second = localstore.edge_version(localeid);
-  
+      // the replica now holds the whole data
+      if (!eid2deltaslot.empty() && eid2deltaslot[localeid] != size_t(-1)) {
+        edge_delta_base[eid2deltaslot[localeid]] = estore.data;
+      }
+      localstore.unlock_edge(localeid);
 
       blockpushes[thrid][proc].srcdest.push_back(std::make_pair<vertex_id_type, vertex_id_type>(vid, targetvid));
       blockpushes[thrid][proc].edgeversion.push_back(localstore.edge_version(localeid));
@@ -34,9 +34,11 @@
 #define GRAPHLAB_GRAPH_LOCAL_STORE_HPP
 #include <climits>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/spin_rwlock.hpp>
 #include <graphlab/graph/graph.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/util/generics/shuffle.hpp>
+#include <graphlab/distributed2/graph/delta_traits.hpp>
 
 #include <graphlab/macros_def.hpp>
 
@@ -341,7 +343,7 @@ namespace graphlab {
         in_edges.push_back(std::vector<edge_id_type>());
         out_edges.push_back(std::vector<edge_id_type>());
         vcolors.push_back(vertex_color_type(-1));
-        locks.push_back(simple_spinlock());
+        locks.push_back(spin_rwlock());
         return vertices.size() - 1;
       }
     
@@ -398,6 +400,32 @@ namespace graphlab {
         locks[v].unlock();
       }
 
+      /**
+       * Applies a delta computed against version baseversion of the
+       * vertex, moving it to version. A delta older than the vertex
+       * is dropped. Returns false if the vertex is at some other
+       * version older than version, and therefore needs the whole data.
+       */
+      bool conditional_apply_vertex_delta(vertex_id_type v, 
+                         const typename delta_traits<VertexData>::delta_type& delta,
+                         uint64_t baseversion, uint64_t version) {
+        assert(v < nvertices);
+        bool ret = true;
+        locks[v].lock();
+        if (vertices[v].version == baseversion) {
+          delta_traits<VertexData>::apply(vertices[v].data, delta);
+          vertices[v].version = version;
+          vertices[v].modified = false;
+          vertices[v].dirty = false;
+          vertices[v].snapshot_req = true;
+        }
+        else if (vertices[v].version < version) {
+          ret = false;
+        }
+        locks[v].unlock();
+        return ret;
+      }
+
 
       void set_vertex_modified(vertex_id_type v, bool modified) {
         assert(v < nvertices);
@@ -526,6 +554,51 @@ namespace graphlab {
         locks[target(e)].unlock();
       }
 
+      /**
+       * Takes the lock which the updates of vertex v hold. Also guards
+       * state kept alongside the vertex, such as its delta base.
+       */
+      void lock_vertex(vertex_id_type v) {
+        assert(v < nvertices);
+        locks[v].lock();
+      }
+
+      void unlock_vertex(vertex_id_type v) {
+        assert(v < nvertices);
+        locks[v].unlock();
+      }
+
+      /// Takes the lock which the updates of edge e hold: the target's
+      void lock_edge(edge_id_type e) {
+        assert(e < nedges);
+        locks[target(e)].lock();
+      }
+
+      void unlock_edge(edge_id_type e) {
+        assert(e < nedges);
+        locks[target(e)].unlock();
+      }
+
+      /// The edge equivalent of conditional_apply_vertex_delta()
+      bool conditional_apply_edge_delta(edge_id_type e, 
+                         const typename delta_traits<EdgeData>::delta_type& delta,
+                         uint64_t baseversion, uint64_t version) {
+        assert(e < nedges);
+        bool ret = true;
+        locks[target(e)].lock();
+        if (edgedata[e].version == baseversion) {
+          delta_traits<EdgeData>::apply(edgedata[e].data, delta);
+          edgedata[e].version = version;
+          edgedata[e].modified = false;
+          edgedata[e].snapshot_req = true;
+        }
+        else if (edgedata[e].version < version) {
+          ret = false;
+        }
+        locks[target(e)].unlock();
+        return ret;
+      }
+
       uint64_t edge_version(vertex_id_type source, vertex_id_type target) {
         assert(source < nvertices);
         assert(target < nvertices);
@@ -870,7 +943,7 @@ namespace graphlab {
       size_t nvertices;
       size_t nedges;
     
-      std::vector<simple_spinlock> locks;
+      std::vector<spin_rwlock> locks;
     
       /** Mark whether the graph is finalized.  Graph finalization is a
           costly procedure but it can also dramatically improve
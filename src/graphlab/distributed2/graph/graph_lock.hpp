@@ -1,6 +1,8 @@
 #ifndef GRAPHLAB_GRAPH_LOCK_INTERFACE_HPP
 #define GRAPHLAB_GRAPH_LOCK_INTERFACE_HPP
 
+#include <map>
+#include <string>
 #include <boost/function.hpp>
 #include <graphlab/scope/iscope.hpp>
 
@@ -19,6 +21,16 @@ class graph_lock {
                            scope_range::scope_range_enum scopetype) = 0;
                            
   virtual void print_state() = 0; // for debugging                           
+
+  /// Sends lock messages the implementation may have buffered
+  virtual void flush() { }
+
+  /// Message and fork counters of this machine
+  virtual std::map<std::string, size_t> get_statistics() {
+    return std::map<std::string, size_t>();
+  }
+  
+  virtual ~graph_lock() { }
 };
 
 }
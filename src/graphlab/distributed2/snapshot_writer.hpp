@@ -0,0 +1,262 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SNAPSHOT_WRITER_HPP
+#define GRAPHLAB_SNAPSHOT_WRITER_HPP
+
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/graph/write_only_disk_atom.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/mpsc_queue.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+namespace gl_impl {
+
+/**
+ * Writes the vertices and edges of one snapshot to a single append-only
+ * disk atom on a background thread.
+ *
+ * Worker threads only copy the data into a record and push it onto a
+ * lock-free queue. The writer thread serializes the records in batches
+ * and appends them to the atom, so the compression and the disk writes
+ * never run while a worker holds a vertex. close() returns at once. The
+ * writer then drains the queue, closes the atom and fsyncs the file.
+ * wait() blocks until that is done. A snapshot which cannot be finished
+ * is ended with abandon() instead, which removes the file.
+ *
+ * open() does not wait for the previous snapshot either. Its writer is
+ * retired and keeps draining alongside the new one, and is joined once
+ * it is done.
+ *
+ * The output is an ordinary .dump atom. Records which are written later
+ * overwrite earlier ones on playback, so a restart plays back the newest
+ * complete snapshot followed by the incremental ones after it.
+ */
+template <typename Graph>
+class snapshot_writer {
+ public:
+  typedef typename Graph::vertex_data_type vertex_data_type;
+  typedef typename Graph::edge_data_type edge_data_type;
+
+ private:
+  struct record {
+    bool isvertex;
+    vertex_id_t src, target;
+    uint16_t srcowner, targetowner;
+    vertex_data_type vdata;
+    edge_data_type edata;
+  };
+
+  /// The file, queue and thread of one snapshot
+  struct writer {
+    std::string filename;
+    write_only_disk_atom* atom;
+    mpsc_queue<record> queue;
+    thread thr;
+    /// set by abandon(). The writer drops the records and the file
+    volatile bool discard;
+    /// set by the writer thread when the file is done
+    volatile bool finished;
+    writer(const std::string& filename, uint16_t atomid):
+      filename(filename), 
+      atom(new write_only_disk_atom(filename, atomid, true)),
+      discard(false), finished(false) { }
+  };
+
+  /// Records serialized by the writer thread between queue reads
+  static const size_t WRITE_BATCH_SIZE = 1024;
+
+  /// the writer of the last opened snapshot
+  writer* current;
+  /// the writers of older snapshots which may still be draining
+  std::vector<writer*> retired;
+  bool opened;
+  atomic<size_t> nrecords;
+
+  static void writer_loop(writer* w) {
+    std::vector<record> batch;
+    batch.reserve(WRITE_BATCH_SIZE);
+    while (w->queue.dequeue_batch(batch, WRITE_BATCH_SIZE) > 0) {
+      for (size_t i = 0; i < batch.size() && !w->discard; ++i) {
+        const record& r = batch[i];
+        if (r.isvertex) {
+          w->atom->add_vertex_with_data(r.src, r.srcowner,
+                                        serialize_to_string(r.vdata));
+        }
+        else {
+          w->atom->add_edge_with_data(r.src, r.srcowner,
+                                      r.target, r.targetowner,
+                                      serialize_to_string(r.edata));
+        }
+      }
+      batch.clear();
+    }
+    // closes the compressed stream. Only then is the file complete
+    delete w->atom;
+    w->atom = NULL;
+    if (w->discard) {
+      // an incomplete snapshot must not look like an ordinary atom
+      unlink(w->filename.c_str());
+    }
+    else {
+      int fd = ::open(w->filename.c_str(), O_WRONLY);
+      if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+      }
+      else {
+        logstream(LOG_WARNING) << "Unable to fsync snapshot " << w->filename
+                               << std::endl;
+      }
+    }
+    w->finished = true;
+  }
+
+  static void join(writer* w) {
+    w->thr.join();
+    delete w;
+  }
+
+  /// Joins the retired writers which are done. Does not block
+  void reap_retired() {
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i) {
+      if (retired[i]->finished) join(retired[i]);
+      else retired[kept++] = retired[i];
+    }
+    retired.resize(kept);
+  }
+
+  // not copyable
+  snapshot_writer(const snapshot_writer&);
+  void operator=(const snapshot_writer&);
+
+ public:
+  snapshot_writer(): current(NULL), opened(false) { }
+
+  ~snapshot_writer() {
+    close();
+    wait();
+  }
+
+  /**
+   * Opens the file for appending and starts the writer thread. The
+   * previous snapshot must have been closed. If its writer is still
+   * draining, it finishes in the background.
+   */
+  void open(const std::string& fname, uint16_t atomid) {
+    ASSERT_FALSE(opened);
+    if (current != NULL) retired.push_back(current);
+    reap_retired();
+    nrecords.value = 0;
+    current = new writer(fname, atomid);
+    current->thr.launch(boost::bind(&snapshot_writer::writer_loop, current));
+    opened = true;
+  }
+
+  /// True between open() and close()
+  bool is_open() const {
+    return opened;
+  }
+
+  /// Copies a vertex into the log. Safe to call from any number of threads
+  void add_vertex(vertex_id_t vid, uint16_t owner,
+                  const vertex_data_type& vdata) {
+    record r;
+    r.isvertex = true;
+    r.src = vid;
+    r.srcowner = owner;
+    r.target = 0;
+    r.targetowner = 0;
+    r.vdata = vdata;
+    current->queue.enqueue(r);
+    nrecords.inc();
+  }
+
+  /// Copies an edge into the log. Safe to call from any number of threads
+  void add_edge(vertex_id_t src, uint16_t srcowner,
+                vertex_id_t target, uint16_t targetowner,
+                const edge_data_type& edata) {
+    record r;
+    r.isvertex = false;
+    r.src = src;
+    r.srcowner = srcowner;
+    r.target = target;
+    r.targetowner = targetowner;
+    r.edata = edata;
+    current->queue.enqueue(r);
+    nrecords.inc();
+  }
+
+  /// The number of records added since open()
+  size_t num_records() const {
+    return nrecords.value;
+  }
+
+  /**
+   * Ends the snapshot without blocking. No records may be added after
+   * this. The writer thread finishes the file in the background.
+   */
+  void close() {
+    if (opened) {
+      opened = false;
+      current->queue.stop_blocking();
+    }
+  }
+
+  /**
+   * Ends an incomplete snapshot without blocking. The writer thread
+   * drops the queued records and removes the file.
+   */
+  void abandon() {
+    if (opened) {
+      opened = false;
+      current->discard = true;
+      current->queue.stop_blocking();
+    }
+  }
+
+  /// Blocks until the files of all the closed snapshots are on disk
+  void wait() {
+    for (size_t i = 0; i < retired.size(); ++i) join(retired[i]);
+    retired.clear();
+    if (current != NULL && !opened) {
+      join(current);
+      current = NULL;
+    }
+  }
+};
+
+} // namespace gl_impl
+} // namespace graphlab
+
+#endif
@@ -246,12 +246,22 @@ consistency guarantees do not hold.
 
 \subsubsection chromatic_engine_options Engine Options
 The max iteration count and whether to permute 
-the vertex update order can be set. There are two engine options, "max_iterations=N"
+the vertex update order can be set. There are two main engine options, "max_iterations=N"
 and "randomize_schedule=0 or 1" and these can be set on the command line:
 \verbatim
 --engine="dist_chromatic(max_iterations=10,randomize_schedule=1)"
 \endverbatim
 
+Setting "pipelined_sync=1" lets the vertices of a color which have no
+neighbors on other machines run while the machines synchronize at the end
+of the color. Only the remaining vertices wait for the synchronization.
+This helps when there are many colors and many machines. It has no effect
+with full consistency.
+
+Setting "neighborhood_barrier=1" replaces the barrier at the end of each
+color, except the last, with one among the machines which share ghost
+vertices. The update function must then only schedule vertices in its scope.
+
 \subsubsection chromatic_engine_limitations Limitations
 The chromatic engine is therefore somewhat limited in its scheduling capabilities
 (only supporting a chromatic schedule), supports only one update function type, and requires
@@ -41,6 +41,8 @@
 
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/idle_parker.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
 #include <graphlab/util/timer.hpp>
 #include <graphlab/util/random.hpp>
 #include <graphlab/util/mutable_queue.hpp>
@@ -50,6 +52,7 @@
 #include <graphlab/scope/iscope.hpp>
 #include <graphlab/engine/iengine.hpp>
 #include <graphlab/tasks/update_task.hpp>
+#include <graphlab/schedulers/icallback.hpp>
 #include <graphlab/logger/logger.hpp>
 #include <graphlab/monitoring/imonitor.hpp>
 #include <graphlab/shared_data/glshared.hpp>
@@ -121,6 +124,36 @@ namespace graphlab {
     }; // end of task worker
 
 
+    /**
+     * Forwards to the callback of the scheduler and counts the tasks
+     * the updates add, so that parked workers are only woken when
+     * there is new work for them. Owned by one worker.
+     */
+    class counting_callback : public icallback<Graph> {
+      icallback<Graph>& wrapped;
+    public:
+      size_t added;
+      counting_callback(icallback<Graph>& wrapped) :
+        wrapped(wrapped), added(0) { }
+
+      void add_task(update_task_type task, double priority) {
+        ++added;
+        wrapped.add_task(task, priority);
+      }
+
+      void add_tasks(const std::vector<vertex_id_type>& vertices,
+                     update_function_type func, double priority) {
+        added += vertices.size();
+        wrapped.add_tasks(vertices, func, priority);
+      }
+
+      void force_abort() { wrapped.force_abort(); }
+      void enable_buffering() { wrapped.enable_buffering(); }
+      void commit() { wrapped.commit(); }
+      int num_of_buffered_tasks() { return wrapped.num_of_buffered_tasks(); }
+    };
+
+
     class engine_thread_for_sync {
       asynchronous_engine* engine;
       size_t workerid;
@@ -156,6 +189,30 @@ namespace graphlab {
 
     /** Use schedule yielding when waiting on the scheduler*/
     bool use_sched_yield;
+
+    /** What a worker does when the scheduler is empty */
+    enum idle_policy_enum {
+      IDLE_DEFAULT,  ///< yield if use_sched_yield is set, otherwise spin
+      IDLE_SPIN,     ///< spin on the scheduler
+      IDLE_YIELD,    ///< sched_yield() between attempts
+      IDLE_ADAPTIVE  ///< spin, then yield, then park until woken
+    };
+    idle_policy_enum idle_policy;
+
+    /** Parks idle workers under the adaptive idle policy */
+    idle_parker parker;
+
+    /** The number of tasks a worker takes from the scheduler and
+        runs at once. 1 disables batching */
+    size_t batch_size;
+
+    /** Run read only scopes without locks, validating the reads and
+        running the update again if a writer interfered */
+    bool optimistic_reads;
+
+    /** The number of updates which were run again because their
+        optimistic reads were invalidated */
+    atomic<size_t> optimistic_retries;
     
     /** set to 1 if the processor is in the midst of asking scheduler for stuff
      *  and running an update */
@@ -279,6 +336,10 @@ namespace graphlab {
       ncpus( std::max(ncpus, size_t(1)) ),
       use_cpu_affinity(false),
       use_sched_yield(true),
+      idle_policy(IDLE_DEFAULT),
+      batch_size(1),
+      optimistic_reads(false),
+      optimistic_retries(0),
       proc_in_update(std::max(ncpus, size_t(1))),
       update_counts(std::max(ncpus, size_t(1)), 0),
       monitor(NULL),
@@ -337,9 +398,51 @@ namespace graphlab {
       use_cpu_affinity = value;
     }
 
-    void set_engine_options(const scheduler_options& opts) { }
+    void set_engine_options(const scheduler_options& opts) {
+      opts.get_int_option("batch_size", batch_size);
+      batch_size = std::max(batch_size, size_t(1));
+      std::string idle;
+      if (opts.get_string_option("idle", idle)) {
+        if (idle == "spin") idle_policy = IDLE_SPIN;
+        else if (idle == "yield") idle_policy = IDLE_YIELD;
+        else if (idle == "adaptive") idle_policy = IDLE_ADAPTIVE;
+        else logstream(LOG_WARNING) << "Unknown idle policy " << idle
+                                    << ". Using the default" << std::endl;
+      }
+      size_t rounds = 0;
+      if (opts.get_int_option("spin_rounds", rounds)) {
+        parker.set_spin_rounds(rounds);
+      }
+      if (opts.get_int_option("yield_rounds", rounds)) {
+        parker.set_yield_rounds(rounds);
+      }
+      size_t optimistic = 0;
+      if (opts.get_int_option("optimistic_reads", optimistic)) {
+        optimistic_reads = optimistic > 0;
+      }
+      size_t timeout_ms = 0;
+      if (opts.get_int_option("park_timeout_ms", timeout_ms)) {
+        parker.set_timeout_ms(std::max(timeout_ms, size_t(1)));
+      }
+    }
     
-    static void print_options_help(std::ostream& out) { }
+    static void print_options_help(std::ostream& out) {
+      out << "batch_size = [integer, number of tasks each worker takes from "
+          << "the scheduler and runs at once, default=1]\n";
+      out << "idle = [spin, yield or adaptive. What a worker does when the "
+          << "scheduler is empty. adaptive spins, then yields, then sleeps "
+          << "until new tasks are created]\n";
+      out << "spin_rounds = [integer, adaptive idle: empty polls spent "
+          << "spinning, default=100]\n";
+      out << "yield_rounds = [integer, adaptive idle: empty polls spent "
+          << "yielding before sleeping, default=100]\n";
+      out << "park_timeout_ms = [integer, adaptive idle: longest a worker "
+          << "sleeps before polling again, default=10]\n";
+      out << "optimistic_reads = [0 or 1, run read only scopes without "
+          << "locks and repeat the update if a writer interfered. Updates "
+          << "on such scopes must be safe to repeat. Needs trivially copyable "
+          << "vertex and edge data, default=0]\n";
+    }
 
 
     /**
@@ -362,6 +465,9 @@ namespace graphlab {
       ScopeFactory* scope_manager = get_scope_manager();
 
       scope_manager->set_default_scope(default_scope_range);
+      scope_manager->set_optimistic_reads(optimistic_reads);
+      // the scope factory refuses data which cannot be read optimistically
+      optimistic_reads = scope_manager->get_optimistic_reads();
       
       // std::cout << "Scheduler Options:\n";
       // std::cout << sched_options();
@@ -380,6 +486,7 @@ namespace graphlab {
       std::fill(update_counts.begin(), update_counts.end(), 0);
       apx_update_counts.value = 0;
       numsyncs.value = 0;
+      optimistic_retries.value = 0;
       // Reset timers
       start_time_millis = lowres_time_millis();
       last_check_millis = 0;
@@ -420,6 +527,8 @@ namespace graphlab {
       engine_metrics.set_integer("num_vertices", graph.num_vertices());
       engine_metrics.set_integer("num_edges", graph.num_edges());
       engine_metrics.set_integer("num_syncs", numsyncs.value);
+      engine_metrics.set_integer("batch_size", batch_size);
+      engine_metrics.set_integer("optimistic_retries", optimistic_retries.value);
       
       // ok. if death was due to an exception, rethrow
       if (termination_reason == EXEC_EXCEPTION) {
@@ -643,6 +752,12 @@ namespace graphlab {
       
       thread_group threads;
 
+      // Pack the workers onto NUMA nodes so that neighbouring
+      // workers share a memory controller
+      std::vector<size_t> worker_cpus;
+      if (use_cpu_affinity) {
+        worker_cpus = numa_topology::get().worker_cpus(ncpus);
+      }
       
       for(size_t i = 0; i < ncpus; ++i) {
         // Initialize the worker
@@ -652,7 +767,8 @@ namespace graphlab {
         // affinity attached (CPU affinity currently only supported in
         // linux) since Mac affinity is set through the NX frameworks
         if(use_cpu_affinity)  {
-          threads.launch(boost::bind(&engine_thread::run, &(workers[i])), i);
+          threads.launch(boost::bind(&engine_thread::run, &(workers[i])),
+                         worker_cpus[i]);
         } else {
           threads.launch(boost::bind(&engine_thread::run, &(workers[i])));
         }
@@ -791,6 +907,11 @@ namespace graphlab {
           // execute the task
           
           task.function()(*scope, scallback);
+          // an optimistic read scope which raced a writer is run again
+          while (!scope_manager->validate_scope(scope)) {
+            optimistic_retries.inc();
+            task.function()(*scope, scallback);
+          }
           // Commit any changes to the scope
           scope->commit();
           // Release the scope
@@ -824,6 +945,23 @@ namespace graphlab {
       size_t ctr = 0;
       size_t updcount = 0;
       bool isempty = false;
+      idle_parker::worker_state idle_state;
+      // buffers for batch mode. Allocated here so that they are first
+      // touched by this worker and placed on its NUMA node.
+      std::vector<update_task_type> batch_tasks;
+      std::vector<vertex_id_type> batch_vertices;
+      std::vector<iscope_type*> batch_scopes;
+      if (batch_size > 1) {
+        batch_tasks.reserve(batch_size);
+        batch_vertices.reserve(batch_size);
+        batch_scopes.reserve(batch_size);
+      }
+      // only the adaptive policy parks workers, so only it needs to
+      // know whether an update created work
+      counting_callback counter(scheduler->get_callback(cpuid));
+      icallback<Graph>& callback = idle_policy == IDLE_ADAPTIVE ?
+        static_cast<icallback<Graph>&>(counter) :
+        scheduler->get_callback(cpuid);
       while(active) {
         if (__builtin_expect(ctr == 0 || isempty, 0)) {
           if (cpuid == 0) { 
@@ -856,6 +994,23 @@ namespace graphlab {
          * Get and execute the next task from the scheduler.
          */
         proc_in_update[cpuid].val = 1;
+
+        if (batch_size > 1) {
+          size_t ntasks = run_batch(cpuid, scheduler, scope_manager, callback,
+                                    batch_tasks, batch_vertices, batch_scopes);
+          isempty = (ntasks == 0);
+          if (isempty) {
+            if (active) worker_idle(idle_state);
+          }
+          else if (idle_state.idle_rounds > 0) {
+            parker.busy(idle_state);
+          }
+          notify_added_tasks(counter);
+          // count the batch against the time between checks
+          if (ntasks > 1) ctr -= std::min(ctr, ntasks - 1);
+          proc_in_update[cpuid].val = 0;
+          continue;
+        }
         
         update_task_type task;
         sched_status::status_enum stat = scheduler->get_next_task(cpuid, task);
@@ -873,13 +1028,14 @@ namespace graphlab {
               active = false;
             }
             else {
-              if(use_sched_yield) sched_yield();
+              worker_idle(idle_state);
             }
           }
         }
         
         if (stat == sched_status::NEWTASK) {
           isempty = false;
+          if (idle_state.idle_rounds > 0) parker.busy(idle_state);
           // If the status is new task than we must execute the task
           const vertex_id_type vertex = task.vertex();
           assert(vertex < graph.num_vertices());
@@ -889,12 +1045,14 @@ namespace graphlab {
           // to take it build a scope
           iscope_type* scope = scope_manager->get_scope(cpuid, vertex);
           assert(scope != NULL);                    
-          // get the callback for this cpu
-          typename Scheduler::callback_type& scallback = 
-                                      scheduler->get_callback(cpuid);
           // execute the task
           
-          task.function()(*scope, scallback);
+          task.function()(*scope, callback);
+          // an optimistic read scope which raced a writer is run again
+          while (!scope_manager->validate_scope(scope)) {
+            optimistic_retries.inc();
+            task.function()(*scope, callback);
+          }
           // Commit any changes to the scope
           scope->commit();
           // Release the scope
@@ -903,6 +1061,7 @@ namespace graphlab {
 
           // Mark the task as completed in the scheduler
           scheduler->completed_task(cpuid, task);
+          notify_added_tasks(counter);
           // record the successful execution of the task
           if ((updcount & APX_INTERVAL) == APX_INTERVAL) {
             apx_update_counts.inc(APX_INTERVAL + 1);
@@ -912,6 +1071,9 @@ namespace graphlab {
         
         proc_in_update[cpuid].val = 0;
       } // end of while(true)
+      if (idle_state.idle_rounds > 0) parker.busy(idle_state);
+      // do not leave parked workers waiting for their timeout
+      parker.notify_all();
       //update_counts[cpuid] += updcount;
       // loop until all processors are either
       // 1: here. or 
@@ -926,6 +1088,89 @@ namespace graphlab {
       }
     }
     
+    /**
+     * Wakes a parked worker if the updates run since the last call
+     * created tasks.
+     */
+    void notify_added_tasks(counting_callback& counter) {
+      if (counter.added > 0) {
+        counter.added = 0;
+        parker.notify();
+      }
+    }
+
+    /**
+     * Called by a worker which found the scheduler empty, according
+     * to the idle policy.
+     */
+    void worker_idle(idle_parker::worker_state& idle_state) {
+      switch(idle_policy) {
+      case IDLE_SPIN:
+        break;
+      case IDLE_YIELD:
+        sched_yield();
+        break;
+      case IDLE_ADAPTIVE:
+        parker.idle(idle_state);
+        break;
+      default:
+        if(use_sched_yield) sched_yield();
+      }
+    }
+
+    /**
+     * Takes up to batch_size tasks from the scheduler and runs
+     * them. The scopes of all the tasks are acquired together in a
+     * deadlock free order, the updates are run one after the other
+     * and the scopes are then released together. Returns the number
+     * of tasks executed.
+     */
+    size_t run_batch(size_t cpuid,
+                     Scheduler* scheduler,
+                     ScopeFactory* scope_manager,
+                     icallback<Graph>& callback,
+                     std::vector<update_task_type>& tasks,
+                     std::vector<vertex_id_type>& vertices,
+                     std::vector<iscope_type*>& scopes) {
+      size_t ntasks = scheduler->get_next_tasks(cpuid, tasks, batch_size);
+      if (ntasks == 0) {
+        // check the schedule terminator
+        scheduler->get_terminator().begin_critical_section(cpuid);
+        ntasks = scheduler->get_next_tasks(cpuid, tasks, batch_size);
+        if (ntasks > 0) {
+          scheduler->get_terminator().cancel_critical_section(cpuid);
+        }
+        else {
+          if (scheduler->get_terminator().end_critical_section(cpuid)) {
+            active = false;
+          }
+          return 0;
+        }
+      }
+
+      vertices.resize(ntasks);
+      for (size_t i = 0; i < ntasks; ++i) {
+        vertices[i] = tasks[i].vertex();
+        assert(vertices[i] < graph.num_vertices());
+        assert(tasks[i].function() != NULL);
+      }
+      scope_manager->get_scopes(cpuid, vertices, scopes);
+      for (size_t i = 0; i < ntasks; ++i) {
+        tasks[i].function()(*scopes[i], callback);
+        scopes[i]->commit();
+      }
+      scope_manager->release_scopes(cpuid);
+      scheduler->completed_tasks(cpuid, tasks);
+
+      // record the successful execution of the tasks
+      const size_t oldcount = update_counts[cpuid];
+      update_counts[cpuid] += ntasks;
+      const size_t intervals = update_counts[cpuid] / (APX_INTERVAL + 1) -
+        oldcount / (APX_INTERVAL + 1);
+      if (intervals > 0) apx_update_counts.inc(intervals * (APX_INTERVAL + 1));
+      return ntasks;
+    }
+
     void construct_sync_queue() {
       sync_task_queue.clear();
       size_t min_sync_interval = size_t(-1);
@@ -32,6 +32,7 @@
 // The engines
 #include <graphlab/engine/iengine.hpp>
 #include <graphlab/engine/asynchronous_engine.hpp>
+#include <graphlab/engine/synchronous_engine.hpp>
 #include <graphlab/engine/engine_options.hpp>
 
 
@@ -61,6 +62,9 @@ namespace graphlab {
       if(engine == "async") {
         typedef asynchronous_engine<Graph, Scheduler, ScopeFactory> engine_type;
         return new engine_type(_graph, ncpus);
+      } else if(engine == "synchronous") {
+        // bulk synchronous. Does not use the scheduler or the scope factory
+        return new synchronous_engine<Graph>(_graph, ncpus);
       } else {
         std::cout << "Invalid engine type: " << engine
                   << std::endl;
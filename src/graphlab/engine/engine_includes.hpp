@@ -25,6 +25,7 @@
 
 #include <graphlab/engine/iengine.hpp>
 #include <graphlab/engine/asynchronous_engine.hpp>
+#include <graphlab/engine/synchronous_engine.hpp>
 #include <graphlab/engine/engine_factory.hpp>
 #include <graphlab/engine/engine_options.hpp>
 
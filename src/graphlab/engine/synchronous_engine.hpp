@@ -0,0 +1,694 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
+#define GRAPHLAB_SYNCHRONOUS_ENGINE_HPP
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <boost/bind.hpp>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/scope/synchronous_scope_factory.hpp>
+#include <graphlab/engine/iengine.hpp>
+#include <graphlab/schedulers/icallback.hpp>
+#include <graphlab/schedulers/support/vertex_task_set.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/monitoring/imonitor.hpp>
+#include <graphlab/shared_data/glshared.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+namespace graphlab {
+
+
+  /**
+   * \brief A bulk synchronous (BSP) engine.
+   *
+   * Execution proceeds in supersteps. In each superstep every
+   * scheduled vertex is updated once, in parallel and without
+   * locking. Neighbor vertex data is read from a snapshot of the end
+   * of the previous superstep (see synchronous_scope), so the result
+   * does not depend on the order of the updates. Tasks added during a
+   * superstep run in the next one. Between supersteps the updated
+   * vertices are copied into the snapshot and due syncs are evaluated
+   * in parallel.
+   *
+   * The scheduler and scope type chosen for the engine are ignored.
+   * The engine option (or scheduler option) max_iterations bounds
+   * the number of supersteps. Sync intervals are counted in updates
+   * as for the asynchronous engine but are only evaluated at
+   * superstep boundaries.
+   */
+  template<typename Graph>
+  class synchronous_engine : public iengine<Graph> {
+  public:
+    typedef iengine<Graph> iengine_base;
+    typedef typename iengine_base::vertex_id_type vertex_id_type;
+    typedef typename iengine_base::update_task_type update_task_type;
+    typedef typename iengine_base::update_function_type update_function_type;
+    typedef typename iengine_base::iscope_type iscope_type;
+    typedef typename iengine_base::sync_function_type sync_function_type;
+    typedef typename iengine_base::merge_function_type merge_function_type;
+    typedef typename iengine_base::termination_function_type
+    termination_function_type;
+    typedef typename iengine_base::imonitor_type imonitor_type;
+    typedef synchronous_scope_factory<Graph> scope_factory_type;
+    typedef vertex_task_set<Graph> task_set_type;
+
+  private:
+
+    /** Collects the tasks an update function adds for the next
+        superstep */
+    class engine_callback : public icallback<Graph> {
+      synchronous_engine* engine;
+      size_t cpuid;
+    public:
+      engine_callback() : engine(NULL), cpuid(0) { }
+      void init(synchronous_engine* _engine, size_t _cpuid) {
+        engine = _engine;
+        cpuid = _cpuid;
+      }
+      void add_task(update_task_type task, double priority) {
+        engine->schedule(cpuid, task, priority);
+      }
+      void add_tasks(const std::vector<vertex_id_type>& vertices,
+                     update_function_type func, double priority) {
+        foreach(vertex_id_type vertex, vertices) {
+          add_task(update_task_type(vertex, func), priority);
+        }
+      }
+      void force_abort() {
+        engine->stop();
+      }
+    };
+
+    /** Runs a worker thread */
+    class engine_thread {
+      synchronous_engine* engine;
+      size_t cpuid;
+    public:
+      engine_thread() : engine(NULL), cpuid(0) { }
+      void init(synchronous_engine* _engine, size_t _cpuid) {
+        engine = _engine;
+        cpuid = _cpuid;
+      }
+      void run() {
+        logger(LOG_INFO, "Worker %d started.\n", cpuid);
+        engine->run_worker(cpuid);
+        logger(LOG_INFO, "Worker %d finished.\n", cpuid);
+      }
+    };
+
+    struct sync_task {
+      sync_function_type sync_fun;
+      merge_function_type merge_fun;
+      glshared_base::apply_function_type apply_fun;
+      size_t sync_interval;
+      size_t next_time;
+      any zero;
+      vertex_id_type rangelow;
+      vertex_id_type rangehigh;
+      glshared_base *sharedvariable;
+      sync_task() :
+        sync_fun(NULL), merge_fun(NULL), apply_fun(NULL),
+        sync_interval(-1), next_time(0), rangelow(0),
+        rangehigh(vertex_id_type(-1)), sharedvariable(NULL) { }
+    };
+
+    /// Vertices are handed to the workers in chunks of this size
+    static const size_t CHUNK_SIZE = 64;
+
+    /** The graph that this engine is executing */
+    Graph& graph;
+
+    /** Number of cpus to use */
+    size_t ncpus;
+
+    /** Use processor affinities */
+    bool use_cpu_affinity;
+
+    /** Reads neighbors from the snapshot of the last superstep */
+    scope_factory_type scope_factory;
+
+    /** The tasks of the current and of the next superstep */
+    task_set_type tasks_a, tasks_b;
+    task_set_type* current_tasks;
+    task_set_type* next_tasks;
+
+    /** The vertices updated in the current superstep */
+    std::vector<vertex_id_type> active_vertices;
+    /** The next chunk of active_vertices to hand out */
+    atomic<size_t> next_chunk;
+
+    /** 1 if the vertex is already scheduled for the next superstep */
+    std::vector<unsigned char> scheduled;
+    /** The vertices scheduled for the next superstep by each cpu.
+        The last entry collects the tasks added from outside. */
+    std::vector<std::vector<vertex_id_type> > next_vertices;
+    mutex external_lock;
+
+    std::vector<engine_callback> callbacks;
+
+    /** Separates the phases of a superstep */
+    barrier step_barrier;
+
+    /** Track the number of updates */
+    std::vector<size_t> update_counts;
+
+    size_t superstep;
+    size_t max_iterations;
+    atomic<size_t> numsyncs;
+
+    /** The monitor which tracks and records engine events */
+    imonitor_type* monitor;
+
+    size_t start_time_millis;
+    size_t timeout_millis;
+    size_t task_budget;
+    std::vector<termination_function_type> term_functions;
+
+    /** True while the engine should keep running supersteps */
+    bool active;
+    /** Set by stop() or by a failed update. Ends the superstep early */
+    bool abort_requested;
+
+    const char* exception_message;
+    exec_status termination_reason;
+
+    /// A list of all registered sync tasks
+    std::vector<sync_task> sync_tasks;
+    /// A map from the shared variable to the sync task
+    std::map<glshared_base*, size_t> var2synctask;
+    /// Per cpu partial results of the syncs evaluated this superstep
+    std::vector<std::vector<any> > sync_accumulators;
+
+    metrics engine_metrics;
+
+  public:
+
+    synchronous_engine(Graph& graph, size_t ncpus = 1) :
+      graph(graph),
+      ncpus( std::max(ncpus, size_t(1)) ),
+      use_cpu_affinity(false),
+      scope_factory(graph, std::max(ncpus, size_t(1))),
+      tasks_a(0), tasks_b(0),
+      current_tasks(&tasks_a), next_tasks(&tasks_b),
+      next_chunk(0),
+      next_vertices(std::max(ncpus, size_t(1)) + 1),
+      callbacks(std::max(ncpus, size_t(1))),
+      step_barrier(std::max(ncpus, size_t(1))),
+      update_counts(std::max(ncpus, size_t(1)), 0),
+      superstep(0),
+      max_iterations(0),
+      numsyncs(0),
+      monitor(NULL),
+      start_time_millis(lowres_time_millis()),
+      timeout_millis(0),
+      task_budget(0),
+      active(false),
+      abort_requested(false),
+      exception_message(NULL),
+      termination_reason(EXEC_UNSET),
+      sync_accumulators(std::max(ncpus, size_t(1))),
+      engine_metrics("engine") {
+      for (size_t i = 0; i < callbacks.size(); ++i) {
+        callbacks[i].init(this, i);
+      }
+    }
+
+    //! Get the number of cpus
+    size_t get_ncpus() const { return ncpus; }
+
+    void set_cpu_affinities(bool value) {
+      use_cpu_affinity = value;
+    }
+
+    /** Scopes never lock, so the scope range is ignored */
+    void set_default_scope(scope_range::scope_range_enum default_scope_range) { }
+
+    void set_scheduler_options(const scheduler_options& opts) {
+      opts.get_int_option("max_iterations", max_iterations);
+    }
+
+    void set_engine_options(const scheduler_options& opts) {
+      opts.get_int_option("max_iterations", max_iterations);
+    }
+
+    static void print_options_help(std::ostream& out) {
+      out << "max_iterations = [integer, the maximum number of "
+          << "supersteps. 0 runs until no tasks are left, default=0]\n";
+    }
+
+    using iengine<Graph>::exec_status_as_string;
+
+    /** Execute the engine */
+    void start() {
+      graph.finalize();
+      ensure_task_capacity();
+      scope_factory.snapshot_all();
+
+      std::fill(update_counts.begin(), update_counts.end(), 0);
+      numsyncs.value = 0;
+      superstep = 0;
+      start_time_millis = lowres_time_millis();
+      abort_requested = false;
+      exception_message = NULL;
+      termination_reason = EXEC_TASK_DEPLETION;
+
+      // evaluate all syncs before the first superstep
+      for (size_t i = 0; i < sync_tasks.size(); ++i) {
+        evaluate_sync(i);
+      }
+      active = true;
+      begin_superstep();
+
+      std::vector<size_t> worker_cpus;
+      if (use_cpu_affinity) {
+        worker_cpus = numa_topology::get().worker_cpus(ncpus);
+      }
+      thread_group threads;
+      std::vector<engine_thread> workers(ncpus);
+      for (size_t i = 0; i < ncpus; ++i) {
+        workers[i].init(this, i);
+        if (use_cpu_affinity) {
+          threads.launch(boost::bind(&engine_thread::run, &(workers[i])),
+                         worker_cpus[i]);
+        } else {
+          threads.launch(boost::bind(&engine_thread::run, &(workers[i])));
+        }
+      }
+      while (threads.running_threads() > 0) {
+        try {
+          threads.join();
+        }
+        catch(const char* c) {
+          logstream(LOG_ERROR) << "Exception Caught: " << c << std::endl;
+          exception_message = c;
+          termination_reason = EXEC_EXCEPTION;
+        }
+      }
+      active = false;
+
+      // complete sync of all variables
+      for (size_t i = 0; i < sync_tasks.size(); ++i) {
+        evaluate_sync(i);
+      }
+      scope_factory.clear_snapshot();
+
+      for(size_t i = 0; i < update_counts.size(); ++i) {
+        engine_metrics.add("updatecount",
+                           (double)update_counts[i], INTEGER);
+        engine_metrics.add_vector_entry("updatecount_vector", i,
+                                        (double)update_counts[i]);
+      }
+      engine_metrics.add("runtime",
+                         ((double)lowres_time_millis() -
+                          (double)start_time_millis) * 0.001, TIME);
+      engine_metrics.set("termination_reason",
+                         exec_status_as_string(termination_reason));
+      engine_metrics.set_integer("num_vertices", graph.num_vertices());
+      engine_metrics.set_integer("num_edges", graph.num_edges());
+      engine_metrics.set_integer("num_syncs", numsyncs.value);
+      engine_metrics.set_integer("supersteps", superstep);
+
+      if (termination_reason == EXEC_EXCEPTION) {
+        throw(exception_message);
+      }
+    }
+
+    /**
+     * Stop the engine. The updates which are running complete, and the
+     * rest of the current superstep stays scheduled for the next call
+     * to start().
+     */
+    void stop() {
+      abort_requested = true;
+    }
+
+    exec_status last_exec_status() const {
+      return termination_reason;
+    }
+
+    size_t last_update_count() const {
+      size_t sum = 0;
+      for(size_t i = 0; i < update_counts.size(); ++i)
+        sum += update_counts[i];
+      return sum;
+    }
+
+    /** The number of supersteps run by the last start() */
+    size_t last_superstep_count() const { return superstep; }
+
+    void register_monitor(imonitor_type* _monitor = NULL) {
+      monitor = _monitor;
+      if(monitor != NULL) monitor->init(this);
+    }
+
+    void add_task(update_task_type task, double priority) {
+      ensure_task_capacity();
+      external_lock.lock();
+      schedule(ncpus, task, priority);
+      external_lock.unlock();
+    }
+
+    void add_tasks(const std::vector<vertex_id_type>& vertices,
+                   update_function_type func, double priority) {
+      foreach(vertex_id_type vertex, vertices) {
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+    void add_task_to_all(update_function_type func, double priority) {
+      for (vertex_id_type v = 0; v < graph.num_vertices(); ++v) {
+        add_task(update_task_type(v, func), priority);
+      }
+    }
+
+    void add_terminator(termination_function_type term) {
+      term_functions.push_back(term);
+    }
+
+    void clear_terminators() {
+      term_functions.clear();
+    }
+
+    void set_timeout(size_t timeout_seconds = 0) {
+      timeout_millis = timeout_seconds * 1000;
+    }
+
+    void set_task_budget(size_t max_tasks) {
+      task_budget = max_tasks;
+    }
+
+    /**
+     * \brief Registers a sync with the engine.
+     *
+     * See iengine::set_sync(). The sync is evaluated at the first
+     * superstep boundary after sync_interval updates have run since
+     * its last evaluation, in parallel if a merge function is given.
+     */
+    void set_sync(glshared_base& shared,
+                  sync_function_type sync,
+                  glshared_base::apply_function_type apply,
+                  const any& zero,
+                  size_t sync_interval = 0,
+                  merge_function_type merge = NULL,
+                  vertex_id_type rangelow = 0,
+                  vertex_id_type rangehigh = -1) {
+      sync_task st;
+      st.sync_fun = sync;
+      st.merge_fun = merge;
+      st.apply_fun = apply;
+      st.sync_interval = sync_interval;
+      st.next_time = 0;
+      st.zero = zero;
+      st.rangelow = rangelow;
+      st.rangehigh = rangehigh;
+      st.sharedvariable = &shared;
+      sync_tasks.push_back(st);
+      var2synctask[&shared] = sync_tasks.size() - 1;
+    }
+
+    /**
+     * Performs a sync immediately. Must not be called while the
+     * engine is running.
+     */
+    void sync_now(glshared_base& shared) {
+      ASSERT_FALSE(active);
+      std::map<glshared_base*, size_t>::iterator iter =
+        var2synctask.find(&shared);
+      ASSERT_TRUE(iter != var2synctask.end());
+      // neighbors are read from the snapshot
+      scope_factory.snapshot_all();
+      evaluate_sync(iter->second);
+      scope_factory.clear_snapshot();
+    }
+
+    metrics get_metrics() {
+      return engine_metrics;
+    }
+
+    void reset_metrics() {
+      engine_metrics.clear();
+    }
+
+  private:
+
+    /** Sizes the per vertex task state for the current graph */
+    void ensure_task_capacity() {
+      if (scheduled.size() == graph.num_vertices()) return;
+      ASSERT_FALSE(active);
+      tasks_a.resize(graph.num_vertices());
+      tasks_b.resize(graph.num_vertices());
+      scheduled.resize(graph.num_vertices(), 0);
+    }
+
+    /** Adds a task to the next superstep */
+    void schedule(size_t listid, const update_task_type& task,
+                  double priority) {
+      const vertex_id_type v = task.vertex();
+      assert(v < scheduled.size());
+      next_tasks->add(task, priority);
+      if (scheduled[v] == 0 &&
+          __sync_bool_compare_and_swap(&(scheduled[v]), 0, 1)) {
+        next_vertices[listid].push_back(v);
+      }
+    }
+
+    /**
+     * Makes the tasks scheduled so far the tasks of the current
+     * superstep. Called by one thread while the others wait.
+     */
+    void begin_superstep() {
+      std::swap(current_tasks, next_tasks);
+      active_vertices.clear();
+      for (size_t i = 0; i < next_vertices.size(); ++i) {
+        active_vertices.insert(active_vertices.end(),
+                               next_vertices[i].begin(),
+                               next_vertices[i].end());
+        next_vertices[i].clear();
+      }
+      // in vertex order for locality
+      std::sort(active_vertices.begin(), active_vertices.end());
+      for (size_t i = 0; i < active_vertices.size(); ++i) {
+        scheduled[active_vertices[i]] = 0;
+      }
+      next_chunk.value = 0;
+    }
+
+    /** Claims the next chunk of the active vertices */
+    bool next_range(size_t& begin, size_t& end) {
+      begin = next_chunk.inc_ret_last(CHUNK_SIZE);
+      if (begin >= active_vertices.size()) return false;
+      end = std::min(begin + CHUNK_SIZE, active_vertices.size());
+      return true;
+    }
+
+    /** The slice [begin, end) of n items owned by cpuid */
+    void my_slice(size_t cpuid, size_t n, size_t& begin, size_t& end) const {
+      begin = (n * cpuid) / ncpus;
+      end = (n * (cpuid + 1)) / ncpus;
+    }
+
+    bool sync_due(const sync_task& sync, size_t nupdates) const {
+      return sync.sync_interval > 0 && sync.next_time <= nupdates;
+    }
+
+    void run_worker(size_t cpuid) {
+      while(true) {
+        // wait for the superstep to be set up
+        step_barrier.wait();
+        if (!active) break;
+
+        // 1: run the updates
+        engine_callback& callback = callbacks[cpuid];
+        size_t begin = 0, end = 0;
+        while (!abort_requested && next_range(begin, end)) {
+          for (size_t i = begin; i < end; ++i) {
+            const vertex_id_type v = active_vertices[i];
+            update_task_type task;
+            double priority = 0;
+            while (current_tasks->pop(v, task, priority)) {
+              iscope_type* scope = scope_factory.get_scope(cpuid, v);
+              try {
+                task.function()(*scope, callback);
+              }
+              catch(const char* c) {
+                exception_message = c;
+                termination_reason = EXEC_EXCEPTION;
+                abort_requested = true;
+              }
+              ++update_counts[cpuid];
+            }
+          }
+        }
+        step_barrier.wait();
+
+        // 2: flip the buffers of the updated vertices and accumulate
+        // the due syncs over this cpu's share of their ranges
+        my_slice(cpuid, active_vertices.size(), begin, end);
+        for (size_t i = begin; i < end; ++i) {
+          scope_factory.snapshot_vertex(active_vertices[i]);
+        }
+        const size_t nupdates = last_update_count();
+        sync_accumulators[cpuid].resize(sync_tasks.size());
+        for (size_t i = 0; i < sync_tasks.size(); ++i) {
+          if (sync_due(sync_tasks[i], nupdates) &&
+              sync_tasks[i].merge_fun != NULL) {
+            accumulate_sync(i, cpuid);
+          }
+        }
+        step_barrier.wait();
+
+        // 3: merge the syncs and set up the next superstep
+        if (cpuid == 0) end_superstep(nupdates);
+      }
+    }
+
+    /** Accumulates sync i over cpuid's share of its range */
+    void accumulate_sync(size_t syncid, size_t cpuid) {
+      sync_task& sync = sync_tasks[syncid];
+      const size_t vmin = sync.rangelow;
+      const size_t vmax = std::min(size_t(sync.rangehigh) + 1,
+                                   size_t(graph.num_vertices()));
+      size_t begin = 0, end = 0;
+      my_slice(cpuid, vmax > vmin ? vmax - vmin : 0, begin, end);
+      any& accumulator = sync_accumulators[cpuid][syncid];
+      accumulator = sync.zero;
+      for (size_t v = vmin + begin; v < vmin + end; ++v) {
+        iscope_type* scope = scope_factory.get_scope(cpuid, vertex_id_type(v));
+        sync.sync_fun(*scope, accumulator);
+      }
+    }
+
+    /** Evaluates sync i sequentially on the calling thread */
+    void evaluate_sync(size_t syncid) {
+      sync_task& sync = sync_tasks[syncid];
+      const size_t vmin = sync.rangelow;
+      const size_t vmax = std::min(size_t(sync.rangehigh) + 1,
+                                   size_t(graph.num_vertices()));
+      any accumulator = sync.zero;
+      for (size_t v = vmin; v < vmax; ++v) {
+        iscope_type* scope = scope_factory.get_scope(0, vertex_id_type(v));
+        sync.sync_fun(*scope, accumulator);
+      }
+      sync.sharedvariable->apply(sync.apply_fun, accumulator);
+      sync.next_time = last_update_count() + sync.sync_interval;
+      numsyncs.inc();
+    }
+
+    /**
+     * Completes the due syncs, checks the termination conditions and,
+     * if the engine continues, sets up the next superstep. Called by
+     * cpu 0 while the other workers wait for the next superstep.
+     */
+    void end_superstep(size_t nupdates) {
+      for (size_t i = 0; i < sync_tasks.size(); ++i) {
+        sync_task& sync = sync_tasks[i];
+        if (!sync_due(sync, nupdates)) continue;
+        if (sync.merge_fun == NULL) {
+          evaluate_sync(i);
+          continue;
+        }
+        any& result = sync_accumulators[0][i];
+        for (size_t j = 1; j < sync_accumulators.size(); ++j) {
+          sync.merge_fun(result, sync_accumulators[j][i]);
+        }
+        sync.sharedvariable->apply(sync.apply_fun, result);
+        sync.next_time = nupdates + sync.sync_interval;
+        numsyncs.inc();
+      }
+      ++superstep;
+
+      // the tasks are only moved into the next superstep if it runs.
+      // Otherwise they stay scheduled for the next start()
+      if (abort_requested) {
+        carry_over_unfinished();
+        if (termination_reason != EXEC_EXCEPTION) {
+          termination_reason = EXEC_FORCED_ABORT;
+        }
+        active = false;
+      } else if (!tasks_pending()) {
+        termination_reason = EXEC_TASK_DEPLETION;
+        active = false;
+      } else if (max_iterations > 0 && superstep >= max_iterations) {
+        termination_reason = EXEC_TASK_DEPLETION;
+        active = false;
+      } else if (timeout_millis > 0 &&
+                 start_time_millis + timeout_millis < lowres_time_millis()) {
+        termination_reason = EXEC_TIMEOUT;
+        active = false;
+      } else if (task_budget > 0 && nupdates >= task_budget) {
+        termination_reason = EXEC_TASK_BUDGET_EXCEEDED;
+        active = false;
+      } else {
+        for (size_t i = 0; i < term_functions.size(); ++i) {
+          if (term_functions[i]()) {
+            termination_reason = EXEC_TERM_FUNCTION;
+            active = false;
+            break;
+          }
+        }
+      }
+      if (active) begin_superstep();
+    }
+
+    /** True if any task is scheduled for the next superstep */
+    bool tasks_pending() const {
+      for (size_t i = 0; i < next_vertices.size(); ++i) {
+        if (!next_vertices[i].empty()) return true;
+      }
+      return false;
+    }
+
+    /**
+     * Moves the tasks of the current superstep which did not run
+     * before an abort to the next superstep
+     */
+    void carry_over_unfinished() {
+      update_task_type task;
+      double priority = 0;
+      for (size_t i = 0; i < active_vertices.size(); ++i) {
+        const vertex_id_type v = active_vertices[i];
+        while (current_tasks->pop(v, task, priority)) {
+          schedule(ncpus, task, priority);
+        }
+      }
+      active_vertices.clear();
+    }
+  }; // end of synchronous_engine
+
+} // end of namespace graphlab
+
+#include <graphlab/macros_undef.hpp>
+
+#endif
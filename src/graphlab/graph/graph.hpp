@@ -73,6 +73,8 @@
 
 #include <graphlab/util/random.hpp>
 
+#include <graphlab/graph/graph_edge_storage.hpp>
+
 
 
 
@@ -131,6 +133,34 @@ namespace graphlab {
      graph::finalize() is needed after graph construction to restore
      the invariant.  The engine routines will defensively call
      graph::finalize() it is not first called by the user.
+
+     <h2> Compressed Storage </h2>
+
+     Calling graph::finalize(true) additionally freezes the adjacency
+     structure into compressed sparse row form: the in-edges (and
+     out-edges) of all vertices are stored back to back in a single
+     array indexed by a per vertex offset array.  This removes one
+     heap allocation per vertex per direction and makes a walk over
+     the neighborhoods of consecutive vertices a sequential scan.
+     The graph::in_edge_ids() and graph::out_edge_ids() interface is
+     unchanged.  Adding a vertex or an edge to a compressed graph
+     transparently converts it back to the adjacency list form.
+
+     <h2> Edge Layout </h2>
+
+     By default the source, target and data of each edge are stored
+     together.  For large edge data types, code that only needs the
+     graph structure (scope locking, coloring, edge lookup) can be
+     made considerably more cache friendly by storing the edge data
+     in a separate array:
+
+     \code
+     SPLIT_EDGE_DATA(my_edge_data_type)
+     \endcode
+
+     The macro must be used in the global namespace before the graph
+     type is instantiated.  The layout does not change the graph
+     interface or the archive format.
   */
   template<typename VertexData, typename EdgeData>
   class graph {
@@ -208,6 +238,12 @@ namespace graphlab {
 
     /** The type of the edge data stored in the graph */
     typedef EdgeData   edge_data_type;
+
+  private:
+    /** The type of the container holding the edges */
+    typedef graph_detail::edge_storage<vertex_id_type, EdgeData,
+                                       split_edge_data<EdgeData>::value>
+    edge_storage_type;
     
   public:
 
@@ -215,7 +251,7 @@ namespace graphlab {
     /**
      * Build a basic graph
      */
-    graph() : finalized(true),changeid(0) {  }
+    graph() : finalized(true), compressed(false), changeid(0) {  }
 
     /**
      * Create a graph with nverts vertices.
@@ -223,7 +259,7 @@ namespace graphlab {
     graph(size_t nverts) : 
       vertices(nverts),
       in_edges(nverts), out_edges(nverts), vcolors(nverts),
-      finalized(true),changeid(0) { }
+      finalized(true), compressed(false), changeid(0) { }
 
     graph(const graph<VertexData, EdgeData>& g) { (*this) = g; }
 
@@ -234,6 +270,11 @@ namespace graphlab {
       edges.clear();
       in_edges.clear();
       out_edges.clear();
+      in_edge_offset.clear();
+      in_edge_index.clear();
+      out_edge_offset.clear();
+      out_edge_index.clear();
+      compressed = false;
       vcolors.clear();
     }
 
@@ -245,8 +286,13 @@ namespace graphlab {
       edges.clear();
       in_edges.clear();
       out_edges.clear();
+      in_edge_offset.clear();
+      in_edge_index.clear();
+      out_edge_offset.clear();
+      out_edge_index.clear();
       vcolors.clear();
       finalized = true;
+      compressed = false;
       ++changeid;
     }
     
@@ -257,11 +303,19 @@ namespace graphlab {
      * fail if there are any duplicate edges.
      * This is also automatically invoked by the engine at
      * start.
+     *
+     * If compress is true the sorted adjacency lists are then
+     * frozen into compressed sparse row storage (see
+     * graph::is_compressed()).  The graph stays compressed until the
+     * next call to add_vertex(), add_edge() or resize().
      */
-    void finalize() {   
+    void finalize(bool compress = false) {   
       //      std::cout << "considering finalize" << std::endl;
       // check to see if the graph is already finalized
-      if(finalized) return;
+      if(finalized) {
+        if(compress && !compressed) compress_adjacency();
+        return;
+      }
       //      std::cout << "Finalizing" << std::endl;
       typedef std::vector< edge_id_type > edge_set;
       edge_id_less_functor less_functor(this);      
@@ -313,7 +367,12 @@ namespace graphlab {
         }
       }
       finalized = true;
+      if(compress) compress_adjacency();
     } // End of finalize
+
+    /** \brief Returns true if the adjacency structure is currently
+        stored in compressed sparse row form. */
+    bool is_compressed() const { return compressed; }
             
     /** \brief Get the number of vertices */
     size_t num_vertices() const {
@@ -333,14 +392,12 @@ namespace graphlab {
 
     /** \brief Get the number of in edges of a particular vertex */
     size_t num_in_neighbors(vertex_id_type v) const {
-      ASSERT_LT(v, vertices.size());
-      return in_edges[v].size();
+      return in_edge_ids(v).size();
     } // end of num vertices
     
     /** \brief Get the number of out edges of a particular vertex */
     size_t num_out_neighbors(vertex_id_type v) const  {
-      ASSERT_LT(v, vertices.size());
-      return out_edges[v].size();
+      return out_edge_ids(v).size();
     } // end of num vertices
 
     /** \brief Finds an edge.
@@ -349,50 +406,52 @@ namespace graphlab {
         edge is found, the edge ID is returned in the second element of the pair. */
     std::pair<bool, edge_id_type>
     find(vertex_id_type source, vertex_id_type target) const {
-      ASSERT_LT(source, in_edges.size());
-      ASSERT_LT(target, out_edges.size());
+      ASSERT_LT(source, vertices.size());
+      ASSERT_LT(target, vertices.size());
+      const edge_list target_in_edges = in_edge_ids(target);
+      const edge_list source_out_edges = out_edge_ids(source);
       // Check the base case that the souce or target have no edges
-      if (in_edges[target].size() == 0 ||
-          out_edges[source].size() == 0) {
+      if (target_in_edges.size() == 0 ||
+          source_out_edges.size() == 0) {
         return std::make_pair(false,-1);
       } else if(finalized) { // O( log degree ) search ========================>
         // if it is finalized then do the search using a binary search
         // If their are fewer in edges into the target search the in
         // edges
-        if(in_edges[target].size() < out_edges[source].size()) {
+        if(target_in_edges.size() < source_out_edges.size()) {
           // search the source vertices for the edge
-          size_t index = binary_search(in_edges[target], source, target);
-          if(index < in_edges[target].size())
-            return std::make_pair(true, in_edges[target][index]);
+          size_t index = binary_search(target_in_edges, source, target);
+          if(index < target_in_edges.size())
+            return std::make_pair(true, target_in_edges[index]);
           else
             return std::make_pair(false,-1);
         } else { // If their are fewer edges out of the source binary
                  // search there
           // search the source vertices for the edge
-          size_t index = binary_search(out_edges[source], source, target);
-          if(index < out_edges[source].size())
-            return std::make_pair(true, out_edges[source][index]);
+          size_t index = binary_search(source_out_edges, source, target);
+          if(index < source_out_edges.size())
+            return std::make_pair(true, source_out_edges[index]);
           else
             return std::make_pair(false,-1);
         }
       } else { // O( degree ) search ==========================================>
         // if there are few in edges at the target search there
-        if(in_edges[target].size() < out_edges[source].size()) {
+        if(target_in_edges.size() < source_out_edges.size()) {
           // linear search the in_edges at the target 
-          foreach(edge_id_type eid, in_edges[target]) {
+          foreach(edge_id_type eid, target_in_edges) {
             ASSERT_LT(eid, edges.size());
-            if(edges[eid].source() == source 
-               && edges[eid].target() == target) {
+            if(edges.source(eid) == source 
+               && edges.target(eid) == target) {
               return std::make_pair(true, eid);
             }
           }
           return std::make_pair(false, -1);
         } else { // fewer out edges at the source
           // linear search the out_edges at the source
-          foreach(edge_id_type eid, out_edges[source]) {
+          foreach(edge_id_type eid, source_out_edges) {
             ASSERT_LT(eid, edges.size());
-            if(edges[eid].source() == source 
-               && edges[eid].target() == target) {
+            if(edges.source(eid) == source 
+               && edges.target(eid) == target) {
               return std::make_pair(true, eid);
             }
           }
@@ -418,8 +477,8 @@ namespace graphlab {
         Assertion failure if such an edge is not found.  */
     edge_id_type rev_edge_id(edge_id_type eid) const {
       ASSERT_LT(eid, edges.size());
-      vertex_id_type source = edges[eid].source();
-      vertex_id_type target = edges[eid].target();    
+      vertex_id_type source = edges.source(eid);
+      vertex_id_type target = edges.target(eid);    
       return edge_id(target, source);
     } // end of rev_edge_id
 
@@ -429,6 +488,7 @@ namespace graphlab {
      * the first vertex having id 0.
      */
     vertex_id_type add_vertex(const VertexData& vdata = VertexData() ) {
+      if(compressed) decompress_adjacency();
       vertices.push_back(vdata);
       // Resize edge maps
       out_edges.push_back(std::vector<edge_id_type>()); // resize(vertices.size());
@@ -444,6 +504,7 @@ namespace graphlab {
      */
     void resize(size_t num_vertices ) {
       ASSERT_GE(num_vertices, vertices.size());
+      if(compressed) decompress_adjacency();
       vertices.resize(num_vertices);
       // Resize edge maps
       out_edges.resize(vertices.size());
@@ -479,8 +540,10 @@ namespace graphlab {
         ASSERT_MSG(source != target, "Attempting to add self edge!");
       }
 
+      if(compressed) decompress_adjacency();
+
       // Add the edge to the set of edge data (this copies the edata)
-      edges.push_back( edge( source, target, edata ) );
+      edges.push_back(source, target, edata);
 
       // Add the edge id to in and out edge maps
       edge_id_type edge_id = (edge_id_type)edges.size() - 1;
@@ -524,7 +587,7 @@ namespace graphlab {
       ASSERT_TRUE(ans.first);
       // the edge id should be valid!
       ASSERT_LT(ans.second, edges.size());
-      return edges[ans.second].data();
+      return edges.data(ans.second);
     } // end of edge_data(u,v)
     
     /** \brief Returns a constant reference to the data stored on the
@@ -537,31 +600,31 @@ namespace graphlab {
       ASSERT_TRUE(ans.first);
       // the edge id should be valid!
       ASSERT_LT(ans.second, edges.size());
-      return edges[ans.second].data();
+      return edges.data(ans.second);
     } // end of edge_data(u,v)
 
     /** \brief Returns a reference to the data stored on the edge e */
     EdgeData& edge_data(edge_id_type edge_id) { 
       ASSERT_LT(edge_id, edges.size());
-      return edges[edge_id].data();
+      return edges.data(edge_id);
     }
     
     /** \brief Returns a constant reference to the data stored on the edge e */
     const EdgeData& edge_data(edge_id_type edge_id) const {
       ASSERT_LT(edge_id, edges.size());
-      return edges[edge_id].data();
+      return edges.data(edge_id);
     }
 
     /** \brief Returns the source vertex of an edge. */
     vertex_id_type source(edge_id_type edge_id) const {
       //      ASSERT_LT(edge_id, edges.size());
-      return edges[edge_id].source();
+      return edges.source(edge_id);
     }
 
     /** \brief Returns the destination vertex of an edge. */
     vertex_id_type target(edge_id_type edge_id) const {
       //      ASSERT_LT(edge_id, edges.size());
-      return edges[edge_id].target();    
+      return edges.target(edge_id);    
     }
     
     /** \brief Returns the vertex color of a vertex.
@@ -656,21 +719,25 @@ namespace graphlab {
     
     /** \brief Return the edge ids of the edges arriving at v */
     edge_list in_edge_ids(vertex_id_type v) const {
-      ASSERT_LT(v, in_edges.size());
+      ASSERT_LT(v, vertices.size());
+      if(compressed) 
+        return compressed_edge_list(in_edge_offset, in_edge_index, v);
       return edge_list(in_edges[v]);
     } // end of in edges    
 
     /** \brief Return the edge ids of the edges leaving at v */
     edge_list out_edge_ids(vertex_id_type v) const {
-      ASSERT_LT(v, out_edges.size());
+      ASSERT_LT(v, vertices.size());
+      if(compressed) 
+        return compressed_edge_list(out_edge_offset, out_edge_index, v);
       return edge_list(out_edges[v]);
     } // end of out edges
     
     /** \brief Get the set of in vertices of vertex v */
     std::vector<vertex_id_type> in_vertices(vertex_id_type v) const {
       std::vector<vertex_id_type> ret;
-      foreach(edge_id_type eid, in_edges[v]) {
-        ret.push_back(edges[eid].source());
+      foreach(edge_id_type eid, in_edge_ids(v)) {
+        ret.push_back(edges.source(eid));
       }
       return ret;
     }
@@ -678,8 +745,8 @@ namespace graphlab {
     /** \brief Get the set of out vertices of vertex v */
     std::vector<vertex_id_type> out_vertices(vertex_id_type v) const {
       std::vector<vertex_id_type> ret;
-      foreach(edge_id_type eid, out_edges[v]) {
-        ret.push_back(edges[eid].target());
+      foreach(edge_id_type eid, out_edge_ids(v)) {
+        ret.push_back(edges.target(eid));
       }
       return ret;
     }
@@ -706,10 +773,17 @@ namespace graphlab {
     void save(oarchive& arc) const {
       // Write the number of edges and vertices
       arc << vertices
-          << edges
-          << in_edges
-          << out_edges
-          << vcolors
+          << edges;
+      // Compressed graphs are saved in the adjacency list format so
+      // the archive does not depend on the storage layout
+      if(compressed) {
+        save_compressed_edges(arc, in_edge_offset, in_edge_index);
+        save_compressed_edges(arc, out_edge_offset, out_edge_index);
+      } else {
+        arc << in_edges
+            << out_edges;
+      }
+      arc << vcolors
           << finalized;
     } // end of save
     
@@ -745,7 +819,7 @@ namespace graphlab {
       std::ofstream fout(filename.c_str());
       ASSERT_TRUE(fout.good());
       for(size_t i = 0; i < edges.size(); ++i) {
-        fout << edges[i].source() << ", " << edges[i].target() << "\n";
+        fout << edges.source(i) << ", " << edges.target(i) << "\n";
         ASSERT_TRUE(fout.good());
       }          
       fout.close();
@@ -798,45 +872,88 @@ namespace graphlab {
       return true;
     } // end of topological sort
 
-    
-  private:    
-    /** Internal edge class  */   
-    class edge {
-      vertex_id_type _source;
-      vertex_id_type _target;
-      EdgeData _data;
-    public:
-      edge() : _source(-1), _target(-1) { }
-      edge(const edge& other) :
-        _source(other.source()), _target(other.target()),
-        _data(other.data()) { }
-      edge(vertex_id_type source, vertex_id_type target) :
-        _source(source), _target(target)  { }
-      edge(vertex_id_type source, vertex_id_type target, EdgeData data) : 
-        _source(source), _target(target), _data(data) {}
-
-      bool operator<(const edge& other) const {
-        return (_source < other._source) || 
-          (_source == other._source && _target < other._target); 
-      }
-      
-      inline vertex_id_type source() const { return _source; }
-      inline vertex_id_type target() const { return _target; }   
-      inline EdgeData& data() { return _data; }
-      inline const EdgeData& data() const { return _data; }
-      
-      void load(iarchive& arc) {
-        arc >> _source
-            >> _target
-            >> _data;
+
+    /**
+     * \brief Renumbers the vertices of the graph to improve memory
+     * locality and returns the permutation used.
+     *
+     * Vertex ids are assigned in the order given by method:
+     * <ul>
+     *   <li> "rcm" : Reverse Cuthill-McKee ordering, which reduces
+     *        the bandwidth of the adjacency matrix. </li>
+     *   <li> "bfs" : Breadth first search order, restarted at the
+     *        lowest unvisited vertex id for each connected
+     *        component. </li>
+     *   <li> "degree" : Decreasing total (in + out) degree. </li>
+     * </ul>
+     * Edge directions are ignored when computing the ordering.
+     *
+     * On return perm[old_vid] is the new id of the vertex with id
+     * old_vid.  Vertex data and colors move with their vertex.  Edge
+     * ids are preserved, so edge data and any stored edge ids remain
+     * valid.  Any structure sized or indexed by vertex id (scope
+     * locks, schedulers, engines) must be constructed after calling
+     * this function.
+     */
+    void reorder(const std::string& method, 
+                 std::vector<vertex_id_type>& perm) {
+      std::vector<vertex_id_type> order;
+      if(method == "rcm") {
+        cuthill_mckee_order(order);
+        std::reverse(order.begin(), order.end());
+      } else if(method == "bfs") {
+        bfs_order(order);
+      } else if(method == "degree") {
+        degree_order(order);
+      } else {
+        logstream(LOG_FATAL) 
+          << "Unknown vertex ordering method: " << method << std::endl;
       }
-      
-      void save(oarchive& arc) const {
-        arc << _source
-            << _target
-            << _data;
+      ASSERT_EQ(order.size(), num_vertices());
+      perm.resize(order.size());
+      for(size_t i = 0; i < order.size(); ++i) 
+        perm[order[i]] = vertex_id_type(i);
+      permute(perm);
+    } // end of reorder
+
+
+    /**
+     * \brief Renumbers the vertices of the graph such that the vertex
+     * with id v receives the id perm[v].  perm must be a permutation
+     * of 0 .. num_vertices() - 1.  See graph::reorder().
+     */
+    void permute(const std::vector<vertex_id_type>& perm) {
+      ASSERT_EQ(perm.size(), num_vertices());
+      const bool was_compressed = compressed;
+      if(compressed) decompress_adjacency();
+      // Move the vertex data, colors and adjacency lists
+      std::vector<VertexData> new_vertices(vertices.size());
+      std::vector<vertex_color_type> new_vcolors(vcolors.size());
+      std::vector< std::vector<edge_id_type> > new_in_edges(in_edges.size());
+      std::vector< std::vector<edge_id_type> > new_out_edges(out_edges.size());
+      for(size_t v = 0; v < perm.size(); ++v) {
+        const vertex_id_type newv = perm[v];
+        ASSERT_LT(newv, perm.size());
+        new_vertices[newv] = vertices[v];
+        if(!vcolors.empty()) new_vcolors[newv] = vcolors[v];
+        new_in_edges[newv].swap(in_edges[v]);
+        new_out_edges[newv].swap(out_edges[v]);
       }
-    }; // end of edge_data
+      vertices.swap(new_vertices);
+      vcolors.swap(new_vcolors);
+      in_edges.swap(new_in_edges);
+      out_edges.swap(new_out_edges);
+      // Rename the edge endpoints and restore the sorted order of the
+      // edge lists
+      edges.remap_vertices(perm);
+      finalized = false;
+      finalize(was_compressed);
+      ++changeid;
+    } // end of permute
+
+
+    
+  private:    
 
 
     
@@ -858,7 +975,7 @@ namespace graphlab {
     inline bool edge_id_less(edge_id_type a, edge_id_type b) const {
       //      ASSERT_LT(a, edges.size());
       //      ASSERT_LT(b, edges.size());
-      return edges[a] < edges[b];
+      return edges.less(a, b);
     }
 
     
@@ -867,9 +984,9 @@ namespace graphlab {
     /** The vertex data is simply a vector of vertex data */
     std::vector<VertexData> vertices;
 
-    /** The edge data is a vector of edges where each edge stores its
-        source, destination, and data. */
-    std::vector<edge> edges;
+    /** The edges where each edge stores its source, destination, and
+        data.  See split_edge_data for the layout. */
+    edge_storage_type edges;
     
     /** A map from src_vertex -> dest_vertex -> edge index */   
     std::vector< std::vector<edge_id_type> >  in_edges;
@@ -880,22 +997,200 @@ namespace graphlab {
     /** The vertex colors specified by the user. **/
     std::vector< vertex_color_type > vcolors;  
     
+    /** The compressed sparse row form of in_edges.  The in edges of
+        vertex v are in_edge_index[in_edge_offset[v]] through
+        in_edge_index[in_edge_offset[v+1] - 1].  Only used when
+        compressed is true, in which case in_edges is empty. */
+    std::vector<edge_id_type> in_edge_offset;
+    std::vector<edge_id_type> in_edge_index;
+
+    /** The compressed sparse row form of out_edges */
+    std::vector<edge_id_type> out_edge_offset;
+    std::vector<edge_id_type> out_edge_index;
+
     /** Mark whether the graph is finalized.  Graph finalization is a
         costly procedure but it can also dramatically improve
         performance. */
     bool finalized;
+
+    /** Mark whether the adjacency structure is stored in the
+        compressed sparse row arrays rather than in in_edges and
+        out_edges */
+    bool compressed;
     
     /** increments whenever the graph is cleared. Used to track the
      *  changes to the graph structure  */
     size_t changeid;
 
     // PRIVATE HELPERS =========================================================>
+    /** Total (in + out) degree of a vertex */
+    size_t degree(vertex_id_type v) const {
+      return num_in_neighbors(v) + num_out_neighbors(v);
+    }
+
+    /** Collects the neighbors of v ignoring edge direction */
+    void undirected_neighbors(vertex_id_type v, 
+                              std::vector<vertex_id_type>& neighbors) const {
+      neighbors.clear();
+      foreach(edge_id_type eid, in_edge_ids(v)) neighbors.push_back(source(eid));
+      foreach(edge_id_type eid, out_edge_ids(v)) neighbors.push_back(target(eid));
+    }
+
+    struct degree_less_functor {
+      const graph* g_ptr;
+      degree_less_functor(const graph* g_ptr) : g_ptr(g_ptr) { }
+      bool operator()(vertex_id_type a, vertex_id_type b) const {
+        return g_ptr->degree(a) < g_ptr->degree(b);
+      }
+    };
+
+    /** Compares two vertices by decreasing total degree */
+    struct degree_greater_functor {
+      const graph* g_ptr;
+      degree_greater_functor(const graph* g_ptr) : g_ptr(g_ptr) { }
+      bool operator()(vertex_id_type a, vertex_id_type b) const {
+        return g_ptr->degree(a) > g_ptr->degree(b);
+      }
+    };
+
+    /** Breadth first search ordering of the vertices.  Each connected
+        component is started at its lowest vertex id */
+    void bfs_order(std::vector<vertex_id_type>& order) const {
+      order.clear(); order.reserve(num_vertices());
+      std::vector<bool> visited(num_vertices(), false);
+      std::vector<vertex_id_type> neighbors;
+      for(vertex_id_type root = 0; root < num_vertices(); ++root) {
+        if(visited[root]) continue;
+        // order itself is used as the queue
+        size_t head = order.size();
+        visited[root] = true;
+        order.push_back(root);
+        while(head < order.size()) {
+          undirected_neighbors(order[head++], neighbors);
+          foreach(vertex_id_type nbr, neighbors) {
+            if(!visited[nbr]) { visited[nbr] = true; order.push_back(nbr); }
+          }
+        }
+      }
+    } // end of bfs_order
+
+    /** Cuthill-McKee ordering of the vertices.  Each connected
+        component is started at its vertex of minimum degree and the
+        neighbors of each vertex are visited in increasing degree */
+    void cuthill_mckee_order(std::vector<vertex_id_type>& order) const {
+      order.clear(); order.reserve(num_vertices());
+      std::vector<bool> visited(num_vertices(), false);
+      // candidate roots by increasing degree
+      std::vector<vertex_id_type> roots(num_vertices());
+      for(vertex_id_type v = 0; v < num_vertices(); ++v) roots[v] = v;
+      std::stable_sort(roots.begin(), roots.end(), degree_less_functor(this));
+      std::vector<vertex_id_type> neighbors;
+      foreach(vertex_id_type root, roots) {
+        if(visited[root]) continue;
+        size_t head = order.size();
+        visited[root] = true;
+        order.push_back(root);
+        while(head < order.size()) {
+          undirected_neighbors(order[head++], neighbors);
+          const size_t first_new = order.size();
+          foreach(vertex_id_type nbr, neighbors) {
+            if(!visited[nbr]) { visited[nbr] = true; order.push_back(nbr); }
+          }
+          std::stable_sort(order.begin() + first_new, order.end(),
+                           degree_less_functor(this));
+        }
+      }
+    } // end of cuthill_mckee_order
+
+    /** Orders the vertices by decreasing total degree.  Vertices of
+        equal degree keep their original relative order. */
+    void degree_order(std::vector<vertex_id_type>& order) const {
+      order.resize(num_vertices());
+      for(vertex_id_type v = 0; v < num_vertices(); ++v) order[v] = v;
+      std::stable_sort(order.begin(), order.end(), 
+                       degree_greater_functor(this));
+    } // end of degree_order
+
+    /** Freeze the (sorted) adjacency lists into the compressed sparse
+        row arrays and release the per vertex vectors */
+    void compress_adjacency() {
+      ASSERT_FALSE(compressed);
+      build_compressed_edges(in_edges, in_edge_offset, in_edge_index);
+      build_compressed_edges(out_edges, out_edge_offset, out_edge_index);
+      compressed = true;
+    } // end of compress_adjacency
+
+    /** Restore the per vertex adjacency lists from the compressed
+        sparse row arrays so that the graph can be modified */
+    void decompress_adjacency() {
+      ASSERT_TRUE(compressed);
+      build_edge_lists(in_edge_offset, in_edge_index, in_edges);
+      build_edge_lists(out_edge_offset, out_edge_index, out_edges);
+      compressed = false;
+    } // end of decompress_adjacency
+
+    static void
+    build_compressed_edges(std::vector< std::vector<edge_id_type> >& lists,
+                           std::vector<edge_id_type>& offset,
+                           std::vector<edge_id_type>& index) {
+      offset.resize(lists.size() + 1);
+      offset[0] = 0;
+      for(size_t i = 0; i < lists.size(); ++i) 
+        offset[i+1] = offset[i] + edge_id_type(lists[i].size());
+      index.resize(offset.back());
+#pragma omp parallel for
+      for(ssize_t i = 0; i < ssize_t(lists.size()); ++i) 
+        std::copy(lists[i].begin(), lists[i].end(), 
+                  index.begin() + offset[i]);
+      // swap with an empty vector to actually release the memory
+      std::vector< std::vector<edge_id_type> >().swap(lists);
+    } // end of build_compressed_edges
+
+    static void
+    build_edge_lists(std::vector<edge_id_type>& offset,
+                     std::vector<edge_id_type>& index,
+                     std::vector< std::vector<edge_id_type> >& lists) {
+      ASSERT_FALSE(offset.empty());
+      lists.resize(offset.size() - 1);
+      for(size_t i = 0; i < lists.size(); ++i) 
+        lists[i].assign(index.begin() + offset[i], 
+                        index.begin() + offset[i+1]);
+      std::vector<edge_id_type>().swap(offset);
+      std::vector<edge_id_type>().swap(index);
+    } // end of build_edge_lists
+
+    static edge_list 
+    compressed_edge_list(const std::vector<edge_id_type>& offset,
+                         const std::vector<edge_id_type>& index,
+                         vertex_id_type v) {
+      ASSERT_LT(v + 1, offset.size());
+      const edge_id_type* base = index.empty()? NULL : &(index[0]);
+      return edge_list(base + offset[v], offset[v+1] - offset[v]);
+    } // end of compressed_edge_list
+
+    /** Writes a compressed adjacency structure in exactly the format
+        of a std::vector< std::vector<edge_id_type> > */
+    static void 
+    save_compressed_edges(oarchive& arc, 
+                          const std::vector<edge_id_type>& offset,
+                          const std::vector<edge_id_type>& index) {
+      const size_t nverts = offset.size() - 1;
+      // The vector serializer stores the length, and then the
+      // iterator serializer stores it again
+      arc << nverts << nverts;
+      std::vector<edge_id_type> eids;
+      for(size_t i = 0; i < nverts; ++i) {
+        eids.assign(index.begin() + offset[i], index.begin() + offset[i+1]);
+        arc << eids;
+      }
+    } // end of save_compressed_edges
+
     /**
      * This function tries to find the edge in the vector.  If it
      * fails it returns size_t(-1)
      * TODO: switch to stl binary search
      */
-    size_t binary_search(const std::vector<edge_id_type>& vec,
+    size_t binary_search(const edge_list& vec,
                          vertex_id_type source, vertex_id_type target) const {
       // Ensure that the graph is finalized before calling this function
       //      finalize();
@@ -906,8 +1201,8 @@ namespace graphlab {
       while(first <= last) {
         size_t mid = (first+last)/2;
         ASSERT_LT(mid, vec.size());
-        vertex_id_type mid_source = edges[vec[mid]].source();
-        vertex_id_type mid_target = edges[vec[mid]].target();
+        vertex_id_type mid_source = edges.source(vec[mid]);
+        vertex_id_type mid_target = edges.target(vec[mid]);
         // Edge found
         if(mid_source == source && mid_target == target) {
           return mid;
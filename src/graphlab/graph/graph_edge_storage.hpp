@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * \file
+ *
+ * This file contains the edge containers used internally by the
+ * graphlab graph.  The default container stores the source, target
+ * and data of each edge together.  The split container stores them
+ * in three separate arrays so that code which only needs the graph
+ * topology does not pull the edge data through the cache.
+ *
+ */
+
+#ifndef GRAPHLAB_GRAPH_EDGE_STORAGE_HPP
+#define GRAPHLAB_GRAPH_EDGE_STORAGE_HPP
+
+#include <vector>
+#include <boost/type_traits.hpp>
+
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/serialization/iarchive.hpp>
+#include <graphlab/serialization/oarchive.hpp>
+
+namespace graphlab {
+
+  /**
+   * Determines whether the graph stores the edge data of type
+   * EdgeData in a separate array from the edge source and target
+   * vertices.  This is off by default and can be enabled for a
+   * particular edge data type with the SPLIT_EDGE_DATA(tname) macro.
+   * Splitting is worthwhile when the edge data is large compared to
+   * the two vertex ids.
+   */
+  template <typename EdgeData>
+  struct split_edge_data {
+    BOOST_STATIC_CONSTANT(bool, value = false);
+  };
+
+  namespace graph_detail {
+
+    /**
+     * Edge container which stores the source, target and data of an
+     * edge together in a single vector.
+     */
+    template <typename VertexIdType, typename EdgeData, bool Split>
+    class edge_storage {
+    private:
+      /** Internal edge class  */
+      class edge {
+        VertexIdType _source;
+        VertexIdType _target;
+        EdgeData _data;
+      public:
+        edge() : _source(-1), _target(-1) { }
+        edge(const edge& other) :
+          _source(other.source()), _target(other.target()),
+          _data(other.data()) { }
+        edge(VertexIdType source, VertexIdType target) :
+          _source(source), _target(target)  { }
+        edge(VertexIdType source, VertexIdType target, EdgeData data) :
+          _source(source), _target(target), _data(data) {}
+
+        bool operator<(const edge& other) const {
+          return (_source < other._source) ||
+            (_source == other._source && _target < other._target);
+        }
+
+        inline VertexIdType source() const { return _source; }
+        inline VertexIdType target() const { return _target; }
+        inline EdgeData& data() { return _data; }
+        inline const EdgeData& data() const { return _data; }
+
+        /** Renames the endpoints using the vertex permutation perm */
+        void remap(const std::vector<VertexIdType>& perm) {
+          _source = perm[_source];
+          _target = perm[_target];
+        }
+
+        void load(iarchive& arc) {
+          arc >> _source
+              >> _target
+              >> _data;
+        }
+
+        void save(oarchive& arc) const {
+          arc << _source
+              << _target
+              << _data;
+        }
+      }; // end of edge
+
+      std::vector<edge> edges;
+
+    public:
+      size_t size() const { return edges.size(); }
+
+      void clear() { edges.clear(); }
+
+      void push_back(VertexIdType source, VertexIdType target,
+                     const EdgeData& edata) {
+        edges.push_back(edge(source, target, edata));
+      }
+
+      VertexIdType source(size_t eid) const { return edges[eid].source(); }
+      VertexIdType target(size_t eid) const { return edges[eid].target(); }
+      EdgeData& data(size_t eid) { return edges[eid].data(); }
+      const EdgeData& data(size_t eid) const { return edges[eid].data(); }
+
+      /** Lexical ordering of the (source, target) pairs of two edges */
+      bool less(size_t a, size_t b) const { return edges[a] < edges[b]; }
+
+      /** Renames the endpoints of every edge using the vertex
+          permutation perm */
+      void remap_vertices(const std::vector<VertexIdType>& perm) {
+        for(size_t i = 0; i < edges.size(); ++i) edges[i].remap(perm);
+      }
+
+      void load(iarchive& arc) { arc >> edges; }
+      void save(oarchive& arc) const { arc << edges; }
+    }; // end of edge_storage
+
+
+
+    /**
+     * Edge container which stores the sources, targets and data of
+     * the edges in three separate vectors.
+     */
+    template <typename VertexIdType, typename EdgeData>
+    class edge_storage<VertexIdType, EdgeData, true> {
+    private:
+      std::vector<VertexIdType> sources;
+      std::vector<VertexIdType> targets;
+      std::vector<EdgeData> edata;
+
+    public:
+      size_t size() const { return sources.size(); }
+
+      void clear() {
+        sources.clear();
+        targets.clear();
+        edata.clear();
+      }
+
+      void push_back(VertexIdType source, VertexIdType target,
+                     const EdgeData& data) {
+        sources.push_back(source);
+        targets.push_back(target);
+        edata.push_back(data);
+      }
+
+      VertexIdType source(size_t eid) const { return sources[eid]; }
+      VertexIdType target(size_t eid) const { return targets[eid]; }
+      EdgeData& data(size_t eid) { return edata[eid]; }
+      const EdgeData& data(size_t eid) const { return edata[eid]; }
+
+      /** Lexical ordering of the (source, target) pairs of two edges */
+      bool less(size_t a, size_t b) const {
+        return (sources[a] < sources[b]) ||
+          (sources[a] == sources[b] && targets[a] < targets[b]);
+      }
+
+      /** Renames the endpoints of every edge using the vertex
+          permutation perm */
+      void remap_vertices(const std::vector<VertexIdType>& perm) {
+        for(size_t i = 0; i < sources.size(); ++i) {
+          sources[i] = perm[sources[i]];
+          targets[i] = perm[targets[i]];
+        }
+      }
+
+      /** Reads the format written by the default edge_storage so that
+          the archive does not depend on the edge layout */
+      void load(iarchive& arc) {
+        size_t len = 0, vsize = 0;
+        // Same doubled length prefix as save_compressed_edges() in
+        // graph.hpp
+        arc >> len >> vsize;
+        ASSERT_EQ(len, vsize);
+        clear();
+        sources.resize(len);
+        targets.resize(len);
+        edata.resize(len);
+        for(size_t i = 0; i < len; ++i) {
+          arc >> sources[i] >> targets[i] >> edata[i];
+        }
+      }
+
+      /** Writes the format of the default edge_storage */
+      void save(oarchive& arc) const {
+        const size_t len = size();
+        arc << len << len;
+        for(size_t i = 0; i < len; ++i) {
+          arc << sources[i] << targets[i] << edata[i];
+        }
+      }
+    }; // end of edge_storage
+
+  } // end of namespace graph_detail
+
+} // end of namespace graphlab
+
+
+/**
+ * Enables the split (structure of arrays) edge layout for graphs
+ * with edge data of type tname.
+ * \note this must be used in the global namespace
+ */
+#define SPLIT_EDGE_DATA(tname)                     \
+namespace graphlab {                               \
+    template <>                                    \
+    struct split_edge_data<tname> {                \
+      BOOST_STATIC_CONSTANT(bool, value = true);   \
+    };                                             \
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_IDLE_PARKER_HPP
+#define GRAPHLAB_IDLE_PARKER_HPP
+
+#include <ctime>
+#include <algorithm>
+#include <sched.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util_internal
+   * Lets idle worker threads sleep until there may be work for
+   * them. A worker which finds no work calls idle() repeatedly. The
+   * first spin_rounds calls only spin, the next yield_rounds calls
+   * sched_yield(), and after that the worker is parked on a futex
+   * until a producer calls notify() or the park timeout expires.
+   * Parking is two phase: the worker first announces that it is
+   * about to sleep and returns, so that the caller looks for work
+   * once more before the worker actually blocks. A notify() between
+   * the announcement and the block changes the futex word and the
+   * block returns immediately, so no wakeup is lost.
+   *
+   * notify() costs a single read of a shared counter when no worker
+   * is idle. Off linux parking degrades to a short sleep.
+   */
+  class idle_parker {
+  public:
+    /// The idle state of one worker. Owned by that worker.
+    struct worker_state {
+      size_t idle_rounds;
+      bool registered;
+      int epoch;
+      worker_state() : idle_rounds(0), registered(false), epoch(0) { }
+    };
+
+  private:
+    volatile int epoch;
+    char pad0[64 - sizeof(int)];
+    atomic<size_t> nregistered;
+    atomic<size_t> nsleeping;
+    size_t spin_rounds;
+    size_t yield_rounds;
+    size_t timeout_ns;
+
+    void futex_wait(int expected) {
+#ifdef __linux__
+      struct timespec ts;
+      ts.tv_sec = timeout_ns / 1000000000;
+      ts.tv_nsec = timeout_ns % 1000000000;
+      syscall(SYS_futex, &epoch, FUTEX_WAIT_PRIVATE, expected, &ts, NULL, 0);
+#else
+      struct timespec ts;
+      ts.tv_sec = 0;
+      ts.tv_nsec = std::min(timeout_ns, size_t(100000));
+      if (epoch == expected) nanosleep(&ts, NULL);
+#endif
+    }
+
+    void futex_wake(int nthreads) {
+#ifdef __linux__
+      syscall(SYS_futex, &epoch, FUTEX_WAKE_PRIVATE, nthreads, NULL, NULL, 0);
+#endif
+    }
+
+  public:
+    idle_parker(size_t spin_rounds = 100,
+                size_t yield_rounds = 100,
+                size_t timeout_ms = 10) :
+      epoch(0), nregistered(0), nsleeping(0),
+      spin_rounds(spin_rounds), yield_rounds(yield_rounds),
+      timeout_ns(timeout_ms * 1000000) { }
+
+    void set_spin_rounds(size_t n) { spin_rounds = n; }
+    void set_yield_rounds(size_t n) { yield_rounds = n; }
+    void set_timeout_ms(size_t ms) { timeout_ns = ms * 1000000; }
+
+    /**
+     * Called by a worker each time it finds no work. Spins, yields
+     * or parks depending on how long the worker has been idle.
+     */
+    void idle(worker_state& state) {
+      ++state.idle_rounds;
+      if (state.idle_rounds <= spin_rounds) {
+        for (size_t i = 0; i < 16; ++i) {
+#if defined(__i386__) || defined(__x86_64__)
+          __asm__ __volatile__("pause");
+#endif
+        }
+      }
+      else if (state.idle_rounds <= spin_rounds + yield_rounds) {
+        sched_yield();
+      }
+      else if (!state.registered) {
+        // announce, and let the caller look for work once more
+        state.registered = true;
+        state.epoch = epoch;
+        __sync_synchronize();
+        nregistered.inc();
+      }
+      else {
+        nsleeping.inc();
+        futex_wait(state.epoch);
+        nsleeping.dec();
+        state.epoch = epoch;
+      }
+    }
+
+    /** Called by a worker when it finds work again */
+    void busy(worker_state& state) {
+      state.idle_rounds = 0;
+      if (state.registered) {
+        state.registered = false;
+        nregistered.dec();
+      }
+    }
+
+    /**
+     * Called by a producer after it may have created work. Wakes one
+     * parked worker if there is one.
+     */
+    void notify() {
+      if (__builtin_expect(nregistered.value == 0, 1)) return;
+      __sync_fetch_and_add(&epoch, 1);
+      if (nsleeping.value > 0) futex_wake(1);
+    }
+
+    /** Wakes all parked workers. Used on termination */
+    void notify_all() {
+      __sync_fetch_and_add(&epoch, 1);
+      futex_wake(0x7fffffff);
+    }
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <dirent.h>
+#ifdef HAS_SET_AFFINITY
+#include <sched.h>
+#endif
+
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+
+namespace graphlab {
+
+  numa_topology::numa_topology() {
+    load("/sys/devices/system/node");
+    restrict_to(allowed_cpus());
+  }
+
+  numa_topology::numa_topology(const std::string& sysfs_node_dir) {
+    load(sysfs_node_dir);
+  }
+
+  numa_topology::numa_topology(const std::string& sysfs_node_dir,
+                               const std::vector<size_t>& allowed) {
+    load(sysfs_node_dir);
+    restrict_to(allowed);
+  }
+
+
+  void numa_topology::load(const std::string& sysfs_node_dir) {
+    node_cpus.clear();
+    cpu_node.clear();
+    // Node ids need not be consecutive (a machine may have only node0
+    // and node2). Use the "online" list where there is one, and
+    // otherwise every nodeN entry in the directory.
+    std::vector<size_t> nodes;
+    std::ifstream online((sysfs_node_dir + "/online").c_str());
+    if (online.good()) {
+      std::string nodelist;
+      std::getline(online, nodelist);
+      nodes = parse_cpulist(nodelist);
+    } else {
+      DIR* dir = opendir(sysfs_node_dir.c_str());
+      if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+          const std::string name(entry->d_name);
+          if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+              name.find_first_not_of("0123456789", 4) == std::string::npos) {
+            nodes.push_back(atol(name.c_str() + 4));
+          }
+        }
+        closedir(dir);
+      }
+      std::sort(nodes.begin(), nodes.end());
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      std::stringstream fname;
+      fname << sysfs_node_dir << "/node" << nodes[i] << "/cpulist";
+      std::ifstream fin(fname.str().c_str());
+      if (!fin.good()) continue;
+      std::string cpulist;
+      std::getline(fin, cpulist);
+      node_cpus.push_back(parse_cpulist(cpulist));
+    }
+
+    if (nonempty_nodes() == 0) {
+      // no topology information. One node with all the cpus
+      const size_t ncpus = std::max(thread::cpu_count(), size_t(1));
+      node_cpus.resize(1);
+      for (size_t i = 0; i < ncpus; ++i) node_cpus[0].push_back(i);
+    }
+    index_cpus();
+  }
+
+
+  void numa_topology::restrict_to(const std::vector<size_t>& allowed) {
+    if (allowed.empty()) return;
+    std::vector<std::vector<size_t> > restricted(node_cpus.size());
+    for (size_t node = 0; node < node_cpus.size(); ++node) {
+      for (size_t i = 0; i < node_cpus[node].size(); ++i) {
+        const size_t cpu = node_cpus[node][i];
+        if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+          restricted[node].push_back(cpu);
+        }
+      }
+    }
+    // if the mask does not match the topology at all keep the topology
+    // rather than leaving the workers nowhere to run
+    node_cpus.swap(restricted);
+    if (nonempty_nodes() == 0) node_cpus.swap(restricted);
+    index_cpus();
+  }
+
+
+  std::vector<size_t> numa_topology::allowed_cpus() {
+    std::vector<size_t> ret;
+#ifdef HAS_SET_AFFINITY
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpu_set)) ret.push_back(cpu);
+      }
+    }
+#endif
+    return ret;
+  }
+
+
+  size_t numa_topology::nonempty_nodes() const {
+    size_t count = 0;
+    for (size_t i = 0; i < node_cpus.size(); ++i) {
+      if (!node_cpus[i].empty()) ++count;
+    }
+    return count;
+  }
+
+
+  void numa_topology::index_cpus() {
+    // drop memory only nodes and nodes with no usable cpus
+    std::vector<std::vector<size_t> > nonempty;
+    for (size_t i = 0; i < node_cpus.size(); ++i) {
+      if (!node_cpus[i].empty()) nonempty.push_back(node_cpus[i]);
+    }
+    node_cpus.swap(nonempty);
+
+    cpu_node.clear();
+    for (size_t node = 0; node < node_cpus.size(); ++node) {
+      for (size_t i = 0; i < node_cpus[node].size(); ++i) {
+        const size_t cpu = node_cpus[node][i];
+        if (cpu >= cpu_node.size()) cpu_node.resize(cpu + 1, 0);
+        cpu_node[cpu] = node;
+      }
+    }
+  }
+
+
+  std::vector<size_t> numa_topology::worker_cpus(size_t nworkers) const {
+    std::vector<size_t> allcpus;
+    for (size_t node = 0; node < node_cpus.size(); ++node) {
+      allcpus.insert(allcpus.end(),
+                     node_cpus[node].begin(), node_cpus[node].end());
+    }
+    std::vector<size_t> ret(nworkers);
+    for (size_t i = 0; i < nworkers; ++i) {
+      ret[i] = allcpus[i % allcpus.size()];
+    }
+    return ret;
+  }
+
+
+  const numa_topology& numa_topology::get() {
+    static numa_topology topology;
+    return topology;
+  }
+
+
+  std::vector<size_t> numa_topology::parse_cpulist(const std::string& cpulist) {
+    std::vector<size_t> ret;
+    std::string range;
+    std::stringstream strm(cpulist);
+    while (std::getline(strm, range, ',')) {
+      if (range.find_first_of("0123456789") == std::string::npos) continue;
+      const size_t dash = range.find('-');
+      const size_t first = atol(range.substr(0, dash).c_str());
+      size_t last = first;
+      if (dash != std::string::npos) {
+        last = atol(range.substr(dash + 1).c_str());
+      }
+      for (size_t cpu = first; cpu <= last; ++cpu) ret.push_back(cpu);
+    }
+    return ret;
+  }
+
+} // end of namespace graphlab
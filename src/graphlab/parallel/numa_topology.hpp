@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_NUMA_TOPOLOGY_HPP
+#define GRAPHLAB_NUMA_TOPOLOGY_HPP
+
+#include <string>
+#include <vector>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * Describes which cpus belong to which NUMA node. On linux the
+   * topology is read from /sys/devices/system/node and restricted to
+   * the cpus in the affinity mask of the process. Where that is not
+   * available the machine is treated as a single node holding all
+   * the cpus.
+   */
+  class numa_topology {
+  public:
+    /** Reads the topology of this machine */
+    numa_topology();
+
+    /** Reads the topology from a directory laid out like
+        /sys/devices/system/node */
+    explicit numa_topology(const std::string& sysfs_node_dir);
+
+    /** Reads the topology from a directory laid out like
+        /sys/devices/system/node, keeping only the allowed cpus */
+    numa_topology(const std::string& sysfs_node_dir,
+                  const std::vector<size_t>& allowed);
+
+    /** The number of NUMA nodes */
+    size_t num_nodes() const { return node_cpus.size(); }
+
+    /** The cpus on a node */
+    const std::vector<size_t>& cpus_of_node(size_t node) const {
+      return node_cpus[node];
+    }
+
+    /** The node a cpu belongs to. Unknown cpus are placed on node 0 */
+    size_t node_of_cpu(size_t cpu) const {
+      return cpu < cpu_node.size() ? cpu_node[cpu] : 0;
+    }
+
+    /**
+     * Returns the cpu each of nworkers workers should be pinned
+     * to. Workers are packed onto as few nodes as possible: all the
+     * cpus of the first node are used before moving to the next, so
+     * that neighbouring workers share a memory controller. If there
+     * are more workers than cpus the assignment wraps around.
+     */
+    std::vector<size_t> worker_cpus(size_t nworkers) const;
+
+    /** The topology of this machine. Read once. */
+    static const numa_topology& get();
+
+    /** Parses a sysfs cpu list such as "0-3,8,10-11" */
+    static std::vector<size_t> parse_cpulist(const std::string& cpulist);
+
+  private:
+    std::vector<std::vector<size_t> > node_cpus;
+    std::vector<size_t> cpu_node;
+
+    void load(const std::string& sysfs_node_dir);
+    void restrict_to(const std::vector<size_t>& allowed);
+    size_t nonempty_nodes() const;
+    void index_cpus();
+
+    /** The cpus this process may run on. Empty if unknown. */
+    static std::vector<size_t> allowed_cpus();
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_SPIN_RWLOCK_HPP
+#define GRAPHLAB_SPIN_RWLOCK_HPP
+
+#include <stdint.h>
+#include <sched.h>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util
+   * A reader-writer spin lock packed into a single 32 bit word: one
+   * bit marks a writer holding the lock, one bit marks a writer
+   * waiting for it and the remaining bits count the readers. It is
+   * meant for large per-vertex lock arrays where a pthread rwlock
+   * (56 bytes) costs more than the data it protects.
+   *
+   * A waiting writer blocks new readers so that writers are not
+   * starved. Waiting threads back off exponentially up to a bound
+   * and then yield the processor, so the lock degrades gracefully
+   * when there are more threads than cores.
+   *
+   * lock(), unlock() and try_lock() give the same interface as
+   * spinlock, so the lock may also be used as a plain mutex.
+   *
+   * Before you use, see \ref parallel_object_intricacies.
+   */
+  class spin_rwlock {
+  private:
+    static const uint32_t WRITER = 0x80000000u;
+    static const uint32_t WRITER_WAITING = 0x40000000u;
+    static const uint32_t READER_MASK = 0x3fffffffu;
+    /// Longest busy wait in pause instructions before yielding
+    static const size_t MAX_BACKOFF = 1024;
+
+    mutable volatile uint32_t word;
+
+    static void backoff(size_t& rounds) {
+      if (rounds < MAX_BACKOFF) {
+        for (size_t i = 0; i < rounds; ++i) {
+#if defined(__i386__) || defined(__x86_64__)
+          __asm__ __volatile__("pause");
+#endif
+        }
+        rounds *= 2;
+      } else {
+        sched_yield();
+      }
+    }
+
+  public:
+    spin_rwlock() : word(0) { }
+
+    /** Copy constructor which does not copy. Do not use!
+        Required for compatibility with some STL implementations (LLVM).
+        which use the copy constructor for vector resize,
+        rather than the standard constructor.    */
+    spin_rwlock(const spin_rwlock&) : word(0) { }
+
+    // not copyable
+    void operator=(const spin_rwlock& m) { }
+
+    ~spin_rwlock() {
+      ASSERT_EQ(word & (WRITER | READER_MASK), uint32_t(0));
+    }
+
+    inline bool try_readlock() const {
+      uint32_t w = word;
+      const uint32_t newval = w + 1;
+      return (w & (WRITER | WRITER_WAITING)) == 0 &&
+        atomic_compare_and_swap(word, w, newval);
+    }
+
+    inline void readlock() const {
+      size_t rounds = 1;
+      while (!try_readlock()) backoff(rounds);
+    }
+
+    inline bool try_writelock() const {
+      uint32_t w = word;
+      const uint32_t writer = WRITER;
+      return (w & (WRITER | READER_MASK)) == 0 &&
+        atomic_compare_and_swap(word, w, writer);
+    }
+
+    inline void writelock() const {
+      size_t rounds = 1;
+      while (!try_writelock()) {
+        // hold back new readers until we get in
+        if ((word & WRITER_WAITING) == 0) {
+          __sync_fetch_and_or(&word, WRITER_WAITING);
+        }
+        backoff(rounds);
+      }
+    }
+
+    /// Releases a read lock or a write lock
+    inline void unlock() const {
+      if (word & WRITER) wrunlock();
+      else rdunlock();
+    }
+
+    inline void rdunlock() const {
+      const uint32_t prev = __sync_fetch_and_sub(&word, 1);
+      // releasing a read lock which is not held corrupts the word
+      DASSERT_TRUE((prev & READER_MASK) > 0);
+      (void)prev;
+    }
+
+    /// Releases the write lock. A waiting writer flag set by another
+    /// thread is kept.
+    inline void wrunlock() const {
+      __sync_fetch_and_and(&word, ~WRITER);
+    }
+
+    /// Acquires the lock exclusively
+    inline void lock() const { writelock(); }
+    inline bool try_lock() const { return try_writelock(); }
+  };
+
+} // end of namespace graphlab
+
+#endif
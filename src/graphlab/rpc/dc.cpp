@@ -42,11 +42,17 @@
 #include <graphlab/rpc/dc.hpp>
 #include <graphlab/rpc/dc_tcp_comm.hpp>
 #include <graphlab/rpc/dc_sctp_comm.hpp>
+#include <graphlab/rpc/dc_shm_comm.hpp>
 
 #include <graphlab/rpc/dc_stream_send.hpp>
 #include <graphlab/rpc/dc_stream_receive.hpp>
 #include <graphlab/rpc/dc_buffered_stream_send.hpp>
 #include <graphlab/rpc/dc_buffered_stream_receive.hpp>
+#include <graphlab/rpc/dc_aggregated_stream_send.hpp>
+#ifdef HAS_ZLIB
+#include <graphlab/rpc/dc_compressed_stream_send.hpp>
+#include <graphlab/rpc/dc_compressed_stream_receive.hpp>
+#endif
 #include <graphlab/rpc/reply_increment_counter.hpp>
 #include <graphlab/rpc/dc_services.hpp>
 
@@ -61,31 +67,26 @@ pthread_key_t thrlocal_resizing_array_key;
 bool thrlocal_sequentialization_key_initialized = false;
 pthread_key_t thrlocal_sequentialization_key;
 
+bool thrlocal_affinity_hint_initialized = false;
+pthread_key_t thrlocal_affinity_hint;
+
 struct dc_tls_data{
-  resizing_array_sink ras;
-  boost::iostreams::stream<resizing_array_sink_ref> strm;    
-  
-  dc_tls_data(): ras(128),strm(ras){ };
-  ~dc_tls_data() {
-    strm.flush();
-    free(ras.c_str());
-  }
-  
+  oarchive oarc;
+  dc_tls_data(): oarc(128) { };
 };
 
-boost::iostreams::stream<resizing_array_sink_ref>& 
-get_thread_local_stream() {
+oarchive& get_thread_local_oarchive() {
   dc_tls_data* curptr = reinterpret_cast<dc_tls_data*>(
                         pthread_getspecific(thrlocal_resizing_array_key));
   if (curptr != NULL) {
-    curptr->ras.clear();
-    return curptr->strm;
+    curptr->oarc.clear();
+    return curptr->oarc;
   }
   else {
     dc_tls_data* ras = new dc_tls_data;
     int err = pthread_setspecific(thrlocal_resizing_array_key, ras);
     ASSERT_EQ(err, 0);
-    return ras->strm;
+    return ras->oarc;
   }
 }
 
@@ -120,6 +121,18 @@ unsigned char distributed_control::get_sequentialization_key() {
   return (unsigned char)oldval;
 }
 
+uint32_t distributed_control::set_affinity_hint(uint32_t newhint) {
+  size_t oldval = reinterpret_cast<size_t>(pthread_getspecific(dc_impl::thrlocal_affinity_hint));
+  size_t newval = newhint;
+  pthread_setspecific(dc_impl::thrlocal_affinity_hint, reinterpret_cast<void*>(newval));
+  return (uint32_t)oldval;
+}
+
+uint32_t distributed_control::get_affinity_hint() {
+  size_t oldval = reinterpret_cast<size_t>(pthread_getspecific(dc_impl::thrlocal_affinity_hint));
+  return (uint32_t)oldval;
+}
+
 static std::string get_working_dir() {
 #ifdef _GNU_SOURCE
   char* path = get_current_dir_name();
@@ -180,100 +193,103 @@ distributed_control::~distributed_control() {
   
 void distributed_control::exec_function_call(procid_t source, 
                                             const dc_impl::packet_hdr& hdr, 
-                                            std::istream &istrm) {
+                                            const char* buf, size_t len) {
   unsigned char packet_type_mask = hdr.packet_type_mask;
-  // extract the dispatch function
-  iarchive arc(istrm);
-  size_t f; 
-  arc >> f;
-  // a regular funcion call
-  if (f != 0) {
-    dc_impl::dispatch_type dispatch = (dc_impl::dispatch_type)f;
-    dispatch(*this, source, packet_type_mask, istrm);
-  }
-  else {
-    // f is NULL!. This is a portable call. deserialize the function name
-    std::string s;
-    arc >> s;
-    char isrequest;
-    arc >> isrequest;
-    if (isrequest == 0) {
-      // std::cout << "portable call to " << s << std::endl;
-      // look for the registration
-      dc_impl::dispatch_map_type::const_iterator iter = portable_dispatch_call_map.find(s);
-      if (iter == portable_dispatch_call_map.end()) {
-        logstream(LOG_ERROR) << "Unable to locate dispatcher for function " << s << std::endl;
-        return;
-      }
-      // dispatch
-      iter->second(*this, source, packet_type_mask, istrm);
-
+  // extract the dispatch function. Arguments are deserialized in place
+  iarchive arc(buf, len);
+  try {
+    size_t f; 
+    arc >> f;
+    // a regular funcion call
+    if (f != 0) {
+      dc_impl::dispatch_type dispatch = (dc_impl::dispatch_type)f;
+      dispatch(*this, source, packet_type_mask, arc);
     }
     else {
-     // std::cout << "portable request to " << s << std::endl;
-     dc_impl::dispatch_map_type::const_iterator iter = portable_dispatch_request_map.find(s);
-      if (iter == portable_dispatch_request_map.end()) {
-        logstream(LOG_ERROR) << "Unable to locate dispatcher for function " << s << std::endl;
+      // f is NULL!. This is a portable call. Look up the call id
+      uint32_t id;
+      arc >> id;
+      const dc_impl::portable_dispatch_table::entry* e = 
+                    portable_dispatch.find(id & ~PORTABLE_REQUEST_BIT);
+      if (e == NULL) {
+        logstream(LOG_ERROR) << "Unable to locate dispatcher for call id " 
+                             << (id & ~PORTABLE_REQUEST_BIT) << std::endl;
         return;
       }
       // dispatch
-      iter->second(*this, source, packet_type_mask, istrm);
-
+      if (id & PORTABLE_REQUEST_BIT) e->request(*this, source, packet_type_mask, arc);
+      else e->call(*this, source, packet_type_mask, arc);
     }
   }
+  catch (iarchive_buffer_overrun&) {
+    // the arguments end early. The function has not been called since
+    // the arguments are read first. Drop the call but count it, so
+    // that the full barrier still adds up
+    logstream(LOG_ERROR) << "Dropping a truncated call from " << source
+                         << " (" << len << " bytes)" << std::endl;
+  }
   if ((packet_type_mask & CONTROL_PACKET) == 0) inc_calls_received(source);
 } 
 
   const size_t buffer_size_wait = 1000; 
   const size_t nano_wait = 100000;
+  /// the most calls a handler takes off its queue at once
+  const size_t FCALL_BATCH_SIZE = 256;
   
 void distributed_control::deferred_function_call(procid_t source, const dc_impl::packet_hdr& hdr,
-                                                char* buf, size_t len) {
-
-  if (hdr.sequentialization_key == 0) {
-    // fcallqueue[random::fast_uniform<size_t>(0, fcallqueue.size() - 1)].
-    //   enqueue_conditional_signal(function_call_block(source, hdr, buf, len), buffer_size_wait);
-    fcallqueue[random::fast_uniform<size_t>(0, fcallqueue.size() - 1)].
-      enqueue(function_call_block(source, hdr, buf, len));
-
+                                                dc_impl::receive_slab* slab,
+                                                const char* buf, size_t len) {
+
+  // calls with the same key must run in order, so they go to the same
+  // handler. Otherwise the sender's affinity hint picks the handler.
+  size_t target;
+  if (hdr.sequentialization_key != 0) {
+    target = hdr.sequentialization_key % fcallqueue.size();
+  }
+  else if (hdr.affinity_hint != 0) {
+    target = hdr.affinity_hint % fcallqueue.size();
   }
   else {
-    fcallqueue[hdr.sequentialization_key % fcallqueue.size()].
-      enqueue(function_call_block(source, hdr, buf, len));
+    target = random::fast_uniform<size_t>(0, fcallqueue.size() - 1);
   }
+  fcallqueue[target].enqueue(function_call_block(source, hdr, slab, buf, len));
+}
+
+void distributed_control::deferred_local_call(const boost::function<void (void)>& fn) {
+  fcallqueue[random::fast_uniform<size_t>(0, fcallqueue.size() - 1)].
+    enqueue(function_call_block(new boost::function<void (void)>(fn)));
 }
 
 void distributed_control::fcallhandler_loop(size_t id) {
-  // pop an element off the queue
-//  float t = lowres_time_seconds();
-  while(1) {
-    fcallqueue[id].wait_for_data();
-    if (fcallqueue[id].is_alive() == false) break;
-    
-    std::deque<function_call_block> q;
-    fcallqueue[id].swap(q);
-    while (!q.empty()) {
-      function_call_block entry;
-      entry = q.front();
-      q.pop_front();
-      
-      // if (id == 0 && lowres_time_seconds() - t > 2)  {
-      //   t = lowres_time_seconds();
-      //   std::cout << "RPC backlog: ";
-      //   for (size_t i = 0 ; i < fcallqueue.get_num_queues();++i) 
-      //     std::cout << fcallqueue.size(i) << " ";
-      //   std::cout << std::endl;
-      // }
-
-      //create a stream containing all the data
-      boost::iostreams::stream<boost::iostreams::array_source> 
-        istrm(entry.data, entry.len);
-      exec_function_call(entry.source, entry.hdr, istrm);
+  // take batches off the queue. The receivers are gone once the queue
+  // is stopped, so whatever is left then is dropped
+  std::vector<function_call_block> batch;
+  batch.reserve(FCALL_BATCH_SIZE);
+  while(fcallqueue[id].dequeue_batch(batch, FCALL_BATCH_SIZE) > 0) {
+    if (fcallqueue[id].is_alive() == false) {
+      // free the dropped calls, including those still queued
+      do {
+        for (size_t i = 0;i < batch.size(); ++i) {
+          if (batch[i].task != NULL) delete batch[i].task;
+          else batch[i].slab->release();
+        }
+        batch.clear();
+      } while(fcallqueue[id].try_dequeue_batch(batch, FCALL_BATCH_SIZE) > 0);
+      break;
+    }
+    for (size_t i = 0;i < batch.size(); ++i) {
+      function_call_block& entry = batch[i];
+      if (entry.task != NULL) {
+        (*entry.task)();
+        delete entry.task;
+        continue;
+      }
+      exec_function_call(entry.source, entry.hdr, entry.data, entry.len);
       receivers[entry.source]->
         function_call_completed(entry.hdr.packet_type_mask);
-      delete [] entry.data;
+      entry.slab->release();
     }
-    //  std::cerr << "Handler " << id << " died." << std::endl;
+    batch.clear();
   }
 }
   
@@ -317,16 +333,24 @@ void distributed_control::init(const std::vector<std::string> &machines,
     ASSERT_EQ(err, 0);
   }
 
+  if (dc_impl::thrlocal_affinity_hint_initialized == false) {
+    dc_impl::thrlocal_affinity_hint_initialized = true;
+    int err = pthread_key_create(&dc_impl::thrlocal_affinity_hint, NULL);
+    ASSERT_EQ(err, 0);
+  }
+
   //-------- Initialize the full barrier ---------
   full_barrier_in_effect = false;
   procs_complete.resize(machines.size());
   //-----------------------------------------------
   
+  portable_calls_verified = false;
   REGISTER_RPC((*this), reply_increment_counter);
   // parse the initstring
   std::map<std::string,std::string> options = parse_options(initstring);
   bool buffered_send = true;
   bool buffered_recv = false;
+  compressed = false;
 
   if (options["buffered_recv"] == "true" ||
     options["buffered_recv"] == "1" ||
@@ -334,11 +358,50 @@ void distributed_control::init(const std::vector<std::string> &machines,
     buffered_recv = true;
     std::cerr << "Buffered Recv Option is ON." << std::endl;
   }
+
+  if (options["compressed"] == "true" ||
+    options["compressed"] == "1" ||
+    options["compressed"] == "yes") {
+    #ifdef HAS_ZLIB
+    compressed = true;
+    std::cerr << "Compressed Communication Option is ON." << std::endl;
+    #else
+    logstream(LOG_WARNING) << "ZLib support was not compiled. "
+                           << "Communication will not be compressed." << std::endl;
+    #endif
+  }
+  aggregated = false;
+  if (options["aggregated_send"] == "true" ||
+    options["aggregated_send"] == "1" ||
+    options["aggregated_send"] == "yes") {
+    aggregated = true;
+    std::cerr << "Aggregated Send Option is ON." << std::endl;
+  }
+  size_t aggregate_bytes = 65536;
+  if (options.find("aggregate_bytes") != options.end()) {
+    std::stringstream strm(options["aggregate_bytes"]);
+    strm >> aggregate_bytes;
+  }
+  size_t aggregate_usec = 100;
+  if (options.find("aggregate_usec") != options.end()) {
+    std::stringstream strm(options["aggregate_usec"]);
+    strm >> aggregate_usec;
+  }
+
+  size_t compressed_threshold = 1024;
+  if (options.find("compressed_threshold") != options.end()) {
+    std::stringstream strm(options["compressed_threshold"]);
+    strm >> compressed_threshold;
+  }
   
   if (commtype == TCP_COMM) {
     comm = new dc_impl::dc_tcp_comm();
     std::cerr << "TCP Communication layer constructed." << std::endl;
   }
+  else if (commtype == SHM_COMM) {
+    comm = new dc_impl::dc_shm_comm();
+    std::cerr << "Shared Memory/TCP Communication layer constructed." << std::endl;
+  }
   else if (commtype == SCTP_COMM) {
     #ifdef HAS_SCTP
     comm = new dc_impl::dc_sctp_comm();
@@ -356,6 +419,16 @@ void distributed_control::init(const std::vector<std::string> &machines,
   // create the receiving objects
   if (comm->capabilities() && dc_impl::COMM_STREAM) {
     for (procid_t i = 0; i < machines.size(); ++i) {
+      #ifdef HAS_ZLIB
+      if (compressed) {
+        receivers.push_back(new dc_impl::dc_compressed_stream_receive(this, i,
+                                        new dc_impl::dc_stream_receive(this)));
+        single_sender = false;
+        senders.push_back(new dc_impl::dc_compressed_stream_send(this, comm, i,
+                                                  compressed_threshold));
+        continue;
+      }
+      #endif
       if (buffered_recv) {
         receivers.push_back(new dc_impl::dc_buffered_stream_receive(this));
       }
@@ -363,7 +436,12 @@ void distributed_control::init(const std::vector<std::string> &machines,
         receivers.push_back(new dc_impl::dc_stream_receive(this));
       }
   
-      if (buffered_send) {
+      if (aggregated) {
+        single_sender = false;
+        senders.push_back(new dc_impl::dc_aggregated_stream_send(this, comm, i,
+                                                aggregate_bytes, aggregate_usec));
+      }
+      else if (buffered_send) {
         single_sender = false;
         senders.push_back(new dc_impl::dc_buffered_stream_send(this, comm, i));
       }
@@ -418,9 +496,28 @@ void distributed_control::comm_barrier() {
 }
 
 void distributed_control::barrier() {
+  if (!portable_calls_verified) verify_portable_calls();
   distributed_services->barrier();
 }
 
+void distributed_control::verify_portable_calls() {
+  // a call id only means the same function on all machines if they
+  // registered the same calls. Fail here rather than misdispatch later
+  std::vector<uint64_t> signatures(numprocs());
+  signatures[procid()] = portable_dispatch.signature();
+  all_gather(signatures);
+  for (procid_t i = 1; i < signatures.size(); ++i) {
+    if (signatures[i] != signatures[0]) {
+      logstream(LOG_FATAL) << "Machines 0 and " << i << " registered "
+                           << "different portable calls. This machine has "
+                           << portable_dispatch.size() << ". All machines "
+                           << "must call REGISTER_RPC for the same functions "
+                           << "before the first barrier()." << std::endl;
+    }
+  }
+  portable_calls_verified = true;
+}
+
 
 
 void distributed_control::compute_master_ranks() {
@@ -461,7 +558,18 @@ other threads are still issuing function calls since we
 cannot differentiate between calls issued before the barrier
 and calls issued while the barrier is being evaluated.
 */
+void distributed_control::flush() {
+  for (procid_t i = 0;i < senders.size(); ++i) senders[i]->flush();
+}
+
+void distributed_control::flush_thread() {
+  for (procid_t i = 0;i < senders.size(); ++i) senders[i]->flush_thread();
+}
+
 void distributed_control::full_barrier() {
+  // make sure the calls held back by the senders are counted 
+  // by the remote machines
+  flush();
   // gather a sum of all the calls issued to machine 0
   std::vector<size_t> calls_sent_to_target(numprocs(), 0);
   for (size_t i = 0;i < numprocs(); ++i) {
@@ -511,6 +619,22 @@ std::map<std::string, size_t> distributed_control::gather_statistics(){
     stats[procid()].callssent = calls_sent();
     stats[procid()].bytessent = bytes_sent();
     stats[procid()].network_bytessent = network_bytes_sent();
+    for (size_t i = 0;i < senders.size(); ++i) {
+      size_t raw, wire;
+      double seconds;
+      senders[i]->compression_statistics(raw, wire, seconds);
+      stats[procid()].compress_rawbytes += raw;
+      stats[procid()].compress_wirebytes += wire;
+      stats[procid()].compress_usec += size_t(seconds * 1000000);
+      size_t flushes, messages;
+      senders[i]->aggregation_statistics(flushes, messages);
+      stats[procid()].flushes += flushes;
+      stats[procid()].flushed_messages += messages;
+    }
+    for (size_t i = 0;i < receivers.size(); ++i) {
+      stats[procid()].decompress_usec +=
+                      size_t(receivers[i]->decompression_time() * 1000000);
+    }
     gather(stats, 0, true);
     if (procid() == 0) {
       collected_statistics cs;
@@ -521,10 +645,22 @@ std::map<std::string, size_t> distributed_control::gather_statistics(){
         rpc_metrics.set_vector_entry_integer("bytes_sent", i, stats[i].bytessent);
         rpc_metrics.set_vector_entry_integer("network_bytes_sent", i, stats[i].network_bytessent);
         cs.network_bytessent += stats[i].network_bytessent;
+        cs.compress_rawbytes += stats[i].compress_rawbytes;
+        cs.compress_wirebytes += stats[i].compress_wirebytes;
+        cs.compress_usec += stats[i].compress_usec;
+        cs.decompress_usec += stats[i].decompress_usec;
+        cs.flushes += stats[i].flushes;
+        cs.flushed_messages += stats[i].flushed_messages;
       }
       ret["total_calls_sent"] = cs.callssent;
       ret["total_bytes_sent"] = cs.bytessent;
       ret["network_bytes_sent"] = cs.network_bytessent;
+      ret["compression_raw_bytes"] = cs.compress_rawbytes;
+      ret["compression_wire_bytes"] = cs.compress_wirebytes;
+      ret["compression_usec"] = cs.compress_usec;
+      ret["decompression_usec"] = cs.decompress_usec;
+      ret["flushes"] = cs.flushes;
+      ret["flushed_messages"] = cs.flushed_messages;
     }
     return ret; 
 }
@@ -536,6 +672,25 @@ void distributed_control::fill_metrics() {
     rpc_metrics.set_integer("total_calls_sent", ret["total_calls_sent"]);
     rpc_metrics.set_integer("total_bytes_sent", ret["total_bytes_sent"]);
     rpc_metrics.set_integer("total_network_bytes_sent", ret["network_bytes_sent"]);
+    if (aggregated) {
+      rpc_metrics.set_integer("flushes", ret["flushes"]);
+      if (ret["flushes"] > 0) {
+        rpc_metrics.set("messages_per_flush", 
+                        double(ret["flushed_messages"]) / ret["flushes"]);
+      }
+    }
+    if (compressed) {
+      rpc_metrics.set_integer("compression_raw_bytes", ret["compression_raw_bytes"]);
+      rpc_metrics.set_integer("compression_wire_bytes", ret["compression_wire_bytes"]);
+      if (ret["compression_wire_bytes"] > 0) {
+        rpc_metrics.set("compression_ratio", 
+                        double(ret["compression_raw_bytes"]) / ret["compression_wire_bytes"]);
+      }
+      rpc_metrics.set("compression_time", 
+                      ret["compression_usec"] / 1000000.0, TIME);
+      rpc_metrics.set("decompression_time", 
+                      ret["decompression_usec"] / 1000000.0, TIME);
+    }
   }
   total_bytes_sent = ret["total_bytes_sent"];
 }
@@ -25,16 +25,19 @@
 #define GRAPHLAB_DC_HPP
 #include <iostream>
 #include <boost/iostreams/stream.hpp>
+#include <boost/function.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/util/resizing_array_sink.hpp>
 #include <graphlab/util/blocking_queue.hpp>
 #include <graphlab/util/multi_blocking_queue.hpp>
+#include <graphlab/util/mpsc_queue.hpp>
 #include <graphlab/util/dense_bitset.hpp>
 #include <graphlab/serialization/serialization_includes.hpp>
 #include <graphlab/metrics/metrics.hpp>
 
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/receive_slab.hpp>
 
 #include <graphlab/rpc/dc_receive.hpp>
 #include <graphlab/rpc/dc_send.hpp>
@@ -75,12 +78,33 @@ struct dc_init_param{
     "key1=value1,key2=value2".
     Available options are:
     
-    \li \b compressed=yes Use ZLib compressed communication
+    \li \b compressed=yes Use ZLib compressed communication. Outgoing
+                          data is batched and each batch of at least
+                          compressed_threshold bytes is compressed.
+                          All machines must use the same setting.
+    \li \b compressed_threshold=NUMBER Smallest batch in bytes which is 
+                          compressed when compressed=yes. Defaults to 1024
     \li \b buffered_send=yes Put an circular buffer on outgoing transmission
     \li \b buffered_queued_send=yes Put a queue buffer on outgoing transmission
     \li \b buffered_queued_send_single=yes Like buffered_queued but use only one sending thread
+    \li \b aggregated_send=yes Collect outgoing calls in per thread buffers
+                               which are sent when they hold aggregate_bytes
+                               or have waited aggregate_usec. Calls issued
+                               by different threads may be reordered.
+    \li \b aggregate_bytes=NUMBER Flush threshold of aggregated_send.
+                                  Defaults to 65536
+    \li \b aggregate_usec=NUMBER Longest delay of a call with aggregated_send.
+                                 Defaults to 100
     \li \b buffered_recv=yes Put a buffer on incoming transmissions 
                              (not recommended. Tends to decrease performance)
+    \li \b comm_threads=N Number of threads receiving from the TCP sockets.
+                          Defaults to one for every 16 machines, at most 8
+    \li \b recv_buffer=BYTES Receive buffer size of each of the receiving
+                             threads. Defaults to 1MB
+    \li \b shm_ring_size=BYTES Size of each shared memory ring with SHM_COMM.
+                               Defaults to 4MB
+    \li \b tcp_cork=yes Coalesce outgoing TCP segments until the sender
+                        has caught up with its queue
                              
     Internal options which should not be used
     \li \b __socket__=NUMBER Forces TCP comm to use this socket number for its
@@ -93,7 +117,8 @@ struct dc_init_param{
   procid_t curmachineid;  
   /** Number of background RPC handling threads to create */
   size_t numhandlerthreads; 
-  /** The communication method. Must be TCP_COMM */
+  /** The communication method. TCP_COMM, or SHM_COMM to use shared
+      memory between processes on the same host */
   dc_comm_type commtype;    
 };
 
@@ -156,20 +181,35 @@ In addition to the documented functions, the following RPC routines are provided
  \li \b targetmachine: The ID of the machine to run the function on
  \li \b function: The function to run on the target machine
 
+\par request_future<RetType> distributed_control::future_remote_request(procid_t targetmachine, function, ...)
+ Same as remote_request, but returns immediately with a request_future
+ which holds the return value once the reply arrives. Many requests may
+ be outstanding at the same time. fast_future_remote_request is the
+ future version of fast_remote_request.
+ \li \b targetmachine: The ID of the machine to run the function on
+ \li \b function: The function to run on the target machine
+
 */
 class distributed_control{
   public:
-        /**  Each element of the function call queue is a data/len pair */
+    /**  Each element of the function call queue is a data/len pair
+         inside a receive slab. The block holds a reference to the slab */
     struct function_call_block{
-      function_call_block() {}
+      function_call_block(): task(NULL) {}
       function_call_block(procid_t source, const dc_impl::packet_hdr& hdr, 
-                          char* data, size_t len): 
-                          source(source), hdr(hdr), 
-                          data(data), len(len) {}
+                          dc_impl::receive_slab* slab,
+                          const char* data, size_t len): 
+                          source(source), hdr(hdr), slab(slab),
+                          data(data), len(len), task(NULL) {}
+      /// A local task. Owned by the block
+      explicit function_call_block(boost::function<void (void)>* task):
+                          slab(NULL), data(NULL), len(0), task(task) {}
       procid_t source;
       dc_impl::packet_hdr hdr;
-      char* data;
+      dc_impl::receive_slab* slab;
+      const char* data;
       size_t len;
+      boost::function<void (void)>* task;
     };
   private:
    /// initialize receiver threads. private form of the constructor
@@ -189,12 +229,13 @@ class distributed_control{
   /// A thread group of function call handlers
   thread_group fcallhandlers;
   
-  /// a queue of functions to be executed
-  std::vector<blocking_queue<function_call_block> > fcallqueue;
+  /// a queue of functions to be executed for each handler thread
+  std::vector<mpsc_queue<function_call_block> > fcallqueue;
   
-  /// A map of function name to dispatch function. Used for "portable" calls
-  dc_impl::dispatch_map_type portable_dispatch_call_map;
-  dc_impl::dispatch_map_type portable_dispatch_request_map;
+  /// The dispatch functions of the "portable" calls by call id
+  dc_impl::portable_dispatch_table portable_dispatch;
+  /// Set once barrier() compared the portable calls of all machines
+  bool portable_calls_verified;
 
   
   /// object registrations;
@@ -215,6 +256,12 @@ class distributed_control{
   std::vector<atomic<size_t> > global_calls_received;
   
   bool single_sender;
+
+  /// whether the "compressed" option is in effect
+  bool compressed;
+
+  /// whether the "aggregated_send" option is in effect
+  bool aggregated;
   
   /// the callback given to the comms class. Called when data is inbound
   friend void dc_recv_callback(void* tag, procid_t src, const char* buf, size_t len);
@@ -313,6 +360,29 @@ class distributed_control{
   /// gets the current sequentialization key. This function is not generally useful.
   static unsigned char get_sequentialization_key();
 
+  /**
+  Sets the affinity hint to the new value, returning the previous value.
+  While the hint is non-zero, all remote calls/remote requests made by the
+  current thread are handled by the same handler thread on the receiving
+  machine, (handler hint % number of handler threads). Unlike the
+  sequentialization key, there is no ordering guarantee with respect to
+  calls made by other threads with the same hint. The hint only improves
+  locality: for instance, calls touching the same vertex may all be
+  hinted with the vertex id, so that the vertex stays in one core's cache.
+  The sequentialization key, if set, takes precedence.
+
+  User should
+  oldval = set_affinity_hint(newval)
+  ...
+  ... do stuff
+  ...
+  set_affinity_hint(oldval)
+  */
+  static uint32_t set_affinity_hint(uint32_t newhint);
+
+  /// gets the current affinity hint.
+  static uint32_t get_affinity_hint();
+
   
   /*
   This generates the interface functions for the standard calls, basic calls, and fast calls
@@ -369,6 +439,8 @@ class distributed_control{
 
   BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type fast_remote_request, dc_impl::remote_request_issue, FAST_CALL) )
   BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type control_request, dc_impl::remote_request_issue, (FAST_CALL | CONTROL_PACKET)) )
+  BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (request_future<typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type> future_remote_request, dc_impl::future_request_issue, STANDARD_CALL) )
+  BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (request_future<typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type> fast_future_remote_request, dc_impl::future_request_issue, FAST_CALL) )
  
 
   
@@ -384,18 +456,26 @@ class distributed_control{
   Immediately calls the function described by the data
   inside the buffer. This should not be called directly.
   */
-  void exec_function_call(procid_t source, const dc_impl::packet_hdr& hdr, std::istream &istrm);
+  void exec_function_call(procid_t source, const dc_impl::packet_hdr& hdr,
+                          const char* buf, size_t len);
   
   
   
   /**
   Performs a deferred function call using the information
-  inside the buffer. This function will take over ownership of 
-  the buffer and will free it when done
+  inside the buffer, which lies in the given slab. This function
+  takes over one reference to the slab and releases it when done
   */
   void deferred_function_call(procid_t source, const dc_impl::packet_hdr& hdr, 
-                              char* buf, size_t len);
+                              dc_impl::receive_slab* slab,
+                              const char* buf, size_t len);
   
+  /**
+  Runs fn on one of the function handler threads. Used to run
+  the continuations of request_future off the receiving threads.
+  */
+  void deferred_local_call(const boost::function<void (void)>& fn);
+
 
   /**
   This is called by the function handler threads
@@ -506,11 +586,20 @@ class distributed_control{
   }
 
   /**
-    registers a portable RPC call.
+    registers a portable RPC call. The call is identified on the wire
+    by a 31 bit hash of the name (see portable_call_id()), so all 
+    machines agree on it even if they run different binaries.
+    All machines must register the same calls before the first 
+    barrier(), which checks that the tables match.
   */
   template <typename F, F f>
   void register_rpc(std::string c) {
-    portable_dispatch_request_map[c] = (dc_impl::dispatch_type)
+    if (portable_calls_verified) {
+      logstream(LOG_WARNING) << "RPC " << c << " is registered after the "
+                             << "first barrier() and is not checked "
+                             << "against the other machines" << std::endl;
+    }
+    portable_dispatch.insert(portable_call_id(c.c_str()), c,
               dc_impl::portable_detail::find_dispatcher<F,        // function type
                               __GLRPC_FRESULT,                            // result
                               boost::function_traits<               
@@ -518,9 +607,7 @@ class distributed_control{
                                                     >::arity ,   // number of arguments
                               f,                                    // function itself
                               typename dc_impl::is_rpc_call<F>::type  // whether it is an RPC style call
-                              >::dispatch_request_fn();
-                              
-    portable_dispatch_call_map[c] = (dc_impl::dispatch_type)
+                              >::dispatch_call_fn(),
               dc_impl::portable_detail::find_dispatcher<F,        // function type
                               __GLRPC_FRESULT,                            // result
                               boost::function_traits<               
@@ -528,7 +615,7 @@ class distributed_control{
                                                     >::arity ,   // number of arguments
                               f,                                    // function itself
                               typename dc_impl::is_rpc_call<F>::type  // whether it is an RPC style call
-                              >::dispatch_call_fn();
+                              >::dispatch_request_fn());
   }
 
   /// \cond DC_INTERNAL
@@ -652,6 +739,36 @@ class distributed_control{
   template <typename U>
   inline void all_gather(std::vector<U>& data, bool control = false);
 
+
+  /**
+   * Combines the data of all machines with op(U& accumulator, const U& other)
+   * up a binary tree, leaving the result in data on machine root.
+   * \see dc_dist_object::reduce
+   */
+  template <typename U, typename ReduceOp>
+  inline void reduce(U& data, procid_t root, ReduceOp op, bool control = false);
+
+  /**
+   * Combines the data of all machines with op and returns the result
+   * on every machine. \see dc_dist_object::all_reduce
+   */
+  template <typename U, typename ReduceOp>
+  inline void all_reduce(U& data, ReduceOp op, bool control = false);
+
+  /**
+   * all_gather() passing the contributions around a ring. Better for
+   * large contributions. \see dc_dist_object::ring_all_gather
+   */
+  template <typename U>
+  inline void ring_all_gather(std::vector<U>& data, bool control = false);
+
+  /**
+   * Element-wise all_reduce() of equal length vectors using the ring
+   * algorithm. \see dc_dist_object::ring_all_reduce
+   */
+  template <typename U, typename ReduceOp>
+  inline void ring_all_reduce(std::vector<U>& data, ReduceOp op,
+                              bool control = false);
   
   /**
    * This function is takes a vector of local elements T which must
@@ -674,10 +791,25 @@ class distributed_control{
     A machine entering this barrier will wait until every machine 
     reaches this barrier before continuing. Only one thread from each machine
     should call the barrier.
+    The first barrier also checks that all machines registered the 
+    same portable calls, and fails if they did not.
     
     \see full_barrier
     */
   void barrier();
+
+  /**
+    Sends all calls held back by the senders. Only has an effect
+    with the aggregated_send option. Called by full_barrier().
+  */
+  void flush();
+
+  /**
+    Sends the calls the calling thread has issued and the senders
+    still hold back. Calls issued by other threads afterwards cannot
+    overtake them. Only has an effect with the aggregated_send option.
+  */
+  void flush_thread();
   
 
 
@@ -705,6 +837,9 @@ class distributed_control{
   mutex full_barrier_lock;
   conditional full_barrier_cond;
   std::vector<size_t> calls_to_receive;
+  /// Fails if the machines registered different portable calls
+  void verify_portable_calls();
+
   // used to inform the counter that the full barrier
   // is in effect and all modifications to the calls_recv
   // counter will need to lock and signal
@@ -726,12 +861,27 @@ class distributed_control{
     size_t callssent;
     size_t bytessent;
     size_t network_bytessent;
-    collected_statistics(): callssent(0), bytessent(0), network_bytessent(0) { }
+    size_t compress_rawbytes;
+    size_t compress_wirebytes;
+    size_t compress_usec;
+    size_t decompress_usec;
+    size_t flushes;
+    size_t flushed_messages;
+    collected_statistics(): callssent(0), bytessent(0), network_bytessent(0),
+                            compress_rawbytes(0), compress_wirebytes(0),
+                            compress_usec(0), decompress_usec(0),
+                            flushes(0), flushed_messages(0) { }
     void save(oarchive &oarc) const {
-      oarc << callssent << bytessent << network_bytessent;
+      oarc << callssent << bytessent << network_bytessent
+           << compress_rawbytes << compress_wirebytes
+           << compress_usec << decompress_usec
+           << flushes << flushed_messages;
     }
     void load(iarchive &iarc) {
-      iarc >> callssent >> bytessent >> network_bytessent;
+      iarc >> callssent >> bytessent >> network_bytessent
+           >> compress_rawbytes >> compress_wirebytes
+           >> compress_usec >> decompress_usec
+           >> flushes >> flushed_messages;
     }
   };
  public:
@@ -805,6 +955,28 @@ inline void distributed_control::all_gather(std::vector<U>& data, bool control)
   distributed_services->all_gather(data, control);
 }
 
+template <typename U, typename ReduceOp>
+inline void distributed_control::reduce(U& data, procid_t root, ReduceOp op,
+                                        bool control) {
+  distributed_services->reduce(data, root, op, control);
+}
+
+template <typename U, typename ReduceOp>
+inline void distributed_control::all_reduce(U& data, ReduceOp op, bool control) {
+  distributed_services->all_reduce(data, op, control);
+}
+
+template <typename U>
+inline void distributed_control::ring_all_gather(std::vector<U>& data, bool control) {
+  distributed_services->ring_all_gather(data, control);
+}
+
+template <typename U, typename ReduceOp>
+inline void distributed_control::ring_all_reduce(std::vector<U>& data, ReduceOp op,
+                                                 bool control) {
+  distributed_services->ring_all_reduce(data, op, control);
+}
+
 template <typename U>
 inline void distributed_control::gather_partition(const std::vector<U>& local_contribution,
                       std::vector< std::vector<U> >& ret_partition,
@@ -0,0 +1,254 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <unistd.h>
+#include <pthread.h>
+#include <iostream>
+#include <algorithm>
+
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_aggregated_stream_send.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+namespace {
+/// each thread holds an array of buffers indexed by the sender instanceid
+bool thrlocal_aggregation_key_initialized = false;
+pthread_key_t thrlocal_aggregation_key;
+atomic<size_t> next_instanceid;
+
+/// protects thread_buffer::owner
+mutex ownerlock;
+
+void thrlocal_aggregation_destructor(void* v) {
+  std::vector<void*>* tls = reinterpret_cast<std::vector<void*>*>(v);
+  // send out whatever the thread left behind and detach its buffers
+  // from the senders, so that they are neither leaked nor scanned
+  // by the flushing threads any more
+  ownerlock.lock();
+  for (size_t i = 0;i < tls->size(); ++i) {
+    dc_aggregated_stream_send::thread_buffer* tb = 
+      reinterpret_cast<dc_aggregated_stream_send::thread_buffer*>((*tls)[i]);
+    if (tb == NULL) continue;
+    if (tb->owner != NULL) tb->owner->release_thread_buffer(tb);
+    else delete tb;
+  }
+  ownerlock.unlock();
+  delete tls;
+  pthread_setspecific(thrlocal_aggregation_key, NULL);
+}
+}
+
+
+dc_aggregated_stream_send::dc_aggregated_stream_send(distributed_control* dc, 
+                                                     dc_comm_base *comm,
+                                                     procid_t target, 
+                                                     size_t flush_bytes,
+                                                     size_t flush_usec):
+                              dc(dc), comm(comm), target(target),
+                              flush_bytes(flush_bytes), flush_usec(flush_usec),
+                              pending(false), done(false) {
+  // senders are constructed by distributed_control::init, one thread
+  if (thrlocal_aggregation_key_initialized == false) {
+    thrlocal_aggregation_key_initialized = true;
+    int err = pthread_key_create(&thrlocal_aggregation_key, 
+                                 thrlocal_aggregation_destructor);
+    ASSERT_EQ(err, 0);
+  }
+  instanceid = next_instanceid.inc_ret_last();
+  thr = launch_in_new_thread(boost::bind(&dc_aggregated_stream_send::flush_loop,
+                                         this));
+}
+
+dc_aggregated_stream_send::~dc_aggregated_stream_send() {
+  // the buffers are still referenced by the threads which own them.
+  // Those threads free them when they exit.
+  ownerlock.lock();
+  for (size_t i = 0;i < buffers.size(); ++i) buffers[i]->owner = NULL;
+  ownerlock.unlock();
+}
+
+dc_aggregated_stream_send::thread_buffer* 
+dc_aggregated_stream_send::get_thread_buffer() {
+  std::vector<void*>* tls = reinterpret_cast<std::vector<void*>*>(
+                              pthread_getspecific(thrlocal_aggregation_key));
+  if (tls == NULL) {
+    tls = new std::vector<void*>;
+    int err = pthread_setspecific(thrlocal_aggregation_key, tls);
+    ASSERT_EQ(err, 0);
+  }
+  if (tls->size() <= instanceid) tls->resize(instanceid + 1, NULL);
+  if ((*tls)[instanceid] == NULL) {
+    thread_buffer* tb = new thread_buffer(this);
+    bufferslock.lock();
+    buffers.push_back(tb);
+    bufferslock.unlock();
+    (*tls)[instanceid] = tb;
+  }
+  return reinterpret_cast<thread_buffer*>((*tls)[instanceid]);
+}
+
+void dc_aggregated_stream_send::send_data(procid_t target_, 
+                unsigned char packet_type_mask,
+                std::istream &istrm,
+                size_t len) {
+  ASSERT_EQ(target, target_);
+  std::vector<char> data;
+  if (len != size_t(-1)) {
+    data.resize(len);
+    if (len > 0) istrm.read(&(data[0]), len);
+  }
+  else {
+    char c[4096];
+    while (istrm.good()) {
+      istrm.read(c, sizeof(c));
+      data.insert(data.end(), c, c + istrm.gcount());
+    }
+  }
+  send_data(target, packet_type_mask,
+            data.empty() ? NULL : &(data[0]), data.size());
+}
+
+void dc_aggregated_stream_send::send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len) {
+  if ((packet_type_mask & CONTROL_PACKET) == 0) {
+    if (packet_type_mask & (FAST_CALL | STANDARD_CALL)) {
+      dc->inc_calls_sent(target);
+    }
+    bytessent.inc(len);
+  }
+
+  // build the packet header
+  packet_hdr hdr;
+  memset(&hdr, 0, sizeof(packet_hdr));
+  hdr.len = len;
+  hdr.src = dc->procid(); 
+  hdr.sequentialization_key = dc->get_sequentialization_key();
+  hdr.affinity_hint = dc->get_affinity_hint();
+  hdr.packet_type_mask = packet_type_mask;
+
+  // everything issued before a barrier must go out before it
+  if (packet_type_mask & BARRIER) flush();
+  
+  thread_buffer* tb = get_thread_buffer();
+  tb->lock.lock();
+  const bool wasempty = tb->buf.empty();
+  tb->buf.insert(tb->buf.end(), reinterpret_cast<char*>(&hdr),
+                 reinterpret_cast<char*>(&hdr) + sizeof(packet_hdr));
+  tb->buf.insert(tb->buf.end(), data, data + len);
+  ++tb->nmessages;
+  // somebody waits for packets of these types
+  const bool flushnow = tb->buf.size() >= flush_bytes ||
+     (packet_type_mask & (WAIT_FOR_REPLY | REPLY_PACKET | CONTROL_PACKET));
+  if (flushnow) flush_buffer(tb);
+  tb->lock.unlock();
+
+  // wake up the flushing thread so that the data does not wait long
+  if (wasempty && !flushnow && !pending) {
+    flushlock.lock();
+    pending = true;
+    flushcond.signal();
+    flushlock.unlock();
+  }
+}
+
+void dc_aggregated_stream_send::flush_buffer(thread_buffer* tb) {
+  if (tb->buf.empty()) return;
+  sendlock.lock();
+  comm->send(target, &(tb->buf[0]), tb->buf.size());
+  comm->flush(target);
+  sendlock.unlock();
+  nflushes.inc();
+  nmessages.inc(tb->nmessages);
+  tb->nmessages = 0;
+  // keep the memory unless an unusually large packet grew the buffer
+  if (tb->buf.capacity() > 4 * flush_bytes) std::vector<char>().swap(tb->buf);
+  else tb->buf.clear();
+}
+
+void dc_aggregated_stream_send::flush() {
+  // bufferslock is held throughout so that an exiting thread cannot
+  // free its buffer under us
+  bufferslock.lock();
+  for (size_t i = 0;i < buffers.size(); ++i) {
+    buffers[i]->lock.lock();
+    flush_buffer(buffers[i]);
+    buffers[i]->lock.unlock();
+  }
+  bufferslock.unlock();
+}
+
+void dc_aggregated_stream_send::flush_thread() {
+  std::vector<void*>* tls = reinterpret_cast<std::vector<void*>*>(
+                              pthread_getspecific(thrlocal_aggregation_key));
+  // a thread which never sent through this sender has no buffer
+  if (tls == NULL || tls->size() <= instanceid || 
+      (*tls)[instanceid] == NULL) return;
+  thread_buffer* tb = reinterpret_cast<thread_buffer*>((*tls)[instanceid]);
+  tb->lock.lock();
+  flush_buffer(tb);
+  tb->lock.unlock();
+}
+
+void dc_aggregated_stream_send::release_thread_buffer(thread_buffer* tb) {
+  bufferslock.lock();
+  std::vector<thread_buffer*>::iterator iter = 
+    std::find(buffers.begin(), buffers.end(), tb);
+  ASSERT_TRUE(iter != buffers.end());
+  buffers.erase(iter);
+  tb->lock.lock();
+  flush_buffer(tb);
+  tb->lock.unlock();
+  bufferslock.unlock();
+  delete tb;
+}
+
+void dc_aggregated_stream_send::flush_loop() {
+  flushlock.lock();
+  while (1) {
+    while (!pending && !done) flushcond.wait(flushlock);
+    if (done) break;
+    pending = false;
+    flushlock.unlock();
+    // give the threads flush_usec to fill their buffers
+    if (flush_usec > 0) usleep(flush_usec);
+    flush();
+    flushlock.lock();
+  }
+  flushlock.unlock();
+}
+
+void dc_aggregated_stream_send::shutdown() {
+  flushlock.lock();
+  done = true;
+  flushcond.signal();
+  flushlock.unlock();
+  thr.join();
+  flush();
+}
+
+} // namespace dc_impl
+} // namespace graphlab
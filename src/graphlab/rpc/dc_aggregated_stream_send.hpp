@@ -0,0 +1,158 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef DC_AGGREGATED_STREAM_SEND_HPP
+#define DC_AGGREGATED_STREAM_SEND_HPP
+#include <iostream>
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_send.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/logger.hpp>
+namespace graphlab {
+class distributed_control;
+
+namespace dc_impl {
+
+/**
+   \ingroup rpc
+  Sender for the dc class which aggregates small messages.
+  Every thread appends its packets to a buffer of its own, so
+  senders do not contend with each other. A thread's buffer is
+  passed to the communication classes when it reaches 
+  flush_bytes, or by a flushing thread once it has held data for
+  flush_usec microseconds. 
+
+  Packets which somebody is waiting for (requests, replies and
+  control packets) are sent right away together with everything 
+  the thread buffered before them. A barrier packet flushes the
+  buffers of all threads first, so all calls issued before
+  the barrier are sent before it. Calls issued by different threads
+  may otherwise be reordered.
+
+  Enabled by passing "aggregated_send=yes" in the distributed 
+  control initstring. 
+*/
+class dc_aggregated_stream_send: public dc_send{
+ public:
+  /// The buffer of one thread
+  struct thread_buffer {
+    mutex lock;
+    std::vector<char> buf;
+    /// number of packets in buf
+    size_t nmessages;
+    /// the sender the buffer belongs to. NULL once the sender is
+    /// destroyed, in which case the thread frees the buffer on exit
+    dc_aggregated_stream_send* owner;
+    thread_buffer(dc_aggregated_stream_send* owner): 
+                              nmessages(0), owner(owner) { }
+  };
+
+  dc_aggregated_stream_send(distributed_control* dc, dc_comm_base *comm,
+                            procid_t target, size_t flush_bytes,
+                            size_t flush_usec);
+
+  ~dc_aggregated_stream_send();
+
+  inline bool channel_active(procid_t target) const {
+    return comm->channel_active(target);
+  }
+
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 std::istream &istrm,
+                 size_t len = size_t(-1));
+
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len);
+
+  /// Sends the contents of all thread buffers
+  void flush();
+
+  /// Sends the contents of the buffer of the calling thread
+  void flush_thread();
+
+  /** Sends and frees the buffer of a thread which is exiting. Called
+      from the thread local destructor */
+  void release_thread_buffer(thread_buffer* tb);
+
+  void shutdown();
+
+  inline size_t bytes_sent() {
+    return bytessent.value;
+  }
+
+  void aggregation_statistics(size_t& flushes, size_t& messages) {
+    flushes = nflushes.value;
+    messages = nmessages.value;
+  }
+
+ private:
+  /// pointer to the owner
+  distributed_control* dc;
+  dc_comm_base *comm;
+  procid_t target;
+  /// index of this sender into the thread local buffer arrays
+  size_t instanceid;
+
+  size_t flush_bytes;
+  size_t flush_usec;
+
+  /// serializes transmissions to the target
+  mutex sendlock;
+
+  /// the buffers of all live threads. Protected by bufferslock
+  std::vector<thread_buffer*> buffers;
+  mutex bufferslock;
+
+  /// the flushing thread waits on this until a buffer has data
+  mutex flushlock;
+  conditional flushcond;
+  bool pending;
+  bool done;
+  thread thr;
+
+  atomic<size_t> bytessent;
+  atomic<size_t> nflushes;
+  atomic<size_t> nmessages;
+
+  /// returns the buffer of the calling thread, creating it if necessary
+  thread_buffer* get_thread_buffer();
+
+  /// sends the contents of the buffer. tb->lock must be held
+  void flush_buffer(thread_buffer* tb);
+
+  void flush_loop();
+};
+
+
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -61,17 +61,15 @@ void dc_buffered_stream_receive::process_buffer() {
   if (barrier) return;
   // only makes sense to process if we at least have
   // a header
-  while (size_t(buffer.size()) >= sizeof(packet_hdr)) {
-    // read the header
-    packet_hdr hdr;
-    buffer.peek((char*)(&hdr), sizeof(hdr));
+  packet_hdr hdr;
+  while (buffer.peek_header(hdr)) {
     #ifdef DC_RECEIVE_DEBUG
     logstream(LOG_INFO) << "peeked packet header. Has length "
                         << hdr.len << std::endl;
     #endif
     //do we have enough to extract a single packet
     // if not, quit now!
-    if (size_t(buffer.size()) < sizeof(packet_hdr) + hdr.len) break;
+    if (buffer.size() < sizeof(packet_hdr) + hdr.len) break;
 
     buffer.skip(sizeof(packet_hdr));
 
@@ -94,18 +92,21 @@ void dc_buffered_stream_receive::process_buffer() {
       #ifdef DC_RECEIVE_DEBUG
       logstream(LOG_INFO) << "Is fast call" << std::endl;
       #endif
-      boost::iostreams::stream<circular_char_buffer_source> strm(buffer,hdr.len);
-      dc->exec_function_call(hdr.src, hdr, strm);
+      const char* data = buffer.read_ptr();
+      buffer.skip(hdr.len);
+      dc->exec_function_call(hdr.src, hdr, data, hdr.len);
     }
     else if (hdr.packet_type_mask & STANDARD_CALL) {
       #ifdef DC_RECEIVE_DEBUG
       logstream(LOG_INFO) << "Is deferred call" << std::endl;
       #endif
-      // not a fast call. so read out the buffer
-      char* tmpbuf = new char[hdr.len];
-      buffer.read(tmpbuf, hdr.len);
+      // not a fast call. execute it in place
+      receive_slab* slab = buffer.current_slab();
+      slab->acquire();
+      const char* data = buffer.read_ptr();
+      buffer.skip(hdr.len);
       pending_calls.inc();
-      dc->deferred_function_call(hdr.src,hdr, tmpbuf, hdr.len);
+      dc->deferred_function_call(hdr.src, hdr, slab, data, hdr.len);
     }
   }
 }
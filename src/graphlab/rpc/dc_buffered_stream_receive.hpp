@@ -24,7 +24,7 @@
 #ifndef DC_BUFFERED_STREAM_RECEIVE_HPP
 #define DC_BUFFERED_STREAM_RECEIVE_HPP
 #include <boost/type_traits/is_base_of.hpp>
-#include <graphlab/rpc/circular_char_buffer.hpp>
+#include <graphlab/rpc/receive_slab.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_receive.hpp>
@@ -84,7 +84,7 @@ class dc_buffered_stream_receive: public dc_receive{
   
   /** the incoming data stream. This is protected
   by the bufferlock */
-  circular_char_buffer buffer;
+  receive_slab_buffer buffer;
 
   /** number of rpc calls from this other processor
      which are in the deferred execution queue */
@@ -84,6 +84,7 @@ void dc_buffered_stream_send::send_data(procid_t target,
   hdr.len = len;
   hdr.src = dc->procid(); 
   hdr.sequentialization_key = dc->get_sequentialization_key();
+  hdr.affinity_hint = dc->get_affinity_hint();
   hdr.packet_type_mask = packet_type_mask;
   
   std::streamsize numbytes_needed = sizeof(packet_hdr) + len;
@@ -134,6 +135,7 @@ void dc_buffered_stream_send::send_data(procid_t target,
     comm->send2(target, 
                 reinterpret_cast<char*>(&hdr), sizeof(packet_hdr),
                 data,  len);
+    comm->flush(target);
     sendbuf.end_critical_section();
   }
   
@@ -149,6 +151,7 @@ void dc_buffered_stream_send::send_till_empty() {
     comm->send(target, c,  readlen);
     sendbuf.advance_head(readlen);
   }
+  comm->flush(target);
 }
 
 void dc_buffered_stream_send::send_loop() {
@@ -158,6 +161,8 @@ void dc_buffered_stream_send::send_loop() {
     if (readlen == 0 && sendbuf.is_done()) break;
     comm->send(target, c,  readlen);
     sendbuf.advance_head(readlen);
+    // push out the partial segment once we have caught up
+    if (sendbuf.empty()) comm->flush(target);
   }
 }
 
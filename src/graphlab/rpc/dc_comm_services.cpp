@@ -145,6 +145,7 @@ void dc_comm_services::barrier() {
     if (comm->procid() != 0) {
       comm->send(parent, childtoparent_message.c_str(), 
                  childtoparent_message.length());
+      comm->flush(parent);
     }
     // wait for 0.1s
     barrier_cond.timedwait_ns(barrier_mut, 100000000);
@@ -0,0 +1,117 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <zlib.h>
+#include <iostream>
+
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_compressed_stream_receive.hpp>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+void dc_compressed_stream_receive::incoming_data(procid_t src, 
+                    const char* buf, 
+                    size_t len) {
+  framelock.lock();
+  if (!stream_failed) {
+    framebuf.write(buf, len);
+    process_frames();
+  }
+  framelock.unlock();
+}
+
+size_t dc_compressed_stream_receive::frame_remaining() const {
+  if (framebuf.size() < sizeof(compressed_frame_hdr)) return 0;
+  compressed_frame_hdr fhdr;
+  memcpy(&fhdr, framebuf.read_ptr(), sizeof(compressed_frame_hdr));
+  const size_t framelen = sizeof(compressed_frame_hdr) + fhdr.len;
+  return framelen > framebuf.size() ? framelen - framebuf.size() : 0;
+}
+
+void dc_compressed_stream_receive::process_frames() {
+  compressed_frame_hdr fhdr;
+  while (!stream_failed && framebuf.size() >= sizeof(compressed_frame_hdr)) {
+    memcpy(&fhdr, framebuf.read_ptr(), sizeof(compressed_frame_hdr));
+    if (fhdr.rawlen > MAX_COMPRESSED_FRAME_RAWLEN) {
+      // no sender produces this. Do not allocate what it asks for
+      logstream(LOG_ERROR) << "Compressed frame from " << source
+                           << " claims " << fhdr.rawlen << " bytes"
+                           << ". Dropping the connection." << std::endl;
+      stream_failed = true;
+      break;
+    }
+    if (framebuf.size() < sizeof(compressed_frame_hdr) + fhdr.len) break;
+    framebuf.skip(sizeof(compressed_frame_hdr));
+    const char* payload = framebuf.read_ptr();
+    framebuf.skip(fhdr.len);
+    if (fhdr.rawlen == 0) {
+      inner->incoming_data(source, payload, fhdr.len);
+    }
+    else {
+      timer ti;
+      ti.start();
+      if (rawbuf.size() < fhdr.rawlen) rawbuf.resize(fhdr.rawlen);
+      uLongf rawlen = fhdr.rawlen;
+      int ret = uncompress(reinterpret_cast<Bytef*>(&(rawbuf[0])), &rawlen,
+                           reinterpret_cast<const Bytef*>(payload), fhdr.len);
+      if (ret != Z_OK || rawlen != fhdr.rawlen) {
+        // the stream is corrupt and cannot be resynchronized
+        logstream(LOG_ERROR) << "Corrupt compressed frame from " << source
+                             << ": " << (ret != Z_OK ? zError(ret) : "bad length")
+                             << ". Dropping the connection." << std::endl;
+        stream_failed = true;
+        break;
+      }
+      decompress_seconds += ti.current_time();
+      inner->incoming_data(source, &(rawbuf[0]), rawlen);
+    }
+  }
+  // nothing after a corrupt frame can be decoded
+  if (stream_failed) framebuf.skip(framebuf.size());
+}
+
+char* dc_compressed_stream_receive::get_buffer(size_t& retbuflength) {
+  char* ret;
+  framelock.lock();
+  ret = framebuf.write_ptr(retbuflength, frame_remaining());
+  framelock.unlock();
+  return ret;
+}
+
+
+char* dc_compressed_stream_receive::advance_buffer(char* c, size_t wrotelength, 
+                            size_t& retbuflength) {
+  char* ret;
+  framelock.lock();
+  framebuf.advance_write(wrotelength);
+  process_frames();
+  ret = framebuf.write_ptr(retbuflength, frame_remaining());
+  framelock.unlock();
+  return ret;
+}
+
+} // namespace dc_impl
+} // namespace graphlab
@@ -0,0 +1,119 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef DC_COMPRESSED_STREAM_RECEIVE_HPP
+#define DC_COMPRESSED_STREAM_RECEIVE_HPP
+#include <vector>
+#include <graphlab/rpc/receive_slab.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_receive.hpp>
+#include <graphlab/rpc/dc_compressed_stream_send.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/logger/logger.hpp>
+namespace graphlab {
+class distributed_control;
+
+namespace dc_impl {
+
+/**
+  \ingroup rpc
+  Receiver for streams written by dc_compressed_stream_send.
+  Incoming bytes are cut into frames, and each frame is
+  decompressed if necessary and passed on to an inner receiver
+  which parses the packets within.
+  The inner receiver is owned by this class.
+*/
+class dc_compressed_stream_receive: public dc_receive{
+ public:
+  
+  dc_compressed_stream_receive(distributed_control* dc, procid_t source,
+                               dc_receive* inner): 
+                  dc(dc), source(source), inner(inner),
+                  decompress_seconds(0), stream_failed(false) { }
+
+  ~dc_compressed_stream_receive() {
+    delete inner;
+  }
+
+  void incoming_data(procid_t src, 
+                     const char* buf, 
+                     size_t len);
+   
+  void function_call_completed(unsigned char packettype) {
+    inner->function_call_completed(packettype);
+  }
+
+  size_t bytes_received() {
+    return inner->bytes_received();
+  }
+  
+  void shutdown() {
+    inner->shutdown();
+  }
+
+  inline bool direct_access_support() {
+    return true;
+  }
+  
+  char* get_buffer(size_t& retbuflength);
+
+  char* advance_buffer(char* c, size_t wrotelength, 
+                              size_t& retbuflength);
+
+  double decompression_time() {
+    return decompress_seconds;
+  }
+
+  bool failed() {
+    return stream_failed;
+  }
+
+ private:
+  /// pointer to the owner
+  distributed_control* dc;
+  procid_t source;
+  dc_receive* inner;
+
+  /// protects framebuf
+  mutex framelock;
+  /// the incoming frames
+  receive_slab_buffer framebuf;
+  /// decompression output
+  std::vector<char> rawbuf;
+  double decompress_seconds;
+  /// set when a frame did not decompress. Later data is dropped
+  bool stream_failed;
+
+  /// the number of bytes still missing from the frame at the head
+  size_t frame_remaining() const;
+
+  /// decodes and forwards all complete frames
+  void process_frames();
+};
+
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
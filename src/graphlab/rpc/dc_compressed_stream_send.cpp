@@ -0,0 +1,148 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <zlib.h>
+#include <iostream>
+
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_compressed_stream_send.hpp>
+#include <graphlab/util/timer.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+void dc_compressed_stream_send::send_data(procid_t target_, 
+                unsigned char packet_type_mask,
+                std::istream &istrm,
+                size_t len) {
+  ASSERT_EQ(target, target_);
+  std::vector<char> data;
+  if (len != size_t(-1)) {
+    data.resize(len);
+    if (len > 0) istrm.read(&(data[0]), len);
+  }
+  else {
+    char c[4096];
+    while (istrm.good()) {
+      istrm.read(c, sizeof(c));
+      data.insert(data.end(), c, c + istrm.gcount());
+    }
+  }
+  send_data(target, packet_type_mask,
+            data.empty() ? NULL : &(data[0]), data.size());
+}
+
+void dc_compressed_stream_send::send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len) {
+  if ((packet_type_mask & CONTROL_PACKET) == 0) {
+    if (packet_type_mask & (FAST_CALL | STANDARD_CALL)) {
+      dc->inc_calls_sent(target);
+    }
+    bytessent.inc(len);
+  }
+
+  // build the packet header
+  packet_hdr hdr;
+  memset(&hdr, 0, sizeof(packet_hdr));
+  hdr.len = len;
+  hdr.src = dc->procid(); 
+  hdr.sequentialization_key = dc->get_sequentialization_key();
+  hdr.affinity_hint = dc->get_affinity_hint();
+  hdr.packet_type_mask = packet_type_mask;
+
+  lock.lock();
+  while (sendbuf.size() > MAX_PENDING_BYTES) sentcond.wait(lock);
+  const bool wasempty = sendbuf.empty();
+  sendbuf.insert(sendbuf.end(), reinterpret_cast<char*>(&hdr),
+                 reinterpret_cast<char*>(&hdr) + sizeof(packet_hdr));
+  sendbuf.insert(sendbuf.end(), data, data + len);
+  if (wasempty) datacond.signal();
+  lock.unlock();
+}
+
+
+void dc_compressed_stream_send::send_frame(const std::vector<char>& batch) {
+  compressed_frame_hdr fhdr;
+  fhdr.len = batch.size();
+  fhdr.rawlen = 0;
+  const char* payload = &(batch[0]);
+  double seconds = 0;
+
+  if (batch.size() >= compress_threshold &&
+      batch.size() <= MAX_COMPRESSED_FRAME_RAWLEN) {
+    timer ti;
+    ti.start();
+    uLongf complen = compressBound(batch.size());
+    if (compressbuf.size() < complen) compressbuf.resize(complen);
+    int ret = compress2(reinterpret_cast<Bytef*>(&(compressbuf[0])), &complen,
+                        reinterpret_cast<const Bytef*>(&(batch[0])),
+                        batch.size(), Z_BEST_SPEED);
+    ASSERT_EQ(ret, Z_OK);
+    seconds = ti.current_time();
+    // incompressible batches are sent as they are
+    if (complen < batch.size()) {
+      fhdr.len = complen;
+      fhdr.rawlen = batch.size();
+      payload = &(compressbuf[0]);
+    }
+  }
+  lock.lock();
+  compress_seconds += seconds;
+  rawbytes += batch.size();
+  wirebytes += sizeof(compressed_frame_hdr) + fhdr.len;
+  lock.unlock();
+  comm->send2(target,
+              reinterpret_cast<char*>(&fhdr), sizeof(compressed_frame_hdr),
+              payload, fhdr.len);
+  comm->flush(target);
+}
+
+
+void dc_compressed_stream_send::send_loop() {
+  lock.lock();
+  while (1) {
+    while (sendbuf.empty() && !done) datacond.wait(lock);
+    if (sendbuf.empty()) break;
+    // take everything that accumulated while the last frame was sent
+    flushbuf.swap(sendbuf);
+    sentcond.broadcast();
+    lock.unlock();
+    send_frame(flushbuf);
+    flushbuf.clear();
+    lock.lock();
+  }
+  lock.unlock();
+}
+
+void dc_compressed_stream_send::shutdown() {
+  lock.lock();
+  done = true;
+  datacond.signal();
+  lock.unlock();
+  thr.join();
+}
+
+} // namespace dc_impl
+} // namespace graphlab
@@ -0,0 +1,152 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef DC_COMPRESSED_STREAM_SEND_HPP
+#define DC_COMPRESSED_STREAM_SEND_HPP
+#include <iostream>
+#include <vector>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_send.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/logger.hpp>
+namespace graphlab {
+class distributed_control;
+
+namespace dc_impl {
+
+/**
+ * \ingroup rpc_internal
+ * Header of each frame sent by dc_compressed_stream_send.
+ * rawlen is 0 if the payload is not compressed.
+ */
+struct compressed_frame_hdr {
+  uint64_t len;     /// length of the payload on the wire
+  uint64_t rawlen;  /// length of the payload after decompression
+};
+
+/**
+ * \ingroup rpc_internal
+ * Larger batches are sent uncompressed. The receiver drops the
+ * connection on a frame claiming a larger rawlen.
+ */
+const size_t MAX_COMPRESSED_FRAME_RAWLEN = 256 * 1024 * 1024;
+
+/**
+   \ingroup rpc
+  Sender for the dc class which compresses its transmissions.
+  Like dc_buffered_stream_send, packets are appended to a buffer
+  which a sending thread passes to the communication classes. Each
+  batch the sending thread takes out of the buffer is sent as one
+  frame, zlib compressed at the fastest level if it is at least
+  compress_threshold bytes long (and at most
+  MAX_COMPRESSED_FRAME_RAWLEN) and compression makes it smaller.
+
+  Enabled by passing "compressed=yes" in the distributed control
+  initstring. Both ends must agree. The receiving end is
+  dc_compressed_stream_receive.
+*/
+class dc_compressed_stream_send: public dc_send{
+ public:
+  /// Batches beyond this size block the callers until sent
+  static const size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+  dc_compressed_stream_send(distributed_control* dc, dc_comm_base *comm,
+                            procid_t target, size_t compress_threshold):
+                            dc(dc), comm(comm), target(target), done(false),
+                            compress_threshold(compress_threshold),
+                            rawbytes(0), wirebytes(0), compress_seconds(0) {
+    thr = launch_in_new_thread(boost::bind(&dc_compressed_stream_send::send_loop,
+                                           this));
+  }
+
+  ~dc_compressed_stream_send() { }
+
+  inline bool channel_active(procid_t target) const {
+    return comm->channel_active(target);
+  }
+
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 std::istream &istrm,
+                 size_t len = size_t(-1));
+
+  void send_data(procid_t target, 
+                 unsigned char packet_type_mask,
+                 char* data, size_t len);
+
+  void send_loop();
+
+  void shutdown();
+
+  inline size_t bytes_sent() {
+    return bytessent.value;
+  }
+
+  void compression_statistics(size_t& raw, size_t& wire, double& seconds) {
+    lock.lock();
+    raw = rawbytes;
+    wire = wirebytes;
+    seconds = compress_seconds;
+    lock.unlock();
+  }
+
+ private:
+  /// pointer to the owner
+  distributed_control* dc;
+  dc_comm_base *comm;
+  procid_t target;
+
+  /// protects sendbuf, done and the compression statistics
+  mutex lock;
+  conditional datacond;
+  conditional sentcond;
+  /// packets waiting for the sending thread
+  std::vector<char> sendbuf;
+  /// owned by the sending thread
+  std::vector<char> flushbuf;
+  std::vector<char> compressbuf;
+
+  thread thr;
+  bool done;
+  atomic<size_t> bytessent;
+
+  size_t compress_threshold;
+  /// bytes of all the frames before and after compression
+  size_t rawbytes;
+  size_t wirebytes;
+  double compress_seconds;
+
+  /// sends one batch as a single frame
+  void send_frame(const std::vector<char>& batch);
+};
+
+
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -28,7 +28,10 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
+#include <algorithm>
 #include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_dist_object_base.hpp>
 #include <graphlab/rpc/object_request_issue.hpp>
@@ -36,6 +39,8 @@
 #include <graphlab/rpc/function_ret_type.hpp>
 #include <graphlab/rpc/mem_function_arg_types_def.hpp>
 #include <graphlab/util/charstream.hpp>
+#include <graphlab/serialization/serialize_to_from_string.hpp>
+#include <graphlab/rpc/reduce_ops.hpp>
 #include <boost/preprocessor.hpp>
 #include <graphlab/macros_def.hpp>
 
@@ -143,8 +148,8 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
     //------ Initialize the matched send/recv ------
     recv_froms.resize(dc_.numprocs());
     
-    //------ Initialize the gatherer ------
-    gather_receive.resize(dc_.numprocs());
+    //------ Initialize the collectives ------
+    collective_seq = 0;
 
     
     //------- Initialize the Barrier ----------
@@ -343,6 +348,8 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
   BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type remote_request, dc_impl::object_request_issue, STANDARD_CALL) )
   BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type fast_remote_request, dc_impl::object_request_issue, FAST_CALL) )
   BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type control_request, dc_impl::object_request_issue, (FAST_CALL | CONTROL_PACKET)) )
+  BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (request_future<typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type> future_remote_request, dc_impl::object_future_request_issue, STANDARD_CALL) )
+  BOOST_PP_REPEAT(6, REQUEST_INTERFACE_GENERATOR, (request_future<typename dc_impl::function_ret_type<__GLRPC_FRESULT>::type> fast_future_remote_request, dc_impl::object_future_request_issue, FAST_CALL) )
  
 
 
@@ -493,18 +500,101 @@ class dc_dist_object : public dc_impl::dc_dist_object_base{
 
 
 /*****************************************************************************
-                      Implementation of Broadcast
+                Transport of the tree and ring collectives
  *****************************************************************************/
-  
-private:
 
-  std::string broadcast_receive;
+ private:
+  typedef std::vector<std::pair<procid_t, std::string> > collective_records;
+
+  /** Collective messages which arrived but were not consumed yet, keyed
+   * by (collective sequence number, slot). Every machine issues the
+   * collectives on this object in the same order, so the sequence
+   * number names the same collective everywhere, and messages from a
+   * machine which ran ahead into the next collective wait here. */
+  std::map<std::pair<size_t, size_t>, std::string> collective_inbox;
+  mutex collective_lock;
+  conditional collective_cond;
+  /// The sequence number of the next collective
+  size_t collective_seq;
+
+  /// The slot of the originator's message to the root in broadcast()
+  static const size_t BROADCAST_UP_SLOT = size_t(-1);
+
+  void __collective_deliver(size_t seq, size_t slot, const std::string& s) {
+    collective_lock.lock();
+    collective_inbox[std::make_pair(seq, slot)] = s;
+    collective_cond.broadcast();
+    collective_lock.unlock();
+  }
+
+  void collective_send(procid_t target, size_t seq, size_t slot,
+                       const std::string& s, bool control) {
+    if (control) {
+      internal_control_call(target, &dc_dist_object<T>::__collective_deliver,
+                            seq, slot, s);
+    }
+    else {
+      internal_call(target, &dc_dist_object<T>::__collective_deliver,
+                    seq, slot, s);
+      // do not let the aggregating sender hold back a collective
+      dc_.flush();
+    }
+  }
+
+  /// Blocks until the message for (seq, slot) arrives and moves it to s
+  void collective_recv(size_t seq, size_t slot, std::string& s) {
+    const std::pair<size_t, size_t> key(seq, slot);
+    collective_lock.lock();
+    std::map<std::pair<size_t, size_t>, std::string>::iterator iter;
+    while ((iter = collective_inbox.find(key)) == collective_inbox.end()) {
+      collective_cond.wait(collective_lock);
+    }
+    s.swap(iter->second);
+    collective_inbox.erase(iter);
+    collective_lock.unlock();
+  }
+
+  /** The position of this machine in a binary tree over all machines
+   * rooted at root. The children of rank r are 2r+1 and 2r+2. */
+  size_t tree_rank(procid_t root) const {
+    return (size_t(procid()) + numprocs() - root) % numprocs();
+  }
+
+  /// The machine at position rank in the binary tree rooted at root
+  procid_t tree_proc(size_t rank, procid_t root) const {
+    return (procid_t)((rank + root) % numprocs());
+  }
 
-  void set_broadcast_receive(const std::string &s) {
-    broadcast_receive = s;
+  /// Sends s down to the children of rank in the tree rooted at root
+  void tree_send_to_children(size_t rank, procid_t root, size_t seq,
+                             const std::string& s, bool control) {
+    for (size_t c = 2 * rank + 1; c <= 2 * rank + 2 && c < numprocs(); ++c) {
+      collective_send(tree_proc(c, root), seq, 0, s, control);
+    }
+  }
+
+  /// Broadcasts data from root down the binary tree
+  template <typename U>
+  void tree_broadcast(U& data, procid_t root, bool control) {
+    const size_t seq = collective_seq++;
+    if (numprocs() == 1) return;
+    const size_t rank = tree_rank(root);
+    std::string s;
+    if (rank == 0) {
+      s = serialize_to_string(data);
+    }
+    else {
+      collective_recv(seq, 0, s);
+      deserialize_from_string(s, data);
+    }
+    tree_send_to_children(rank, root, seq, s, control);
   }
 
 
+/*****************************************************************************
+                      Implementation of Broadcast
+ *****************************************************************************/
+
  public:
  
   /**
@@ -517,6 +607,10 @@ private:
      The originator will then return 'data'. All other machines
      will receive the originator's transmission in the "data" parameter.
 
+     The data travels down a binary tree rooted at machine 0 (by way
+     of machine 0 if it is not the originator), so no machine sends
+     more than two copies of it.
+
      This call is guaranteed to have barrier-like behavior. That is to say,
      this call will block until all machines enter the broadcast function.
 
@@ -529,44 +623,21 @@ private:
   */
   template <typename U>
   void broadcast(U& data, bool originator, bool control = false) { 
-    if (originator) {
-      // construct the data stream
-      std::stringstream strm;
-      oarchive oarc(strm);
-      oarc << data;
-      strm.flush();
-      broadcast_receive = strm.str();
-      if (control == false) {
-        for (size_t i = 0;i < numprocs(); ++i) {
-          if (i != procid()) {
-            internal_request(i,
-                            &dc_dist_object<T>::set_broadcast_receive,
-                            broadcast_receive);
-          }
-        }
-      }
-      else {
-        for (size_t i = 0;i < numprocs(); ++i) {
-          if (i != procid()) {
-            internal_control_request(i,
-                                    &dc_dist_object<T>::set_broadcast_receive,
-                                    broadcast_receive);
-          }
-        }
+    const size_t seq = collective_seq++;
+    if (numprocs() > 1) {
+      std::string s;
+      if (originator) {
+        s = serialize_to_string(data);
+        if (procid() != 0) collective_send(0, seq, BROADCAST_UP_SLOT, s, control);
       }
+      // the originator also receives its own data back, since it has
+      // to forward it to its children in the tree
+      if (procid() != 0) collective_recv(seq, 0, s);
+      else if (!originator) collective_recv(seq, BROADCAST_UP_SLOT, s);
+      tree_send_to_children(procid(), 0, seq, s, control);
+      if (!originator) deserialize_from_string(s, data);
     }
-  
-    // by the time originator gets here, all machines
-    // will have received the data due to the broadcast_receive
-    // set a barrier here.
     barrier();
-  
-    // all machines will now deserialize the data
-    if (!originator) {
-      std::stringstream strm(broadcast_receive);
-      iarchive iarc(strm);
-      iarc >> data;
-    }
   }
 
 
@@ -574,14 +645,6 @@ private:
       Implementation of Gather, all_gather and gather_partition
  *****************************************************************************/
 
- private:
-  std::vector<std::string> gather_receive;
-  atomic<size_t> gatherid;
-  
-  void set_gather_receive(procid_t source, const std::string &s, size_t gid) {
-    while(gatherid.value != gid) sched_yield();
-    gather_receive[source] = s;
-  }
  public:
   /**
    * Collects information contributed by each machine onto 
@@ -591,46 +654,42 @@ private:
    * when function returns, machine sendto will have the complete vector
    * where data[i] is the data contributed by machine i.
    * All machines must have the same parameter for "sendto"
+   *
+   * The contributions are collected up a binary tree rooted at sendto,
+   * so sendto receives two messages rather than one per machine.
+   * Machines other than sendto return as soon as they have passed
+   * their subtree's contributions on.
    */
   template <typename U>
   void gather(std::vector<U>& data, procid_t sendto, bool control = false) {
-    // if not root
-    if (sendto != procid()) {
-      std::stringstream strm( std::ios::out | std::ios::binary );
-      oarchive oarc(strm);
-      oarc << data[procid()];
-      strm.flush();
-      if (control == false) {
-        internal_request(sendto,
-                        &dc_dist_object<T>::set_gather_receive,
-                        procid(),
-                        strm.str(),
-                        gatherid.value);
-      }
-      else {
-        internal_control_request(sendto,
-                                  &dc_dist_object<T>::set_gather_receive,
-                                  procid(),
-                                  strm.str(),
-                                  gatherid.value);
+    const size_t seq = collective_seq++;
+    if (numprocs() == 1) return;
+    const size_t rank = tree_rank(sendto);
+    collective_records records;
+    for (size_t c = 2 * rank + 1; c <= 2 * rank + 2 && c < numprocs(); ++c) {
+      std::string s;
+      collective_recv(seq, c, s);
+      collective_records subtree;
+      deserialize_from_string(s, subtree);
+      const size_t base = records.size();
+      records.resize(base + subtree.size());
+      for (size_t i = 0; i < subtree.size(); ++i) {
+        records[base + i].first = subtree[i].first;
+        records[base + i].second.swap(subtree[i].second);
       }
     }
-    barrier();
-    if (sendto == procid()) {
-      // if I am the receiver
-      for (procid_t i = 0; i < numprocs(); ++i) {
-        if (i != procid()) {
-          // receiving only from others
-          std::stringstream strm(gather_receive[i], 
-                                 std::ios::in | std::ios::binary);
-          assert(strm.good());
-          iarchive iarc(strm);
-          iarc >> data[i];
-        }
+    if (rank > 0) {
+      records.push_back(std::make_pair(procid(),
+                                       serialize_to_string(data[procid()])));
+      collective_send(tree_proc((rank - 1) / 2, sendto), seq, rank,
+                      serialize_to_string(records), control);
+    }
+    else {
+      ASSERT_EQ(records.size(), numprocs() - 1);
+      for (size_t i = 0; i < records.size(); ++i) {
+        deserialize_from_string(records[i].second, data[records[i].first]);
       }
     }
-    gatherid.inc();
-  
   }
 
 /********************************************************************
@@ -844,6 +903,138 @@ private:
 
 
 
+/*****************************************************************************
+           Implementation of reduce, all_reduce and the ring collectives
+ *****************************************************************************/
+
+  /**
+   * Combines the data of all machines with op, leaving the result in
+   * data on machine root. op is called as op(U& accumulator, const U& other)
+   * (see graphlab::reduce_ops for common operators) and must be
+   * associative and commutative, since contributions are combined up
+   * a binary tree rooted at root in no particular order. The tree has
+   * logarithmic depth and every machine sends a single message, so
+   * the root receives two messages instead of one per machine.
+   * data is left unchanged on the other machines.
+   * All machines must have the same parameter for "root".
+   */
+  template <typename U, typename ReduceOp>
+  void reduce(U& data, procid_t root, ReduceOp op, bool control = false) {
+    const size_t seq = collective_seq++;
+    if (numprocs() == 1) return;
+    const size_t rank = tree_rank(root);
+    const size_t firstchild = 2 * rank + 1;
+    if (firstchild >= numprocs()) {
+      // a leaf. just pass my contribution up
+      collective_send(tree_proc((rank - 1) / 2, root), seq, rank,
+                      serialize_to_string(data), control);
+      return;
+    }
+    U acc(data);
+    for (size_t c = firstchild; c <= firstchild + 1 && c < numprocs(); ++c) {
+      std::string s;
+      collective_recv(seq, c, s);
+      U other;
+      deserialize_from_string(s, other);
+      op(acc, other);
+    }
+    if (rank > 0) {
+      collective_send(tree_proc((rank - 1) / 2, root), seq, rank,
+                      serialize_to_string(acc), control);
+    }
+    else {
+      data = acc;
+    }
+  }
+
+  /**
+   * Combines the data of all machines with op and returns the result
+   * in data on every machine. This is a tree reduce() onto machine 0
+   * followed by a tree broadcast, so it completes in logarithmic depth.
+   * For long vectors ring_all_reduce() moves fewer bytes per machine.
+   */
+  template <typename U, typename ReduceOp>
+  void all_reduce(U& data, ReduceOp op, bool control = false) {
+    reduce(data, 0, op, control);
+    tree_broadcast(data, 0, control);
+  }
+
+  /**
+   * Same as all_gather(), but passes the contributions around a ring:
+   * in each of numprocs()-1 steps every machine forwards one
+   * contribution to its right neighbour. Every machine sends and
+   * receives each contribution once, so no machine is a bandwidth
+   * bottleneck, at the price of a latency linear in the number of
+   * machines. Prefer it over all_gather() for large contributions.
+   */
+  template <typename U>
+  void ring_all_gather(std::vector<U>& data, bool control = false) {
+    const size_t seq = collective_seq++;
+    const size_t nprocs = numprocs();
+    if (nprocs == 1) return;
+    const procid_t right = (procid_t)((procid() + 1) % nprocs);
+    std::vector<std::string> blocks(nprocs);
+    blocks[procid()] = serialize_to_string(data[procid()]);
+    for (size_t step = 0; step + 1 < nprocs; ++step) {
+      const size_t sendblock = (procid() + nprocs - step) % nprocs;
+      const size_t recvblock = (procid() + nprocs - step - 1) % nprocs;
+      collective_send(right, seq, step, blocks[sendblock], control);
+      collective_recv(seq, step, blocks[recvblock]);
+    }
+    for (size_t i = 0; i < nprocs; ++i) {
+      if (i != procid()) deserialize_from_string(blocks[i], data[i]);
+    }
+  }
+
+  /**
+   * Element-wise all_reduce() of a vector which has the same length on
+   * every machine, using the ring algorithm: the vector is cut into
+   * numprocs() chunks which are reduced around the ring (reduce-scatter)
+   * and then passed around once more (all-gather). Every machine sends
+   * about twice the length of the vector regardless of the number of
+   * machines. op must be associative and commutative.
+   */
+  template <typename U, typename ReduceOp>
+  void ring_all_reduce(std::vector<U>& data, ReduceOp op, bool control = false) {
+    const size_t seq = collective_seq++;
+    const size_t nprocs = numprocs();
+    if (nprocs == 1) return;
+    const procid_t right = (procid_t)((procid() + 1) % nprocs);
+    const size_t len = data.size();
+    // chunk c covers [len * c / nprocs, len * (c + 1) / nprocs)
+    // reduce-scatter. Afterwards this machine holds the reduced chunk procid() + 1
+    for (size_t step = 0; step + 1 < nprocs; ++step) {
+      const size_t sendchunk = (procid() + nprocs - step) % nprocs;
+      const size_t recvchunk = (procid() + nprocs - step - 1) % nprocs;
+      std::vector<U> out(data.begin() + len * sendchunk / nprocs,
+                         data.begin() + len * (sendchunk + 1) / nprocs);
+      collective_send(right, seq, step, serialize_to_string(out), control);
+      std::string s;
+      collective_recv(seq, step, s);
+      std::vector<U> in;
+      deserialize_from_string(s, in);
+      const size_t begin = len * recvchunk / nprocs;
+      ASSERT_EQ(in.size(), len * (recvchunk + 1) / nprocs - begin);
+      for (size_t i = 0; i < in.size(); ++i) op(data[begin + i], in[i]);
+    }
+    // all-gather of the reduced chunks
+    for (size_t step = 0; step + 1 < nprocs; ++step) {
+      const size_t sendchunk = (procid() + 1 + nprocs - step) % nprocs;
+      const size_t recvchunk = (procid() + nprocs - step) % nprocs;
+      std::vector<U> out(data.begin() + len * sendchunk / nprocs,
+                         data.begin() + len * (sendchunk + 1) / nprocs);
+      collective_send(right, seq, nprocs + step, serialize_to_string(out), control);
+      std::string s;
+      collective_recv(seq, nprocs + step, s);
+      std::vector<U> in;
+      deserialize_from_string(s, in);
+      const size_t begin = len * recvchunk / nprocs;
+      ASSERT_EQ(in.size(), len * (recvchunk + 1) / nprocs - begin);
+      std::copy(in.begin(), in.end(), data.begin() + begin);
+    }
+  }
+
+
 ////////////////////////////////////////////////////////////////////////////
 
   /**
@@ -1058,6 +1249,8 @@ private:
   \see barrier
   */
   void full_barrier() {
+    // make sure the calls held back by the senders are counted
+    dc_.flush();
     // gather a sum of all the calls issued to machine 0
     std::vector<size_t> calls_sent_to_target(numprocs(), 0);
     for (size_t i = 0;i < numprocs(); ++i) {
@@ -1099,6 +1292,63 @@ private:
 //     }
     barrier();
   }
+
+  /**
+  A full_barrier() among neighbors only. On return, all RMI calls on this
+  object issued by the machines in neighbors before they entered the
+  barrier have completed, and so have the calls this machine issued to
+  them. Messages are only exchanged with the neighbors, so the cost grows
+  with the number of neighbors rather than with the number of machines.
+  
+  Every machine must call the barrier, and the relation must be symmetric:
+  if j is in the neighbors of i, then i must be in the neighbors of j.
+  Calls from machines which are not neighbors are not waited for. The
+  same multithreading caveats as full_barrier() apply.
+  
+  \see full_barrier
+  */
+  void neighborhood_barrier(const std::vector<procid_t>& neighbors) {
+    // make sure the calls held back by the senders are counted
+    dc_.flush();
+    const size_t seq = collective_seq++;
+    // tell every neighbor how many calls I have sent it
+    for (size_t i = 0;i < neighbors.size(); ++i) {
+      size_t sent = callssent[neighbors[i]].value;
+      collective_send(neighbors[i], seq, procid(), serialize_to_string(sent), true);
+    }
+    // and find out how many calls I am supposed to receive.
+    // Nothing is expected from anyone else
+    calls_to_receive.clear(); calls_to_receive.resize(numprocs(), 0);
+    std::string s;
+    for (size_t i = 0;i < neighbors.size(); ++i) {
+      collective_recv(seq, neighbors[i], s);
+      deserialize_from_string(s, calls_to_receive[neighbors[i]]);
+    }
+    // wait for them exactly as in the full barrier
+    num_proc_recvs_incomplete.value = numprocs();
+    procs_complete.clear();
+    full_barrier_in_effect = true;
+    __asm("mfence");
+    for (size_t i = 0;i < numprocs(); ++i) {
+      if (callsreceived[i].value >= calls_to_receive[i]) {
+        if (procs_complete.set_bit((uint32_t)i) == false) {
+          num_proc_recvs_incomplete.dec();
+        }
+      }
+    }
+    full_barrier_lock.lock();
+    while (num_proc_recvs_incomplete.value > 0) full_barrier_cond.wait(full_barrier_lock);
+    full_barrier_lock.unlock();
+    full_barrier_in_effect = false;
+    // in place of the trailing barrier: tell the neighbors that their
+    // calls are done, and wait until mine are done on their side
+    for (size_t i = 0;i < neighbors.size(); ++i) {
+      collective_send(neighbors[i], seq, numprocs() + procid(), std::string(), true);
+    }
+    for (size_t i = 0;i < neighbors.size(); ++i) {
+      collective_recv(seq, numprocs() + neighbors[i], s);
+    }
+  }
   
  /* --------------------  Implementation of Gather Statistics -----------------*/ 
  private:
@@ -38,7 +38,8 @@ namespace graphlab {
 
 bool init_param_from_mpi(dc_init_param& param,dc_comm_type commtype) {
 #ifdef HASMPI
-  ASSERT_MSG(commtype == TCP_COMM, "MPI initialization only supports TCP at the moment");
+  ASSERT_MSG(commtype == TCP_COMM || commtype == SHM_COMM, 
+             "MPI initialization only supports TCP and SHM communication");
   // Look for a free port to use. 
   std::pair<size_t, int> port_and_sock = get_free_tcp_port();
   size_t port = port_and_sock.first;
@@ -25,6 +25,11 @@
 #define DC_INTERNAL_TYPES_HPP
 #include <boost/function.hpp>
 #include <boost/unordered_map.hpp>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <string>
+#include <graphlab/logger/logger.hpp>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/util/resizing_array_sink.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
@@ -46,9 +51,113 @@ typedef void (*comm_recv_callback_type)(void* tag, procid_t src,
  * \ingroup rpc_internal
  * 
  * The type of the local function call dispatcher */
-typedef void (*dispatch_type)(distributed_control& dc, procid_t, unsigned char, std::istream&);
+typedef void (*dispatch_type)(distributed_control& dc, procid_t, unsigned char, iarchive&);
 
-typedef boost::unordered_map<std::string, dispatch_type> dispatch_map_type;
+/** 
+ * \ingroup rpc_internal
+ * 
+ * The dispatchers of the registered (portable) calls, keyed by the
+ * call id. An open addressing table with linear probing, so a lookup
+ * is a few comparisons in one or two cache lines. Registration 
+ * should complete before calls arrive.
+ */
+class portable_dispatch_table {
+ public:
+  struct entry {
+    uint32_t id;  /// 0 if the slot is empty
+    dispatch_type call;
+    dispatch_type request;
+  };
+
+  portable_dispatch_table(): nentries(0) {
+    entries.resize(64);
+    memset(&(entries[0]), 0, sizeof(entry) * entries.size());
+  }
+
+  /**
+   * Registers the dispatchers of the function called name with the
+   * given id. A different name with the same id is a fatal error.
+   */
+  void insert(uint32_t id, const std::string& name, 
+              dispatch_type call, dispatch_type request) {
+    ASSERT_NE(id, 0);
+    std::map<uint32_t, std::string>::const_iterator iter = names.find(id);
+    if (iter != names.end() && iter->second != name) {
+      logstream(LOG_FATAL) << "RPC " << name << " and " << iter->second 
+                           << " hash to the same id " << id 
+                           << ". Please rename one of them." << std::endl;
+    }
+    names[id] = name;
+    if (iter == names.end() && 2 * (nentries + 1) > entries.size()) {
+      // keep the table at most half full
+      std::vector<entry> old;
+      old.swap(entries);
+      entries.resize(old.size() * 2);
+      memset(&(entries[0]), 0, sizeof(entry) * entries.size());
+      for (size_t i = 0;i < old.size(); ++i) {
+        if (old[i].id != 0) *slot(old[i].id) = old[i];
+      }
+    }
+    entry* e = slot(id);
+    if (e->id == 0) ++nentries;
+    e->id = id;
+    e->call = call;
+    e->request = request;
+  }
+
+  /// Returns the entry of the id, or NULL if it is not registered
+  inline const entry* find(uint32_t id) const {
+    const size_t mask = entries.size() - 1;
+    for (size_t i = id & mask; ; i = (i + 1) & mask) {
+      if (entries[i].id == id) return &(entries[i]);
+      if (entries[i].id == 0) return NULL;
+    }
+  }
+
+  /// The number of registered calls
+  inline size_t size() const { return names.size(); }
+
+  /**
+   * A 64 bit FNV-1a hash of all the registered (id, name) pairs.
+   * Machines which registered the same calls have the same signature.
+   */
+  inline uint64_t signature() const {
+    uint64_t h = 14695981039346656037ull;
+    std::map<uint32_t, std::string>::const_iterator iter = names.begin();
+    for (; iter != names.end(); ++iter) {
+      for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+        h ^= (unsigned char)(iter->first >> (8 * i));
+        h *= 1099511628211ull;
+      }
+      // include the terminating 0 to separate the names
+      for (size_t i = 0; i <= iter->second.length(); ++i) {
+        h ^= (unsigned char)(iter->second.c_str()[i]);
+        h *= 1099511628211ull;
+      }
+    }
+    return h;
+  }
+
+  /// Returns the name registered for the id
+  inline std::string name(uint32_t id) const {
+    std::map<uint32_t, std::string>::const_iterator iter = names.find(id);
+    return iter == names.end() ? std::string() : iter->second;
+  }
+
+ private:
+  std::vector<entry> entries;
+  size_t nentries;
+  /// for error messages
+  std::map<uint32_t, std::string> names;
+
+  /// the slot holding id, or the empty slot where it should go
+  inline entry* slot(uint32_t id) {
+    const size_t mask = entries.size() - 1;
+    size_t i = id & mask;
+    while (entries[i].id != 0 && entries[i].id != id) i = (i + 1) & mask;
+    return &(entries[i]);
+  }
+};
 
 // commm capabilities
 const size_t COMM_STREAM = 1;
@@ -63,6 +172,7 @@ struct packet_hdr {
   procid_t src; /// source machine
   unsigned char packet_type_mask; /// the types are in dc_packet_mask.hpp
   unsigned char sequentialization_key;
+  uint32_t affinity_hint; /// picks the handler thread. 0 if any
 };
 
 /** 
@@ -115,7 +225,11 @@ struct terminator_token {
   bool terminate;
 };
 
-extern boost::iostreams::stream<resizing_array_sink_ref>& get_thread_local_stream();
+/**
+ * Returns an empty buffer archive owned by the calling thread. Used to
+ * serialize outgoing calls without allocating.
+ */
+extern oarchive& get_thread_local_oarchive();
 
 }
 }
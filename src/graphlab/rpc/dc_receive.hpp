@@ -93,6 +93,18 @@ class dc_receive {
    * If the sender multithreads, the sending thread must shut down.
    */
   virtual void shutdown() = 0;
+
+  /**
+   * Seconds spent decompressing received data. Zero for receivers
+   * which do not decompress.
+   */
+  virtual double decompression_time() { return 0; }
+
+  /**
+   * True once the data from the source could not be decoded. The
+   * comm layer then drops the connection to the source.
+   */
+  virtual bool failed() { return false; }
 };
 
 
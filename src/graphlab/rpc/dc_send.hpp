@@ -83,6 +83,35 @@ class dc_send{
    */
   virtual void shutdown() = 0;
 
+  /**
+   * Sends everything the sender is holding back. Senders which
+   * transmit on their own within bounded time need not do anything.
+   */
+  virtual void flush() { }
+
+  /**
+   * Sends everything the calling thread is holding back, so that it
+   * cannot be overtaken by calls other threads issue afterwards.
+   */
+  virtual void flush_thread() { }
+
+  /**
+   * Number of transmissions, and the number of packets they contained.
+   * Zero for senders which do not aggregate packets.
+   */
+  virtual void aggregation_statistics(size_t& flushes, size_t& messages) {
+    flushes = 0; messages = 0;
+  }
+
+  /**
+   * Bytes sent before and after compression, including the frames
+   * which were not compressed, and the seconds spent compressing.
+   * Zero for senders which do not compress.
+   */
+  virtual void compression_statistics(size_t& rawbytes, size_t& wirebytes,
+                                      double& seconds) {
+    rawbytes = 0; wirebytes = 0; seconds = 0;
+  }
 };
   
 
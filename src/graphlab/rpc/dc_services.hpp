@@ -155,6 +155,44 @@ namespace graphlab {
     }
 
 
+  /**
+   * Combines the data of all machines with op(U& accumulator, const U& other)
+   * up a binary tree, leaving the result in data on machine root.
+   * \see dc_dist_object::reduce
+   */
+    template <typename U, typename ReduceOp>
+    inline void reduce(U& data, procid_t root, ReduceOp op, bool control = false) {
+      rmi.reduce(data, root, op, control);
+    }
+
+  /**
+   * Combines the data of all machines with op and returns the result
+   * on every machine. \see dc_dist_object::all_reduce
+   */
+    template <typename U, typename ReduceOp>
+    inline void all_reduce(U& data, ReduceOp op, bool control = false) {
+      rmi.all_reduce(data, op, control);
+    }
+
+  /**
+   * all_gather() passing the contributions around a ring. Better for
+   * large contributions. \see dc_dist_object::ring_all_gather
+   */
+    template <typename U>
+    inline void ring_all_gather(std::vector<U>& data, bool control = false) {
+      rmi.ring_all_gather(data, control);
+    }
+
+  /**
+   * Element-wise all_reduce() of equal length vectors using the ring
+   * algorithm. \see dc_dist_object::ring_all_reduce
+   */
+    template <typename U, typename ReduceOp>
+    inline void ring_all_reduce(std::vector<U>& data, ReduceOp op,
+                                bool control = false) {
+      rmi.ring_all_reduce(data, op, control);
+    }
+
   /**
    * This function is takes a vector of local elements T which must
    * be comparable and constructs a vector of length numprocs where
@@ -202,6 +240,14 @@ namespace graphlab {
     inline void full_barrier() {
       rmi.full_barrier();
     }
+
+  /**
+    A full_barrier() restricted to the given neighbors.
+    \see dc_dist_object::neighborhood_barrier
+    */
+    inline void neighborhood_barrier(const std::vector<procid_t>& neighbors) {
+      rmi.neighborhood_barrier(neighbors);
+    }
   
  
 
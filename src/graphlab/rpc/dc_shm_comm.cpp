@@ -0,0 +1,187 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <netdb.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/rpc/dc_shm_comm.hpp>
+
+namespace graphlab {
+ 
+namespace dc_impl {
+  
+void dc_shm_comm::init(const std::vector<std::string> &machines,
+                       const std::map<std::string,std::string> &initopts,
+                       procid_t curmachineid,
+                       std::vector<dc_receive*> receiver_){ 
+  receiver = receiver_;
+  const size_t nprocs = machines.size();
+  size_t ringsize = 4 * 1024 * 1024;
+  std::map<std::string, std::string>::const_iterator opt = 
+                                      initopts.find("shm_ring_size");
+  if (opt != initopts.end()) ringsize = atoi(opt->second.c_str());
+  
+  // find the machines which share our address. Machines whose
+  // address does not resolve are reached over TCP
+  std::vector<uint32_t> addrs(nprocs, 0);
+  std::vector<bool> resolved(nprocs, false);
+  portnums.resize(nprocs);
+  for (size_t i = 0;i < nprocs; ++i) {
+    size_t pos = machines[i].find(":");
+    ASSERT_NE(pos, std::string::npos);
+    std::string address = machines[i].substr(0, pos);
+    portnums[i] = boost::lexical_cast<uint16_t>(machines[i].substr(pos+1));
+    struct hostent* ent = gethostbyname(address.c_str());
+    if (ent == NULL || ent->h_length != 4 || ent->h_addr_list[0] == NULL) {
+      logstream(LOG_WARNING) << "Cannot resolve " << address 
+                             << ". Using TCP for machine " << i << std::endl;
+      continue;
+    }
+    addrs[i] = *reinterpret_cast<uint32_t*>(ent->h_addr_list[0]);
+    resolved[i] = true;
+  }
+  islocal.resize(nprocs, false);
+  inrings.resize(nprocs, NULL);
+  inthreads.resize(nprocs, NULL);
+  outrings.resize(nprocs, NULL);
+  outlocks.resize(nprocs);
+  size_t nlocal = 0;
+  for (size_t i = 0;i < nprocs; ++i) {
+    if (i != curmachineid && resolved[i] && resolved[curmachineid] &&
+        addrs[i] == addrs[curmachineid]) {
+      islocal[i] = true;
+      ++nlocal;
+    }
+  }
+  // create the rings to us before anyone may send
+  for (size_t i = 0;i < nprocs; ++i) {
+    if (!islocal[i]) continue;
+    inrings[i] = shm_ring::create(ring_name(i, curmachineid), ringsize);
+    inthreads[i] = new thread();
+    inthreads[i]->launch(boost::bind(&dc_shm_comm::receive_loop, this, 
+                                     (procid_t)i));
+  }
+  logstream(LOG_INFO) << "Proc " << curmachineid << " uses shared memory with "
+                      << nlocal << " machines" << std::endl;
+  tcp.init(machines, initopts, curmachineid, receiver);
+}
+
+std::string dc_shm_comm::ring_name(procid_t src, procid_t dest) const {
+  // listening ports are unique on a host
+  std::stringstream strm;
+  strm << "/graphlab_shm_" << portnums[src] << "_" << portnums[dest];
+  return strm.str();
+}
+
+void dc_shm_comm::close() {
+  tcp.close();
+  // wake and stop the receiving threads
+  for (size_t i = 0;i < inrings.size(); ++i) {
+    if (inrings[i] == NULL) continue;
+    inrings[i]->close();
+    inthreads[i]->join();
+    delete inthreads[i];
+    delete inrings[i];
+    inthreads[i] = NULL;
+    inrings[i] = NULL;
+  }
+  for (size_t i = 0;i < outrings.size(); ++i) {
+    if (outrings[i] == NULL) continue;
+    outlocks[i].lock();
+    delete outrings[i];
+    outrings[i] = NULL;
+    outlocks[i].unlock();
+  }
+}
+
+void dc_shm_comm::connect(size_t target) {
+  if (outrings[target] != NULL) return;
+  // the target creates the ring during its init. 
+  // Wait up to 10 seconds for it
+  for (size_t i = 0;i < 1000; ++i) {
+    outrings[target] = shm_ring::attach(ring_name(procid(), target));
+    if (outrings[target] != NULL) break;
+    usleep(10000);
+  }
+  if (outrings[target] == NULL) {
+    logstream(LOG_FATAL) << "Failed to attach to the shared memory of machine " 
+                         << target << std::endl;
+  }
+}
+
+void dc_shm_comm::send(size_t target, const char* buf, size_t len) {
+  if (!islocal[target]) {
+    tcp.send(target, buf, len);
+    return;
+  }
+  shm_bytessent.inc(len);
+  outlocks[target].lock();
+  connect(target);
+  outrings[target]->write(buf, len);
+  outlocks[target].unlock();
+}
+
+void dc_shm_comm::send2(size_t target, 
+                       const char* buf1, const size_t len1,
+                       const char* buf2, const size_t len2) {
+  if (!islocal[target]) {
+    tcp.send2(target, buf1, len1, buf2, len2);
+    return;
+  }
+  shm_bytessent.inc(len1 + len2);
+  outlocks[target].lock();
+  connect(target);
+  outrings[target]->write(buf1, len1);
+  outrings[target]->write(buf2, len2);
+  outlocks[target].unlock();
+}
+
+void dc_shm_comm::flush(size_t target) {
+  // the rings are never held back
+  if (!islocal[target]) tcp.flush(target);
+}
+
+void dc_shm_comm::receive_loop(procid_t src) {
+  shm_ring* ring = inrings[src];
+  dc_receive* r = receiver[src];
+  while(1) {
+    const char* c = NULL;
+    size_t len = ring->readable(c);
+    if (len > 0) {
+      shm_bytesreceived.inc(len);
+      r->incoming_data(src, c, len);
+      ring->consume(len);
+    }
+    else if (!ring->wait_for_data()) {
+      break;
+    }
+  }
+}
+
+} // namespace dc_impl
+} // namespace graphlab
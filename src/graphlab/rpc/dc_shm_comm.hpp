@@ -0,0 +1,140 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef DC_SHM_COMM_HPP
+#define DC_SHM_COMM_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_types.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/dc_comm_base.hpp>
+#include <graphlab/rpc/dc_tcp_comm.hpp>
+#include <graphlab/rpc/shm_ring.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+  
+/**
+ \ingroup rpc_internal
+Communications subsystem for several processes on each host.
+Processes on the same host (with the same address in the machines
+list) talk through a pair of shared memory rings. All other
+machines are reached through an embedded dc_tcp_comm.
+
+Selected by the SHM_COMM communication type.
+*/
+class dc_shm_comm:public dc_comm_base {
+ public:
+   
+  dc_shm_comm() {}
+  
+  size_t capabilities() const {
+    return COMM_STREAM;
+  }
+  
+  /**
+   Same as dc_tcp_comm::init(). Additional options are
+   shm_ring_size=BYTES  Size of each ring. Defaults to 4MB.
+  */
+  void init(const std::vector<std::string> &machines,
+            const std::map<std::string,std::string> &initopts,
+            procid_t curmachineid,
+            std::vector<dc_receive*> receiver);
+
+  /** shuts down all rings and sockets and cleans up */
+  void close();
+  
+  ~dc_shm_comm() {
+    close();
+  }
+  
+  inline bool channel_active(size_t target) const {
+    return islocal[target] ? outrings[target] != NULL : 
+                             tcp.channel_active(target);
+  }
+
+  inline procid_t numprocs() const {
+    return tcp.numprocs();
+  }
+  
+  inline procid_t procid() const {
+    return tcp.procid();
+  }
+  
+  inline size_t network_bytes_sent() const {
+    return tcp.network_bytes_sent() + shm_bytessent.value;
+  }
+
+  inline size_t network_bytes_received() const {
+    return tcp.network_bytes_received() + shm_bytesreceived.value;
+  }
+ 
+  void flush(size_t target);
+  
+  void send(size_t target, const char* buf, size_t len);
+  
+  void send2(size_t target, 
+             const char* buf1, const size_t len1,
+             const char* buf2, const size_t len2); 
+  
+ private:
+  /// machines on other hosts
+  dc_tcp_comm tcp;
+
+  /// islocal[i] is true if machine i is on this host
+  std::vector<bool> islocal;
+  std::vector<uint16_t> portnums;
+  
+  std::vector<dc_receive*> receiver;
+
+  /// inrings[i] carries the data from local machine i. Created by us.
+  std::vector<shm_ring*> inrings;
+  std::vector<thread*> inthreads;
+  
+  /// outrings[i] carries the data to local machine i. Created lazily
+  std::vector<shm_ring*> outrings;
+  /// serializes writers of outrings[i]
+  std::vector<mutex> outlocks;
+  
+  atomic<size_t> shm_bytessent;
+  atomic<size_t> shm_bytesreceived;
+
+  /// the name of the ring carrying data from machine src to machine dest
+  std::string ring_name(procid_t src, procid_t dest) const;
+  
+  /// attaches to the ring to the target. outlocks[target] must be held
+  void connect(size_t target);
+
+  /// passes everything arriving on inrings[src] to the receiver
+  void receive_loop(procid_t src);
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -62,17 +62,15 @@ void dc_stream_receive::process_buffer(bool outsidelocked) {
   if (outsidelocked || bufferlock.try_lock()) {
     // only makes sense to process if we at least have
     // a header
-    while (size_t(buffer.size()) >= sizeof(packet_hdr)) {
-      // read the header
-      packet_hdr hdr;
-      buffer.peek((char*)(&hdr), sizeof(hdr));
+    packet_hdr hdr;
+    while (buffer.peek_header(hdr)) {
       #ifdef DC_RECEIVE_DEBUG
       logstream(LOG_INFO) << "peeked packet header. Has length " 
                           << hdr.len << std::endl;         
       #endif
       //do we have enough to extract a single packet
       // if not, quit now!
-      if (size_t(buffer.size()) < sizeof(packet_hdr) + hdr.len) break;
+      if (buffer.size() < sizeof(packet_hdr) + hdr.len) break;
 
       buffer.skip(sizeof(packet_hdr));
       
@@ -96,18 +94,22 @@ void dc_stream_receive::process_buffer(bool outsidelocked) {
         if (hdr.packet_type_mask & REPLY_PACKET) logstream(LOG_INFO) << "Is reply" << std::endl;
         else logstream(LOG_INFO) << "Is fast call" << std::endl;
         #endif
-        boost::iostreams::stream<circular_char_buffer_source> strm(buffer,hdr.len);
-        dc->exec_function_call(hdr.src,hdr, strm);
+        const char* data = buffer.read_ptr();
+        buffer.skip(hdr.len);
+        dc->exec_function_call(hdr.src, hdr, data, hdr.len);
       }
       else if (hdr.packet_type_mask & STANDARD_CALL) {
         #ifdef DC_RECEIVE_DEBUG
         logstream(LOG_INFO) << "Is deferred call" << std::endl;
         #endif
-        // not a fast call. so read out the buffer
-        char* tmpbuf = new char[hdr.len];
-        buffer.read(tmpbuf, hdr.len);
+        // not a fast call. The call is executed in place, holding
+        // a reference to the slab until it completes
+        receive_slab* slab = buffer.current_slab();
+        slab->acquire();
+        const char* data = buffer.read_ptr();
+        buffer.skip(hdr.len);
         pending_calls.inc();
-        dc->deferred_function_call(hdr.src,hdr, tmpbuf, hdr.len);
+        dc->deferred_function_call(hdr.src, hdr, slab, data, hdr.len);
       }
     }
     if (!outsidelocked) bufferlock.unlock();
@@ -117,9 +119,7 @@ void dc_stream_receive::process_buffer(bool outsidelocked) {
 char* dc_stream_receive::get_buffer(size_t& retbuflength) {
   char* ret;
   bufferlock.lock();
-  // get a write section
-  retbuflength = buffer.introspective_write(ret);
-  assert(retbuflength > 0);
+  ret = buffer.write_ptr(retbuflength, buffer.packet_remaining());
   bufferlock.unlock();
   return ret;
 }
@@ -132,33 +132,10 @@ char* dc_stream_receive::advance_buffer(char* c, size_t wrotelength,
   buffer.advance_write(wrotelength);
 
   process_buffer(true);
-  
-  retbuflength = buffer.introspective_write(ret);
-  // if the writeable section is too small, sqeeze the buffer 
-  // and try again
-  if (retbuflength < 1024) {
-    // realign the buffer if it is cheap to do so
-    if (buffer.align_requires_alloc() == false) {
-      buffer.align();
-      retbuflength = buffer.introspective_write(ret);
-    }
-    // try again
-    // if this is still too small
-    if (retbuflength < 1024) {
-      //reserve more capacity
-      buffer.reserve(2 * buffer.reserved_size());
-      retbuflength = buffer.introspective_write(ret);
-    }
-    
-    // if still too small
-    if (retbuflength < 1024) {
-      //reserve more capacity
-      buffer.reserve(2 * buffer.reserved_size());
-      retbuflength = buffer.introspective_write(ret);    
-    }
-    // by design of the circular buffer, this is guaranteed to 
-    // free up enough space
-  }
+  // packets are consumed in place, so the bytes left over are at
+  // most one partial packet. write_ptr() moves them to a new slab
+  // if the current one is full
+  ret = buffer.write_ptr(retbuflength, buffer.packet_remaining());
   bufferlock.unlock();
 
   return ret;
@@ -24,7 +24,7 @@
 #ifndef DC_STREAM_RECEIVE_HPP
 #define DC_STREAM_RECEIVE_HPP
 #include <boost/type_traits/is_base_of.hpp>
-#include <graphlab/rpc/circular_char_buffer.hpp>
+#include <graphlab/rpc/receive_slab.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_receive.hpp>
@@ -43,13 +43,14 @@ namespace dc_impl {
   (as received from the socket) and cut it up into meaningful chunks.
   This can be thought of as a receiving end of a multiplexor.
   
-  This is the default unbuffered receiver.
+  This is the default unbuffered receiver. The socket reads straight
+  into a receive_slab_buffer and calls are deserialized in place, so
+  received bytes are not copied.
 */
 class dc_stream_receive: public dc_receive{
  public:
   
   dc_stream_receive(distributed_control* dc): 
-                  buffer(10240),
                   barrier(false), dc(dc),
                   bytesreceived(0){ }
 
@@ -68,9 +69,9 @@ class dc_stream_receive: public dc_receive{
   /// the mutex protecting the buffer and the barrier 
   mutex bufferlock;
   
-  /** the incoming data stream. This is protected
-  by the bufferlock */
-  circular_char_buffer buffer;
+  /** the incoming data stream. Calls are executed directly out of
+  it. This is protected by the bufferlock */
+  receive_slab_buffer buffer;
 
   /** number of rpc calls from this other processor
      which are in the deferred execution queue */
@@ -94,6 +94,7 @@ void dc_stream_send::send_data(procid_t target,
   hdr.len = len;
   hdr.src = dc->procid(); 
   hdr.sequentialization_key = dc->get_sequentialization_key();
+  hdr.affinity_hint = dc->get_affinity_hint();
   hdr.packet_type_mask = packet_type_mask;
   lock.lock();
  /* comm->send(target, 
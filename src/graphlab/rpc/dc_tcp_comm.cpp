@@ -31,11 +31,17 @@
 #include <netinet/tcp.h>
 #include <ifaddrs.h>
 #include <poll.h>
+#include <errno.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include <limits>
 #include <vector>
 #include <string>
 #include <map>
+#include <algorithm>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/bind.hpp>
@@ -64,7 +70,6 @@ void dc_tcp_comm::init(const std::vector<std::string> &machines,
   // fill all the socks
   socks.resize(nprocs, -1);
   handlers.resize(nprocs, NULL);
-  handlerthreads.resize(nprocs, NULL);
   outsocks.resize(nprocs, -1);
   // parse the machines list, and extract the relevant address information
   for (size_t i = 0;i < machines.size(); ++i) {
@@ -83,6 +88,37 @@ void dc_tcp_comm::init(const std::vector<std::string> &machines,
     portnums[i] = (uint16_t)(port);
   }
   network_bytessent = 0;
+
+  // read the options
+  size_t nthreads = std::min(size_t(8), (size_t(nprocs) + 15) / 16);
+  size_t recvbufsize = 1024 * 1024;
+  corked = false;
+  std::map<std::string, std::string>::const_iterator opt;
+  opt = initopts.find("comm_threads");
+  if (opt != initopts.end()) nthreads = atoi(opt->second.c_str());
+  opt = initopts.find("recv_buffer");
+  if (opt != initopts.end()) recvbufsize = atoi(opt->second.c_str());
+  opt = initopts.find("tcp_cork");
+  if (opt != initopts.end() && 
+      (opt->second == "true" || opt->second == "1" || opt->second == "yes")) {
+    #ifdef TCP_CORK
+    corked = true;
+    #else
+    logger(LOG_WARNING, "TCP_CORK is not supported on this system");
+    #endif
+  }
+  nthreads = std::max(nthreads, size_t(1));
+  recvbufsize = std::max(recvbufsize, size_t(4096));
+  
+  // start the receiving threads
+  ASSERT_EQ(pipe(wakepipe), 0);
+  for (size_t i = 0;i < nthreads; ++i) {
+    iohandlers.push_back(new io_handler(*this, recvbufsize));
+    iothreads.push_back(new thread());
+    iothreads[i]->launch(boost::bind(&io_handler::run, iohandlers[i]));
+  }
+  logstream(LOG_INFO) << "Proc " << procid() << " receiving with " 
+                      << nthreads << " threads" << std::endl;
   // if sock handle is set
   std::map<std::string, std::string>::const_iterator iter = initopts.find("__sockhandle__");
   if (iter != initopts.end()) {
@@ -117,20 +153,29 @@ void dc_tcp_comm::close() {
     }
   }
   logstream(LOG_INFO) << "Closing incoming sockets" << std::endl;
+  // stop the receiving threads. The wake pipe is never read, so
+  // every thread sees it
+  if (!iothreads.empty()) {
+    char c = 0;
+    ASSERT_EQ(write(wakepipe[1], &c, 1), 1);
+    for (size_t i = 0;i < iothreads.size(); ++i) {
+      iothreads[i]->join();
+      delete iothreads[i];
+      // deletes the socket handlers still attached
+      delete iohandlers[i];
+    }
+    iothreads.clear();
+    iohandlers.clear();
+    ::close(wakepipe[0]);
+    ::close(wakepipe[1]);
+  }
   // close all incoming sockets
   for (size_t i = 0;i < socks.size(); ++i) {
     if (socks[i] > 0) {
       ::close(socks[i]);
       socks[i] = -1;
-      // join the receiving threads
-      // remember that the receiving handler is self deleting
-      if (handlerthreads[i] != NULL) {
-        handlerthreads[i]->join();
-        delete handlerthreads[i];
-      }
-      handlerthreads[i] = NULL;
-      handlers[i] = NULL;
     }
+    handlers[i] = NULL;
   }
 }
 void dc_tcp_comm::check_for_out_connection(size_t target) {
@@ -162,60 +207,16 @@ void dc_tcp_comm::send2(size_t target,
                        const char* buf2, const size_t len2) {
   network_bytessent.inc(len1 + len2);
   check_for_out_connection(target);
-  struct msghdr data;
   struct iovec vec[2];
   vec[0].iov_base = (void*)buf1;
   vec[0].iov_len = len1;
   vec[1].iov_base = (void*)buf2;
   vec[1].iov_len = len2;
- 
-  data.msg_name = NULL;
-  data.msg_namelen = 0;
-  data.msg_control = NULL;
-  data.msg_controllen = 0;
-  data.msg_flags = 0;
-  data.msg_iovlen = 2;
-  data.msg_iov = vec;
-  
- 
   #ifdef COMM_DEBUG
-  logstream(LOG_INFO) << len << " bytes --> " << target  << std::endl;
+  logstream(LOG_INFO) << len1 + len2 << " bytes --> " << target  << std::endl;
   #endif
-  // amount of data to transmit
-  size_t dataleft = len1 + len2;
-  // while there is still data to be sent
-  while(dataleft > 0) {
-    size_t ret = sendmsg(outsocks[target], &data, 0);
-    // decrement the counter
-    dataleft -= ret;
-    // restructure the msghdr depending on how much was sent
-    struct iovec* newiovecptr = data.msg_iov;
-    size_t newiovlen = data.msg_iovlen;
-    for (size_t i = 0;i < (size_t)(data.msg_iovlen); ++i) {
-      // amount sent was less than this entry.
-      // shift the entry and retry
-      if (ret < data.msg_iov[i].iov_len) {
-        // shift the data
-        data.msg_iov[i].iov_len -= ret;
-        char* tmp = (char*) data.msg_iov[i].iov_base;
-        tmp += ret;
-        data.msg_iov[i].iov_base = (void*)tmp;
-        break;
-      }
-      else {
-        // amount sent exceeds this entry. we need to 
-        // erase this entry (increment the iovec_ptr)
-        // and go on to the next entry
-        size_t l = std::min(ret, data.msg_iov[i].iov_len);
-        newiovlen--;
-        newiovecptr++;
-        ret -= l;
-        if (ret == 0) break;
-      }
-    }
-    data.msg_iov = newiovecptr;
-    data.msg_iovlen = newiovlen;
-  }
+  int err = sendvtosock(outsocks[target], vec, 2);
+  ASSERT_EQ(err, 0);
 }
 
 int dc_tcp_comm::sendtosock(int sockfd, const char* buf, size_t len) {
@@ -230,6 +231,34 @@ int dc_tcp_comm::sendtosock(int sockfd, const char* buf, size_t len) {
   }
   return 0;
 }
+
+int dc_tcp_comm::sendvtosock(int sockfd, struct iovec* vec, size_t veclen) {
+  struct msghdr data;
+  memset(&data, 0, sizeof(struct msghdr));
+  data.msg_iov = vec;
+  data.msg_iovlen = veclen;
+  while (data.msg_iovlen > 0) {
+    ssize_t ret = sendmsg(sockfd, &data, 0);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      logstream(LOG_ERROR) << "send error: " << strerror(errno) << std::endl;
+      return errno;
+    }
+    // drop the buffers which were sent completely
+    size_t sent = (size_t)ret;
+    while (data.msg_iovlen > 0 && sent >= data.msg_iov->iov_len) {
+      sent -= data.msg_iov->iov_len;
+      ++data.msg_iov;
+      --data.msg_iovlen;
+    }
+    // and shift the one which was sent partially
+    if (sent > 0) {
+      data.msg_iov->iov_base = (char*)(data.msg_iov->iov_base) + sent;
+      data.msg_iov->iov_len -= sent;
+    }
+  }
+  return 0;
+}
   
 void dc_tcp_comm::set_socket_options(int fd) {
    int flag = 1;
@@ -244,11 +273,14 @@ void dc_tcp_comm::set_socket_options(int fd) {
 }
 
 void dc_tcp_comm::flush(size_t target) {
-/*  ASSERT_NE(outsocks[target], -1);
+  #ifdef TCP_CORK
+  if (!corked || outsocks[target] == -1) return;
+  // uncorking pushes out the partial segment
   int one = 1;
   int zero = 0;
   setsockopt(outsocks[target], IPPROTO_TCP, TCP_CORK, &zero, sizeof(zero));
-  setsockopt(outsocks[target], IPPROTO_TCP, TCP_CORK, &one, sizeof(one)); */
+  setsockopt(outsocks[target], IPPROTO_TCP, TCP_CORK, &one, sizeof(one));
+  #endif
 }
 void dc_tcp_comm::new_socket(int newsock, sockaddr_in* otheraddr, procid_t id) {
   // figure out the address of the incoming connection
@@ -263,9 +295,7 @@ void dc_tcp_comm::new_socket(int newsock, sockaddr_in* otheraddr, procid_t id) {
                         << "from machine " << id << std::endl;
   
   handlers[id] = new socket_handler(*this, newsock, (procid_t)id);
-  if (handlerthreads[id] != NULL) delete handlerthreads[id];
-  handlerthreads[id] = new thread();
-  handlerthreads[id]->launch(boost::bind(&socket_handler::run, handlers[id]));
+  iohandlers[id % iohandlers.size()]->add(handlers[id]);
 }
 
 
@@ -344,6 +374,12 @@ void dc_tcp_comm::connect(size_t target) {
     if (!success) {
       logstream(LOG_FATAL) << "Failed to establish connection" << std::endl;
     }
+    #ifdef TCP_CORK
+    if (corked) {
+      int one = 1;
+      setsockopt(newsock, IPPROTO_TCP, TCP_CORK, &one, sizeof(one));
+    }
+    #endif
     // remember the socket
     outsocks[target] = newsock;
     logstream(LOG_INFO) << "connection from " << curid << " to " << target
@@ -354,50 +390,169 @@ void dc_tcp_comm::connect(size_t target) {
 
 
 
-void dc_tcp_comm::socket_handler::run() {
+bool dc_tcp_comm::socket_handler::receive(char* overflow, size_t overflowlen) {
   // get a direct pointer to my receiver
   dc_receive* receiver = owner.receiver[sourceid];
-  
-  if (receiver->direct_access_support()) {
-    // we have direct buffer access!
-    size_t buflength;
-    char *c = receiver->get_buffer(buflength);
-    while(1) {      
-      ssize_t msglen = recv(fd, c, buflength, 0);
-      // if msglen == 0, the scoket is closed
-      if (msglen <= 0) {
-        owner.socks[sourceid] = -1;
-        // self deleting
-        delete this;
-        break;
+  // read until the socket is drained, but give the other sockets 
+  // of the thread a turn eventually
+  for (size_t round = 0; round < 16; ++round) {
+    ssize_t msglen;
+    size_t capacity;
+    if (receiver->direct_access_support()) {
+      // we have direct buffer access!
+      // Anything beyond the receiver's buffer lands in the
+      // overflow buffer and is copied in after.
+      if (c == NULL) c = receiver->get_buffer(buflength);
+      struct iovec vec[2];
+      vec[0].iov_base = c;
+      vec[0].iov_len = buflength;
+      vec[1].iov_base = overflow;
+      vec[1].iov_len = overflowlen;
+      capacity = buflength + overflowlen;
+      msglen = readv(fd, vec, 2);
+      if (msglen > 0) {
+        owner.network_bytesreceived.inc(msglen);
+        #ifdef COMM_DEBUG
+        logstream(LOG_INFO) << msglen << " bytes <-- " << sourceid  << std::endl;
+        #endif
+        size_t direct = std::min((size_t)msglen, buflength);
+        size_t spilled = msglen - direct;
+        c = receiver->advance_buffer(c, direct, buflength);
+        const char* src = overflow;
+        while (spilled > 0) {
+          size_t len = std::min(spilled, buflength);
+          memcpy(c, src, len);
+          c = receiver->advance_buffer(c, len, buflength);
+          src += len;
+          spilled -= len;
+        }
+      }
+    }
+    else {
+      // fall back to using the overflow buffer
+      capacity = overflowlen;
+      msglen = recv(fd, overflow, overflowlen, 0);
+      if (msglen > 0) {
+        #ifdef COMM_DEBUG
+        logstream(LOG_INFO) << msglen << " bytes <-- " << sourceid  << std::endl;
+        #endif
+        owner.network_bytesreceived.inc(msglen);
+        receiver->incoming_data(sourceid, overflow, msglen);
       }
-      owner.network_bytesreceived.inc(msglen);
-      #ifdef COMM_DEBUG
-      logstream(LOG_INFO) << msglen << " bytes <-- " << sourceid  << std::endl;
-      #endif
-      c = receiver->advance_buffer(c, msglen, buflength);
     }
+    // if msglen == 0, the socket is closed
+    if (msglen == 0) return false;
+    // the receiver could not decode the stream
+    if (receiver->failed()) return false;
+    if (msglen < 0) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    // a short read means there is nothing more for now
+    if ((size_t)msglen < capacity) break;
   }
-  else {
-    // fall back to using my own buffer
-    while(1) {
-      char c[10240];
-      
-      ssize_t msglen = recv(fd, c, 10240, 0);
-      // if msglen == 0, the scoket is closed
-      if (msglen <= 0) {
-        owner.socks[sourceid] = -1;
-        // self deleting
-        delete this;
-        break;
+  return true;
+}
+
+
+dc_tcp_comm::io_handler::io_handler(dc_tcp_comm& owner, size_t bufsize):
+                                    owner(owner), epollfd(-1), overflow(bufsize) {
+  #ifdef __linux__
+  epollfd = epoll_create(16);
+  ASSERT_GE(epollfd, 0);
+  // the wake pipe has a NULL handler
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  ASSERT_EQ(epoll_ctl(epollfd, EPOLL_CTL_ADD, owner.wakepipe[0], &ev), 0);
+  #endif
+}
+
+dc_tcp_comm::io_handler::~io_handler() {
+  for (size_t i = 0;i < sockhandlers.size(); ++i) delete sockhandlers[i];
+  if (epollfd >= 0) ::close(epollfd);
+}
+
+void dc_tcp_comm::io_handler::add(socket_handler* handler) {
+  fcntl(handler->fd, F_SETFL, fcntl(handler->fd, F_GETFL) | O_NONBLOCK);
+  lock.lock();
+  sockhandlers.push_back(handler);
+  lock.unlock();
+  #ifdef __linux__
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = handler;
+  ASSERT_EQ(epoll_ctl(epollfd, EPOLL_CTL_ADD, handler->fd, &ev), 0);
+  #endif
+}
+
+void dc_tcp_comm::io_handler::remove(socket_handler* handler) {
+  #ifdef __linux__
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, handler->fd, NULL);
+  #endif
+  lock.lock();
+  sockhandlers.erase(std::find(sockhandlers.begin(), sockhandlers.end(), 
+                               handler));
+  lock.unlock();
+  owner.socks[handler->sourceid] = -1;
+  owner.handlers[handler->sourceid] = NULL;
+  ::close(handler->fd);
+  delete handler;
+}
+
+void dc_tcp_comm::io_handler::run() {
+  #ifdef __linux__
+  struct epoll_event events[64];
+  while(1) {
+    int n = epoll_wait(epollfd, events, 64, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      logstream(LOG_ERROR) << "epoll_wait: " << strerror(errno) << std::endl;
+      break;
+    }
+    bool quit = false;
+    for (int i = 0;i < n; ++i) {
+      socket_handler* handler = (socket_handler*)(events[i].data.ptr);
+      if (handler == NULL) quit = true;
+      else if (!handler->receive(&(overflow[0]), overflow.size())) remove(handler);
+    }
+    if (quit) break;
+  }
+  #else
+  // poll the sockets instead. Sockets added while we wait are picked
+  // up after the timeout
+  std::vector<socket_handler*> polled;
+  std::vector<pollfd> pfds;
+  while(1) {
+    lock.lock();
+    polled = sockhandlers;
+    lock.unlock();
+    pfds.resize(polled.size() + 1);
+    pfds[0].fd = owner.wakepipe[0];
+    pfds[0].events = POLLIN;
+    pfds[0].revents = 0;
+    for (size_t i = 0;i < polled.size(); ++i) {
+      pfds[i + 1].fd = polled[i]->fd;
+      pfds[i + 1].events = POLLIN;
+      pfds[i + 1].revents = 0;
+    }
+    int n = poll(&(pfds[0]), pfds.size(), 100);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      logstream(LOG_ERROR) << "poll: " << strerror(errno) << std::endl;
+      break;
+    }
+    if (pfds[0].revents) break;
+    for (size_t i = 0;i < polled.size(); ++i) {
+      if (pfds[i + 1].revents &&
+          !polled[i]->receive(&(overflow[0]), overflow.size())) {
+        remove(polled[i]);
       }
-      #ifdef COMM_DEBUG
-      logstream(LOG_INFO) << msglen << " bytes <-- " << sourceid  << std::endl;
-      #endif
-      owner.network_bytesreceived.inc(msglen);
-      receiver->incoming_data(sourceid, c, msglen);
     }
   }
+  #endif
 }
 
 
@@ -25,6 +25,7 @@
 #define DC_TCP_COMM_HPP
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 
 #include <vector>
@@ -62,7 +63,12 @@ class dc_tcp_comm:public dc_comm_base {
    attached receiver
    
    machines: a vector of strings where each string is of the form [IP]:[portnumber]
-   initopts: unused
+   initopts: options. Those used are
+             comm_threads=N     Number of receiving threads. Defaults to
+                                one for every 16 machines, at most 8.
+             recv_buffer=BYTES  Size of the receive buffer of each
+                                receiving thread. Defaults to 1MB.
+             tcp_cork=yes       Hold back sends until flush()
    curmachineid: The ID of the current machine. machines[curmachineid] will be 
                  the listening address of this machine
    
@@ -115,7 +121,11 @@ class dc_tcp_comm:public dc_comm_base {
     return network_bytesreceived.value;
   }
  
-  /// Flushes the TCP stream. \note Not Implemented.
+  /**
+   * Flushes the TCP stream. Only has an effect with the "tcp_cork"
+   * option, where data is held back until flush() so that small sends
+   * are coalesced into full segments.
+   */
   void flush(size_t target);
   
   /**
@@ -136,17 +146,52 @@ class dc_tcp_comm:public dc_comm_base {
              const char* buf2, const size_t len2); 
   
   
-  // receiving socket handler
+  /**
+   * The receiving state of one incoming socket. A socket is served by
+   * a single io_handler so the state is never accessed concurrently.
+   */
   class socket_handler {
    public:
     dc_tcp_comm &owner;
     int fd;
     procid_t sourceid;
-    socket_handler(dc_tcp_comm& owner, int fd, procid_t id):owner(owner), fd(fd), sourceid(id) {}
+    /// the current receive window given by a direct access receiver
+    char* c;
+    size_t buflength;
+    socket_handler(dc_tcp_comm& owner, int fd, procid_t id):
+              owner(owner), fd(fd), sourceid(id), c(NULL), buflength(0) {}
     
-    void run();
+    /**
+     * Reads everything available on the socket, using overflow as
+     * scratch space. Returns false if the socket was closed.
+     */
+    bool receive(char* overflow, size_t overflowlen);
   };
   
+  /**
+   * A receiving thread. Waits for data on the sockets assigned to it
+   * (with epoll on linux) and reads them in turn.
+   */
+  class io_handler {
+   public:
+    dc_tcp_comm &owner;
+    int epollfd;
+    /// sockets served by this thread
+    std::vector<socket_handler*> sockhandlers;
+    /// protects sockhandlers
+    mutex lock;
+    /// scratch receive buffer shared by the sockets of this thread
+    std::vector<char> overflow;
+    
+    io_handler(dc_tcp_comm& owner, size_t bufsize);
+    ~io_handler();
+    /// starts serving the socket
+    void add(socket_handler* handler);
+    /// stops serving the socket and deletes the handler
+    void remove(socket_handler* handler);
+    void run();
+  };
+
   // listening socket handler
   class accept_handler {
    public:
@@ -175,6 +220,10 @@ class dc_tcp_comm:public dc_comm_base {
 
   /// wrapper around the standard send. but loops till the buffer is all sent
   int sendtosock(int sockfd, const char* buf, size_t len);
+
+  /// Like sendtosock, but sends a sequence of buffers with one sendmsg
+  /// call where possible. vec is modified.
+  int sendvtosock(int sockfd, struct iovec* vec, size_t veclen);
   
   /** checks for the existance of an outgoing connectino to the target
    if none exists, it will create one
@@ -202,7 +251,15 @@ class dc_tcp_comm:public dc_comm_base {
   /// If socks[i] == int(-1) then the sock is invalid
   std::vector<int> socks; 
   std::vector<socket_handler*> handlers;
-  std::vector<thread*> handlerthreads;
+
+  /// the receiving threads. socket i is served by iohandlers[i % size]
+  std::vector<io_handler*> iohandlers;
+  std::vector<thread*> iothreads;
+  /// written to on close() to wake up the receiving threads
+  int wakepipe[2];
+  
+  /// whether outgoing sockets are corked until flush()
+  bool corked;
   
   std::vector<int> outsocks; 
   
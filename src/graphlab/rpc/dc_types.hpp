@@ -34,7 +34,8 @@ namespace graphlab {
    */
   enum dc_comm_type {
     TCP_COMM,   ///< TCP/IP
-    SCTP_COMM   ///< SCTP (limited support)
+    SCTP_COMM,  ///< SCTP (limited support)
+    SHM_COMM    ///< Shared memory within a host, TCP/IP between hosts
   };
 };
 #include <graphlab/rpc/dc_packet_mask.hpp>
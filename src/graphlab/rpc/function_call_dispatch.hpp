@@ -61,9 +61,8 @@ template<typename DcType,
         typename T0> void DISPATCH1 (DcType& dc, 
                                      procid_t source, 
                                      unsigned char packet_type_mask, 
-                                     std::istream &strm)
+                                     iarchive &iarc)
 {
-    iarchive iarc(strm);
     size_t s;
     iarc >> s;
     F f = reinterpret_cast<F>(s);
@@ -93,8 +92,7 @@ avoiding problems with circular references.
 #define DISPATCH_GENERATOR(Z,N,_) \
 template<typename DcType, typename F  BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 void BOOST_PP_CAT(DISPATCH,N) (DcType& dc, procid_t source, unsigned char packet_type_mask, \
-               std::istream &strm) { \
-  iarchive iarc(strm); \
+               iarchive &iarc) { \
   size_t s; iarc >> s; F f = reinterpret_cast<F>(s); \
   BOOST_PP_REPEAT(N, GENPARAMS, _)                \
   f(dc, source BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_)  ); \
@@ -122,9 +120,8 @@ template<typename DcType,
         typename T0> void NONINTRUSIVE_DISPATCH1 (DcType& dc, 
                                                 procid_t source, 
                                                 unsigned char packet_type_mask, 
-                                                std::istream &strm)
+                                                iarchive &iarc)
 {
-    iarchive iarc(strm);
     size_t s;
     iarc >> s;
     F f = reinterpret_cast<F>(s);
@@ -148,8 +145,7 @@ template<typename DcType,
 #define NONINTRUSIVE_DISPATCH_GENERATOR(Z,N,_) \
 template<typename DcType, typename F  BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 void BOOST_PP_CAT(NONINTRUSIVE_DISPATCH,N) (DcType& dc, procid_t source, unsigned char packet_type_mask,  \
-               std::istream &strm) { \
-  iarchive iarc(strm); \
+               iarchive &iarc) { \
   size_t s; iarc >> s; F f = reinterpret_cast<F>(s); \
   BOOST_PP_REPEAT(N, GENPARAMS, _)                \
   f(BOOST_PP_ENUM(N,GENARGS ,_)  ); \
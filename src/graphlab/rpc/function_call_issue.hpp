@@ -101,14 +101,12 @@ template<typename F , typename T0> class remote_call_issue1
                             F remote_function , 
                             const T0 &i0 )
     {
-        boost::iostreams::stream<resizing_array_sink> strm(128);
-        oarchive arc(strm);
+        oarchive& arc = get_thread_local_oarchive();
         dispatch_type d = function_call_issue_detail::dispatch_selector1<typename is_rpc_call<F>::type, F , T0 >::dispatchfn();
         arc << reinterpret_cast<size_t>(d);
         arc << reinterpret_cast<size_t>(remote_function);
         arc << i0;
-        strm.flush();
-        sender->send_data(target,flags , strm->str, strm->len);
+        sender->send_data(target,flags , arc.buf, arc.off);
     }
 };
 
@@ -157,17 +155,15 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
   public: \
   static void exec(dc_send* sender, unsigned char flags, procid_t target, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    boost::iostreams::stream<resizing_array_sink_ref> &strm = get_thread_local_stream();    \
-    oarchive arc(strm);                         \
+    oarchive& arc = get_thread_local_oarchive();    \
     dispatch_type d = BOOST_PP_CAT(function_call_issue_detail::dispatch_selector,N)<typename is_rpc_call<F>::type, F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, T) >::dispatchfn();   \
     arc << reinterpret_cast<size_t>(d);       \
     arc << reinterpret_cast<size_t>(remote_function); \
     BOOST_PP_REPEAT(N, GENARC, _)                \
-    strm.flush();           \
     if (reinterpret_cast<size_t>(remote_function) == reinterpret_cast<size_t>(reply_increment_counter)) { \
       flags |= REPLY_PACKET; \
     } \
-    sender->send_data(target,flags , strm->c_str(), strm->size());    \
+    sender->send_data(target,flags , arc.buf, arc.off);    \
   }\
 }; 
 
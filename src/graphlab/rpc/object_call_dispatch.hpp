@@ -52,9 +52,8 @@ template<typename DcType,
         void OBJECT_NONINTRUSIVE_DISPATCH1 (DcType& dc, 
                                           procid_t source, 
                                           unsigned char packet_type_mask, 
-                                          std::istream &strm)
+                                          iarchive &iarc)
 {
-    iarchive iarc(strm);
     F f;
     deserialize(iarc, (char*)(&f), sizeof(F));
     size_t objid;
@@ -96,8 +95,7 @@ template<typename DcType,
   void BOOST_PP_CAT(OBJECT_NONINTRUSIVE_DISPATCH,N)(DcType& dc,         \
                                                     procid_t source,    \
                                                     unsigned char packet_type_mask, \
-                                                    std::istream& strm){ \
-    iarchive iarc(strm);                                                \
+                                                    iarchive &iarc){ \
     F f;                                                                \
     deserialize(iarc, (char*)(&f), sizeof(F));                          \
     size_t objid;                                                       \
@@ -62,9 +62,8 @@ template<typename DcType,
         void OBJECT_NONINTRUSIVE_REQUESTDISPATCH1 (DcType& dc, 
                                                     procid_t source, 
                                                     unsigned char packet_type_mask, 
-                                                    std::istream &strm)
+                                                    iarchive &iarc)
 {
-    iarchive iarc(strm);
     F f;
     deserialize(iarc, (char*)(&f), sizeof(F));
     size_t objid;
@@ -120,8 +119,7 @@ template<typename DcType,
   void BOOST_PP_CAT(OBJECT_NONINTRUSIVE_REQUESTDISPATCH,N) (DcType& dc, \
                                                             procid_t source, \
                                                             unsigned char packet_type_mask, \
-                                                            std::istream &strm) { \
-    iarchive iarc(strm);                                                \
+                                                            iarchive &iarc) { \
     F f;                                                                \
     deserialize(iarc, (char*)(&f), sizeof(F));                          \
     size_t objid;                                                       \
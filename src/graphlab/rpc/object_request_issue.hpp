@@ -30,6 +30,7 @@
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/reply_increment_counter.hpp>
+#include <graphlab/rpc/request_future.hpp>
 #include <graphlab/rpc/object_request_dispatch.hpp>
 #include <graphlab/rpc/function_ret_type.hpp>
 #include <graphlab/rpc/mem_function_arg_types_def.hpp>
@@ -69,8 +70,7 @@ template<typename T,
                 ::type>::result_type>::type>::type>::type 
                 exec(dc_send* sender, unsigned char flags, procid_t target,size_t objid, F remote_function , const T0 &i0 )
     {
-        boost::iostreams::stream<resizing_array_sink> strm(128);
-        oarchive arc(strm);
+        oarchive& arc = get_thread_local_oarchive();
         reply_ret_type reply(1);
         dispatch_type d = dc_impl::OBJECT_NONINTRUSIVE_REQUESTDISPATCH1<distributed_control,T,F , T0 >;
         arc << reinterpret_cast<size_t>(d);
@@ -78,11 +78,9 @@ template<typename T,
         arc << objid;
         arc << reinterpret_cast<size_t>(&reply);
         arc << i0;
-        strm.flush();
-        sender->send_data(target, flags, strm->str, strm->len);
+        sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);
         reply.wait();
-        boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);
-        iarchive iarc(retstrm);
+        iarchive iarc(reply.val.c, reply.val.len);
         typename function_ret_type<
             typename boost::remove_const<
             typename boost::remove_reference<
@@ -103,8 +101,7 @@ template<typename T,typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, type
 class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
   public: \
   static typename function_ret_type<__GLRPC_FRESULT>::type exec(dc_dist_object_base* rmi, dc_send* sender, unsigned char flags, procid_t target,size_t objid, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    boost::iostreams::stream<resizing_array_sink_ref> &strm = get_thread_local_stream();    \
-    oarchive arc(strm);                         \
+    oarchive& arc = get_thread_local_oarchive();    \
     reply_ret_type reply(REQUEST_WAIT_METHOD);      \
     dispatch_type d = BOOST_PP_CAT(dc_impl::OBJECT_NONINTRUSIVE_REQUESTDISPATCH,N)<distributed_control,T,F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N, GENT ,_) >;  \
     arc << reinterpret_cast<size_t>(d);       \
@@ -112,13 +109,11 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
     arc << objid;       \
     arc << reinterpret_cast<size_t>(&reply);       \
     BOOST_PP_REPEAT(N, GENARC, _)                \
-    strm.flush();           \
-    sender->send_data(target, flags, strm->c_str(), strm->size());    \
+    sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);    \
     if ((flags & CONTROL_PACKET) == 0)                       \
-      rmi->inc_bytes_sent(target, strm->size());           \
+      rmi->inc_bytes_sent(target, arc.off);           \
     reply.wait(); \
-    boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);  \
-    iarchive iarc(retstrm);  \
+    iarchive iarc(reply.val.c, reply.val.len);  \
     typename function_ret_type<__GLRPC_FRESULT>::type result; \
     iarc >> result;  \
     reply.val.free(); \
@@ -129,11 +124,39 @@ class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
 BOOST_PP_REPEAT(6, REMOTE_REQUEST_ISSUE_GENERATOR,  object_request_issue )
 
 
+/**
+The future version of the object request issue. The reply goes to a
+future_state on the heap and the issue returns without waiting for it.
+*/
+#define FUTURE_REQUEST_ISSUE_GENERATOR(Z,N,FNAME_AND_CALL) \
+template<typename T,typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
+class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
+  public: \
+  static request_future<typename function_ret_type<__GLRPC_FRESULT>::type> exec(dc_dist_object_base* rmi, dc_send* sender, unsigned char flags, procid_t target,size_t objid, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
+    oarchive& arc = get_thread_local_oarchive();    \
+    future_state* reply = new future_state;      \
+    dispatch_type d = BOOST_PP_CAT(dc_impl::OBJECT_NONINTRUSIVE_REQUESTDISPATCH,N)<distributed_control,T,F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N, GENT ,_) >;  \
+    arc << reinterpret_cast<size_t>(d);       \
+    serialize(arc, (char*)(&remote_function), sizeof(remote_function)); \
+    arc << objid;       \
+    arc << reinterpret_cast<size_t>(static_cast<reply_ret_type*>(reply));       \
+    BOOST_PP_REPEAT(N, GENARC, _)                \
+    sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);    \
+    if ((flags & CONTROL_PACKET) == 0)                       \
+      rmi->inc_bytes_sent(target, arc.off);           \
+    return request_future<typename function_ret_type<__GLRPC_FRESULT>::type>(reply);  \
+  }\
+};
+
+BOOST_PP_REPEAT(6, FUTURE_REQUEST_ISSUE_GENERATOR,  object_future_request_issue )
+
+
 
 #undef GENARC
 #undef GENT
 #undef GENARGS
 #undef REMOTE_REQUEST_ISSUE_GENERATOR
+#undef FUTURE_REQUEST_ISSUE_GENERATOR
   
   
 } // namespace dc_impl
@@ -24,6 +24,7 @@
 #ifndef PORTABLE_HPP
 #define PORTABLE_HPP
 
+#include <stdint.h>
 #include <string>
 #include <graphlab/util/generics/any.hpp>
 #include <graphlab/rpc/function_arg_types_def.hpp>
@@ -35,15 +36,40 @@ namespace graphlab {
 \ingroup rpc
 Defines a simple macro called PORTABLE which is used to wrap
 a function name when issuing a portable call. 
+
+Only portable calls can be exchanged between different binaries.
+The regular calls still send the address of the dispatch function,
+which is only valid if all machines run the same binary.
 */  
 #define PORTABLE(f) graphlab::portable_call<typeof(f)*>(BOOST_PP_STRINGIZE(f)) 
 
+/// Set in the call id of a portable request on the wire
+const uint32_t PORTABLE_REQUEST_BIT = 0x80000000u;
+
+/**
+\ingroup rpc_internal
+Returns the id of the portable call to the function called name.
+This is the 32 bit FNV-1a hash of the name without the top bit (which
+flags requests on the wire), so all binaries agree on the ids without
+exchanging them. The id is never 0. 
+*/
+inline uint32_t portable_call_id(const char* name) {
+  uint32_t h = 2166136261u;
+  for (; *name != 0; ++name) {
+    h ^= (unsigned char)(*name);
+    h *= 16777619u;
+  }
+  h &= ~PORTABLE_REQUEST_BIT;
+  return h == 0 ? 1 : h;
+}
+
 template <typename F>
 struct portable_call{
   typedef F f_type;
-  portable_call(){}
-  portable_call(std::string c): fname(c) {}
-  std::string fname;
+  portable_call(): id(0) {}
+  portable_call(const char* c): id(portable_call_id(c)) {}
+  portable_call(const std::string& c): id(portable_call_id(c.c_str())) {}
+  uint32_t id;
 };
 
 } // makespace graphlab
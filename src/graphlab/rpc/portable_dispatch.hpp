@@ -55,8 +55,9 @@ of the find_dispatch class.
 Otherwise, it instantiates a PORTABLE_REQUESTDISPATCH function which sends back the 
 return value of the function.
 
-Finally, the macro inserts the pointer to the dispatch function into a hashmap in the 
-distributed_control class.
+Finally, the macro inserts the pointers to the dispatch functions into the
+portable_dispatch_table of the distributed_control class, under the id
+portable_call_id() computes from the function name.
 */
 namespace graphlab {
 
@@ -75,8 +76,8 @@ template arguments are
 */
 template<typename F, typename Fret, size_t Nargs, F f, typename IsRPCCall>
 struct find_dispatcher{
-  static void* dispatch_call_fn() { return NULL; }
-  static void* dispatch_request_fn() { return NULL; }
+  static dispatch_type dispatch_call_fn() { return NULL; }
+  static dispatch_type dispatch_request_fn() { return NULL; }
 };
 };
 
@@ -93,8 +94,7 @@ struct find_dispatcher{
 #define PORTABLE_DISPATCH_GENERATOR(Z,N,_) \
 template<typename DcType, typename F, F f  BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 void BOOST_PP_CAT(PORTABLEDISPATCH,N) (DcType& dc, procid_t source, unsigned char packet_type_mask, \
-               std::istream &strm) { \
-  iarchive iarc(strm); \
+               iarchive &iarc) { \
   BOOST_PP_REPEAT(N, GENPARAMS, _)                \
   f(dc, source BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_)  ); \
   BOOST_PP_REPEAT(N, CHARSTRINGFREE, _)                \
@@ -102,8 +102,7 @@ void BOOST_PP_CAT(PORTABLEDISPATCH,N) (DcType& dc, procid_t source, unsigned cha
 \
 template<typename DcType, typename F, F f  BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 void BOOST_PP_CAT(PORTABLE_REQUESTDISPATCH,N) (DcType& dc, procid_t source, unsigned char packet_type_mask, \
-               std::istream &strm) { \
-  iarchive iarc(strm); \
+               iarchive &iarc) { \
   size_t id; iarc >> id;                        \
   BOOST_PP_REPEAT(N, GENPARAMS, _)                \
   typename function_ret_type<__GLRPC_FRESULT>::type ret = function_ret_type<__GLRPC_FRESULT>::BOOST_PP_CAT(fcall, BOOST_PP_ADD(N, 2))   \
@@ -123,8 +122,7 @@ void BOOST_PP_CAT(PORTABLE_REQUESTDISPATCH,N) (DcType& dc, procid_t source, unsi
 \
 template<typename DcType, typename F, F f  BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 void BOOST_PP_CAT(PORTABLE_NONINTRUSIVE_DISPATCH,N) (DcType& dc, procid_t source, unsigned char packet_type_mask, \
-               std::istream &strm) { \
-  iarchive iarc(strm); \
+               iarchive &iarc) { \
   BOOST_PP_REPEAT(N, GENPARAMS, _)                \
   f(BOOST_PP_ENUM(N,GENNIARGS ,_)  ); \
   BOOST_PP_REPEAT(N, CHARSTRINGFREE, _)                \
@@ -132,8 +130,7 @@ void BOOST_PP_CAT(PORTABLE_NONINTRUSIVE_DISPATCH,N) (DcType& dc, procid_t source
 \
 template<typename DcType, typename F, F f  BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 void BOOST_PP_CAT(PORTABLE_NONINTRUSIVE_REQUESTDISPATCH,N) (DcType& dc, procid_t source, unsigned char packet_type_mask,  \
-               std::istream &strm) { \
-  iarchive iarc(strm); \
+               iarchive &iarc) { \
   size_t id; iarc >> id;                        \
   BOOST_PP_REPEAT(N, GENPARAMS, _)                \
   typename function_ret_type<__GLRPC_FRESULT>::type ret = function_ret_type<__GLRPC_FRESULT>::BOOST_PP_CAT(fcall, N) \
@@ -50,8 +50,7 @@ Portable Call Formats \n
 The format of a "portable call" packet is in the form of an archive and is as follows
 
 \li size_t(NULL)     -- NULL. Corresponds to the dispatch_type* in the native call
-\li  std::string      -- name of the function to call
-\li  char(0)          -- flag that this is a call
+\li  uint32_t         -- id of the function to call (see portable_call_id())
 \li  fn::arg1_type    -- target function's 1st argument
 \li  fn::arg2_type    -- target function's 2nd argument
 \li ...
@@ -63,8 +62,8 @@ required to know the type of the function (At least through a function prototype
 ---------\n
 The format of a "portable request" packet is in the form of an archive and is as follows
 \li  size_t(NULL)     -- NULL. Corresponds to the dispatch_type* in the native call
-\li  std::string      -- name of the function to call
-\li  char(1)          -- flag that this is a request
+\li  uint32_t         -- id of the function to call, with PORTABLE_REQUEST_BIT set
+\li  size_t           -- the address of the reply_ret_type to complete
 \li  fn::arg1_type    -- target function's 1st argument
 \li  fn::arg2_type    -- target function's 2nd argument
 \li   ...
@@ -87,14 +86,11 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T) > \
   class BOOST_PP_CAT(FNAME_AND_CALL,N)<portable_call<F> BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, T)> { \
    public: \
     static void exec(dc_send* sender, unsigned char flags, procid_t target, portable_call<F> remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_)  ) {   \
-    boost::iostreams::stream<resizing_array_sink_ref> &strm = get_thread_local_stream();    \
-      oarchive arc(strm);                           \
-      arc << 0;       \
-      arc << remote_function.fname;      \
-      arc << char(0);    \
+    oarchive& arc = get_thread_local_oarchive();    \
+      arc << size_t(0);       \
+      arc << remote_function.id;      \
       BOOST_PP_REPEAT(N, GENARC, _)                \
-        strm.flush();                   \
-      sender->send_data(target,  flags, strm->c_str(), strm->size());    \
+      sender->send_data(target,  flags, arc.buf, arc.off);    \
     }  \
   };
 
@@ -108,20 +104,16 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T) > \
   class BOOST_PP_CAT(FNAME_AND_CALL,N)<portable_call<F> BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, T)> { \
    public: \
     static typename function_ret_type<__GLRPC_FRESULT>::type  exec(dc_send* sender, unsigned char flags, procid_t target, portable_call<F> remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_)  ) {   \
-    boost::iostreams::stream<resizing_array_sink_ref> &strm = get_thread_local_stream();    \
-    oarchive arc(strm);                         \
+    oarchive& arc = get_thread_local_oarchive();    \
     reply_ret_type reply(REQUEST_WAIT_METHOD);      \
     size_t fn = 0; \
     arc << fn;       \
-    arc << remote_function.fname; \
-    arc << char(1);       \
+    arc << uint32_t(remote_function.id | PORTABLE_REQUEST_BIT); \
     arc << reinterpret_cast<size_t>(&reply);       \
     BOOST_PP_REPEAT(N, GENARC, _)                \
-    strm.flush();           \
-    sender->send_data(target, flags, strm->c_str(), strm->size());    \
+    sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);    \
     reply.wait(); \
-    boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);    \
-    iarchive iarc(retstrm);  \
+    iarchive iarc(reply.val.c, reply.val.len);    \
     typename function_ret_type<__GLRPC_FRESULT>::type  result; \
     iarc >> result;  \
     reply.val.free(); \
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef RECEIVE_SLAB_HPP
+#define RECEIVE_SLAB_HPP
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc_internal
+ * A reference counted block of received bytes. Deferred calls are
+ * executed directly out of the slab they arrived in: each holds a
+ * reference, and the slab is freed when the receiver has moved on
+ * to a new slab and the last call in it has completed.
+ */
+struct receive_slab {
+  atomic<size_t> refcount;
+  size_t capacity;
+
+  /// Allocates a slab holding capacity bytes with a reference count of 1
+  static receive_slab* create(size_t capacity) {
+    void* mem = malloc(sizeof(receive_slab) + capacity);
+    ASSERT_TRUE(mem != NULL);
+    receive_slab* slab = new (mem) receive_slab;
+    slab->refcount.value = 1;
+    slab->capacity = capacity;
+    return slab;
+  }
+
+  inline char* data() {
+    return reinterpret_cast<char*>(this + 1);
+  }
+
+  inline void acquire() {
+    refcount.inc();
+  }
+
+  inline void release() {
+    if (refcount.dec() == 0) {
+      this->~receive_slab();
+      free(this);
+    }
+  }
+};
+
+
+/**
+ * \ingroup rpc_internal
+ * The receive buffer of a dc_receive. Bytes are written at the tail
+ * of the current slab and complete packets are consumed from the
+ * head. When the slab runs out of room, the unconsumed bytes (at
+ * most one partial packet) move to a fresh slab, or to the front of
+ * the current one if no deferred call still refers to it.
+ *
+ * Not thread safe. The owning receiver serializes access, except
+ * that the bytes between the tail and the end of the slab may be
+ * filled by a recv() while packets are consumed from the head.
+ */
+class receive_slab_buffer {
+ public:
+  /// Packets smaller than this share slabs
+  static const size_t DEFAULT_SLAB_SIZE = 65536;
+  /// The smallest write window handed out
+  static const size_t MIN_WRITE_SIZE = 4096;
+
+  receive_slab_buffer():
+    slab(receive_slab::create(DEFAULT_SLAB_SIZE)), head(0), tail(0) { }
+
+  ~receive_slab_buffer() {
+    slab->release();
+  }
+
+  /// Number of received bytes not yet consumed
+  inline size_t size() const { return tail - head; }
+
+  /// The unconsumed bytes
+  inline const char* read_ptr() const { return slab->data() + head; }
+
+  /// The slab holding read_ptr()
+  inline receive_slab* current_slab() const { return slab; }
+
+  /// Consumes len bytes
+  inline void skip(size_t len) {
+    head += len;
+  }
+
+  /// Reads the header of the next packet if one is buffered
+  inline bool peek_header(packet_hdr& hdr) const {
+    if (size() < sizeof(packet_hdr)) return false;
+    memcpy(&hdr, read_ptr(), sizeof(packet_hdr));
+    return true;
+  }
+
+  /**
+   * Returns the writable window at the tail, making room first if
+   * it is smaller than MIN_WRITE_SIZE or than the pending bytes the
+   * caller still needs to complete its next message.
+   */
+  inline char* write_ptr(size_t& len, size_t pending = 0) {
+    const size_t want = std::max(size_t(MIN_WRITE_SIZE), pending);
+    if (slab->capacity - tail < want) make_room(want);
+    len = slab->capacity - tail;
+    return slab->data() + tail;
+  }
+
+  /**
+   * The number of bytes still missing from the packet at the head,
+   * or 0 if the buffer does not hold a packet header
+   */
+  inline size_t packet_remaining() const {
+    packet_hdr hdr;
+    if (!peek_header(hdr) || sizeof(packet_hdr) + hdr.len <= size()) return 0;
+    return sizeof(packet_hdr) + hdr.len - size();
+  }
+
+  /// Commits len bytes written at write_ptr()
+  inline void advance_write(size_t len) {
+    tail += len;
+    ASSERT_LE(tail, slab->capacity);
+  }
+
+  /// Copies len bytes in at the tail
+  inline void write(const char* c, size_t len) {
+    if (slab->capacity - tail < len) make_room(len);
+    memcpy(slab->data() + tail, c, len);
+    tail += len;
+  }
+
+ private:
+  receive_slab* slab;
+  size_t head;
+  size_t tail;
+
+  /// Makes at least want bytes available after the tail
+  void make_room(size_t want) {
+    const size_t used = size();
+    if (slab->refcount.value == 1 && used + want <= slab->capacity) {
+      // nobody else refers to this slab. Reuse it.
+      memmove(slab->data(), read_ptr(), used);
+    }
+    else {
+      receive_slab* newslab =
+          receive_slab::create(std::max(size_t(DEFAULT_SLAB_SIZE), used + want));
+      memcpy(newslab->data(), read_ptr(), used);
+      slab->release();
+      slab = newslab;
+    }
+    head = 0;
+    tail = used;
+  }
+
+  // not copyable
+  receive_slab_buffer(const receive_slab_buffer&);
+  receive_slab_buffer& operator=(const receive_slab_buffer&);
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
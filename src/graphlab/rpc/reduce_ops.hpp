@@ -0,0 +1,68 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#ifndef GRAPHLAB_RPC_REDUCE_OPS_HPP
+#define GRAPHLAB_RPC_REDUCE_OPS_HPP
+#include <algorithm>
+
+namespace graphlab {
+
+/**
+ * \ingroup rpc
+ * Reduction operators for dc_dist_object::reduce(), all_reduce() and
+ * ring_all_reduce(). An operator is called as op(U& accumulator,
+ * const U& other) and folds other into accumulator. Any function or
+ * functor with this signature may be used, for instance the merge
+ * function of a sync.
+ */
+namespace reduce_ops {
+
+  /// accumulator += other
+  struct sum {
+    template <typename U>
+    void operator()(U& acc, const U& other) const { acc += other; }
+  };
+
+  /// accumulator = max(accumulator, other)
+  struct max {
+    template <typename U>
+    void operator()(U& acc, const U& other) const { acc = std::max(acc, other); }
+  };
+
+  /// accumulator = min(accumulator, other)
+  struct min {
+    template <typename U>
+    void operator()(U& acc, const U& other) const { acc = std::min(acc, other); }
+  };
+
+  /// accumulator = accumulator || other
+  struct logical_or {
+    template <typename U>
+    void operator()(U& acc, const U& other) const { acc = acc || other; }
+  };
+
+} // namespace reduce_ops
+} // namespace graphlab
+#endif
@@ -36,7 +36,12 @@ void reply_increment_counter(distributed_control &dc, procid_t src,
   if (retval == 0 && a->usemutex) {
     a->cond.signal();
   }
+  // read before unlocking. A waiter on the stack may return and 
+  // destroy the reply as soon as the lock is released
+  void (*on_complete)(distributed_control&, dc_impl::reply_ret_type*) =
+    retval == 0 ? a->on_complete : NULL;
   a->mut.unlock();
+  if (on_complete != NULL) on_complete(dc, a);
 }
 
 void stored_increment_counter(distributed_control &dc, procid_t src, 
@@ -87,12 +87,19 @@ struct reply_ret_type{
   bool usemutex;
   mutex mut;
   conditional cond;
+  /**
+   * If not NULL, called by the handler of the last reply after the
+   * waiter has been signalled. Used by request_future which, unlike
+   * a blocked caller, may not be waiting for the reply.
+   */
+  void (*on_complete)(distributed_control& dc, reply_ret_type* reply);
   /**
    * Constructs a reply object which waits for 'retcount' replies.
    * usemutex should always be true
    */
   reply_ret_type(bool usemutex, size_t retcount = 1):flag(retcount), 
-                                                     usemutex(true) { 
+                                                     usemutex(true),
+                                                     on_complete(NULL) { 
   }
   
   ~reply_ret_type() { }
@@ -0,0 +1,56 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/request_future.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+void future_state::complete(distributed_control& dc, reply_ret_type* reply) {
+  future_state* state = static_cast<future_state*>(reply);
+  // the reply is in, so then() will not register a continuation
+  // any more. Take the one registered before, if any
+  state->mut.lock();
+  bool hascontinuation = !state->continuation.empty();
+  state->mut.unlock();
+  if (hascontinuation) {
+    // keep the receiving thread free. The reference of the reply is
+    // passed on to the continuation
+    dc.deferred_local_call(boost::bind(&future_state::run_continuation, state));
+  }
+  else {
+    state->release();
+  }
+}
+
+void future_state::run_continuation() {
+  continuation();
+  continuation.clear();
+  release();
+}
+
+} // namespace dc_impl
+} // namespace graphlab
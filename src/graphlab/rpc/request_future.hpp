@@ -0,0 +1,198 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#ifndef GRAPHLAB_RPC_REQUEST_FUTURE_HPP
+#define GRAPHLAB_RPC_REQUEST_FUTURE_HPP
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/rpc/dc_internal_types.hpp>
+#include <graphlab/rpc/reply_increment_counter.hpp>
+
+namespace graphlab {
+
+class distributed_control;
+
+namespace dc_impl {
+
+/**
+ * \ingroup rpc_internal
+ * The reply of a future request. It is a reply_ret_type on the heap
+ * which is released by the request_future objects refering to it and
+ * by the reply handler, whichever finishes last.
+ */
+struct future_state: public reply_ret_type {
+  /// One reference for the futures and one for the pending reply
+  atomic<size_t> refcount;
+  /// The continuation to run once the reply arrives. Protected by mut
+  boost::function<void (void)> continuation;
+
+  future_state(): reply_ret_type(REQUEST_WAIT_METHOD), refcount(2) {
+    on_complete = complete;
+  }
+
+  inline void acquire() {
+    refcount.inc();
+  }
+
+  inline void release() {
+    if (refcount.dec() == 0) {
+      val.free();
+      delete this;
+    }
+  }
+
+  /**
+   * Called by reply_increment_counter once the reply is stored.
+   * Hands the continuation, if any, to the handler threads.
+   */
+  static void complete(distributed_control& dc, reply_ret_type* reply);
+  
+  /// Runs the continuation and drops the reference of the reply
+  void run_continuation();
+};
+
+} // namespace dc_impl
+
+
+/**
+ * \ingroup rpc
+ * The result of a future_remote_request(). The request is sent
+ * when the future is created and the caller is free to issue more
+ * requests before waiting on any of them, so that N requests cost
+ * one round trip instead of N. Futures may be copied. All copies
+ * refer to the same reply.
+ * 
+ * \code
+ * std::vector<request_future<int> > replies;
+ * for (procid_t i = 0; i < dc.numprocs(); ++i) {
+ *   replies.push_back(dc.future_remote_request(i, get_count));
+ * }
+ * int total = 0;
+ * for (size_t i = 0; i < replies.size(); ++i) total += replies[i]();
+ * \endcode
+ */
+template <typename T>
+class request_future {
+ private:
+  dc_impl::future_state* state;
+  T value;
+  bool hasvalue;
+
+  static void deliver(const boost::function<void (T&)>& fn, 
+                      dc_impl::future_state* state) {
+    T val;
+    iarchive iarc(state->val.c, state->val.len);
+    iarc >> val;
+    fn(val);
+  }
+
+ public:
+  request_future(): state(NULL), hasvalue(false) { }
+
+  /// Takes over one reference to state
+  explicit request_future(dc_impl::future_state* state): 
+    state(state), hasvalue(false) { }
+
+  request_future(const request_future& other): 
+    state(other.state), value(other.value), hasvalue(other.hasvalue) {
+    if (state) state->acquire();
+  }
+
+  request_future& operator=(const request_future& other) {
+    if (other.state) other.state->acquire();
+    if (state) state->release();
+    state = other.state;
+    value = other.value;
+    hasvalue = other.hasvalue;
+    return *this;
+  }
+
+  ~request_future() {
+    if (state) state->release();
+  }
+
+  /// Returns true if the reply has arrived
+  bool is_ready() const {
+    return state == NULL || state->flag.value == 0;
+  }
+
+  /// Blocks until the reply arrives
+  void wait() {
+    if (state) state->wait();
+  }
+
+  /// Waits for the reply and returns the value returned by the remote function
+  T& get() {
+    if (!hasvalue) {
+      wait();
+      ASSERT_TRUE(state != NULL);
+      iarchive iarc(state->val.c, state->val.len);
+      iarc >> value;
+      hasvalue = true;
+    }
+    return value;
+  }
+
+  /// Same as get()
+  T& operator()() {
+    return get();
+  }
+
+  /**
+   * Registers fn to be called with the returned value once the reply
+   * arrives. fn runs on one of the RPC handler threads, and must not
+   * block for long. If the reply has already arrived fn runs
+   * immediately on the calling thread. At most one continuation may
+   * be registered per request.
+   */
+  void then(const boost::function<void (T&)>& fn) {
+    ASSERT_TRUE(state != NULL);
+    state->mut.lock();
+    if (state->flag.value != 0) {
+      ASSERT_TRUE(state->continuation.empty());
+      state->continuation = boost::bind(deliver, fn, state);
+      state->mut.unlock();
+      return;
+    }
+    state->mut.unlock();
+    fn(get());
+  }
+};
+
+
+/**
+ * \ingroup rpc
+ * Waits until the replies of all the futures have arrived
+ */
+template <typename T>
+void wait_all(std::vector<request_future<T> >& futures) {
+  for (size_t i = 0; i < futures.size(); ++i) futures[i].wait();
+}
+
+} // namespace graphlab
+#endif
@@ -30,6 +30,7 @@
 #include <graphlab/rpc/dc_types.hpp>
 #include <graphlab/rpc/dc_internal_types.hpp>
 #include <graphlab/rpc/reply_increment_counter.hpp>
+#include <graphlab/rpc/request_future.hpp>
 #include <graphlab/rpc/request_dispatch.hpp>
 #include <graphlab/rpc/function_ret_type.hpp>
 #include <graphlab/rpc/function_arg_types_def.hpp>
@@ -97,19 +98,16 @@ template<typename F , typename T0> class remote_request_issue1
                   ::type>::type>::type 
       exec(dc_send* sender, unsigned char flags, procid_t target, F remote_function , const T0 &i0 )
     {
-        boost::iostreams::stream<resizing_array_sink> strm(128);
-        oarchive arc(strm);
+        oarchive& arc = get_thread_local_oarchive();
         reply_ret_type reply(1);
         dispatch_type d = request_issue_detail::dispatch_selector1<typename is_rpc_call<F>::type, F , T0 >::dispatchfn();
         arc << reinterpret_cast<size_t>(d);
         arc << reinterpret_cast<size_t>(remote_function);
         arc << reinterpret_cast<size_t>(&reply);
         arc << i0;
-        strm.flush();
-        sender->send_data(target, flags, strm->str, strm->len);
+        sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);
         reply.wait();
-        boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);
-        iarchive iarc(retstrm);
+        iarchive iarc(reply.val.c, reply.val.len);
         typename function_ret_type<
               typename boost::remove_const<
               typename boost::remove_reference<
@@ -153,19 +151,16 @@ template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
 class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
   public: \
   static typename function_ret_type<__GLRPC_FRESULT>::type exec(dc_send* sender, unsigned char flags, procid_t target, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
-    boost::iostreams::stream<resizing_array_sink_ref> &strm = get_thread_local_stream();    \
-    oarchive arc(strm);                         \
+    oarchive& arc = get_thread_local_oarchive();    \
     reply_ret_type reply(REQUEST_WAIT_METHOD);      \
     dispatch_type d = BOOST_PP_CAT(request_issue_detail::dispatch_selector,N)<typename is_rpc_call<F>::type, F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, T) >::dispatchfn();   \
     arc << reinterpret_cast<size_t>(d);       \
     arc << reinterpret_cast<size_t>(remote_function); \
     arc << reinterpret_cast<size_t>(&reply);       \
     BOOST_PP_REPEAT(N, GENARC, _)                \
-    strm.flush();           \
-    sender->send_data(target, flags, strm->c_str(), strm->size());    \
+    sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);    \
     reply.wait(); \
-    boost::iostreams::stream<boost::iostreams::array_source> retstrm(reply.val.c, reply.val.len);    \
-    iarchive iarc(retstrm);  \
+    iarchive iarc(reply.val.c, reply.val.len);    \
     typename function_ret_type<__GLRPC_FRESULT>::type result; \
     iarc >> result;  \
     reply.val.free(); \
@@ -180,11 +175,36 @@ Generates a function call issue. 3rd argument is the issue name
 BOOST_PP_REPEAT(6, REMOTE_REQUEST_ISSUE_GENERATOR,  remote_request_issue )
 
 
+/**
+The future version of the request issue. The reply goes to a
+future_state on the heap and the issue returns without waiting for it.
+*/
+#define FUTURE_REQUEST_ISSUE_GENERATOR(Z,N,FNAME_AND_CALL) \
+template<typename F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, typename T)> \
+class  BOOST_PP_CAT(FNAME_AND_CALL, N) { \
+  public: \
+  static request_future<typename function_ret_type<__GLRPC_FRESULT>::type> exec(dc_send* sender, unsigned char flags, procid_t target, F remote_function BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM(N,GENARGS ,_) ) {  \
+    oarchive& arc = get_thread_local_oarchive();    \
+    future_state* reply = new future_state;      \
+    dispatch_type d = BOOST_PP_CAT(request_issue_detail::dispatch_selector,N)<typename is_rpc_call<F>::type, F BOOST_PP_COMMA_IF(N) BOOST_PP_ENUM_PARAMS(N, T) >::dispatchfn();   \
+    arc << reinterpret_cast<size_t>(d);       \
+    arc << reinterpret_cast<size_t>(remote_function); \
+    arc << reinterpret_cast<size_t>(static_cast<reply_ret_type*>(reply));       \
+    BOOST_PP_REPEAT(N, GENARC, _)                \
+    sender->send_data(target, flags | WAIT_FOR_REPLY, arc.buf, arc.off);    \
+    return request_future<typename function_ret_type<__GLRPC_FRESULT>::type>(reply);  \
+  }\
+}; 
+
+BOOST_PP_REPEAT(6, FUTURE_REQUEST_ISSUE_GENERATOR,  future_request_issue )
+
+
 
 #undef GENARC
 #undef GENT
 #undef GENARGS
 #undef REMOTE_REQUEST_ISSUE_GENERATOR
+#undef FUTURE_REQUEST_ISSUE_GENERATOR
   
   
 } // namespace dc_impl
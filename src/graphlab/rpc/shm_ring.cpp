@@ -0,0 +1,206 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <cstring>
+#include <ctime>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include <graphlab/logger/logger.hpp>
+#include <graphlab/rpc/shm_ring.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+namespace {
+const uint64_t SHM_RING_MAGIC = 0x676c73686d72696eULL;
+/// busy waiting rounds before sleeping
+const size_t SHM_RING_SPINS = 1000;
+/// upper bound on a single sleep, in case a wakeup is lost
+const long SHM_RING_SLEEP_NS = 10000000;
+}
+
+shm_ring* shm_ring::create(const std::string& name, size_t capacity) {
+  size_t cap = 4096;
+  while (cap < capacity) cap *= 2;
+  // remove anything left behind by an earlier run
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    logstream(LOG_FATAL) << "shm_open " << name << ": " 
+                         << strerror(errno) << std::endl;
+  }
+  shm_ring* ring = new shm_ring;
+  ring->name = name;
+  ring->owner = true;
+  ring->maplen = sizeof(shm_ring_header) + cap;
+  ASSERT_EQ(ftruncate(fd, ring->maplen), 0);
+  void* mem = mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE, 
+                   MAP_SHARED, fd, 0);
+  ::close(fd);
+  ASSERT_TRUE(mem != MAP_FAILED);
+  ring->hdr = reinterpret_cast<shm_ring_header*>(mem);
+  ring->data = reinterpret_cast<char*>(ring->hdr + 1);
+  ring->mask = cap - 1;
+  // the segment is zero filled
+  ring->hdr->capacity = cap;
+  ring->hdr->reader_pid = getpid();
+  __sync_synchronize();
+  ring->hdr->magic = SHM_RING_MAGIC;
+  return ring;
+}
+
+shm_ring* shm_ring::attach(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(shm_ring_header)) {
+    ::close(fd);
+    return NULL;
+  }
+  void* mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) return NULL;
+  shm_ring_header* hdr = reinterpret_cast<shm_ring_header*>(mem);
+  // not initialized yet, or left behind by a dead process
+  if (hdr->magic != SHM_RING_MAGIC || hdr->closed || 
+      kill(hdr->reader_pid, 0) != 0 ||
+      sizeof(shm_ring_header) + hdr->capacity != size_t(st.st_size)) {
+    munmap(mem, st.st_size);
+    return NULL;
+  }
+  shm_ring* ring = new shm_ring;
+  ring->name = name;
+  ring->owner = false;
+  ring->maplen = st.st_size;
+  ring->hdr = hdr;
+  ring->data = reinterpret_cast<char*>(hdr + 1);
+  ring->mask = hdr->capacity - 1;
+  return ring;
+}
+
+shm_ring::~shm_ring() {
+  munmap(hdr, maplen);
+  if (owner) shm_unlink(name.c_str());
+}
+
+void shm_ring::futex_wait(volatile int32_t* addr, int32_t expected) {
+  struct timespec ts;
+  ts.tv_sec = 0;
+  ts.tv_nsec = SHM_RING_SLEEP_NS;
+#ifdef __linux__
+  // not FUTEX_PRIVATE: the word is shared between processes
+  syscall(SYS_futex, addr, FUTEX_WAIT, expected, &ts, NULL, 0);
+#else
+  ts.tv_nsec = 100000;
+  if (*addr == expected) nanosleep(&ts, NULL);
+#endif
+}
+
+void shm_ring::futex_wake(volatile int32_t* addr) {
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+}
+
+void shm_ring::write(const char* buf, size_t len) {
+  const uint64_t capacity = hdr->capacity;
+  size_t spins = 0;
+  while (len > 0) {
+    if (hdr->closed) return;
+    const uint64_t tail = hdr->tail;
+    const uint64_t head = hdr->head;
+    const uint64_t space = capacity - (tail - head);
+    if (space == 0) {
+      // full. wait for the reader
+      if (++spins < SHM_RING_SPINS) continue;
+      const int32_t seq = hdr->space_seq;
+      hdr->writer_sleeping = 1;
+      __sync_synchronize();
+      if (hdr->head == head && !hdr->closed) futex_wait(&hdr->space_seq, seq);
+      hdr->writer_sleeping = 0;
+      continue;
+    }
+    spins = 0;
+    const size_t offset = size_t(tail & mask);
+    const size_t n = std::min(len, std::min(size_t(space), 
+                                            size_t(capacity) - offset));
+    memcpy(data + offset, buf, n);
+    // publish the bytes before the new tail
+    __sync_synchronize();
+    hdr->tail = tail + n;
+    buf += n;
+    len -= n;
+    __sync_synchronize();
+    if (hdr->reader_sleeping) {
+      __sync_fetch_and_add(&hdr->data_seq, 1);
+      futex_wake(&hdr->data_seq);
+    }
+  }
+}
+
+void shm_ring::consume(size_t len) {
+  // the bytes must be read before the writer may reuse them
+  __sync_synchronize();
+  hdr->head = hdr->head + len;
+  __sync_synchronize();
+  if (hdr->writer_sleeping) {
+    __sync_fetch_and_add(&hdr->space_seq, 1);
+    futex_wake(&hdr->space_seq);
+  }
+}
+
+bool shm_ring::wait_for_data() {
+  size_t spins = 0;
+  while (hdr->tail == hdr->head) {
+    if (hdr->closed) return false;
+    if (++spins < SHM_RING_SPINS) continue;
+    const int32_t seq = hdr->data_seq;
+    hdr->reader_sleeping = 1;
+    __sync_synchronize();
+    if (hdr->tail == hdr->head && !hdr->closed) futex_wait(&hdr->data_seq, seq);
+    hdr->reader_sleeping = 0;
+  }
+  return true;
+}
+
+void shm_ring::close() {
+  hdr->closed = 1;
+  __sync_synchronize();
+  __sync_fetch_and_add(&hdr->data_seq, 1);
+  futex_wake(&hdr->data_seq);
+  __sync_fetch_and_add(&hdr->space_seq, 1);
+  futex_wake(&hdr->space_seq);
+}
+
+} // namespace dc_impl
+} // namespace graphlab
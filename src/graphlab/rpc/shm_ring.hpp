@@ -0,0 +1,139 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+#ifndef GRAPHLAB_SHM_RING_HPP
+#define GRAPHLAB_SHM_RING_HPP
+#include <stdint.h>
+#include <string>
+#include <algorithm>
+#include <graphlab/logger/assertions.hpp>
+
+namespace graphlab {
+namespace dc_impl {
+
+/**
+ * \ingroup rpc_internal
+ * The shared header at the start of a shm_ring. The reader and the
+ * writer positions count bytes since creation and live on separate
+ * cache lines.
+ */
+struct shm_ring_header {
+  volatile uint64_t magic;
+  uint64_t capacity;
+  volatile int32_t reader_pid;
+  volatile int32_t closed;
+  char pad0[64 - 2 * sizeof(uint64_t) - 2 * sizeof(int32_t)];
+  /// bytes consumed by the reader
+  volatile uint64_t head;
+  volatile int32_t reader_sleeping;
+  /// futex word the reader sleeps on
+  volatile int32_t data_seq;
+  char pad1[64 - sizeof(uint64_t) - 2 * sizeof(int32_t)];
+  /// bytes written by the writer
+  volatile uint64_t tail;
+  volatile int32_t writer_sleeping;
+  /// futex word the writer sleeps on
+  volatile int32_t space_seq;
+  char pad2[64 - sizeof(uint64_t) - 2 * sizeof(int32_t)];
+};
+
+/**
+ * \ingroup rpc_internal
+ * A single reader, single writer byte ring in a POSIX shared memory
+ * object, used by dc_shm_comm between processes on the same host.
+ * The reading process creates the ring and the writing process
+ * attaches to it by name. A side which runs out of data or space
+ * spins briefly and then sleeps on a futex in the shared segment
+ * until the other side wakes it.
+ *
+ * Writes are not synchronized. The caller must make sure that only
+ * one thread writes at a time.
+ */
+class shm_ring {
+ public:
+  /// Creates a ring of capacity bytes (rounded up to a power of 2).
+  static shm_ring* create(const std::string& name, size_t capacity);
+
+  /**
+   * Attaches to a ring created by another process. Returns NULL if
+   * the ring does not exist yet, or was left behind by a process 
+   * which has died.
+   */
+  static shm_ring* attach(const std::string& name);
+
+  /// Unmaps the ring, and removes it if this is the creator
+  ~shm_ring();
+
+  /**
+   * Copies len bytes into the ring, waiting for the reader if it is
+   * full. Returns immediately if the ring has been closed.
+   */
+  void write(const char* buf, size_t len);
+
+  /// Returns the number of contiguous readable bytes, and their location
+  inline size_t readable(const char*& ptr) const {
+    const uint64_t head = hdr->head;
+    const uint64_t avail = hdr->tail - head;
+    // the bytes must be read after tail
+    __sync_synchronize();
+    const size_t offset = size_t(head & mask);
+    ptr = data + offset;
+    return std::min(size_t(avail), size_t(hdr->capacity) - offset);
+  }
+
+  /// Releases len bytes returned by readable() to the writer
+  void consume(size_t len);
+
+  /**
+   * Waits until data is available. Returns false if the ring was
+   * closed instead.
+   */
+  bool wait_for_data();
+
+  /// Marks the ring closed and wakes up both sides
+  void close();
+
+  inline bool is_closed() const { return hdr->closed != 0; }
+
+ private:
+  std::string name;
+  bool owner;
+  size_t maplen;
+  shm_ring_header* hdr;
+  char* data;
+  uint64_t mask;
+
+  shm_ring(): owner(false), maplen(0), hdr(NULL), data(NULL), mask(0) { }
+
+  static void futex_wait(volatile int32_t* addr, int32_t expected);
+  static void futex_wake(volatile int32_t* addr);
+
+  // not copyable
+  shm_ring(const shm_ring&);
+  shm_ring& operator=(const shm_ring&);
+};
+
+} // namespace dc_impl
+} // namespace graphlab
+#endif
@@ -158,12 +158,48 @@ namespace graphlab {
     virtual sched_status::status_enum get_next_task(size_t cpuid, 
                                        update_task_type &ret_task) = 0;
 
+    /**
+     * This function is called by the engine when running in batch
+     * mode to ask for up to max_tasks tasks at once.  The tasks are
+     * returned in ret_tasks, which is cleared first, and the number of
+     * tasks returned is the return value.  Zero means that the
+     * scheduler is empty.
+     *
+     * The default implementation simply calls get_next_task()
+     * repeatedly. Schedulers which can hand out several tasks for the
+     * cost of one (for instance by taking a queue lock only once)
+     * should override this.
+     */
+    virtual size_t get_next_tasks(size_t cpuid,
+                                  std::vector<update_task_type>& ret_tasks,
+                                  size_t max_tasks) {
+      ret_tasks.clear();
+      update_task_type task;
+      while(ret_tasks.size() < max_tasks &&
+            get_next_task(cpuid, task) == sched_status::NEWTASK) {
+        ret_tasks.push_back(task);
+      }
+      return ret_tasks.size();
+    }
+
     /**
      * This is called after a task has been executed
      */
     virtual void completed_task(size_t cpuid, 
                                 const update_task_type &task) = 0;
 
+    /**
+     * This is called after a batch of tasks obtained through
+     * get_next_tasks() has been executed. The default implementation
+     * calls completed_task() on each task.
+     */
+    virtual void completed_tasks(size_t cpuid,
+                                 const std::vector<update_task_type>& tasks) {
+      for(size_t i = 0; i < tasks.size(); ++i) {
+        completed_task(cpuid, tasks[i]);
+      }
+    }
+
 
     /** Installs a listener (done by the engine) */
     virtual void register_monitor(monitor_type* monitor_) { 
@@ -162,6 +162,39 @@ namespace graphlab {
     } // end of get_next_task
 
 
+    /** Get up to max_tasks tasks. Each queue is locked once and as
+        many tasks as possible are taken from it. Other cpus' queues
+        are only looked at if my own queues are empty. */
+    size_t get_next_tasks(size_t cpuid,
+                          std::vector<update_task_type>& ret_tasks,
+                          size_t max_tasks) {
+      ret_tasks.clear();
+      size_t firstown = cpuid * queues_per_cpu;
+      for(size_t i = 0; i < num_queues && ret_tasks.size() < max_tasks; ++i) {
+        // do not steal if my own queues had something
+        if (i == queues_per_cpu && !ret_tasks.empty()) break;
+        size_t queueidx = (firstown + i) % num_queues;
+        taskqueue_t& queue = task_queues[queueidx];
+        if (queue.empty()) continue;
+        queue_locks[queueidx].lock();
+        while (!queue.empty() && ret_tasks.size() < max_tasks) {
+          ret_tasks.push_back(queue.front());
+          queue.pop();
+        }
+        queue_locks[queueidx].unlock();
+        // after stealing from one queue, stop
+        if (i >= queues_per_cpu && !ret_tasks.empty()) break;
+      }
+
+      for(size_t i = 0; i < ret_tasks.size(); ++i) {
+        binary_vertex_tasks.remove(ret_tasks[i]);
+        if (monitor != NULL)
+          monitor->scheduler_task_scheduled(ret_tasks[i], 0.0);
+      }
+      return ret_tasks.size();
+    } // end of get_next_tasks
+
+
     void add_task(update_task_type task, double priority) {
       if (binary_vertex_tasks.add(task)) {
         terminator.new_job();
@@ -225,6 +258,11 @@ namespace graphlab {
       terminator.completed_job();
     }
 
+    void completed_tasks(size_t cpuid,
+                         const std::vector<update_task_type>& tasks) {
+      terminator.completed_jobs(tasks.size());
+    }
+
 
     bool is_task_scheduled(update_task_type task)  {
       return binary_vertex_tasks.get(task);
@@ -0,0 +1,398 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * This class defines a relaxed concurrent priority scheduler in the
+ * style of the MultiQueue of Rihani, Sanders and Dementiev (SPAA
+ * 2015).
+ **/
+#ifndef GRAPHLAB_RELAXED_PRIORITY_SCHEDULER_HPP
+#define GRAPHLAB_RELAXED_PRIORITY_SCHEDULER_HPP
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <graphlab/logger/assertions.hpp>
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/util/mutable_queue.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/schedulers/ischeduler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/schedulers/support/direct_callback.hpp>
+#include <graphlab/schedulers/support/vertex_task_set.hpp>
+#include <graphlab/util/task_count_termination.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup group_schedulers
+   *
+   * A relaxed priority scheduler. Vertices are kept in
+   * queues_per_cpu * ncpus heaps. A task is added to a random heap,
+   * and a thread looking for work compares the top priorities of two
+   * random heaps and pops from the better one. Heaps are only
+   * try-locked while popping, so a busy heap is simply skipped.
+   *
+   * As in the priority_scheduler the tasks on each vertex are kept
+   * in a vertex_task_set. Adding a task which is already scheduled
+   * promotes it to the larger of the two priorities, and the heap
+   * holding the vertex is updated accordingly.
+   *
+   * The order in which tasks are run only approximates the strict
+   * priority order. Every inversion_sample pops, the popped priority
+   * is compared against the best top priority over all heaps, and
+   * the number of inversions and their mean priority gap are
+   * reported in the metrics.
+   */
+  template<typename Graph>
+  class relaxed_priority_scheduler :
+    public ischeduler<Graph> {
+
+  public:
+    typedef Graph graph_type;
+    typedef ischeduler<Graph> base;
+
+    typedef typename base::vertex_id_type vertex_id_type;
+    typedef typename base::iengine_type iengine_type;
+    typedef typename base::update_task_type update_task_type;
+    typedef typename base::update_function_type update_function_type;
+    typedef typename base::callback_type callback_type;
+    typedef typename base::monitor_type monitor_type;
+    typedef task_count_termination terminator_type;
+
+    typedef mutable_queue<vertex_id_type, double> taskqueue_type;
+
+  private:
+    using base::monitor;
+
+    /** One of the heaps together with its lock. top_priority caches
+        the priority of the top of the heap so that it can be read
+        without locking */
+    struct relaxed_queue {
+      taskqueue_type queue;
+      spinlock lock;
+      volatile double top_priority;
+      relaxed_queue() : top_priority(empty_priority()) { }
+      void update_top() {
+        top_priority = queue.empty() ? empty_priority() : queue.top().second;
+      }
+    };
+
+    /** Per cpu counters. Padded to avoid false sharing */
+    struct cpu_counters {
+      size_t pops;
+      size_t sampled;
+      size_t inversions;
+      double inversion_gap;
+      size_t lock_failures;
+      size_t promotions;
+      char pad[64];
+      cpu_counters() : pops(0), sampled(0), inversions(0),
+                       inversion_gap(0), lock_failures(0), promotions(0) { }
+    };
+
+    static double empty_priority() {
+      return -std::numeric_limits<double>::max();
+    }
+
+    /// Marks a vertex which is not known to be in any heap
+    static size_t no_queue() { return size_t(-1); }
+
+  public:
+
+    relaxed_priority_scheduler(iengine_type* engine,
+                               Graph& g,
+                               size_t ncpus) :
+      numvertices(g.local_vertices()), ncpus(ncpus),
+      queues_per_cpu(2), inversion_sample(16),
+      queues(queues_per_cpu * ncpus),
+      location(g.local_vertices(), no_queue()),
+      task_set(g.local_vertices()),
+      callbacks(ncpus, direct_callback<Graph>(this, engine)),
+      counters(ncpus),
+      sched_metrics("relaxed_priority") { }
+
+
+    ~relaxed_priority_scheduler() { }
+
+    callback_type& get_callback(size_t cpuid) {
+      return callbacks[cpuid];
+    }
+
+    void start() {};
+
+    /** Get the next task. Pops from the better of two random heaps,
+        falling back to a scan of all heaps before giving up */
+    sched_status::status_enum get_next_task(size_t cpuid,
+                                            update_task_type &ret_task) {
+      const size_t nqueues = queues.size();
+      cpu_counters& counter = counters[cpuid];
+      vertex_id_type vertex = 0;
+      double queue_priority = 0;
+      double priority = 0;
+      bool found = false;
+      // Stale heap entries (see add_task) are skipped, so loop until a
+      // vertex with a pending task comes out
+      while(!found) {
+        bool popped = false;
+        for(size_t attempt = 0; attempt < 2 * nqueues && !popped; ++attempt) {
+          const size_t prod =
+            random::fast_uniform<size_t>(0, nqueues * nqueues - 1);
+          const size_t r1 = prod / nqueues;
+          const size_t r2 = prod % nqueues;
+          const size_t qidx =
+            queues[r1].top_priority >= queues[r2].top_priority ? r1 : r2;
+          if (queues[qidx].top_priority == empty_priority()) continue;
+          if (!queues[qidx].lock.try_lock()) {
+            counter.lock_failures++;
+            continue;
+          }
+          popped = unsync_pop(qidx, vertex, queue_priority);
+          queues[qidx].lock.unlock();
+        }
+        /* The random probes failed. Look at every heap before
+           declaring the scheduler empty */
+        for(size_t i = 0; i < nqueues && !popped; ++i) {
+          queues[i].lock.lock();
+          popped = unsync_pop(i, vertex, queue_priority);
+          queues[i].lock.unlock();
+        }
+        if (!popped) return sched_status::EMPTY;
+
+        found = task_set.pop(vertex, ret_task, priority);
+        // Put the vertex back if it has more tasks
+        update_task_type new_top_task;
+        double new_priority(0);
+        if (found && task_set.top(vertex, new_top_task, new_priority)) {
+          insert(vertex, new_priority);
+        }
+      }
+
+      if (counter.pops++ % inversion_sample == 0) {
+        counter.sampled++;
+        double best = empty_priority();
+        for(size_t i = 0; i < nqueues; ++i) {
+          best = std::max(best, double(queues[i].top_priority));
+        }
+        if (best > queue_priority) {
+          counter.inversions++;
+          counter.inversion_gap += best - queue_priority;
+        }
+      }
+
+      if (monitor != NULL)
+        monitor->scheduler_task_scheduled(ret_task, priority);
+      return sched_status::NEWTASK;
+    } // end of get_next_task
+
+
+    void add_task(update_task_type task, double priority) {
+      const bool first_add = task_set.add(task, priority);
+      if (first_add) {
+        terminator.new_job();
+      } else {
+        counters[thread::thread_id() % ncpus].promotions++;
+      }
+      insert(task.vertex(), priority);
+      if (monitor != NULL) {
+        if (first_add) {
+          monitor->scheduler_task_added(task, priority);
+        } else {
+          monitor->scheduler_task_pruned(task);
+        }
+      }
+    } // end of add_task
+
+    void add_tasks(const std::vector<vertex_id_type> &vertices,
+                   update_function_type func,
+                   double priority) {
+      foreach(vertex_id_type vertex, vertices) {
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+
+    void add_task_to_all(update_function_type func, double priority)  {
+      for (vertex_id_type vertex = 0; vertex < numvertices; ++vertex){
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+    void completed_task(size_t cpuid, const update_task_type &task) {
+      terminator.completed_job();
+    }
+
+    void print() {
+      std::cout << "SSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSS" << std::endl;
+      std::cout << "Printing task queue sizes: " << std::endl;
+      for(size_t i = 0; i < queues.size(); ++i) {
+        std::cout << queues[i].queue.size() << std::endl;
+      }
+      std::cout << "SSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSS" << std::endl;
+    }
+
+    terminator_type& get_terminator() {
+      return terminator;
+    };
+
+    void set_options(const scheduler_options &opts) {
+      size_t qpc = queues_per_cpu;
+      if (opts.get_int_option("queues_per_cpu", qpc) && qpc != queues_per_cpu) {
+        bool all_empty = true;
+        for(size_t i = 0; i < queues.size(); ++i) {
+          all_empty = all_empty && queues[i].queue.empty();
+        }
+        if (qpc == 0) {
+          logstream(LOG_WARNING) << "queues_per_cpu must be positive"
+                                 << std::endl;
+        } else if (!all_empty) {
+          logstream(LOG_WARNING) << "queues_per_cpu cannot be changed once "
+                                 << "tasks have been added" << std::endl;
+        } else {
+          queues_per_cpu = qpc;
+          queues = std::vector<relaxed_queue>(queues_per_cpu * ncpus);
+        }
+      }
+      size_t sample = inversion_sample;
+      if (opts.get_int_option("inversion_sample", sample)) {
+        inversion_sample = std::max(sample, size_t(1));
+      }
+    }
+
+    static void print_options_help(std::ostream &out) {
+      out << "queues_per_cpu = [integer, default=2]\n";
+      out << "inversion_sample = [integer, measure priority inversion "
+          << "every n pops, default=16]\n";
+    };
+
+    metrics get_metrics() {
+      size_t pops = 0, sampled = 0, inversions = 0;
+      double gap = 0;
+      for(size_t i = 0; i < counters.size(); ++i) {
+        pops += counters[i].pops;
+        sampled += counters[i].sampled;
+        inversions += counters[i].inversions;
+        gap += counters[i].inversion_gap;
+        sched_metrics.add("lock_failures",
+                          (double)counters[i].lock_failures, INTEGER);
+        sched_metrics.add("promotions",
+                          (double)counters[i].promotions, INTEGER);
+      }
+      sched_metrics.set("pops", (double)pops, INTEGER);
+      sched_metrics.set("sampled_pops", (double)sampled, INTEGER);
+      sched_metrics.set("inversions", (double)inversions, INTEGER);
+      sched_metrics.set("inversion_rate",
+                        sampled > 0 ? double(inversions) / sampled : 0.0);
+      sched_metrics.set("mean_inversion_gap",
+                        inversions > 0 ? gap / inversions : 0.0);
+      return sched_metrics;
+    }
+
+    void reset_metrics() {
+      counters = std::vector<cpu_counters>(ncpus);
+      sched_metrics.clear();
+    }
+
+  private:
+
+    /** Pops the top of heap qidx. The heap lock must be held */
+    bool unsync_pop(size_t qidx, vertex_id_type& vertex, double& priority) {
+      relaxed_queue& rq = queues[qidx];
+      if (rq.queue.empty()) return false;
+      std::pair<vertex_id_type, double> top = rq.queue.pop();
+      vertex = top.first;
+      priority = top.second;
+      if (location[vertex] == qidx) location[vertex] = no_queue();
+      rq.update_top();
+      return true;
+    }
+
+    /**
+     * Makes sure that the vertex is in a heap with at least the given
+     * priority. If the heap which last received the vertex still holds
+     * it, the priority is promoted in place. Otherwise the vertex goes
+     * into a random heap. This may leave a vertex in two heaps, in
+     * which case the second entry to come out finds no tasks in the
+     * vertex_task_set and is skipped.
+     */
+    void insert(vertex_id_type vertex, double priority) {
+      const size_t loc = location[vertex];
+      if (loc != no_queue()) {
+        relaxed_queue& rq = queues[loc];
+        rq.lock.lock();
+        if (location[vertex] == loc) {
+          rq.queue.insert_max(vertex, priority);
+          rq.update_top();
+          rq.lock.unlock();
+          return;
+        }
+        rq.lock.unlock();
+      }
+      // Prefer a heap which is not locked
+      size_t qidx = 0;
+      bool locked = false;
+      for(size_t i = 0; i < queues.size() && !locked; ++i) {
+        qidx = random::fast_uniform<size_t>(0, queues.size() - 1);
+        locked = queues[qidx].lock.try_lock();
+      }
+      if (!locked) queues[qidx].lock.lock();
+      relaxed_queue& rq = queues[qidx];
+      rq.queue.insert_max(vertex, priority);
+      location[vertex] = qidx;
+      rq.update_top();
+      rq.lock.unlock();
+    }
+
+    size_t numvertices; /// Remember the number of vertices in the graph
+    size_t ncpus;
+    size_t queues_per_cpu;
+    size_t inversion_sample;
+
+    std::vector<relaxed_queue> queues;
+
+    /// The heap which last received each vertex
+    std::vector<size_t> location;
+
+    /// The tasks and priorities pending on each vertex
+    vertex_task_set<Graph> task_set;
+
+    /// The callbacks pre-created for each cpuid
+    std::vector<direct_callback<Graph> > callbacks;
+
+    task_count_termination terminator;
+
+    std::vector<cpu_counters> counters;
+
+    metrics sched_metrics;
+  };
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
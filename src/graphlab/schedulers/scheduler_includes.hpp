@@ -28,6 +28,8 @@
 #include <graphlab/schedulers/sweep_scheduler.hpp>
 #include <graphlab/schedulers/multiqueue_fifo_scheduler.hpp>
 #include <graphlab/schedulers/multiqueue_priority_scheduler.hpp>
+#include <graphlab/schedulers/work_stealing_scheduler.hpp>
+#include <graphlab/schedulers/relaxed_priority_scheduler.hpp>
 #include <graphlab/schedulers/priority_scheduler.hpp>
 #include <graphlab/schedulers/round_robin_scheduler.hpp>
 #include <graphlab/schedulers/chromatic_scheduler.hpp>
@@ -49,6 +49,14 @@
     "One or more Priority task queues is assigned to each processor, "  \
     "where the queues are stochastically load balanced. Like the "      \
     "priority scheduler, but less predictable, and much faster."))      \
+  (("work_stealing", work_stealing_scheduler,                          \
+    "Each processor owns a lock free deque and pushes the tasks it "    \
+    "creates onto it. Idle processors steal from randomly chosen "      \
+    "processors. Scales better than multiqueue_fifo on many cores."))   \
+  (("relaxed_priority", relaxed_priority_scheduler,                    \
+    "Several try-locked priority queues per processor. Tasks are popped " \
+    "from the better of two random queues, so the priority order is "   \
+    "only approximate, but the scheduler scales with the processors.")) \
   (("splash", splash_scheduler,                                         \
     "Similar to the priority queue scheduler, but allows for only one " \
     "update function. Updates are evaluted in a \"splash\" ordering"))  \
@@ -71,6 +79,8 @@
 #include <graphlab/schedulers/splash_scheduler.hpp>
 #include <graphlab/schedulers/multiqueue_fifo_scheduler.hpp>
 #include <graphlab/schedulers/multiqueue_priority_scheduler.hpp>
+#include <graphlab/schedulers/work_stealing_scheduler.hpp>
+#include <graphlab/schedulers/relaxed_priority_scheduler.hpp>
 #include <graphlab/schedulers/clustered_priority_scheduler.hpp>
 #include <graphlab/graph/graph.hpp>
 
@@ -32,6 +32,7 @@
 
 #include <graphlab/tasks/update_task.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/spin_rwlock.hpp>
 
 
 #include <graphlab/macros_def.hpp>
@@ -57,7 +58,7 @@ namespace graphlab {
     std::vector< vertex_fun_set > task_set;    
     
     /// The accompanying set of locks for the task_set
-    std::vector<spinlock> locks;
+    std::vector<spin_rwlock> locks;
 
     /**
      * Examine a task set for an update function returning true if
@@ -0,0 +1,378 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * This class defines a work stealing scheduler. Each thread owns a
+ * lock free deque. Tasks created by an update function are pushed
+ * onto the deque of the thread running it, and a thread which runs
+ * out of work steals from the deques of randomly chosen threads.
+ **/
+#ifndef GRAPHLAB_WORK_STEALING_SCHEDULER_HPP
+#define GRAPHLAB_WORK_STEALING_SCHEDULER_HPP
+
+#include <deque>
+#include <vector>
+#include <cassert>
+
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/iscope.hpp>
+#include <graphlab/tasks/update_task.hpp>
+#include <graphlab/schedulers/ischeduler.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/work_stealing_deque.hpp>
+#include <graphlab/schedulers/support/direct_callback.hpp>
+#include <graphlab/schedulers/support/binary_vertex_task_set.hpp>
+#include <graphlab/util/task_count_termination.hpp>
+#include <graphlab/metrics/metrics.hpp>
+
+#include <graphlab/macros_def.hpp>
+namespace graphlab {
+
+  /**
+   * \ingroup group_schedulers
+   *
+   * A scheduler built on per thread Chase-Lev deques. The owner of a
+   * deque pushes and pops without locking. Tasks added from outside
+   * of an update function (for instance by add_task_to_all() before
+   * the engine starts) are placed in small spinlock protected
+   * injection queues which are drained by the worker threads.
+   *
+   * Tasks are deduplicated through a binary_vertex_task_set, so a
+   * vertex/update function pair is in the scheduler at most once.
+   */
+  template<typename Graph>
+  class work_stealing_scheduler :
+    public ischeduler<Graph> {
+
+  public:
+    typedef Graph graph_type;
+    typedef ischeduler<Graph> base;
+
+    typedef typename base::vertex_id_type vertex_id_type;
+    typedef typename base::iengine_type iengine_type;
+    typedef typename base::update_task_type update_task_type;
+    typedef typename base::update_function_type update_function_type;
+    typedef typename base::callback_type callback_type;
+    typedef typename base::monitor_type monitor_type;
+
+    typedef work_stealing_deque<update_task_type> task_deque_type;
+    typedef std::deque<update_task_type> injection_queue_type;
+    typedef task_count_termination terminator_type;
+
+  private:
+    using base::monitor;
+
+    /**
+     * The callback handed to the update functions running on a
+     * particular cpu. New tasks go straight to that cpu's deque.
+     */
+    class local_callback : public direct_callback<Graph> {
+      typedef direct_callback<Graph> callback_base;
+      typedef typename callback_base::task_priority_pair task_priority_pair;
+      work_stealing_scheduler* owner;
+      size_t cpuid;
+    public:
+      local_callback(work_stealing_scheduler* owner = NULL,
+                     iengine_type* engine = NULL,
+                     size_t cpuid = 0) :
+        callback_base(owner, engine), owner(owner), cpuid(cpuid) { }
+
+      void add_task(update_task_type task, double priority) {
+        assert(task.function() != NULL);
+        if (!callback_base::buffering_enabled) {
+          owner->add_local_task(cpuid, task, priority);
+        } else {
+          callback_base::tasks.push_back(task_priority_pair(task, priority));
+        }
+      }
+
+      void commit() {
+        if(callback_base::buffering_enabled) {
+          foreach(task_priority_pair tp, callback_base::tasks) {
+            owner->add_local_task(cpuid, tp.first, tp.second);
+          }
+          callback_base::tasks.clear();
+        }
+      }
+    }; // end of local_callback
+
+  public:
+
+    work_stealing_scheduler(iengine_type* engine,
+                            Graph& g,
+                            size_t ncpus) :
+      ncpus(ncpus), deques(ncpus), injection_queues(ncpus),
+      injection_locks(ncpus), injection_sizes(ncpus),
+      binary_vertex_tasks(g.local_vertices()), prunecounter(ncpus, 0),
+      stealcounter(ncpus, 0), sched_metrics("work_stealing") {
+      numvertices = g.local_vertices();
+      callbacks.reserve(ncpus);
+      for (size_t i = 0; i < ncpus; ++i) {
+        deques[i] = new task_deque_type();
+        callbacks.push_back(local_callback(this, engine, i));
+      }
+    }
+
+
+    ~work_stealing_scheduler() {
+      for (size_t i = 0; i < deques.size(); ++i) delete deques[i];
+    }
+
+    callback_type& get_callback(size_t cpuid) {
+      return callbacks[cpuid];
+    }
+
+    void start() {};
+
+    /** Get the next task. Looks at the local deque, then the local
+        injection queue and then tries to steal. */
+    sched_status::status_enum get_next_task(size_t cpuid,
+                                            update_task_type &ret_task) {
+      bool found = deques[cpuid]->pop(ret_task) ||
+        pop_injected(cpuid, ret_task);
+
+      /* Steal from randomly chosen victims */
+      if (!found && ncpus > 1) {
+        for (size_t attempt = 0; attempt < ncpus && !found; ++attempt) {
+          size_t victim = random::fast_uniform(size_t(0), ncpus - 2);
+          if (victim >= cpuid) ++victim;
+          found =
+            deques[victim]->steal(ret_task) == task_deque_type::STEAL_SUCCESS;
+        }
+        if (found) stealcounter[cpuid]++;
+      }
+
+      /* Before declaring the scheduler empty, look at everything. A
+         steal only gives up when a deque is really empty */
+      if (!found) {
+        for (size_t i = 1; i <= ncpus && !found; ++i) {
+          size_t victim = (cpuid + i) % ncpus;
+          typename task_deque_type::steal_status status;
+          do {
+            status = deques[victim]->steal(ret_task);
+          } while(status == task_deque_type::STEAL_ABORT);
+          found = (status == task_deque_type::STEAL_SUCCESS) ||
+            pop_injected(victim, ret_task);
+        }
+        if (found) stealcounter[cpuid]++;
+      }
+
+      if(!found) {
+        return sched_status::EMPTY;
+      }
+
+      binary_vertex_tasks.remove(ret_task);
+
+      if (monitor != NULL)
+        monitor->scheduler_task_scheduled(ret_task, 0.0);
+      return sched_status::NEWTASK;
+    } // end of get_next_task
+
+
+    /** Get up to max_tasks tasks from the local deque, or failing
+        that from the local injection queue. Only a single task is
+        stolen from other cpus. */
+    size_t get_next_tasks(size_t cpuid,
+                          std::vector<update_task_type>& ret_tasks,
+                          size_t max_tasks) {
+      ret_tasks.clear();
+      update_task_type task;
+      while(ret_tasks.size() < max_tasks && deques[cpuid]->pop(task)) {
+        ret_tasks.push_back(task);
+      }
+      if (ret_tasks.empty() && injection_sizes[cpuid].value > 0) {
+        injection_locks[cpuid].lock();
+        while(ret_tasks.size() < max_tasks &&
+              !injection_queues[cpuid].empty()) {
+          ret_tasks.push_back(injection_queues[cpuid].front());
+          injection_queues[cpuid].pop_front();
+          injection_sizes[cpuid].dec();
+        }
+        injection_locks[cpuid].unlock();
+      }
+      if (ret_tasks.empty()) {
+        if (get_next_task(cpuid, task) == sched_status::NEWTASK) {
+          ret_tasks.push_back(task);
+        }
+        return ret_tasks.size();
+      }
+      for(size_t i = 0; i < ret_tasks.size(); ++i) {
+        binary_vertex_tasks.remove(ret_tasks[i]);
+        if (monitor != NULL)
+          monitor->scheduler_task_scheduled(ret_tasks[i], 0.0);
+      }
+      return ret_tasks.size();
+    } // end of get_next_tasks
+
+
+    /** Adds a task from outside of an update function. The task is
+        placed in the injection queue of a random cpu */
+    void add_task(update_task_type task, double priority) {
+      if (binary_vertex_tasks.add(task)) {
+        terminator.new_job();
+        const size_t qidx = random::fast_uniform(size_t(0), ncpus - 1);
+        injection_locks[qidx].lock();
+        injection_queues[qidx].push_back(task);
+        injection_sizes[qidx].inc();
+        injection_locks[qidx].unlock();
+        if (monitor != NULL)
+          monitor->scheduler_task_added(task, priority);
+      } else {
+        prunecounter[thread::thread_id()]++;
+        if (monitor != NULL)
+          monitor->scheduler_task_pruned(task);
+      }
+    }
+
+    /** Adds a task to the deque of cpuid. Must be called by the
+        thread running as cpuid. */
+    void add_local_task(size_t cpuid, update_task_type task,
+                        double priority) {
+      if (binary_vertex_tasks.add(task)) {
+        terminator.new_job();
+        deques[cpuid]->push(task);
+        if (monitor != NULL)
+          monitor->scheduler_task_added(task, priority);
+      } else {
+        prunecounter[cpuid]++;
+        if (monitor != NULL)
+          monitor->scheduler_task_pruned(task);
+      }
+    }
+
+    void add_tasks(const std::vector<vertex_id_type> &vertices,
+                   update_function_type func,
+                   double priority) {
+      foreach(vertex_id_type vertex, vertices) {
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+
+    void add_task_to_all(update_function_type func, double priority)  {
+      for (vertex_id_type vertex = 0; vertex < numvertices; ++vertex){
+        add_task(update_task_type(vertex, func), priority);
+      }
+    }
+
+
+
+    void completed_task(size_t cpuid, const update_task_type &task) {
+      terminator.completed_job();
+    }
+
+    void completed_tasks(size_t cpuid,
+                         const std::vector<update_task_type>& tasks) {
+      terminator.completed_jobs(tasks.size());
+    }
+
+
+    bool is_task_scheduled(update_task_type task)  {
+      return binary_vertex_tasks.get(task);
+    }
+
+
+    void print() {
+      std::cout << "SSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSS" << std::endl;
+      std::cout << "Printing deque and injection queue sizes: " << std::endl;
+      for(size_t i = 0; i < ncpus; ++i) {
+        std::cout << deques[i]->size() << "\t"
+                  << injection_sizes[i].value << std::endl;
+      }
+      std::cout << "SSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSSS" << std::endl;
+    }
+
+    terminator_type& get_terminator() {
+      return terminator;
+    };
+
+    void set_options(const scheduler_options &opts) { }
+
+    metrics get_metrics() {
+      for(size_t i = 0; i < prunecounter.size(); i++) {
+        sched_metrics.add("pruned", (double)prunecounter[i], INTEGER);
+        sched_metrics.add("steals", (double)stealcounter[i], INTEGER);
+      }
+      return sched_metrics;
+    }
+
+    void reset_metrics() {
+      for(size_t i = 0; i < prunecounter.size(); i++) {
+        prunecounter[i] = 0;
+        stealcounter[i] = 0;
+      }
+      sched_metrics.clear();
+    }
+
+
+  private:
+    /** Pops the front of the injection queue of cpu qidx */
+    bool pop_injected(size_t qidx, update_task_type &ret_task) {
+      // cheap check of the counter first, since the deque itself may
+      // only be read under the lock. A stale answer is harmless since
+      // get_next_task will be called again if tasks remain
+      if (injection_sizes[qidx].value == 0) return false;
+      bool found = false;
+      injection_locks[qidx].lock();
+      if (!injection_queues[qidx].empty()) {
+        ret_task = injection_queues[qidx].front();
+        injection_queues[qidx].pop_front();
+        injection_sizes[qidx].dec();
+        found = true;
+      }
+      injection_locks[qidx].unlock();
+      return found;
+    }
+
+    size_t numvertices; /// Remember the number of vertices in the graph
+    size_t ncpus;
+
+    std::vector<task_deque_type*> deques; /// One deque per cpu
+    std::vector<injection_queue_type> injection_queues;
+    std::vector<spinlock> injection_locks;
+    /// The lengths of the injection queues, readable without the lock
+    std::vector<atomic<size_t> > injection_sizes;
+
+    /// The callbacks pre-created for each cpuid
+    std::vector<local_callback> callbacks;
+
+    // Task set for task pruning
+    binary_vertex_task_set<Graph> binary_vertex_tasks;
+
+    // Terminator
+    task_count_termination terminator;
+
+    // Keep track of how many tasks were pruned and stolen.
+    std::vector<size_t> prunecounter;
+    std::vector<size_t> stealcounter;
+
+    metrics sched_metrics;
+  };
+
+
+} // end of namespace graphlab
+#include <graphlab/macros_undef.hpp>
+
+#endif
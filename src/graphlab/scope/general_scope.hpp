@@ -33,6 +33,7 @@
 #ifndef GRAPHLAB_GENERAL_SCOPE_HPP
 #define GRAPHLAB_GENERAL_SCOPE_HPP
 
+#include <vector>
 #include <boost/bind.hpp>
 
 #include <graphlab/scope/iscope.hpp>
@@ -62,14 +63,24 @@ namespace graphlab {
 
     scope_range::scope_range_enum stype;
     iscope_factory<Graph>* factory;
+
+    /** True if this is an optimistic read scope which holds no locks
+        and must be validated before it is released */
+    bool optimistic;
+    /** The number of times the optimistic reads were invalidated */
+    size_t optimistic_failures;
+    /** The vertices read by an optimistic scope and the version each
+        had when the scope was acquired */
+    std::vector<std::pair<vertex_id_type, uint32_t> > read_versions;
   public:
     general_scope() :
-      base(NULL,NULL) { }
+      base(NULL,NULL), optimistic(false), optimistic_failures(0) { }
 
     general_scope(Graph* graph_ptr, vertex_id_type vertex,
                   iscope_factory<Graph>* factory,
                   scope_range::scope_range_enum s = scope_range::USE_DEFAULT) :
-      base(graph_ptr, vertex), stype(s), factory(factory)  {
+      base(graph_ptr, vertex), stype(s), factory(factory),
+      optimistic(false), optimistic_failures(0) {
     }
 
     scope_range::scope_range_enum scope_type() const {
@@ -84,6 +95,7 @@ namespace graphlab {
     void init(Graph* graph, vertex_id_type vertex) {
       base::_graph_ptr = graph;
       base::_vertex = vertex;
+      optimistic = false;
     }
 
     vertex_data_type& vertex_data() {
@@ -35,12 +35,18 @@
 #define GRAPHLAB_GENERAL_SCOPE_FACTORY_HPP
 
 #include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <sched.h>
+#include <boost/type_traits/has_trivial_copy.hpp>
 
 #include <graphlab/scope/iscope.hpp>
 #include <graphlab/scope/iscope_factory.hpp>
 #include <graphlab/scope/general_scope.hpp>
 #include <graphlab/parallel/pthread_tools.hpp>
+#include <graphlab/parallel/spin_rwlock.hpp>
 #include <graphlab/graph/graph.hpp>
+#include <graphlab/logger/logger.hpp>
 
 
 namespace graphlab {
@@ -59,14 +65,36 @@ namespace graphlab {
     typedef typename Graph::vertex_id_type  vertex_id_type;
     typedef typename Graph::edge_id_type    edge_id_type;
     typedef typename Graph::edge_list_type  edge_list_type;
+    typedef typename Graph::vertex_data_type vertex_data_type;
+    typedef typename Graph::edge_data_type  edge_data_type;
     typedef general_scope<Graph> general_scope_type;
 
   private:
+    /// A vertex lock needed by a batch. second is true for a write lock
+    typedef std::pair<vertex_id_type, bool> batch_lock_type;
+
     Graph& graph;
     std::vector<general_scope_type*> scopes;
-    std::vector<rwlock> locks;
+    std::vector<spin_rwlock> locks;
     scope_range::scope_range_enum default_scope;
 
+    /**
+     * Optimistic read scopes. When enabled, every write lock bumps a
+     * per vertex version counter on acquire and on release, so the
+     * version is odd while a writer holds the vertex. Read only
+     * scopes then take no locks: they record the versions of the
+     * vertices they read and validate them afterwards.
+     */
+    bool optimistic_reads;
+    std::vector<uint32_t> versions;
+    /// Optimistic attempts before validate_scope() falls back to locks
+    size_t max_optimistic_failures;
+
+    /// Additional scopes handed out by get_scopes(), per cpu
+    std::vector<std::vector<general_scope_type*> > batch_scopes;
+    /// The locks held by the current batch of each cpu
+    std::vector<std::vector<batch_lock_type> > batch_locks;
+
   public:
 
     general_scope_factory(Graph& graph,
@@ -74,7 +102,9 @@ namespace graphlab {
                           scope_range::scope_range_enum default_scope_range 
                           = scope_range::NULL_CONSISTENCY) :
       base(graph,ncpus), graph(graph),
-      default_scope(default_scope_range) {
+      default_scope(default_scope_range),
+      optimistic_reads(false),
+      max_optimistic_failures(2) {
       if (default_scope == scope_range::USE_DEFAULT)
         default_scope = scope_range::VERTEX_CONSISTENCY;
       locks.resize(graph.num_vertices());
@@ -86,6 +116,8 @@ namespace graphlab {
         scopes[i] = new general_scope_type(&graph, 0, this, 
                                            scope_range::FULL_CONSISTENCY);
       }
+      batch_scopes.resize(ncpus);
+      batch_locks.resize(ncpus);
     }
 
     void set_default_scope(scope_range::scope_range_enum default_scope_range) {
@@ -94,10 +126,44 @@ namespace graphlab {
         default_scope = scope_range::VERTEX_CONSISTENCY;
     }
 
+    /**
+     * Enables optimistic read scopes. READ_CONSISTENCY and
+     * VERTEX_READ_CONSISTENCY scopes then hold no locks. An update
+     * run on such a scope must be checked with validate_scope() and
+     * run again if that fails, so it must be safe to repeat. Must
+     * not be called while scopes are held.
+     *
+     * An optimistic update may read data while a writer is changing
+     * it, so the vertex and edge data must be trivially copyable: a
+     * torn read of a std::vector could follow a freed pointer before
+     * it is ever validated. For other types optimistic reads stay
+     * disabled.
+     */
+    void set_optimistic_reads(bool value) {
+      if (value &&
+          !(boost::has_trivial_copy<vertex_data_type>::value &&
+            boost::has_trivial_copy<edge_data_type>::value)) {
+        logstream(LOG_WARNING) 
+          << "Optimistic reads need trivially copyable vertex and edge data. "
+          << "Using locked read scopes." << std::endl;
+        value = false;
+      }
+      optimistic_reads = value;
+      if (optimistic_reads) versions.resize(graph.num_vertices(), 0);
+      else versions.clear();
+    }
+
+    bool get_optimistic_reads() const { return optimistic_reads; }
+
     ~general_scope_factory() { 
       for (size_t i = 0;i < scopes.size(); ++i) {
         delete scopes[i];
       }
+      for (size_t i = 0;i < batch_scopes.size(); ++i) {
+        for (size_t j = 0;j < batch_scopes[i].size(); ++j) {
+          delete batch_scopes[i][j];
+        }
+      }
     }
 
     // -----------------ACQUIRE SCOPE-----------------------------
@@ -106,6 +172,11 @@ namespace graphlab {
                            scope_range::scope_range_enum scope = scope_range::USE_DEFAULT) {
       if (scope == scope_range::USE_DEFAULT) scope = default_scope;
       
+      if (optimistic_reads &&
+          (scope == scope_range::READ_CONSISTENCY ||
+           scope == scope_range::VERTEX_READ_CONSISTENCY)) {
+        return get_optimistic_scope(cpuid, v, scope);
+      }
       switch(scope){
       case scope_range::VERTEX_CONSISTENCY:
         return get_vertex_scope(cpuid, v);
@@ -148,17 +219,17 @@ namespace graphlab {
       // include the current vertex in the iteration
       while (inidx < inedges.size() || outidx < outedges.size()) {
         if (!curlocked && curv < inv  && curv < outv) {
-          locks[curv].writelock();
+          write_lock(curv);
           curlocked = true;
           curv = numv;
         } else if (inv < outv) {
-          locks[inv].writelock(); ++inidx;
+          write_lock(inv); ++inidx;
           inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
         } else if (outv < inv) {
-          locks[outv].writelock(); ++outidx;
+          write_lock(outv); ++outidx;
           outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
         } else if (inv == outv){
-          locks[inv].writelock();
+          write_lock(inv);
           ++inidx; ++outidx;
           inv = (inedges.size() > inidx) ? graph.source(inedges[inidx]) : numv;
           outv= (outedges.size() > outidx) ? graph.target(outedges[outidx]) : numv;
@@ -166,7 +237,7 @@ namespace graphlab {
       }
       // just in case we never got around to locking it
       if (!curlocked) {
-        locks[curv].writelock();
+        write_lock(curv);
       }
       return scope;
     }
@@ -194,7 +265,7 @@ namespace graphlab {
       // include the current vertex in the iteration
       while (inidx < inedges.size() || outidx < outedges.size()) {
         if (!curlocked && curv < inv  && curv < outv) {
-          locks[curv].writelock();
+          write_lock(curv);
           curlocked = true;
           curv = numv;
         } else if (inv < outv) {
@@ -212,7 +283,7 @@ namespace graphlab {
       }
       // just in case we never got around to locking it
       if (!curlocked) {
-        locks[curv].writelock();
+        write_lock(curv);
       }
 
       return scope;
@@ -225,7 +296,7 @@ namespace graphlab {
       scope->stype = scope_range::VERTEX_CONSISTENCY;
 
       vertex_id_type curv = scope->vertex();
-      locks[curv].writelock();
+      write_lock(curv);
 
       return scope;
     }
@@ -241,7 +312,8 @@ namespace graphlab {
       general_scope_type* scope = scopes[cpuid];
       
       scope->init(&graph, v);
-      scope->stype = scope_range::READ_CONSISTENCY;
+      // only the centre is locked, so only the centre is released
+      scope->stype = scope_range::VERTEX_READ_CONSISTENCY;
 
       vertex_id_type curv = scope->vertex();
       locks[curv].readlock();
@@ -253,7 +325,71 @@ namespace graphlab {
       
       scope->init(&graph, v);
       scope->stype = scope_range::READ_CONSISTENCY;
+      read_lock_neighborhood(v);
+      return scope;
+    }
+
+    /**
+     * Acquires a READ_CONSISTENCY or VERTEX_READ_CONSISTENCY scope
+     * without locking. The versions of the vertices in the scope are
+     * recorded and checked by validate_scope().
+     */
+    iscope_type* get_optimistic_scope(size_t cpuid, vertex_id_type v,
+                                      scope_range::scope_range_enum stype) {
+      general_scope_type* scope = scopes[cpuid];
 
+      scope->init(&graph, v);
+      scope->stype = stype;
+      scope->optimistic = true;
+      scope->optimistic_failures = 0;
+      record_versions(scope);
+      return scope;
+    }
+
+    /**
+     * Checks that no writer touched the vertices read through an
+     * optimistic scope since they were recorded. Returns true if the
+     * reads were consistent, or if the scope holds locks. Otherwise
+     * the scope is reset so that the update can be run on it again
+     * and false is returned. After max_optimistic_failures failed
+     * attempts the scope takes the read locks instead, so the
+     * following attempt always validates.
+     */
+    bool validate_scope(iscope_type* scopei) {
+      general_scope_type* scope = (general_scope_type*)scopei;
+      if (!scope->optimistic) return true;
+      // the reads of the update must complete before the versions
+      // are read again
+      __sync_synchronize();
+      const volatile uint32_t* vers = &(versions[0]);
+      bool valid = true;
+      for (size_t i = 0; i < scope->read_versions.size(); ++i) {
+        if (vers[scope->read_versions[i].first] !=
+            scope->read_versions[i].second) {
+          valid = false;
+          break;
+        }
+      }
+      if (valid) return true;
+
+      ++scope->optimistic_failures;
+      if (scope->optimistic_failures < max_optimistic_failures) {
+        record_versions(scope);
+      } else {
+        scope->optimistic = false;
+        if (scope->stype == scope_range::VERTEX_READ_CONSISTENCY) {
+          locks[scope->vertex()].readlock();
+        } else {
+          read_lock_neighborhood(scope->vertex());
+        }
+      }
+      return false;
+    }
+
+  private:
+    /** Takes a read lock on v and all its neighbors in increasing
+        vertex order */
+    void read_lock_neighborhood(vertex_id_type v) {
       const edge_list_type inedges =  graph.in_edge_ids(v);
       const edge_list_type outedges = graph.out_edge_ids(v);
 
@@ -263,7 +399,7 @@ namespace graphlab {
 
       bool curlocked = false;
       vertex_id_type numv = (vertex_id_type)(graph.num_vertices());
-      vertex_id_type curv = scope->vertex();
+      vertex_id_type curv = v;
       vertex_id_type inv  = (inedges.size() > 0) ? graph.source(inedges[0]) : numv;
       vertex_id_type outv  = (outedges.size() > 0) ? graph.target(outedges[0]) : numv;
       // iterate both in order and lock
@@ -290,9 +426,62 @@ namespace graphlab {
       if (!curlocked) {
         locks[curv].readlock();
       }
-      return scope;
     }
 
+    /** Write locks v, marking it as being written for optimistic
+        readers */
+    void write_lock(vertex_id_type v) {
+      locks[v].writelock();
+      if (optimistic_reads) {
+        // odd version: a writer is active. Only the holder of the
+        // write lock modifies the version.
+        ((volatile uint32_t*)&(versions[0]))[v] = versions[v] + 1;
+        __sync_synchronize();
+      }
+    }
+
+    void write_unlock(vertex_id_type v) {
+      if (optimistic_reads) {
+        // the writes must be visible before the version changes
+        __sync_synchronize();
+        ((volatile uint32_t*)&(versions[0]))[v] = versions[v] + 1;
+      }
+      locks[v].unlock();
+    }
+
+    /** Records the current version of every vertex an optimistic
+        scope may read, waiting out any active writer */
+    void record_versions(general_scope_type* scope) {
+      const vertex_id_type v = scope->vertex();
+      std::vector<std::pair<vertex_id_type, uint32_t> >& read_versions =
+        scope->read_versions;
+      read_versions.clear();
+      read_versions.push_back(std::make_pair(v, 0));
+      if (scope->stype == scope_range::READ_CONSISTENCY) {
+        const edge_list_type inedges =  graph.in_edge_ids(v);
+        const edge_list_type outedges = graph.out_edge_ids(v);
+        for (size_t i = 0; i < inedges.size(); ++i) {
+          read_versions.push_back(std::make_pair(graph.source(inedges[i]), 0));
+        }
+        for (size_t i = 0; i < outedges.size(); ++i) {
+          read_versions.push_back(std::make_pair(graph.target(outedges[i]), 0));
+        }
+      }
+      const volatile uint32_t* vers = &(versions[0]);
+      for (size_t i = 0; i < read_versions.size(); ++i) {
+        uint32_t ver = vers[read_versions[i].first];
+        while (ver & 1) {
+          sched_yield();
+          ver = vers[read_versions[i].first];
+        }
+        read_versions[i].second = ver;
+      }
+      // the versions must be read before any of the data
+      __sync_synchronize();
+    }
+
+  public:
+
     
     iscope_type* get_null_scope(size_t cpuid, vertex_id_type v) {
       general_scope_type* scope = scopes[cpuid];
@@ -303,10 +492,95 @@ namespace graphlab {
       return scope;
     }
 
+    /**
+     * Acquires the default scope around each of the vertices at
+     * once. The locks needed by all the scopes are merged (a write
+     * lock wins over a read lock on the same vertex) and taken in
+     * increasing vertex order, which is the order used by get_scope(),
+     * so batches cannot deadlock with each other or with single
+     * scopes. The scopes must be released together with
+     * release_scopes(). Scopes acquired this way do not support
+     * experimental_scope_upgrade(), and read only scopes are locked
+     * even when optimistic reads are enabled.
+     */
+    void get_scopes(size_t cpuid,
+                    const std::vector<vertex_id_type>& vertices,
+                    std::vector<iscope_type*>& ret) {
+      std::vector<batch_lock_type>& needed = batch_locks[cpuid];
+      std::vector<general_scope_type*>& pool = batch_scopes[cpuid];
+      ASSERT_TRUE(needed.empty());
+      while (pool.size() < vertices.size()) {
+        pool.push_back(new general_scope_type(&graph, 0, NULL,
+                                              default_scope));
+      }
+      ret.resize(vertices.size());
+      for (size_t i = 0; i < vertices.size(); ++i) {
+        const vertex_id_type v = vertices[i];
+        pool[i]->init(&graph, v);
+        pool[i]->stype = default_scope;
+        ret[i] = pool[i];
+        switch(default_scope) {
+        case scope_range::VERTEX_CONSISTENCY:
+          needed.push_back(batch_lock_type(v, true));
+          break;
+        case scope_range::VERTEX_READ_CONSISTENCY:
+          needed.push_back(batch_lock_type(v, false));
+          break;
+        case scope_range::READ_CONSISTENCY:
+          add_neighbor_locks(v, false, needed);
+          needed.push_back(batch_lock_type(v, false));
+          break;
+        case scope_range::EDGE_CONSISTENCY:
+          add_neighbor_locks(v, false, needed);
+          needed.push_back(batch_lock_type(v, true));
+          break;
+        case scope_range::FULL_CONSISTENCY:
+          add_neighbor_locks(v, true, needed);
+          needed.push_back(batch_lock_type(v, true));
+          break;
+        case scope_range::NULL_CONSISTENCY:
+          break;
+        default:
+          ASSERT_TRUE(false);
+        }
+      }
+      // sort by vertex and merge duplicates keeping the strongest mode
+      std::sort(needed.begin(), needed.end());
+      size_t nlocks = 0;
+      for (size_t i = 0; i < needed.size(); ++i) {
+        if (nlocks > 0 && needed[nlocks - 1].first == needed[i].first) {
+          needed[nlocks - 1].second = needed[nlocks - 1].second || needed[i].second;
+        } else {
+          needed[nlocks++] = needed[i];
+        }
+      }
+      needed.resize(nlocks);
+      for (size_t i = 0; i < needed.size(); ++i) {
+        if (needed[i].second) write_lock(needed[i].first);
+        else locks[needed[i].first].readlock();
+      }
+    }
+
     // -----------------RELEASE SCOPE-----------------------------
 
+    /** Releases all the scopes acquired by the last get_scopes() call
+        on this cpu */
+    void release_scopes(size_t cpuid) {
+      std::vector<batch_lock_type>& held = batch_locks[cpuid];
+      for (size_t i = held.size(); i > 0; --i) {
+        if (held[i - 1].second) write_unlock(held[i - 1].first);
+        else locks[held[i - 1].first].unlock();
+      }
+      held.clear();
+    }
+
     void release_scope(iscope_type* scopei) {
       general_scope_type* scope = (general_scope_type*)scopei;
+      if (scope->optimistic) {
+        // holds no locks
+        scope->optimistic = false;
+        return;
+      }
       switch(scope->scope_type()){
       case scope_range::VERTEX_CONSISTENCY:
       case scope_range::VERTEX_READ_CONSISTENCY:
@@ -327,6 +601,9 @@ namespace graphlab {
 
     void release_full_edge_scope(general_scope_type* scope) {
       vertex_id_type v = scope->vertex();
+      // which of the locks are write locks
+      const bool centerwrite = scope->stype != scope_range::READ_CONSISTENCY;
+      const bool adjwrite = scope->stype == scope_range::FULL_CONSISTENCY;
       const edge_list_type inedges =  graph.in_edge_ids(v);
       const edge_list_type outedges = graph.out_edge_ids(v);
       size_t inidx = inedges.size() - 1;
@@ -344,18 +621,18 @@ namespace graphlab {
       while (inidx < inedges.size() || outidx < outedges.size()) {
         if (!curvunlocked && (curv > inv || inv == vertex_id_type(-1)) &&
             (curv > outv || outv == vertex_id_type(-1))) {
-          locks[curv].unlock();
+          unlock(curv, centerwrite);
           curvunlocked = true;
         } else if ((inv+1) > (outv+1)) {
-          locks[inv].unlock(); --inidx;
+          unlock(inv, adjwrite); --inidx;
           inv  = (inedges.size() > inidx) ?
             graph.source(inedges[inidx]) : vertex_id_type(-1);
         } else if ((outv+1) > (inv+1)) {
-          locks[outv].unlock(); --outidx;
+          unlock(outv, adjwrite); --outidx;
           outv  = (outedges.size() > outidx) ?
             graph.target(outedges[outidx]) : vertex_id_type(-1);
         } else if (inv == outv){
-          locks[inv].unlock();
+          unlock(inv, adjwrite);
           --inidx; --outidx;
           inv  = (inedges.size() > inidx) ?
             graph.source(inedges[inidx]) : vertex_id_type(-1);
@@ -365,13 +642,13 @@ namespace graphlab {
       }
 
       if (!curvunlocked) {
-        locks[curv].unlock();
+        unlock(curv, centerwrite);
       }
     }
 
     void release_vertex_scope(general_scope_type* scope) {
       vertex_id_type curv = scope->vertex();
-      locks[curv].unlock();
+      unlock(curv, scope->stype == scope_range::VERTEX_CONSISTENCY);
     }
 
     void release_range_lock(size_t start, size_t end) {
@@ -384,6 +661,26 @@ namespace graphlab {
 
     size_t num_vertices() const { return graph.num_vertices(); }
 
+  private:
+    void unlock(vertex_id_type v, bool write) {
+      if (write) write_unlock(v);
+      else locks[v].unlock();
+    }
+
+    /** Appends the locks on all the neighbors of v */
+    void add_neighbor_locks(vertex_id_type v, bool write,
+                            std::vector<batch_lock_type>& needed) const {
+      const edge_list_type inedges =  graph.in_edge_ids(v);
+      const edge_list_type outedges = graph.out_edge_ids(v);
+      for (size_t i = 0; i < inedges.size(); ++i) {
+        needed.push_back(batch_lock_type(graph.source(inedges[i]), write));
+      }
+      for (size_t i = 0; i < outedges.size(); ++i) {
+        needed.push_back(batch_lock_type(graph.target(outedges[i]), write));
+      }
+    }
+  public:
+
     Graph& get_graph() { return graph; }
     
   };
@@ -24,6 +24,7 @@
 #ifndef GRAPHLAB_SYNCHRONOUS_SCOPE_HPP
 #define GRAPHLAB_SYNCHRONOUS_SCOPE_HPP
 
+#include <vector>
 #include <boost/bind.hpp>
 
 
@@ -35,6 +36,16 @@ namespace graphlab {
   /**
    * This defines a scope type which is meant for "synchronous" type of 
    * algorithms. This type of scope should only be used by synchronous_engine
+   *
+   * The data on the central vertex is read and written in the graph
+   * directly. The data on neighboring vertices is read from a
+   * snapshot taken at the end of the previous superstep, so every
+   * update in a superstep sees the same neighbor values regardless
+   * of the order in which the updates run. No locks are taken.
+   *
+   * Edge data is not buffered. An update may only write the edge
+   * data of its own in edges, since the out edges are in edges of
+   * vertices which may be updated at the same time.
    */
   template<typename Graph>
   class synchronous_scope : 
@@ -50,36 +61,29 @@ namespace graphlab {
     using base::_graph_ptr;
 
   public:
-    synchronous_scope() : base(NULL,0) { }
+    synchronous_scope() : base(NULL,0), _snapshot(NULL) { }
 
-    // TODO: Why 3 graph arguments?  
-    synchronous_scope(Graph* srcgraph, Graph* destgraph,
-                      Graph* vertexdatagraph, 
+    synchronous_scope(Graph* graph,
+                      std::vector<vertex_data_type>* snapshot,
                       vertex_id_type vertex) : 
-      base(srcgraph, vertex)  {
-      _srcgraph = srcgraph;
-      _destgraph = destgraph;
-      _vertexdatagraph = vertexdatagraph;
-    }
+      base(graph, vertex), _snapshot(snapshot) { }
 
     
     ~synchronous_scope() { }
     
     void commit() {};
     
-    void init(Graph* srcgraph, 
-              Graph* destgraph,
-              Graph* vertexdatagraph, vertex_id_type vertex) {
-      base::_graph_ptr = srcgraph;
+    void init(Graph* graph,
+              std::vector<vertex_data_type>* snapshot,
+              vertex_id_type vertex) {
+      base::_graph_ptr = graph;
       base::_vertex = vertex;
-      _srcgraph = srcgraph;
-      _destgraph = destgraph;
-      _vertexdatagraph = vertexdatagraph;
+      _snapshot = snapshot;
     }
     
     /// Returns the data on the base vertex
     vertex_data_type& vertex_data()  {
-      return (_vertexdatagraph->vertex_data( _vertex ));
+      return (_graph_ptr->vertex_data( _vertex ));
     }
 
     const vertex_data_type& vertex_data() const  {
@@ -87,7 +91,7 @@ namespace graphlab {
     }
 
     const vertex_data_type& const_vertex_data() const  {
-      return (_vertexdatagraph->vertex_data( _vertex ));
+      return (_graph_ptr->vertex_data( _vertex ));
     }
 
     /// Direct calls to access edge data
@@ -97,47 +101,36 @@ namespace graphlab {
 
     /// Direct calls to access edge data
     const edge_data_type& const_edge_data(edge_id_type eid) const { 
-      // TODO: make sure edge is associated with this vertex
-      if (_srcgraph->target(eid) == _vertex ) {
-        // in edge
-        return (_srcgraph->edge_data(eid));
-      } else {
-        // outedge
-        return (_destgraph->edge_data(eid));
-      }
+      return (_graph_ptr->edge_data(eid));
     }
 
     edge_data_type& edge_data(edge_id_type eid) {
-      // TODO: make sure edge is associated with this vertex
-      if (_srcgraph->target(eid) == _vertex) {
-        // in edge
-        return (_srcgraph->edge_data(eid));
-      } else {
-        // outedge
-        return (_destgraph->edge_data(eid));
-      }
+      return (_graph_ptr->edge_data(eid));
     }
     
     const vertex_data_type& neighbor_vertex_data(vertex_id_type vertex) const {
       return const_neighbor_vertex_data(vertex);
     }
 
+    /// The value of the neighbor at the end of the last superstep
     const vertex_data_type& const_neighbor_vertex_data(vertex_id_type vertex) const {
-      return _srcgraph->vertex_data(vertex);
+      return (*_snapshot)[vertex];
     }
 
+    /**
+     * The value of the neighbor at the end of the last superstep.
+     * The reference is non-const only for compatibility with update
+     * functions written for the other engines. Writes through it
+     * are not supported.
+     */
     vertex_data_type& neighbor_vertex_data(vertex_id_type vertex) {
-      // this totally does not make sense for synchronous execution
-      assert(false);
-      return _srcgraph->vertex_data(vertex);
+      return (*_snapshot)[vertex];
     }
 
 
       
   private:
-    Graph* _srcgraph;
-    Graph* _destgraph;
-    Graph* _vertexdatagraph;
+    std::vector<vertex_data_type>* _snapshot;
   }; // end of synchronous_scope
   
 } // end of graphlab namespace
@@ -33,6 +33,12 @@ namespace graphlab {
   /**
    * This defines a scope type which is meant for "synchronous" type of 
    * algorithms. This type of scope should only be used by synchronous_engine
+   *
+   * The factory owns the second buffer of vertex data: a snapshot of
+   * every vertex as of the end of the last superstep. Scopes read
+   * their neighbors from the snapshot and write their own vertex in
+   * the graph. At the end of a superstep the engine copies the
+   * updated vertices into the snapshot with snapshot_vertex().
    */
   template<typename Graph>
   class synchronous_scope_factory : 
@@ -41,20 +47,17 @@ namespace graphlab {
     typedef iscope_factory<Graph> base;
     typedef typename base::iscope_type iscope_type;
     typedef typename base::vertex_id_type vertex_id_type;
+    typedef typename Graph::vertex_data_type vertex_data_type;
     typedef synchronous_scope<Graph> synchronous_scope_type;
     
-    synchronous_scope_factory(Graph& srcgraph, 
-                              Graph& destgraph, size_t ncpus) : 
-      base(srcgraph, ncpus), 
-      _srcgraph(&srcgraph), 
-      _destgraph(&destgraph), 
-      scopes(ncpus) {  
-      // vertexd data graph does not change
-      _vertexdatagraph = _destgraph;
-    }
+    synchronous_scope_factory(Graph& graph, size_t ncpus) : 
+      base(graph, ncpus), 
+      _graph(&graph),
+      scopes(ncpus) { }
     
     ~synchronous_scope_factory() { }
 
+    /// Scopes never lock. The scope range is ignored.
     void set_default_scope(scope_range::scope_range_enum default_scope_range) { };
     
     iscope_type* 
@@ -63,30 +66,37 @@ namespace graphlab {
               scope_range::USE_DEFAULT) {
       assert(cpuid < scopes.size());
       synchronous_scope_type& scope = scopes[cpuid];
-      scope.init(_srcgraph,_destgraph, _vertexdatagraph, v);
+      scope.init(_graph, &_snapshot, v);
       return &(scope);
     }
     
-    void swap_graphs() {
-      Graph* tmp = _srcgraph;
-      _srcgraph = _destgraph;
-      _destgraph = tmp;
-    }
-    
-    Graph* get_src_graph() { return _srcgraph;  }
-    Graph* get_dest_graph() { return _destgraph;  }
-    Graph* get_vertex_data_graph() { return _vertexdatagraph;  }
-    
     void release_scope(iscope_type* scope) { }
 
+    /// Copies the data on all the vertices into the snapshot
+    void snapshot_all() {
+      _snapshot.resize(_graph->num_vertices());
+      for (size_t i = 0; i < _snapshot.size(); ++i) {
+        _snapshot[i] = _graph->vertex_data(vertex_id_type(i));
+      }
+    }
+
+    /// Copies the data on vertex v into the snapshot
+    void snapshot_vertex(vertex_id_type v) {
+      _snapshot[v] = _graph->vertex_data(v);
+    }
+
+    /// Frees the snapshot
+    void clear_snapshot() {
+      std::vector<vertex_data_type>().swap(_snapshot);
+    }
+
     size_t num_vertices() const {
-      return _vertexdatagraph->num_vertices();
+      return _graph->num_vertices();
     }
     
   private:
-    Graph* _srcgraph;
-    Graph* _destgraph;
-    Graph* _vertexdatagraph;
+    Graph* _graph;
+    std::vector<vertex_data_type> _snapshot;
     std::vector<synchronous_scope_type> scopes;  
   };
   
@@ -45,12 +45,12 @@
       uint64_t i = (uint64_t)(i_) ;                                     \
       char c[10];                                                       \
       unsigned char len = compress_int(i, c);                           \
-      a.o->write(c + 10 - len, (std::streamsize)len);                   \
+      a.write(c + 10 - len, (std::streamsize)len);                      \
     }                                                                   \
   };                                                                    \
   template <typename ArcType> struct deserialize_impl<ArcType, tname, false>{ \
     static void exec(ArcType &a, tname &t_) {                           \
-      decompress_int<tname>(*(a.i), t_);                                \
+      a.read_compressed_int(t_);                                        \
     }                                                                   \
   };
 
@@ -84,8 +84,8 @@ namespace graphlab {
         // ++ for the \0
         size_t length = strlen(s); length++;
         serialize_impl<ArcType, size_t, false>::exec(a, length);
-        a.o->write(reinterpret_cast<const char*>(s), length);
-        DASSERT_FALSE(a.o->fail());
+        a.write(reinterpret_cast<const char*>(s), length);
+        DASSERT_FALSE(a.fail());
       }
     };
 
@@ -95,8 +95,8 @@ namespace graphlab {
       static void exec(ArcType& a, const char s[len] ) { 
         size_t length = len;
         serialize_impl<ArcType, size_t, false>::exec(a, length);
-        a.o->write(reinterpret_cast<const char*>(s), length);
-        DASSERT_FALSE(a.o->fail());
+        a.write(reinterpret_cast<const char*>(s), length);
+        DASSERT_FALSE(a.fail());
       }
     };
 
@@ -107,8 +107,8 @@ namespace graphlab {
         // ++ for the \0
         size_t length = strlen(s); length++;
         serialize_impl<ArcType, size_t, false>::exec(a, length);
-        a.o->write(reinterpret_cast<const char*>(s), length);
-        DASSERT_FALSE(a.o->fail());
+        a.write(reinterpret_cast<const char*>(s), length);
+        DASSERT_FALSE(a.fail());
       }
     };
 
@@ -120,8 +120,8 @@ namespace graphlab {
         deserialize_impl<ArcType, size_t, false>::exec(a, length);
         s = new char[length];
         //operator>> the rest
-        a.i->read(reinterpret_cast<char*>(s), length);
-        DASSERT_FALSE(a.i->fail());
+        a.read(reinterpret_cast<char*>(s), length);
+        DASSERT_FALSE(a.fail());
       }
     };
   
@@ -131,8 +131,8 @@ namespace graphlab {
         size_t length;
         deserialize_impl<ArcType, size_t, false>::exec(a, length);
         ASSERT_LE(length, len);
-        a.i->read(reinterpret_cast<char*>(s), length);
-        DASSERT_FALSE(a.i->fail());
+        a.read(reinterpret_cast<char*>(s), length);
+        DASSERT_FALSE(a.fail());
       }
     };
 
@@ -144,8 +144,8 @@ namespace graphlab {
       static void exec(ArcType &a, const std::string& s) {
         size_t length = s.length();
         serialize_impl<ArcType, size_t, false>::exec(a, length);
-        a.o->write(reinterpret_cast<const char*>(s.c_str()), (std::streamsize)length);
-        DASSERT_FALSE(a.o->fail());
+        a.write(reinterpret_cast<const char*>(s.c_str()), (std::streamsize)length);
+        DASSERT_FALSE(a.fail());
       }
     };
 
@@ -158,8 +158,8 @@ namespace graphlab {
         deserialize_impl<ArcType, size_t, false>::exec(a, length);
         //resize the string and read the characters
         s.resize(length);
-        a.i->read(const_cast<char*>(s.c_str()), (std::streamsize)length);
-        DASSERT_FALSE(a.i->fail());
+        a.read(const_cast<char*>(s.c_str()), (std::streamsize)length);
+        DASSERT_FALSE(a.fail());
       }
     };
 
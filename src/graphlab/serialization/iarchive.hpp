@@ -30,24 +30,78 @@
 #ifndef GRAPHLAB_IARCHIVE_HPP
 #define GRAPHLAB_IARCHIVE_HPP
 
+#include <cstring>
 #include <iostream>
 #include <graphlab/logger/assertions.hpp>
+#include <graphlab/serialization/integer.hpp>
 #include <graphlab/serialization/is_pod.hpp>
 #include <graphlab/serialization/has_load.hpp>
 namespace graphlab {
 
+  /**
+   * Thrown by an iarchive reading from a buffer when the buffer ends
+   * before the object does. The buffer is truncated or corrupt.
+   */
+  struct iarchive_buffer_overrun { };
+
   /**
    * The input archive object.
-   * It is just a simple wrapper around a istream 
+   * It reads either from a std::istream or directly from a
+   * contiguous buffer. The buffer is not copied and must outlive
+   * the archive. Reading past the end of the buffer throws
+   * iarchive_buffer_overrun.
    */
   class iarchive {
   public:
     std::istream* i;
+    const char* buf;
+    size_t off;
+    size_t len;
+
     /// constructor. Takes a generic std::istream object
     iarchive(std::istream& is)
-      :i(&is) { }
+      :i(&is), buf(NULL), off(0), len(0) { }
+
+    /// constructs an archive which reads the buffer [buf, buf + len)
+    iarchive(const char* buf, size_t len)
+      :i(NULL), buf(buf), off(0), len(len) { }
       
     ~iarchive() {}
+
+    inline void read(char* c, std::streamsize s) {
+      if (i == NULL) {
+        if (size_t(s) > len - off) throw iarchive_buffer_overrun();
+        memcpy(c, buf + off, size_t(s));
+        off += size_t(s);
+      } else {
+        i->read(c, s);
+      }
+    }
+
+    /// Reads an integer written by compress_int()
+    template <typename IntType>
+    inline void read_compressed_int(IntType& t) {
+      if (i == NULL) {
+        // the last byte of the integer has the top bit set
+        size_t end = off;
+        while (end < len && (buf[end] & 0x80) == 0) ++end;
+        if (end >= len) throw iarchive_buffer_overrun();
+        const char* p = buf + off;
+        decompress_int_from_ref(p, t);
+        off = size_t(p - buf);
+      } else {
+        decompress_int(*i, t);
+      }
+    }
+
+    inline bool fail() const {
+      return i == NULL ? false : i->fail();
+    }
+
+  private:
+    // not copyable
+    iarchive(const iarchive&);
+    iarchive& operator=(const iarchive&);
   };
 
 
@@ -60,14 +114,33 @@ namespace graphlab {
    */
   class iarchive_soft_fail{
   public:
-    std::istream *i;
+    iarchive* iarc;
+    bool own_iarc;
 
     iarchive_soft_fail(std::istream &is)
-      : i(&is) {}
+      : iarc(new iarchive(is)), own_iarc(true) {}
 
-    iarchive_soft_fail(iarchive &iarc):i(iarc.i){}
+    iarchive_soft_fail(iarchive &iarc):iarc(&iarc), own_iarc(false) {}
   
-    ~iarchive_soft_fail() { }
+    ~iarchive_soft_fail() {
+      if (own_iarc) delete iarc;
+    }
+
+    inline void read(char* c, std::streamsize s) {
+      iarc->read(c, s);
+    }
+
+    template <typename IntType>
+    inline void read_compressed_int(IntType& t) {
+      iarc->read_compressed_int(t);
+    }
+
+    inline bool fail() const { return iarc->fail(); }
+
+  private:
+    // not copyable
+    iarchive_soft_fail(const iarchive_soft_fail&);
+    iarchive_soft_fail& operator=(const iarchive_soft_fail&);
   };
 
 
@@ -85,8 +158,7 @@ namespace graphlab {
     template <typename T>
     struct deserialize_hard_or_soft_fail<iarchive_soft_fail, T> {
       static void exec(iarchive_soft_fail &i, T& t) {
-        iarchive iarc(*(i.i));
-        load_or_fail(iarc, t);
+        load_or_fail(*(i.iarc), t);
       }
     };
 
@@ -108,7 +180,7 @@ namespace graphlab {
     template <typename ArcType, typename T>
     struct deserialize_impl<ArcType, T, true>{
       static void exec(ArcType &a, T &t) {
-        a.i->read(reinterpret_cast<char*>(&t), sizeof(T));
+        a.read(reinterpret_cast<char*>(&t), sizeof(T));
       }
     };
 
@@ -145,8 +217,8 @@ namespace graphlab {
     ASSERT_EQ(length, length2);
 
     //operator>> the rest
-    a.i->read(reinterpret_cast<char*>(i), (std::streamsize)length);
-    assert(!a.i->fail());
+    a.read(reinterpret_cast<char*>(i), (std::streamsize)length);
+    assert(!a.fail());
     return a;
   }
 
@@ -162,8 +234,8 @@ namespace graphlab {
     ASSERT_EQ(length, length2);
 
     //operator>> the rest
-    a.i->read(reinterpret_cast<char*>(i), (std::streamsize)length);
-    assert(!a.i->fail());
+    a.read(reinterpret_cast<char*>(i), (std::streamsize)length);
+    assert(!a.fail());
     return a;
   }
 
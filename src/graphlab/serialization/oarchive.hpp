@@ -30,6 +30,8 @@
 #ifndef GRAPHLAB_OARCHIVE_HPP
 #define GRAPHLAB_OARCHIVE_HPP
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <graphlab/logger/assertions.hpp>
@@ -41,16 +43,66 @@ namespace graphlab {
 
   /**
    *  The output archive object.
-   *  It is just a simple wrapper around a ostream. 
+   *  It writes either to a std::ostream or, when default constructed,
+   *  straight into a growable contiguous buffer owned by the
+   *  archive. The buffer avoids the virtual streambuf calls and the
+   *  sentry construction std::ostream::write() makes for every
+   *  field, which dominates the cost of serializing small objects.
+   *
+   *  In buffer mode the serialized bytes are buf[0 .. off).
    */
   class oarchive{
   public:
     std::ostream* o;
+    char* buf;
+    size_t off;
+    size_t len;
+
     /// constructor. Takes a generic std::ostream object
     oarchive(std::ostream& os)
-      : o(&os) {}
+      : o(&os), buf(NULL), off(0), len(0) {}
+
+    /// constructs an archive which writes to an internal buffer
+    explicit oarchive(size_t initial_len = 128)
+      : o(NULL), buf((char*)malloc(initial_len)), off(0), len(initial_len) {}
+
+    ~oarchive() {
+      if (buf != NULL) free(buf);
+    }
+
+    inline void write(const char* c, std::streamsize s) {
+      if (o == NULL) {
+        expand_buf(size_t(s));
+        memcpy(buf + off, c, size_t(s));
+        off += size_t(s);
+      } else {
+        o->write(c, s);
+      }
+    }
+
+    inline bool fail() const {
+      return o == NULL ? false : o->fail();
+    }
 
-    ~oarchive() { }
+    /// The number of bytes written. Buffer mode only
+    inline size_t size() const { return off; }
+
+    /// Discards the contents of the buffer but keeps its memory
+    inline void clear() { off = 0; }
+
+  private:
+    /// Makes room for s more bytes in the buffer
+    inline void expand_buf(size_t s) {
+      if (__builtin_expect(off + s > len, 0)) {
+        len = 2 * (s + len);
+        buf = (char*)realloc(buf, len);
+        ASSERT_TRUE(buf != NULL);
+      }
+    }
+
+    // not copyable
+    oarchive(const oarchive&);
+    oarchive& operator=(const oarchive&);
   };
 
 /**
@@ -62,14 +114,28 @@ namespace graphlab {
    */
   class oarchive_soft_fail{
   public:
-    std::ostream* o;
+    oarchive* oarc;
+    bool own_oarc;
 
     oarchive_soft_fail(std::ostream& os)
-      : o(&os) {}
+      : oarc(new oarchive(os)), own_oarc(true) {}
 
-    oarchive_soft_fail(oarchive &oarc):o(oarc.o) {}
+    oarchive_soft_fail(oarchive &oarc):oarc(&oarc), own_oarc(false) {}
   
-    ~oarchive_soft_fail() { }
+    ~oarchive_soft_fail() {
+      if (own_oarc) delete oarc;
+    }
+
+    inline void write(const char* c, std::streamsize s) {
+      oarc->write(c, s);
+    }
+
+    inline bool fail() const { return oarc->fail(); }
+
+  private:
+    // not copyable
+    oarchive_soft_fail(const oarchive_soft_fail&);
+    oarchive_soft_fail& operator=(const oarchive_soft_fail&);
   };
 
   namespace archive_detail {
@@ -86,8 +152,7 @@ namespace graphlab {
     template <typename T>
     struct serialize_hard_or_soft_fail<oarchive_soft_fail, T> {
       static void exec(oarchive_soft_fail &o, const T& t) {
-        oarchive oarc(*(o.o));
-        save_or_fail(oarc, t);
+        save_or_fail(*(o.oarc), t);
       }
     };
 
@@ -109,7 +174,7 @@ namespace graphlab {
     template <typename ArcType, typename T>
     struct serialize_impl<ArcType, T, true> {
       static void exec(ArcType &a, const T& t) {
-        a.o->write(reinterpret_cast<const char*>(&t), sizeof(T));
+        a.write(reinterpret_cast<const char*>(&t), sizeof(T));
       }
     };
 
@@ -147,8 +212,8 @@ namespace graphlab {
   inline oarchive& serialize(oarchive& a, const void* i,const size_t length) {
     // save the length
     operator<<(a,length);
-    a.o->write(reinterpret_cast<const char*>(i), (std::streamsize)length);
-    assert(!a.o->fail());
+    a.write(reinterpret_cast<const char*>(i), (std::streamsize)length);
+    assert(!a.fail());
     return a;
   }
 
@@ -159,8 +224,8 @@ namespace graphlab {
   inline oarchive_soft_fail& serialize(oarchive_soft_fail& a, const void* i,const size_t length) {
     // save the length
     operator<<(a,length);
-    a.o->write(reinterpret_cast<const char*>(i), (std::streamsize)length);
-    assert(!a.o->fail());
+    a.write(reinterpret_cast<const char*>(i), (std::streamsize)length);
+    assert(!a.fail());
     return a;
   }
 
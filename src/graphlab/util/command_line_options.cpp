@@ -195,6 +195,8 @@ namespace graphlab {
       std::cout << "Options: \n";
       std::cout << "max_iterations = [integer, default = 0]\n";
       std::cout << "randomize_schedule = [integer, default = 0]\n";
+      std::cout << "pipelined_sync = [integer, default = 0]\n";
+      std::cout << "neighborhood_barrier = [integer, default = 0]\n";
       std::cout << "update_function = [update_function_type,"
               "default = set on add_task]\n";
 
@@ -0,0 +1,170 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+#ifndef GRAPHLAB_MPSC_QUEUE_HPP
+#define GRAPHLAB_MPSC_QUEUE_HPP
+
+#include <vector>
+#include <cstddef>
+#include <graphlab/parallel/atomic.hpp>
+#include <graphlab/parallel/idle_parker.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util_internal
+   * An unbounded multi-producer single-consumer queue. Producers link
+   * a node in with a single atomic exchange and never wait for each
+   * other or for the consumer. The consumer takes elements off in
+   * batches, and when the queue is empty it spins, then yields and
+   * finally parks on a futex (see idle_parker) until a producer
+   * enqueues again or the queue is stopped.
+   *
+   * A producer which has exchanged the head but not yet linked its
+   * node hides the elements behind it for that short moment. The
+   * consumer then sees an empty queue. The producer notifies the
+   * consumer only after linking, so no wakeup is lost.
+   *
+   * D. Vyukov. Non-intrusive MPSC node-based queue.
+   * http://www.1024cores.net/home/lock-free-algorithms/queues
+   */
+  template <typename T>
+  class mpsc_queue {
+  private:
+    struct node {
+      node* volatile next;
+      T value;
+      node(): next(NULL) { }
+      explicit node(const T& value): next(NULL), value(value) { }
+    };
+
+    /// The most recently enqueued node. Written by producers
+    node* volatile head;
+    char pad0[64 - sizeof(node*)];
+    /// The node before the oldest element. Owned by the consumer
+    node* tail;
+    volatile bool alive;
+    char pad1[64 - sizeof(node*) - sizeof(bool)];
+    idle_parker parker;
+    idle_parker::worker_state idle_state;
+
+    void init() {
+      head = tail = new node;
+      alive = true;
+    }
+
+  public:
+    mpsc_queue() { init(); }
+
+    /** Copy constructor which does not copy. Do not use!
+        Required for compatibility with some STL implementations (LLVM).
+        which use the copy constructor for vector resize,
+        rather than the standard constructor.    */
+    mpsc_queue(const mpsc_queue&) { init(); }
+
+    // not copyable
+    void operator=(const mpsc_queue& m) { }
+
+    ~mpsc_queue() {
+      while (tail != NULL) {
+        node* next = tail->next;
+        delete tail;
+        tail = next;
+      }
+    }
+
+    /// Adds an element. Safe to call from any number of threads
+    inline void enqueue(const T& elem) {
+      node* n = new node(elem);
+      // the exchange is a full barrier on x86. The node is complete
+      // before it becomes reachable
+      node* prev = __sync_lock_test_and_set(&head, n);
+      // link with an exchange too. A plain store could still sit in
+      // the store buffer while notify() reads that the consumer is
+      // not parked, and the consumer would miss both
+      (void)__sync_lock_test_and_set(&prev->next, n);
+      parker.notify();
+    }
+
+    /**
+     * Moves up to maxelems elements to the end of out without
+     * blocking. Returns the number of elements moved. Consumer only.
+     */
+    size_t try_dequeue_batch(std::vector<T>& out, size_t maxelems) {
+      size_t count = 0;
+      while (count < maxelems) {
+        node* next = tail->next;
+        if (next == NULL) break;
+        out.push_back(next->value);
+        // next becomes the new placeholder node
+        delete tail;
+        tail = next;
+        ++count;
+      }
+      return count;
+    }
+
+    /**
+     * Moves up to maxelems elements to the end of out, waiting while
+     * the queue is empty. Returns 0 only once the queue has been
+     * stopped and drained. Consumer only.
+     */
+    size_t dequeue_batch(std::vector<T>& out, size_t maxelems) {
+      while (true) {
+        size_t count = try_dequeue_batch(out, maxelems);
+        if (count > 0) {
+          parker.busy(idle_state);
+          return count;
+        }
+        if (!alive) {
+          // a producer may have been linking when we looked
+          count = try_dequeue_batch(out, maxelems);
+          parker.busy(idle_state);
+          return count;
+        }
+        parker.idle(idle_state);
+      }
+    }
+
+    /// True if no element is visible to the consumer
+    bool empty() const {
+      return tail->next == NULL;
+    }
+
+    bool is_alive() const {
+      return alive;
+    }
+
+    /// Wakes the consumer and makes dequeue_batch() return once drained
+    void stop_blocking() {
+      alive = false;
+      __sync_synchronize();
+      parker.notify_all();
+    }
+  };
+
+} // end of namespace graphlab
+
+#endif
@@ -82,6 +82,12 @@ namespace graphlab {
       finishedtaskcount.inc();
       assert(finishedtaskcount.value <= newtaskcount.value);
     }
+
+    /** Records n completed jobs with a single atomic operation */
+    void completed_jobs(size_t n) {
+      finishedtaskcount.inc(n);
+      assert(finishedtaskcount.value <= newtaskcount.value);
+    }
     
     void print() {
       std::cout << finishedtaskcount.value << " of "
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#ifndef GRAPHLAB_WORK_STEALING_DEQUE_HPP
+#define GRAPHLAB_WORK_STEALING_DEQUE_HPP
+
+#include <vector>
+#include <cassert>
+#include <sys/types.h>
+
+#include <graphlab/parallel/atomic.hpp>
+
+namespace graphlab {
+
+  /**
+   * \ingroup util_internal
+   * A Chase-Lev work stealing deque.  A single owner thread pushes
+   * and pops at the bottom of the deque without taking any locks,
+   * while any number of other threads may steal from the top. Only a
+   * steal racing with another steal, or with the owner popping the
+   * last element, needs a compare and swap.
+   *
+   * The deque grows when full. Arrays which have been replaced are
+   * kept until the deque is destroyed since a slow thief may still
+   * be reading from them.
+   *
+   * D. Chase and Y. Lev. Dynamic Circular Work-Stealing Deque
+   * (SPAA 2005)
+   */
+  template <typename T>
+  class work_stealing_deque {
+  public:
+    /// The result of a steal() call
+    enum steal_status {
+      STEAL_SUCCESS, ///< An element was stolen
+      STEAL_EMPTY,   ///< The deque was empty
+      STEAL_ABORT    ///< Lost a race with another thread. Try again.
+    };
+
+  private:
+    /** A circular array whose capacity is a power of two */
+    struct circular_array {
+      size_t capacity;
+      T* data;
+      circular_array(size_t capacity) :
+        capacity(capacity), data(new T[capacity]) { }
+      ~circular_array() { delete [] data; }
+      T& operator[](ssize_t i) { return data[size_t(i) & (capacity - 1)]; }
+    };
+
+    // top and bottom are written by different threads. Keep them on
+    // separate cache lines.
+    volatile ssize_t top;
+    char pad0[64 - sizeof(ssize_t)];
+    volatile ssize_t bottom;
+    char pad1[64 - sizeof(ssize_t)];
+    circular_array* volatile array;
+    /// Arrays which were replaced by grow(). Only touched by the owner
+    std::vector<circular_array*> retired;
+
+    // not copyable
+    work_stealing_deque(const work_stealing_deque&);
+    work_stealing_deque& operator=(const work_stealing_deque&);
+
+    /** Doubles the capacity of the array. Called by the owner only */
+    void grow(ssize_t b, ssize_t t) {
+      circular_array* oldarr = array;
+      circular_array* newarr = new circular_array(oldarr->capacity * 2);
+      for (ssize_t i = t; i < b; ++i) (*newarr)[i] = (*oldarr)[i];
+      // the contents must be visible before the new array is
+      __sync_synchronize();
+      array = newarr;
+      retired.push_back(oldarr);
+    }
+
+  public:
+    /** Creates a deque. The initial capacity is rounded up to a
+        power of two. */
+    work_stealing_deque(size_t capacity_hint = 256) : top(0), bottom(0) {
+      size_t capacity = 2;
+      while (capacity < capacity_hint) capacity *= 2;
+      array = new circular_array(capacity);
+    }
+
+    ~work_stealing_deque() {
+      delete array;
+      for (size_t i = 0; i < retired.size(); ++i) delete retired[i];
+    }
+
+    /** Pushes an element onto the bottom of the deque. May only be
+        called by the owner. */
+    void push(const T& elem) {
+      ssize_t b = bottom;
+      ssize_t t = top;
+      if (b - t >= ssize_t(array->capacity) - 1) grow(b, t);
+      (*array)[b] = elem;
+      // the element must be visible before the new bottom is
+      __sync_synchronize();
+      bottom = b + 1;
+    }
+
+    /** Pops an element from the bottom of the deque. May only be
+        called by the owner. Returns false if the deque was empty. */
+    bool pop(T& ret) {
+      ssize_t b = bottom - 1;
+      circular_array* arr = array;
+      bottom = b;
+      // the new bottom must be visible before top is read
+      __sync_synchronize();
+      ssize_t t = top;
+      if (t > b) {
+        // empty
+        bottom = b + 1;
+        return false;
+      }
+      ret = (*arr)[b];
+      if (t == b) {
+        // last element. Race the thieves for it.
+        bool success = atomic_compare_and_swap(top, t, t + 1);
+        bottom = b + 1;
+        return success;
+      }
+      return true;
+    }
+
+    /** Steals an element from the top of the deque. May be called by
+        any thread. */
+    steal_status steal(T& ret) {
+      ssize_t t = top;
+      __sync_synchronize();
+      ssize_t b = bottom;
+      if (t >= b) return STEAL_EMPTY;
+      circular_array* arr = array;
+      ret = (*arr)[t];
+      if (!atomic_compare_and_swap(top, t, t + 1)) return STEAL_ABORT;
+      return STEAL_SUCCESS;
+    }
+
+    /** An estimate of the number of elements in the deque. Exact only
+        when there is no concurrent access. */
+    size_t size() const {
+      ssize_t s = bottom - top;
+      return s > 0 ? size_t(s) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+  };
+
+} // end of namespace graphlab
+
+#endif
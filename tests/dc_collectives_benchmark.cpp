@@ -0,0 +1,134 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+
+
+/**
+ * Compares the tree and ring collectives of dc_dist_object against
+ * the flat scheme they replace, where every machine sends its value
+ * to one root which merges and sends the result back to everyone.
+ * Run with any number of processes, e.g.
+ *   mpiexec -n 16 ./dc_collectives_benchmark
+ */
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/util/mpi_tools.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/dc_init_from_mpi.hpp>
+#include <graphlab/rpc/dc_dist_object.hpp>
+#include <graphlab/logger/logger.hpp>
+using namespace graphlab;
+
+class collectives_benchmark {
+ public:
+  dc_dist_object<collectives_benchmark> rmi;
+  std::vector<double> flat_result;
+  mutex lock;
+
+  collectives_benchmark(distributed_control &dc): rmi(dc, this) { 
+    dc.barrier();
+  }
+
+  void flat_merge(const std::vector<double>& v) {
+    lock.lock();
+    for (size_t i = 0; i < v.size(); ++i) flat_result[i] += v[i];
+    lock.unlock();
+  }
+
+  void flat_set(const std::vector<double>& v) {
+    flat_result = v;
+  }
+
+  /// the all reduce as done by gather to a root followed by a broadcast
+  void flat_all_reduce(std::vector<double>& v) {
+    if (rmi.procid() == 0) flat_result = v;
+    rmi.barrier();
+    if (rmi.procid() != 0) {
+      rmi.remote_request(0, &collectives_benchmark::flat_merge, v);
+    }
+    rmi.barrier();
+    if (rmi.procid() == 0) {
+      for (procid_t i = 1; i < rmi.numprocs(); ++i) {
+        rmi.remote_request(i, &collectives_benchmark::flat_set, flat_result);
+      }
+    }
+    rmi.barrier();
+    v = flat_result;
+  }
+
+  void check(const std::vector<double>& v, const char* name) {
+    const double expected = double(rmi.numprocs()) * (rmi.numprocs() + 1) / 2;
+    for (size_t i = 0; i < v.size(); ++i) {
+      if (v[i] != expected) {
+        logstream(LOG_FATAL) << name << ": element " << i << " is " << v[i]
+                             << " instead of " << expected << std::endl;
+      }
+    }
+  }
+
+  void run(size_t len, size_t reps) {
+    const char* names[3] = {"flat", "tree all_reduce", "ring_all_reduce"};
+    for (size_t method = 0; method < 3; ++method) {
+      rmi.barrier();
+      timer ti;
+      ti.start();
+      for (size_t r = 0; r < reps; ++r) {
+        std::vector<double> v(len, double(rmi.procid() + 1));
+        if (method == 0) flat_all_reduce(v);
+        else if (method == 1) rmi.all_reduce(v, vector_sum());
+        else rmi.ring_all_reduce(v, reduce_ops::sum());
+        check(v, names[method]);
+      }
+      rmi.barrier();
+      if (rmi.procid() == 0) {
+        std::printf("%3u procs %8lu doubles %-16s %10.3f ms\n", 
+                    (unsigned)rmi.numprocs(), (unsigned long)len, names[method],
+                    1000 * ti.current_time() / reps);
+      }
+    }
+  }
+
+  struct vector_sum {
+    void operator()(std::vector<double>& acc, const std::vector<double>& other) const {
+      for (size_t i = 0; i < acc.size(); ++i) acc[i] += other[i];
+    }
+  };
+};
+
+int main(int argc, char ** argv) {
+  global_logger().set_log_level(LOG_WARNING);
+  dc_init_param param;
+  mpi_tools::init(argc, argv);
+  if (!init_param_from_mpi(param)) {
+    return 0;
+  }
+  distributed_control dc(param);
+  collectives_benchmark bench(dc);
+  const size_t lengths[4] = {1, 1024, 65536, 1048576};
+  const size_t reps[4] = {100, 50, 10, 3};
+  for (size_t i = 0; i < 4; ++i) bench.run(lengths[i], reps[i]);
+  dc.barrier();
+  mpi_tools::finalize();
+}
@@ -0,0 +1,108 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+/**
+ * Measures the cost of the lock acquisition loop in
+ * general_scope_factory::get_full_scope() on a graph with large edge
+ * data, with the default edge layout and with the split edge layout.
+ */
+
+#include <iostream>
+#include <set>
+
+#include <graphlab/graph/graph.hpp>
+#include <graphlab/scope/general_scope_factory.hpp>
+#include <graphlab/util/random.hpp>
+#include <graphlab/util/timer.hpp>
+
+#include <graphlab/macros_def.hpp>
+
+// Roughly the size of the pmf edge data with a latent vector
+struct edge_data {
+  double weight[32];
+};
+
+struct split_edge_data_type {
+  double weight[32];
+};
+SPLIT_EDGE_DATA(split_edge_data_type)
+
+
+template <typename Graph>
+void build_graph(Graph& g, size_t nverts, size_t degree) {
+  typedef typename Graph::vertex_id_type vertex_id_type;
+  graphlab::random::seed(1234);
+  g.resize(nverts);
+  for(vertex_id_type i = 0; i < nverts; ++i) {
+    std::set<vertex_id_type> neighbors;
+    for(size_t j = 0; j < degree; ++j) {
+      vertex_id_type neighbor = 
+        graphlab::random::uniform<vertex_id_type>(0, nverts - 1);
+      if(neighbor != i && neighbors.insert(neighbor).second) g.add_edge(i, neighbor);
+    }
+  }
+  g.finalize();
+}
+
+
+template <typename Graph>
+double time_full_scopes(Graph& g, size_t iterations) {
+  typedef typename Graph::vertex_id_type vertex_id_type;
+  graphlab::general_scope_factory<Graph> factory(g, 1);
+  graphlab::timer ti;
+  ti.start();
+  for(size_t iter = 0; iter < iterations; ++iter) {
+    for(vertex_id_type v = 0; v < g.num_vertices(); ++v) {
+      typename graphlab::general_scope_factory<Graph>::iscope_type* scope =
+        factory.get_full_scope(0, v);
+      factory.release_scope(scope);
+    }
+  }
+  return ti.current_time();
+}
+
+
+int main(int argc, char** argv) {
+  typedef graphlab::graph<char, edge_data> graph_type;
+  typedef graphlab::graph<char, split_edge_data_type> split_graph_type;
+  const size_t nverts = 100000;
+  const size_t degree = 20;
+  const size_t iterations = 10;
+  
+  graph_type g;
+  build_graph(g, nverts, degree);
+  split_graph_type sg;
+  build_graph(sg, nverts, degree);
+  std::cout << g.num_vertices() << " vertices, "
+            << g.num_edges() << " edges, "
+            << sizeof(edge_data) << " bytes of data per edge" << std::endl;
+
+  double t = time_full_scopes(g, iterations);
+  std::cout << "Default edge layout: " << t << " s for " 
+            << iterations << " sweeps" << std::endl;
+  t = time_full_scopes(sg, iterations);
+  std::cout << "Split edge layout:   " << t << " s for "
+            << iterations << " sweeps" << std::endl;
+}
+
+#include <graphlab/macros_undef.hpp>
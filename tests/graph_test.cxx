@@ -48,6 +48,14 @@ struct edge_data {
   size_t weight;
   size_t sum;
 };
+SERIALIZABLE_POD(edge_data)
+
+struct split_edge_data_type {
+  size_t weight;
+  size_t sum;
+};
+SERIALIZABLE_POD(split_edge_data_type)
+SPLIT_EDGE_DATA(split_edge_data_type)
 
 
 
@@ -155,7 +163,155 @@ public:
       }
     }
   }
-                               
+
+  void test_compressed_storage() {
+    typedef graph<char, char> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    size_t num_verts = 1000;
+    size_t degree = 20;
+    graph_type g(num_verts);
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      std::set<vertex_id_type> neighbors;
+      for(size_t j = 0; j < degree; ++j) {
+        vertex_id_type neighbor = vertex_id_type(graphlab::random::uniform<vertex_id_type>(0, num_verts - 1));
+        if(neighbor != i && neighbors.insert(neighbor).second) g.add_edge(i, neighbor);
+      }
+    }
+    g.finalize();
+    // record the sorted adjacency lists
+    std::vector<std::vector<edge_id_type> > in(num_verts), out(num_verts);
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      g.in_edge_ids(i).fill_vector(in[i]);
+      g.out_edge_ids(i).fill_vector(out[i]);
+    }
+    TS_TRACE("Compressing");
+    g.finalize(true);
+    TS_ASSERT(g.is_compressed());
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      std::vector<edge_id_type> eids;
+      g.in_edge_ids(i).fill_vector(eids);
+      TS_ASSERT(eids == in[i]);
+      g.out_edge_ids(i).fill_vector(eids);
+      TS_ASSERT(eids == out[i]);
+      TS_ASSERT_EQUALS(g.num_in_neighbors(i), in[i].size());
+      foreach(edge_id_type eid, out[i]) {
+        TS_ASSERT_EQUALS(g.edge_id(i, g.target(eid)), eid);
+      }
+    }
+    TS_TRACE("Save and load a compressed graph");
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << g;
+    strm.flush();
+    iarchive iarc(strm);
+    graph_type g2;
+    iarc >> g2;
+    TS_ASSERT(!g2.is_compressed());
+    TS_ASSERT_EQUALS(g2.num_edges(), g.num_edges());
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      std::vector<edge_id_type> eids;
+      g2.in_edge_ids(i).fill_vector(eids);
+      TS_ASSERT(eids == in[i]);
+    }
+    TS_TRACE("Modifying a compressed graph");
+    vertex_id_type v = g.add_vertex();
+    TS_ASSERT(!g.is_compressed());
+    g.add_edge(0, v);
+    g.finalize(true);
+    TS_ASSERT(g.is_compressed());
+    TS_ASSERT_EQUALS(g.num_in_neighbors(v), size_t(1));
+    TS_ASSERT_EQUALS(g.num_out_neighbors(0), out[0].size() + 1);
+  }
+
+  void test_split_edge_layout() {
+    typedef graph<char, edge_data> graph_type;
+    typedef graph<char, split_edge_data_type> split_graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    size_t num_verts = 1000;
+    graph_type g(num_verts);
+    split_graph_type sg(num_verts);
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      vertex_id_type j = (i + 1) % num_verts;
+      edge_data edata; edata.weight = i; edata.sum = j;
+      split_edge_data_type sedata; sedata.weight = i; sedata.sum = j;
+      g.add_edge(j, i, edata);
+      sg.add_edge(j, i, sedata);
+    }
+    g.finalize();
+    sg.finalize();
+    for(vertex_id_type i = 0; i < num_verts; ++i) {
+      vertex_id_type j = (i + 1) % num_verts;
+      edge_id_type eid = sg.edge_id(j, i);
+      TS_ASSERT_EQUALS(eid, g.edge_id(j, i));
+      TS_ASSERT_EQUALS(sg.source(eid), j);
+      TS_ASSERT_EQUALS(sg.target(eid), i);
+      TS_ASSERT_EQUALS(sg.edge_data(eid).weight, size_t(i));
+    }
+    TS_TRACE("The edge layout does not change the archive format");
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << g;
+    strm.flush();
+    iarchive iarc(strm);
+    split_graph_type sg2;
+    iarc >> sg2;
+    TS_ASSERT_EQUALS(sg2.num_edges(), g.num_edges());
+    for(edge_id_type eid = 0; eid < g.num_edges(); ++eid) {
+      TS_ASSERT_EQUALS(sg2.source(eid), g.source(eid));
+      TS_ASSERT_EQUALS(sg2.target(eid), g.target(eid));
+      TS_ASSERT_EQUALS(sg2.edge_data(eid).sum, g.edge_data(eid).sum);
+    }
+  }
+
+  void test_reorder() {
+    typedef graph<size_t, size_t> graph_type;
+    typedef graph_type::vertex_id_type vertex_id_type;
+    typedef graph_type::edge_id_type edge_id_type;
+    const char* methods[] = {"rcm", "bfs", "degree"};
+    for(size_t m = 0; m < 3; ++m) {
+      TS_TRACE(methods[m]);
+      // make a 30x30 grid
+      size_t dim = 30;
+      graph_type g(dim * dim);
+      for(vertex_id_type i = 0; i < dim * dim; ++i) g.vertex_data(i) = i;
+      for (size_t i = 0;i < dim; ++i) {
+        for (size_t j = 0;j < dim - 1; ++j) {
+          g.add_edge((vertex_id_type)(dim * i + j), (vertex_id_type)(dim * i + j + 1), dim * i + j);
+          g.add_edge((vertex_id_type)(dim * j + i), (vertex_id_type)(dim * (j + 1) + i), dim * j + i);
+        }
+      }
+      g.finalize(m == 0);
+      g.compute_coloring();
+      std::vector<vertex_id_type> sources, targets, colors;
+      for(edge_id_type eid = 0; eid < g.num_edges(); ++eid) {
+        sources.push_back(g.source(eid));
+        targets.push_back(g.target(eid));
+      }
+      for(vertex_id_type i = 0; i < g.num_vertices(); ++i)
+        colors.push_back(g.color(i));
+      std::vector<vertex_id_type> perm;
+      g.reorder(methods[m], perm);
+      TS_ASSERT_EQUALS(g.is_compressed(), m == 0);
+      TS_ASSERT_EQUALS(perm.size(), g.num_vertices());
+      std::vector<bool> seen(perm.size(), false);
+      for(vertex_id_type i = 0; i < perm.size(); ++i) {
+        TS_ASSERT(!seen[perm[i]]);
+        seen[perm[i]] = true;
+        TS_ASSERT_EQUALS(g.vertex_data(perm[i]), size_t(i));
+        TS_ASSERT_EQUALS(g.color(perm[i]), colors[i]);
+      }
+      TS_ASSERT(g.valid_coloring());
+      for(edge_id_type eid = 0; eid < g.num_edges(); ++eid) {
+        TS_ASSERT_EQUALS(g.source(eid), perm[sources[eid]]);
+        TS_ASSERT_EQUALS(g.target(eid), perm[targets[eid]]);
+        TS_ASSERT_EQUALS(g.edge_id(perm[sources[eid]], perm[targets[eid]]), eid);
+        TS_ASSERT_EQUALS(g.edge_data(eid), size_t(sources[eid]));
+      }
+    }
+  }
+
   void test_partition() {
     typedef graph<char, char> graph_type;
     typedef graph_type::vertex_id_type vertex_id_type;
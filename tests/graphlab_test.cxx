@@ -173,6 +173,110 @@ bool test_graphlab_colored(gl::core &glcore,
 }
 
 
+#define OPTIMISTIC_ROUNDS 20
+
+// set by the readers of the optimistic read test. 1 if every
+// neighbor they saw was consistent
+std::vector<char> optimistic_consistent;
+
+/**
+ * Even vertices write val and ucount in two steps under an edge
+ * scope, keeping val == 2 * ucount. Odd vertices only read, under
+ * the default (optimistic) read scope, and check that they never
+ * see a neighbor half way through a write.
+ */
+void optimistic_update_function(gl::iscope& scope,
+                                gl::icallback& scheduler) {
+  gl::vertex_id v = scope.vertex();
+  if (v % 2 == 0) {
+    scope.experimental_scope_upgrade(graphlab::scope_range::EDGE_CONSISTENCY);
+    vertex_data& curvdata = scope.vertex_data();
+    curvdata.val += 1;
+    for (volatile size_t i = 0; i < 100; ++i);
+    curvdata.ucount += 1;
+    curvdata.val += 1;
+    if (curvdata.ucount < OPTIMISTIC_ROUNDS) {
+      scheduler.add_task(gl::update_task(v, optimistic_update_function), 1.0);
+    }
+  }
+  else {
+    bool consistent = true;
+    bool done = true;
+    foreach(gl::edge_id eid, scope.in_edge_ids()) {
+      const vertex_data& nbrvertex =
+        scope.const_neighbor_vertex_data(scope.source(eid));
+      int val = nbrvertex.val;
+      for (volatile size_t i = 0; i < 100; ++i);
+      int ucount = nbrvertex.ucount;
+      consistent = consistent && (val == 2 * ucount);
+      done = done && (ucount >= OPTIMISTIC_ROUNDS);
+    }
+    optimistic_consistent[v] = consistent;
+    if (!done) {
+      scheduler.add_task(gl::update_task(v, optimistic_update_function), 1.0);
+    }
+  }
+}
+
+
+bool test_graphlab_optimistic(gl::core &glcore) {
+  init_graph(glcore.graph(), NUM_VERTICES);
+  optimistic_consistent.assign(NUM_VERTICES, 1);
+  glcore.engine().set_default_scope(graphlab::scope_range::READ_CONSISTENCY);
+  glcore.add_task_to_all(optimistic_update_function, 1.0);
+  glcore.start();
+  for (gl::vertex_id i = 0;i < NUM_VERTICES; ++i) {
+    if (i % 2 == 0) {
+      TS_ASSERT_EQUALS(glcore.graph().vertex_data(i).ucount, OPTIMISTIC_ROUNDS);
+    }
+    else if (!optimistic_consistent[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+#define SYNCHRONOUS_ROUNDS 10
+
+/**
+ * Sets val to one more than the largest neighbor value. Under the
+ * synchronous engine every neighbor still holds the value of the
+ * previous superstep, so after k supersteps every vertex has val k.
+ */
+void synchronous_update_function(gl::iscope& scope,
+                                 gl::icallback& scheduler) {
+  vertex_data& curvdata = scope.vertex_data();
+  int maxval = 0;
+  foreach(gl::edge_id eid, scope.in_edge_ids()) {
+    maxval = std::max(maxval,
+                      scope.const_neighbor_vertex_data(scope.source(eid)).val);
+  }
+  curvdata.val = maxval + 1;
+  curvdata.ucount += 1;
+  if (curvdata.ucount < SYNCHRONOUS_ROUNDS) {
+    scheduler.add_task(gl::update_task(scope.vertex(),
+                                       synchronous_update_function), 1.0);
+  }
+}
+
+
+bool test_graphlab_synchronous(gl::core &glcore, int rounds) {
+  init_graph(glcore.graph(), NUM_VERTICES);
+  glcore.add_task_to_all(synchronous_update_function, 1.0);
+  glcore.start();
+  TS_ASSERT_EQUALS(glcore.engine().last_update_count(),
+                   size_t(NUM_VERTICES * rounds));
+  for (gl::vertex_id i = 0;i < NUM_VERTICES; ++i) {
+    if (glcore.graph().vertex_data(i).ucount != rounds ||
+        glcore.graph().vertex_data(i).val != rounds) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 class GraphlabTestSuite: public CxxTest::TestSuite {
 public:
 
@@ -181,14 +285,15 @@ public:
     global_logger().set_log_level(LOG_WARNING);
     global_logger().set_log_to_console(true);
     
-    const char* engine_types[] = {"async"};
+    const char* engine_types[] = {"async", "async(batch_size=8)",
+                                  "async(idle=adaptive)"};
     const char* scope_types[] = {"vertex", "edge", "full"};
-    const char* schedulers[]  = {"fifo", "multiqueue_fifo", "priority", "multiqueue_priority", "sweep", "clustered_priority"};
+    const char* schedulers[]  = {"fifo", "multiqueue_fifo", "priority", "multiqueue_priority", "sweep", "clustered_priority", "work_stealing", "relaxed_priority"};
     std::cout << "\n\n\n";
     std::cout << "engine\tscheduler\tscope\tncpus" << std::endl;
-    for (size_t e = 0;e < 1; ++e) {
+    for (size_t e = 0;e < 3; ++e) {
       for (size_t c = 0; c < 3; ++c) {
-        for (size_t s = 0;s < 6; ++s) {
+        for (size_t s = 0;s < 8; ++s) {
           for (size_t n =1; n <= 4; ++n) {
             gl::core glcore;
             glcore.set_engine_type(engine_types[e]);
@@ -209,6 +314,49 @@ public:
   }
 
 
+  void test_optimistic_reads(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    std::cout << "\n\n\n";
+    std::cout << "engine\tscheduler\tncpus" << std::endl;
+    const char* schedulers[]  = {"fifo", "multiqueue_fifo"};
+    for (size_t s = 0;s < 2; ++s) {
+      for (size_t n = 1; n <= 4; ++n) {
+        gl::core glcore;
+        glcore.set_engine_type("async(optimistic_reads=1)");
+        glcore.set_scheduler_type(schedulers[s]);
+        glcore.set_scope_type("edge");
+        glcore.set_ncpus(n);
+        std::cout << "async(optimistic_reads=1)\t" << schedulers[s] << "\t"
+                  << n << std::endl;
+        TS_ASSERT_EQUALS(test_graphlab_optimistic(glcore), true);
+      }
+    }
+  }
+
+
+  void test_synchronous(void) {
+    global_logger().set_log_level(LOG_WARNING);
+    global_logger().set_log_to_console(true);
+    std::cout << "\n\n\n";
+    std::cout << "engine\tncpus" << std::endl;
+    const char* engine_types[] = {"synchronous",
+                                  "synchronous(max_iterations=5)"};
+    const int rounds[] = {SYNCHRONOUS_ROUNDS, 5};
+    for (size_t e = 0;e < 2; ++e) {
+      for (size_t n = 1; n <= 4; ++n) {
+        gl::core glcore;
+        glcore.set_engine_type(engine_types[e]);
+        glcore.set_scheduler_type("fifo");
+        glcore.set_scope_type("edge");
+        glcore.set_ncpus(n);
+        std::cout << engine_types[e] << "\t" << n << std::endl;
+        TS_ASSERT_EQUALS(test_graphlab_synchronous(glcore, rounds[e]), true);
+      }
+    }
+  }
+
+
   void test_round_robin(void) {
     global_logger().set_log_level(LOG_WARNING);
     global_logger().set_log_to_console(true);
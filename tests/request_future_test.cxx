@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/dc.hpp>
+#include <graphlab/rpc/request_future.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using namespace graphlab;
+
+
+// The requests block until released, so that the tests can act
+// before the reply arrives
+mutex request_lock;
+conditional request_cond;
+bool requests_released = true;
+
+void hold_requests() {
+  request_lock.lock();
+  requests_released = false;
+  request_lock.unlock();
+}
+
+void release_requests() {
+  request_lock.lock();
+  requests_released = true;
+  request_cond.broadcast();
+  request_lock.unlock();
+}
+
+int add_one_when_released(int x) {
+  request_lock.lock();
+  while (!requests_released) request_cond.wait(request_lock);
+  request_lock.unlock();
+  return x + 1;
+}
+
+
+// Set by the continuations. 0 until one has run
+mutex result_lock;
+conditional result_cond;
+int result = 0;
+
+void store_result(int& x) {
+  result_lock.lock();
+  result = x;
+  result_cond.signal();
+  result_lock.unlock();
+}
+
+void store_result_value(int x) {
+  store_result(x);
+}
+
+int wait_for_result() {
+  result_lock.lock();
+  while (result == 0) result_cond.wait(result_lock);
+  int ret = result;
+  result = 0;
+  result_lock.unlock();
+  return ret;
+}
+
+
+// A single machine with a port unlikely to be in use
+std::vector<std::string> local_machine() {
+  std::stringstream strm;
+  strm << "127.0.0.1:" << 20000 + getpid() % 20000;
+  return std::vector<std::string>(1, strm.str());
+}
+
+// The reply to a request returning val, as the reply handler receives it
+dc_impl::blob reply_blob(int val) {
+  boost::iostreams::stream<resizing_array_sink> strm(16);
+  oarchive oarc(strm);
+  oarc << val;
+  strm.flush();
+  return dc_impl::blob(strm->str, strm->len);
+}
+
+
+class RequestFutureTestSuite : public CxxTest::TestSuite {
+  distributed_control* dc;
+
+public:
+  // the suite is created at run time since it starts a distributed_control
+  static RequestFutureTestSuite* createSuite() {
+    return new RequestFutureTestSuite();
+  }
+
+  static void destroySuite(RequestFutureTestSuite* suite) {
+    delete suite;
+  }
+
+  RequestFutureTestSuite() {
+    dc = new distributed_control(local_machine(), "", 0);
+  }
+
+  ~RequestFutureTestSuite() {
+    delete dc;
+  }
+
+  void test_get(void) {
+    std::vector<request_future<int> > replies;
+    for (int i = 1; i <= 10; ++i) {
+      replies.push_back(dc->future_remote_request(0, add_one_when_released, i));
+    }
+    wait_all(replies);
+    for (int i = 0; i < 10; ++i) {
+      TS_ASSERT(replies[i].is_ready());
+      TS_ASSERT_EQUALS(replies[i](), i + 2);
+    }
+  }
+
+  void test_then_before_reply(void) {
+    hold_requests();
+    request_future<int> reply = dc->future_remote_request(0,
+                                                          add_one_when_released,
+                                                          41);
+    reply.then(store_result);
+    TS_ASSERT(!reply.is_ready());
+    release_requests();
+    // runs on a handler thread
+    TS_ASSERT_EQUALS(wait_for_result(), 42);
+  }
+
+  void test_then_after_reply(void) {
+    request_future<int> reply = dc->future_remote_request(0,
+                                                          add_one_when_released,
+                                                          9);
+    reply.wait();
+    reply.then(store_result);
+    // ran on this thread, before then() returned
+    result_lock.lock();
+    TS_ASSERT_EQUALS(result, 10);
+    result = 0;
+    result_lock.unlock();
+  }
+
+  void test_deferred_local_call(void) {
+    dc->deferred_local_call(boost::bind(store_result_value, 7));
+    TS_ASSERT_EQUALS(wait_for_result(), 7);
+  }
+
+  void test_release_futures_first(void) {
+    // one reference for the futures and one for the reply
+    dc_impl::future_state* state = new dc_impl::future_state;
+    {
+      request_future<int> reply(state);
+      {
+        request_future<int> copy(reply);
+        TS_ASSERT_EQUALS(state->refcount.value, 3);
+      }
+      TS_ASSERT_EQUALS(state->refcount.value, 2);
+    }
+    TS_ASSERT_EQUALS(state->refcount.value, 1);
+    // the reply handler drops the last reference
+    reply_increment_counter(*dc, 0, reinterpret_cast<size_t>(state),
+                            reply_blob(5));
+  }
+
+  void test_release_reply_first(void) {
+    dc_impl::future_state* state = new dc_impl::future_state;
+    request_future<int> reply(state);
+    reply_increment_counter(*dc, 0, reinterpret_cast<size_t>(state),
+                            reply_blob(5));
+    TS_ASSERT(reply.is_ready());
+    TS_ASSERT_EQUALS(state->refcount.value, 1);
+    TS_ASSERT_EQUALS(reply(), 5);
+    // the future drops the last reference
+  }
+
+  void test_release_with_continuation(void) {
+    dc_impl::future_state* state = new dc_impl::future_state;
+    {
+      request_future<int> reply(state);
+      reply.then(store_result);
+    }
+    // the continuation keeps the reply's reference until it has run
+    TS_ASSERT_EQUALS(state->refcount.value, 1);
+    reply_increment_counter(*dc, 0, reinterpret_cast<size_t>(state),
+                            reply_blob(3));
+    TS_ASSERT_EQUALS(wait_for_result(), 3);
+  }
+};
@@ -0,0 +1,211 @@
+/**  
+ * Copyright (c) 2009 Carnegie Mellon University. 
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <vector>
+#include <sstream>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <graphlab/rpc/receive_slab.hpp>
+#include <graphlab/rpc/shm_ring.hpp>
+#include <graphlab/parallel/pthread_tools.hpp>
+
+using namespace graphlab;
+using namespace graphlab::dc_impl;
+
+
+// writes len bytes counting up from start
+void write_pattern(receive_slab_buffer& buf, size_t len, char start) {
+  std::vector<char> c(len);
+  for (size_t i = 0; i < len; ++i) c[i] = char(start + i);
+  buf.write(&(c[0]), len);
+}
+
+bool check_pattern(const char* c, size_t len, char start) {
+  for (size_t i = 0; i < len; ++i) {
+    if (c[i] != char(start + i)) return false;
+  }
+  return true;
+}
+
+
+std::string test_ring_name() {
+  std::stringstream strm;
+  strm << "/graphlab_shm_ring_test_" << getpid();
+  return strm.str();
+}
+
+// writes len bytes counting up from 0, in chunks of varying size
+void ring_writer(shm_ring* ring, size_t len) {
+  std::vector<char> c(1000);
+  size_t written = 0;
+  size_t chunk = 1;
+  while (written < len) {
+    const size_t n = std::min(std::min(chunk, c.size()), len - written);
+    for (size_t i = 0; i < n; ++i) c[i] = char(written + i);
+    ring->write(&(c[0]), n);
+    written += n;
+    chunk = chunk * 7 % 997 + 1;
+  }
+}
+
+void ring_write_all(shm_ring* ring, const std::vector<char>* c) {
+  ring->write(&((*c)[0]), c->size());
+}
+
+
+class RPCBuffersTestSuite : public CxxTest::TestSuite {
+public:
+
+  void test_receive_slab_reuse(void) {
+    // nothing else refers to the slab, so making room moves the
+    // unconsumed bytes to its front
+    receive_slab_buffer buf;
+    write_pattern(buf, 100, 0);
+    buf.skip(90);
+    receive_slab* slab = buf.current_slab();
+    TS_ASSERT_EQUALS(slab->refcount.value, size_t(1));
+
+    size_t len = 0;
+    const size_t pending = slab->capacity - 50;
+    char* w = buf.write_ptr(len, pending);
+    TS_ASSERT_EQUALS(buf.current_slab(), slab);
+    TS_ASSERT_EQUALS(buf.read_ptr(), slab->data());
+    TS_ASSERT_EQUALS(w, slab->data() + 10);
+    TS_ASSERT(len >= pending);
+    TS_ASSERT_EQUALS(buf.size(), size_t(10));
+    TS_ASSERT(check_pattern(buf.read_ptr(), 10, 90));
+  }
+
+  void test_receive_slab_held(void) {
+    // a deferred call still holds the slab, so its bytes must not
+    // move. The unconsumed bytes go to a fresh slab instead
+    receive_slab_buffer buf;
+    write_pattern(buf, 100, 0);
+    receive_slab* slab = buf.current_slab();
+    slab->acquire();
+    const char* call = buf.read_ptr();
+    buf.skip(90);
+
+    size_t len = 0;
+    const size_t pending = slab->capacity - 50;
+    buf.write_ptr(len, pending);
+    TS_ASSERT_DIFFERS(buf.current_slab(), slab);
+    TS_ASSERT_EQUALS(buf.current_slab()->refcount.value, size_t(1));
+    TS_ASSERT(len >= pending);
+    TS_ASSERT_EQUALS(buf.size(), size_t(10));
+    TS_ASSERT(check_pattern(buf.read_ptr(), 10, 90));
+
+    // the buffer dropped its reference, the call still has its bytes
+    TS_ASSERT_EQUALS(slab->refcount.value, size_t(1));
+    TS_ASSERT(check_pattern(call, 90, 0));
+
+    // writing into the new slab leaves the old one alone too
+    write_pattern(buf, 100, 7);
+    TS_ASSERT(check_pattern(call, 90, 0));
+    slab->release();
+  }
+
+  void test_receive_slab_grow(void) {
+    // a message larger than a slab gets a slab large enough for it
+    receive_slab_buffer buf;
+    const size_t big = 3 * receive_slab_buffer::DEFAULT_SLAB_SIZE;
+    write_pattern(buf, big, 3);
+    TS_ASSERT_EQUALS(buf.size(), big);
+    TS_ASSERT(buf.current_slab()->capacity >= big);
+    TS_ASSERT(check_pattern(buf.read_ptr(), big, 3));
+  }
+
+  void test_shm_ring_stream(void) {
+    // many times the capacity passes through, so the ring wraps around
+    shm_ring* reader = shm_ring::create(test_ring_name(), 4096);
+    shm_ring* writer = shm_ring::attach(test_ring_name());
+    TS_ASSERT(writer != NULL);
+    const size_t len = 1000000;
+    thread thr;
+    thr.launch(boost::bind(ring_writer, writer, len));
+    size_t received = 0;
+    bool inorder = true;
+    while (received < len && reader->wait_for_data()) {
+      const char* c = NULL;
+      size_t n = reader->readable(c);
+      // the readable bytes never run past the end of the ring
+      TS_ASSERT(n <= 4096);
+      for (size_t i = 0; i < n; ++i) {
+        if (c[i] != char(received + i)) inorder = false;
+      }
+      reader->consume(n);
+      received += n;
+    }
+    thr.join();
+    TS_ASSERT(inorder);
+    TS_ASSERT_EQUALS(received, len);
+    const char* c = NULL;
+    TS_ASSERT_EQUALS(reader->readable(c), size_t(0));
+    delete writer;
+    delete reader;
+  }
+
+  void test_shm_ring_full(void) {
+    shm_ring* reader = shm_ring::create(test_ring_name(), 4096);
+    shm_ring* writer = shm_ring::attach(test_ring_name());
+    TS_ASSERT(writer != NULL);
+    // fill the ring exactly, starting part way in so that the
+    // readable bytes wrap around the end
+    std::vector<char> c(4096);
+    for (size_t i = 0; i < c.size(); ++i) c[i] = char(i);
+    writer->write(&(c[0]), 1000);
+    const char* ptr = NULL;
+    TS_ASSERT_EQUALS(reader->readable(ptr), size_t(1000));
+    reader->consume(1000);
+    writer->write(&(c[0]), c.size());
+    TS_ASSERT_EQUALS(reader->readable(ptr), size_t(4096 - 1000));
+    TS_ASSERT(check_pattern(ptr, 4096 - 1000, 0));
+
+    // a writer on a full ring waits until the reader makes room
+    std::vector<char> more(100, 'x');
+    thread thr;
+    thr.launch(boost::bind(ring_write_all, writer, &more));
+    usleep(100000);
+    reader->consume(4096 - 1000);
+    TS_ASSERT_EQUALS(reader->readable(ptr), size_t(1000));
+    TS_ASSERT(check_pattern(ptr, 1000, char(4096 - 1000)));
+    reader->consume(1000);
+    thr.join();
+    TS_ASSERT(reader->wait_for_data());
+    TS_ASSERT_EQUALS(reader->readable(ptr), size_t(100));
+    reader->consume(100);
+
+    // closing the ring releases a blocked writer and the reader
+    writer->write(&(c[0]), c.size());
+    thread thr2;
+    thr2.launch(boost::bind(ring_write_all, writer, &more));
+    usleep(100000);
+    reader->close();
+    thr2.join();
+    reader->consume(4096);
+    TS_ASSERT(!reader->wait_for_data());
+    TS_ASSERT(shm_ring::attach(test_ring_name()) == NULL);
+    delete writer;
+    delete reader;
+  }
+};
@@ -25,6 +25,7 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <sstream>
 #include <cstring>
 
 #include <cxxtest/TestSuite.h>
@@ -36,6 +37,8 @@
 
 
 #include <graphlab/serialization/serialization_includes.hpp>
+#include <graphlab/util/timer.hpp>
+#include <graphlab/distributed2/graph/delta_traits.hpp>
 
 
 using namespace graphlab;
@@ -345,5 +348,137 @@ public:
     TS_ASSERT(m2.find("hello") != m2.end());
     TS_ASSERT(m2.find("world") != m2.end());
   }
-};
 
+  void test_buffer_archive(void) {
+    TestClass t;
+    t.i = -10; t.j = 1 << 30;
+    for (int i = 0;i < 100; ++i) t.k.push_back(i * i - 50);
+    t.l.z = 7;
+    std::vector<std::string> strs;
+    strs.push_back("hello"); strs.push_back(""); strs.push_back("world");
+    std::map<int, double> m;
+    m[-1] = 0.5; m[100000] = 2.5;
+
+    // the buffer archive writes the same bytes as the stream archive
+    std::stringstream strm;
+    oarchive sa(strm);
+    sa << t << strs << m << (long long)(-1);
+    oarchive ba(4);
+    ba << t << strs << m << (long long)(-1);
+    std::string sstr = strm.str();
+    TS_ASSERT_EQUALS(sstr.size(), ba.size());
+    TS_ASSERT_SAME_DATA(sstr.c_str(), ba.buf, ba.size());
+
+    TestClass t2;
+    std::vector<std::string> strs2;
+    std::map<int, double> m2;
+    long long ll;
+    iarchive ia(ba.buf, ba.size());
+    ia >> t2 >> strs2 >> m2 >> ll;
+    TS_ASSERT_EQUALS(ia.off, ba.size());
+    TS_ASSERT_EQUALS(t2.i, t.i);
+    TS_ASSERT_EQUALS(t2.j, t.j);
+    TS_ASSERT_EQUALS(t2.k, t.k);
+    TS_ASSERT_EQUALS(t2.l.z, t.l.z);
+    TS_ASSERT_EQUALS(strs2, strs);
+    TS_ASSERT_EQUALS(m2, m);
+    TS_ASSERT_EQUALS(ll, -1);
+
+    // clear() reuses the buffer
+    ba.clear();
+    ba << t.j;
+    iarchive ia2(ba.buf, ba.size());
+    int j;
+    ia2 >> j;
+    TS_ASSERT_EQUALS(j, t.j);
+  }
+
+  void test_buffer_archive_overrun(void) {
+    oarchive ba;
+    ba << size_t(1000000) << std::string("truncated");
+    // all but the last byte of the integer
+    iarchive ia(ba.buf, 2);
+    size_t i = 0;
+    TS_ASSERT_THROWS(ia >> i, iarchive_buffer_overrun);
+    // all but the last byte of the string
+    iarchive ia2(ba.buf, ba.size() - 1);
+    std::string s;
+    ia2 >> i;
+    TS_ASSERT_EQUALS(i, 1000000);
+    TS_ASSERT_THROWS(ia2 >> s, iarchive_buffer_overrun);
+  }
+
+  void test_buffer_archive_benchmark(void) {
+    const size_t n = 1000000;
+    std::cout << std::endl;
+
+    graphlab::timer ti;
+    ti.start();
+    std::stringstream strm;
+    oarchive sa(strm);
+    for (size_t i = 0;i < n; ++i) sa << i << double(i);
+    double stream_write = ti.current_time();
+
+    ti.start();
+    oarchive ba;
+    for (size_t i = 0;i < n; ++i) ba << i << double(i);
+    double buffer_write = ti.current_time();
+
+    size_t i2 = 0;
+    double d2 = 0;
+    ti.start();
+    iarchive si(strm);
+    for (size_t i = 0;i < n; ++i) si >> i2 >> d2;
+    double stream_read = ti.current_time();
+    TS_ASSERT_EQUALS(i2, n - 1);
+
+    ti.start();
+    iarchive bi(ba.buf, ba.size());
+    for (size_t i = 0;i < n; ++i) bi >> i2 >> d2;
+    double buffer_read = ti.current_time();
+    TS_ASSERT_EQUALS(i2, n - 1);
+
+    const double mb = double(ba.size()) / (1024 * 1024);
+    std::cout << "stream oarchive: " << mb / stream_write << " MB/s" << std::endl;
+    std::cout << "buffer oarchive: " << mb / buffer_write << " MB/s" << std::endl;
+    std::cout << "stream iarchive: " << mb / stream_read << " MB/s" << std::endl;
+    std::cout << "buffer iarchive: " << mb / buffer_read << " MB/s" << std::endl;
+  }
+
+  void test_dense_vector_delta(void) {
+    typedef graphlab::delta_traits<std::vector<double> > traits;
+    std::vector<double> oldval(100, 1.0);
+    std::vector<double> newval(oldval);
+    newval[3] = 2.0;
+    newval[50] = 1.0005;   // within the tolerance
+    newval[99] = -1.0;
+    traits::delta_type delta;
+    TS_ASSERT(traits::diff(oldval, newval, 0.001, delta));
+    TS_ASSERT_EQUALS(delta.entries.size(), 2);
+    // the delta survives the trip through an archive
+    std::stringstream strm;
+    oarchive oarc(strm);
+    oarc << delta;
+    traits::delta_type delta2;
+    iarchive iarc(strm);
+    iarc >> delta2;
+    std::vector<double> replica(oldval);
+    traits::apply(replica, delta2);
+    TS_ASSERT_EQUALS(replica[3], 2.0);
+    TS_ASSERT_EQUALS(replica[50], 1.0);
+    TS_ASSERT_EQUALS(replica[99], -1.0);
+    // nothing beyond the tolerance. Nothing to send
+    TS_ASSERT(!traits::diff(replica, newval, 0.001, delta));
+    TS_ASSERT(traits::diff(replica, newval, 0.0, delta));
+    // a change of size replaces the whole vector
+    std::vector<double> longer(newval);
+    longer.push_back(5.0);
+    TS_ASSERT(traits::diff(newval, longer, 0.001, delta));
+    traits::apply(replica, delta);
+    TS_ASSERT(replica == longer);
+    std::vector<double> empty;
+    TS_ASSERT(traits::diff(longer, empty, 0.001, delta));
+    traits::apply(replica, delta);
+    TS_ASSERT(replica.empty());
+  }
+};
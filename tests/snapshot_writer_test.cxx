@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2009 Carnegie Mellon University.
+ *     All rights reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an "AS
+ *  IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ *  express or implied.  See the License for the specific language
+ *  governing permissions and limitations under the License.
+ *
+ * For more about this software visit:
+ *
+ *      http://www.graphlab.ml.cmu.edu
+ *
+ */
+
+
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <graphlab/distributed2/snapshot_writer.hpp>
+#include <graphlab/serialization/serialization_includes.hpp>
+
+using namespace graphlab;
+
+
+struct test_graph {
+  typedef double vertex_data_type;
+  typedef int edge_data_type;
+};
+
+typedef gl_impl::snapshot_writer<test_graph> writer_type;
+
+typedef std::pair<vertex_id_t, vertex_id_t> edge_type;
+
+// The contents of a snapshot atom. Later records overwrite earlier ones
+struct snapshot_contents {
+  std::map<vertex_id_t, std::pair<uint16_t, double> > vertices;
+  std::map<edge_type, int> edges;
+};
+
+// Reads the vertex and edge records of the atom like playback_dump()
+snapshot_contents read_snapshot(const std::string& filename) {
+  snapshot_contents ret;
+  std::ifstream in_file(filename.c_str(), std::ios::binary);
+  boost::iostreams::filtering_stream<boost::iostreams::input> fin;
+  fin.push(boost::iostreams::zlib_decompressor());
+  fin.push(in_file);
+  iarchive iarc(fin);
+  while(fin.good()) {
+    char command;
+    fin >> command;
+    if (fin.fail()) break;
+    if (command == 'c') {
+      vertex_id_t vid; uint16_t owner; std::string data;
+      iarc >> vid >> owner >> data;
+      double vdata;
+      deserialize_from_string(data, vdata);
+      ret.vertices[vid] = std::make_pair(owner, vdata);
+    }
+    else if (command == 'd') {
+      vertex_id_t src, target; uint16_t srcowner, targetowner;
+      std::string data;
+      iarc >> src >> srcowner >> target >> targetowner >> data;
+      int edata;
+      deserialize_from_string(data, edata);
+      ret.edges[edge_type(src, target)] = edata;
+    }
+    else {
+      TS_FAIL("Unexpected record in the snapshot");
+      break;
+    }
+  }
+  return ret;
+}
+
+std::string snapshot_name(const std::string& name) {
+  std::stringstream strm;
+  strm << "snapshot_writer_test_" << getpid() << "_" << name << ".dump";
+  return strm.str();
+}
+
+bool file_exists(const std::string& filename) {
+  return access(filename.c_str(), F_OK) == 0;
+}
+
+
+class SnapshotWriterTestSuite : public CxxTest::TestSuite {
+public:
+
+  void test_write_and_read_back(void) {
+    const std::string fname = snapshot_name("records");
+    writer_type writer;
+    writer.open(fname, 1);
+    TS_ASSERT(writer.is_open());
+    for (vertex_id_t v = 0; v < 1000; ++v) {
+      writer.add_vertex(v, v % 3, v * 0.5);
+      writer.add_edge(v, v % 3, (v + 1) % 1000, (v + 1) % 3, int(v) * 2);
+    }
+    // the newer record of the vertex wins on playback
+    writer.add_vertex(7, 2, -1.0);
+    TS_ASSERT_EQUALS(writer.num_records(), 2001);
+    writer.close();
+    TS_ASSERT(!writer.is_open());
+    writer.wait();
+
+    snapshot_contents contents = read_snapshot(fname);
+    TS_ASSERT_EQUALS(contents.vertices.size(), 1000);
+    TS_ASSERT_EQUALS(contents.edges.size(), 1000);
+    for (vertex_id_t v = 0; v < 1000; ++v) {
+      TS_ASSERT_EQUALS(contents.vertices[v].first, v == 7 ? 2 : v % 3);
+      TS_ASSERT_EQUALS(contents.vertices[v].second, v == 7 ? -1.0 : v * 0.5);
+      TS_ASSERT_EQUALS((contents.edges[edge_type(v, (v + 1) % 1000)]),
+                       int(v) * 2);
+    }
+    unlink(fname.c_str());
+  }
+
+  void test_open_without_waiting(void) {
+    // the first snapshot is still draining when the second opens
+    const std::string fname1 = snapshot_name("first");
+    const std::string fname2 = snapshot_name("second");
+    writer_type writer;
+    writer.open(fname1, 0);
+    for (vertex_id_t v = 0; v < 10000; ++v) writer.add_vertex(v, 0, 1.0);
+    writer.close();
+    writer.open(fname2, 0);
+    writer.add_vertex(1, 0, 2.0);
+    TS_ASSERT_EQUALS(writer.num_records(), 1);
+    writer.close();
+    writer.wait();
+
+    TS_ASSERT_EQUALS(read_snapshot(fname1).vertices.size(), 10000);
+    snapshot_contents contents = read_snapshot(fname2);
+    TS_ASSERT_EQUALS(contents.vertices.size(), 1);
+    TS_ASSERT_EQUALS(contents.vertices[1].second, 2.0);
+    unlink(fname1.c_str());
+    unlink(fname2.c_str());
+  }
+
+  void test_abandon_removes_file(void) {
+    const std::string fname = snapshot_name("abandoned");
+    writer_type writer;
+    writer.open(fname, 0);
+    for (vertex_id_t v = 0; v < 1000; ++v) writer.add_vertex(v, 0, 1.0);
+    writer.abandon();
+    TS_ASSERT(!writer.is_open());
+    writer.wait();
+    TS_ASSERT(!file_exists(fname));
+  }
+};
@@ -1,9 +1,20 @@
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/stat.h>
+#ifdef HAS_SET_AFFINITY
+#include <sched.h>
+#endif
 #include <graphlab/parallel/pthread_tools.hpp>
 #include <graphlab/parallel/thread_pool.hpp>
 #include <graphlab/parallel/thread_flip_flop.hpp>
 #include <graphlab/logger/assertions.hpp>
 #include <graphlab/util/timer.hpp>
+#include <graphlab/util/work_stealing_deque.hpp>
+#include <graphlab/util/mpsc_queue.hpp>
+#include <graphlab/parallel/numa_topology.hpp>
+#include <graphlab/parallel/spin_rwlock.hpp>
 #include <boost/bind.hpp>
 
 using namespace graphlab;
@@ -207,6 +218,325 @@ void adaptive_mutex_test() {
 
 
 
+const size_t num_deque_elements = 1000000;
+work_stealing_deque<size_t> wsdeque(16);
+atomic<size_t> wsdeque_sum;
+atomic<size_t> wsdeque_count;
+
+void deque_owner() {
+  size_t sum = 0, val = 0;
+  for (size_t i = 0; i < num_deque_elements; ++i) {
+    wsdeque.push(i);
+    // pop every third element so that the deque both grows and
+    // races the thieves for the last element
+    if (i % 3 == 0 && wsdeque.pop(val)) {
+      sum += val;
+      wsdeque_count.inc();
+    }
+  }
+  while (wsdeque.pop(val)) {
+    sum += val;
+    wsdeque_count.inc();
+  }
+  wsdeque_sum.inc(sum);
+}
+
+void deque_thief() {
+  size_t sum = 0, val = 0;
+  while (wsdeque_count.value < num_deque_elements) {
+    if (wsdeque.steal(val) == work_stealing_deque<size_t>::STEAL_SUCCESS) {
+      sum += val;
+      wsdeque_count.inc();
+    }
+  }
+  wsdeque_sum.inc(sum);
+}
+
+void work_stealing_deque_test() {
+  thread_group group;
+  group.launch(deque_owner);
+  for (size_t i = 0; i < 3; ++i) group.launch(deque_thief);
+  group.join();
+  TS_ASSERT_EQUALS(wsdeque_count.value, num_deque_elements);
+  TS_ASSERT_EQUALS(wsdeque_sum.value,
+                   num_deque_elements * (num_deque_elements - 1) / 2);
+  TS_ASSERT(wsdeque.empty());
+}
+
+
+const size_t num_mpsc_producers = 4;
+const size_t num_mpsc_elements = 200000;
+mpsc_queue<size_t> mpscqueue;
+
+// producer p enqueues p, p + nproducers, p + 2 * nproducers ...
+void mpsc_producer(size_t p) {
+  for (size_t i = p; i < num_mpsc_elements; i += num_mpsc_producers) {
+    mpscqueue.enqueue(i);
+  }
+}
+
+void mpsc_blocked_consumer(mpsc_queue<size_t>* queue, size_t* count) {
+  std::vector<size_t> batch;
+  *count = queue->dequeue_batch(batch, 64);
+}
+
+void mpsc_queue_test() {
+  thread_group group;
+  for (size_t p = 0; p < num_mpsc_producers; ++p) {
+    group.launch(boost::bind(mpsc_producer, p));
+  }
+  // take everything in batches while the producers run
+  std::vector<size_t> batch;
+  std::vector<size_t> last(num_mpsc_producers, size_t(-1));
+  size_t count = 0, sum = 0;
+  bool inorder = true;
+  while (count < num_mpsc_elements) {
+    batch.clear();
+    size_t n = mpscqueue.dequeue_batch(batch, 64);
+    TS_ASSERT(n > 0 && n <= 64);
+    TS_ASSERT_EQUALS(n, batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+      // each producer's elements arrive in the order it sent them
+      const size_t p = batch[i] % num_mpsc_producers;
+      if (last[p] != size_t(-1) && batch[i] != last[p] + num_mpsc_producers) {
+        inorder = false;
+      }
+      last[p] = batch[i];
+      sum += batch[i];
+    }
+    count += n;
+  }
+  group.join();
+  TS_ASSERT(inorder);
+  TS_ASSERT_EQUALS(count, num_mpsc_elements);
+  TS_ASSERT_EQUALS(sum, num_mpsc_elements * (num_mpsc_elements - 1) / 2);
+  TS_ASSERT(mpscqueue.empty());
+
+  // a stopped queue still hands out what is left, then returns 0
+  for (size_t i = 0; i < 100; ++i) mpscqueue.enqueue(i);
+  mpscqueue.stop_blocking();
+  TS_ASSERT(!mpscqueue.is_alive());
+  batch.clear();
+  TS_ASSERT_EQUALS(mpscqueue.dequeue_batch(batch, 64), size_t(64));
+  TS_ASSERT_EQUALS(mpscqueue.dequeue_batch(batch, 64), size_t(36));
+  TS_ASSERT_EQUALS(mpscqueue.dequeue_batch(batch, 64), size_t(0));
+  TS_ASSERT_EQUALS(batch.size(), size_t(100));
+
+  // stopping wakes a consumer parked on an empty queue
+  mpsc_queue<size_t> emptyqueue;
+  size_t blockedcount = 1;
+  thread thr;
+  thr.launch(boost::bind(mpsc_blocked_consumer, &emptyqueue, &blockedcount));
+  usleep(100000);
+  emptyqueue.stop_blocking();
+  thr.join();
+  TS_ASSERT_EQUALS(blockedcount, size_t(0));
+}
+
+
+// writers keep both halves equal. readers check they never see a
+// half finished write.
+struct rwlock_test_data {
+  size_t a;
+  size_t b;
+};
+atomic<size_t> rwlock_inconsistent;
+
+template<typename RWLock>
+void rwlock_test_helper(RWLock* lock, rwlock_test_data* data,
+                        size_t niter, bool writer) {
+  for (size_t i = 0; i < niter; ++i) {
+    if (writer) {
+      lock->writelock();
+      ++data->a;
+      ++data->b;
+      lock->unlock();
+    } else {
+      lock->readlock();
+      if (data->a != data->b) rwlock_inconsistent.inc();
+      lock->unlock();
+    }
+  }
+}
+
+/**
+ * Runs nthreads threads, half of them writers, on one lock and
+ * returns the acquires per second. With a single thread this is the
+ * uncontended rate of alternating write and read acquires.
+ */
+template<typename RWLock>
+double rwlock_benchmark(size_t nthreads, size_t niter) {
+  RWLock lock;
+  rwlock_test_data data;
+  data.a = 0; data.b = 0;
+  timer ti;
+  ti.start();
+  if (nthreads == 1) {
+    rwlock_test_helper(&lock, &data, niter, true);
+    rwlock_test_helper(&lock, &data, niter, false);
+  } else {
+    thread_group group;
+    for (size_t i = 0; i < nthreads; ++i) {
+      group.launch(boost::bind(rwlock_test_helper<RWLock>,
+                               &lock, &data, niter, i % 2 == 0));
+    }
+    group.join();
+  }
+  double runtime = ti.current_time();
+  const size_t nwriters = nthreads == 1 ? 1 : (nthreads + 1) / 2;
+  const size_t nacquires = nthreads == 1 ? 2 * niter : nthreads * niter;
+  TS_ASSERT_EQUALS(data.a, nwriters * niter);
+  TS_ASSERT_EQUALS(data.b, nwriters * niter);
+  return double(nacquires) / std::max(runtime, 1e-6);
+}
+
+void spin_rwlock_test() {
+  // the lock array entries this is meant to replace
+  TS_ASSERT_EQUALS(sizeof(spin_rwlock), size_t(4));
+  rwlock_inconsistent.value = 0;
+  std::cout << std::endl;
+  std::cout << "lock\tthreads\tacquires/s" << std::endl;
+  const size_t nthreads[] = {1, 4};
+  for (size_t i = 0; i < 2; ++i) {
+    const size_t niter = nthreads[i] == 1 ? 1000000 : 100000;
+    std::cout << "rwlock\t" << nthreads[i] << "\t"
+              << rwlock_benchmark<rwlock>(nthreads[i], niter) << std::endl;
+    std::cout << "spin_rwlock\t" << nthreads[i] << "\t"
+              << rwlock_benchmark<spin_rwlock>(nthreads[i], niter) << std::endl;
+  }
+  TS_ASSERT_EQUALS(rwlock_inconsistent.value, size_t(0));
+
+  // readers share the lock, writers exclude everyone
+  spin_rwlock lock;
+  lock.readlock();
+  TS_ASSERT(lock.try_readlock());
+  TS_ASSERT(!lock.try_writelock());
+  lock.unlock();
+  lock.unlock();
+  TS_ASSERT(lock.try_writelock());
+  TS_ASSERT(!lock.try_readlock());
+  lock.unlock();
+  TS_ASSERT(lock.try_lock());
+  lock.unlock();
+}
+
+
+void numa_topology_test() {
+  std::vector<size_t> cpus = numa_topology::parse_cpulist("0-3,8,10-11\n");
+  TS_ASSERT_EQUALS(cpus.size(), size_t(7));
+  TS_ASSERT_EQUALS(cpus[0], size_t(0));
+  TS_ASSERT_EQUALS(cpus[3], size_t(3));
+  TS_ASSERT_EQUALS(cpus[4], size_t(8));
+  TS_ASSERT_EQUALS(cpus[6], size_t(11));
+  TS_ASSERT(numa_topology::parse_cpulist("").empty());
+
+  // every worker lands on a cpu which belongs to some node
+  const numa_topology& topology = numa_topology::get();
+  TS_ASSERT(topology.num_nodes() > 0);
+  std::vector<size_t> workers = topology.worker_cpus(2 * thread::cpu_count());
+  TS_ASSERT_EQUALS(workers.size(), 2 * thread::cpu_count());
+  for (size_t i = 0; i < workers.size(); ++i) {
+    const std::vector<size_t>& nodecpus =
+      topology.cpus_of_node(topology.node_of_cpu(workers[i]));
+    TS_ASSERT(std::find(nodecpus.begin(), nodecpus.end(), workers[i]) !=
+              nodecpus.end());
+  }
+}
+
+
+void write_file(const std::string& fname, const std::string& contents) {
+  std::ofstream fout(fname.c_str());
+  fout << contents << "\n";
+}
+
+void numa_sparse_nodes_test() {
+  // a machine with nodes 0 and 2 but no node 1 and no online list
+  char dirname[] = "/tmp/numa_topology_XXXXXX";
+  TS_ASSERT(mkdtemp(dirname) != NULL);
+  const std::string dir(dirname);
+  mkdir((dir + "/node0").c_str(), 0755);
+  mkdir((dir + "/node2").c_str(), 0755);
+  write_file(dir + "/node0/cpulist", "0-1");
+  write_file(dir + "/node2/cpulist", "2-3");
+
+  numa_topology sparse(dir);
+  TS_ASSERT_EQUALS(sparse.num_nodes(), size_t(2));
+  TS_ASSERT_EQUALS(sparse.node_of_cpu(3), size_t(1));
+
+  // cpus outside the affinity mask are never handed out, and a node
+  // left with no allowed cpus disappears
+  std::vector<size_t> allowed;
+  allowed.push_back(2);
+  allowed.push_back(3);
+  numa_topology masked(dir, allowed);
+  TS_ASSERT_EQUALS(masked.num_nodes(), size_t(1));
+  std::vector<size_t> workers = masked.worker_cpus(4);
+  for (size_t i = 0; i < workers.size(); ++i) {
+    TS_ASSERT(workers[i] == 2 || workers[i] == 3);
+  }
+
+  // the online list takes precedence over the directory entries
+  write_file(dir + "/online", "2");
+  numa_topology online(dir);
+  TS_ASSERT_EQUALS(online.num_nodes(), size_t(1));
+  TS_ASSERT_EQUALS(online.cpus_of_node(0).size(), size_t(2));
+  TS_ASSERT_EQUALS(online.cpus_of_node(0)[0], size_t(2));
+
+  unlink((dir + "/online").c_str());
+  unlink((dir + "/node0/cpulist").c_str());
+  unlink((dir + "/node2/cpulist").c_str());
+  rmdir((dir + "/node0").c_str());
+  rmdir((dir + "/node2").c_str());
+  rmdir(dir.c_str());
+}
+
+
+// the cpus the calling thread may run on
+std::vector<size_t> affinity_of_current_thread() {
+  std::vector<size_t> ret;
+#ifdef HAS_SET_AFFINITY
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) ret.push_back(cpu);
+    }
+  }
+#endif
+  return ret;
+}
+
+void record_affinity(std::vector<size_t>* affinity) {
+  *affinity = affinity_of_current_thread();
+}
+
+void thread_affinity_test() {
+#ifdef HAS_SET_AFFINITY
+  // a thread launched on a cpu runs on that cpu and nowhere else
+  std::vector<size_t> allowed = affinity_of_current_thread();
+  TS_ASSERT(!allowed.empty());
+  for (size_t i = 0; i < allowed.size(); ++i) {
+    std::vector<size_t> affinity;
+    thread thr;
+    thr.launch(boost::bind(record_affinity, &affinity), allowed[i]);
+    thr.join();
+    TS_ASSERT_EQUALS(affinity.size(), size_t(1));
+    if (!affinity.empty()) TS_ASSERT_EQUALS(affinity[0], allowed[i]);
+  }
+  // and so does a worker placed by the topology
+  const size_t cpu = numa_topology::get().worker_cpus(1)[0];
+  std::vector<size_t> affinity;
+  thread thr;
+  thr.launch(boost::bind(record_affinity, &affinity), cpu);
+  thr.join();
+  TS_ASSERT_EQUALS(affinity.size(), size_t(1));
+  if (!affinity.empty()) TS_ASSERT_EQUALS(affinity[0], cpu);
+#else
+  std::cout << "pthread_setaffinity_np not available. Skipping" << std::endl;
+#endif
+}
+
+
 class ThreadToolsTestSuite : public CxxTest::TestSuite {
 public:
   void test_thread_group_exception(void) {
@@ -221,6 +551,30 @@ public:
     test_pool_exception_forwarding();
   }
 
+  void test_work_stealing_deque(void) {
+    work_stealing_deque_test();
+  }
+
+  void test_mpsc_queue(void) {
+    mpsc_queue_test();
+  }
+
+  void test_spin_rwlock(void) {
+    spin_rwlock_test();
+  }
+
+  void test_numa_topology(void) {
+    numa_topology_test();
+  }
+
+  void test_numa_sparse_nodes(void) {
+    numa_sparse_nodes_test();
+  }
+
+  void test_thread_affinity(void) {
+    thread_affinity_test();
+  }
+
 //   void test_adaptive_mutex() {
 //     adaptive_mutex_test();
 //   }